@@ -27,10 +27,14 @@
 #include <math.h>
 
 #include "check.h"
+#include "check_bench.h"
 #include "check_error.h"
 #include "check_list.h"
 #include "check_impl.h"
 #include "check_msg.h"
+#include "check_perf.h"
+#include "check_select.h"
+#include "check_alloc.h"
 
 #ifndef DEFAULT_TIMEOUT
 #define DEFAULT_TIMEOUT 4
@@ -49,12 +53,17 @@ int check_minor_version = CHECK_MINOR_VERSION;
 int check_micro_version = CHECK_MICRO_VERSION;
 
 static int non_pass(int val);
+static TF *tcase_add_tfun(TCase * tc, TFun fn, const char *name,
+                          int _signal, int allowed_exit_value, int start,
+                          int end);
 static Fixture *fixture_create(SFun fun, int ischecked);
 static void tcase_add_fixture(TCase * tc, SFun setup, SFun teardown,
                               int ischecked);
 static void tr_init(TestResult * tr);
 static void suite_free(Suite * s);
 static void tcase_free(TCase * tc);
+static void tfun_free(void *tf);
+static long limit_from_env(const char *name);
 
 Suite *suite_create(const char *name)
 {
@@ -149,14 +158,39 @@ TCase *tcase_create(const char *name)
     tc->ch_sflst = check_list_create();
     tc->unch_tflst = check_list_create();
     tc->ch_tflst = check_list_create();
+    tc->snapshot = 0;
+    tc->tags = check_list_create();
+    tc->loop_fail_fast = 0;
+    tc->memory_limit = limit_from_env("CK_MEMORY_LIMIT");
+    tc->cpu_limit = limit_from_env("CK_CPU_LIMIT");
+    tc->core_limit = limit_from_env("CK_CORE_LIMIT");
 
     return tc;
 }
 
+/* A resource limit from the environment, -1 if it is not set */
+static long limit_from_env(const char *name)
+{
+    char *env = getenv(name);
+    char *endptr = NULL;
+    long limit;
+
+    if(env == NULL)
+    {
+        return -1;
+    }
+    limit = strtol(env, &endptr, 10);
+    if(limit < 0 || endptr == env || *endptr != '\0')
+    {
+        return -1;
+    }
+    return limit;
+}
+
 
 static void tcase_free(TCase * tc)
 {
-    check_list_apply(tc->tflst, free);
+    check_list_apply(tc->tflst, tfun_free);
     check_list_apply(tc->unch_sflst, free);
     check_list_apply(tc->ch_sflst, free);
     check_list_apply(tc->unch_tflst, free);
@@ -166,24 +200,78 @@ static void tcase_free(TCase * tc)
     check_list_free(tc->ch_sflst);
     check_list_free(tc->unch_tflst);
     check_list_free(tc->ch_tflst);
+    check_list_free(tc->tags);
 
     free(tc);
 }
 
+static void tfun_free(void *tf)
+{
+    free(((TF *)tf)->sizes);
+    free(tf);
+}
+
 void suite_add_tcase(Suite * s, TCase * tc)
 {
     if(s == NULL || tc == NULL)
         return;
     check_list_add_end(s->tclst, tc);
+    test_index_changed();
 }
 
 void _tcase_add_test(TCase * tc, TFun fn, const char *name, int _signal,
                      int allowed_exit_value, int start, int end)
+{
+    tcase_add_tfun(tc, fn, name, _signal, allowed_exit_value, start, end);
+}
+
+void _tcase_add_batched_loop_test(TCase * tc, TFun fn, const char *name,
+                                  int start, int end)
+{
+    TF *tf = tcase_add_tfun(tc, fn, name, 0, 0, start, end);
+
+    if(tf != NULL)
+    {
+        tf->batched = 1;
+    }
+}
+
+void _tcase_add_bench(TCase * tc, TFun fn, const char *name)
+{
+    TF *tf = tcase_add_tfun(tc, fn, name, 0, 0, 0, 1);
+
+    if(tf != NULL)
+    {
+        tf->bench = 1;
+    }
+}
+
+void _tcase_add_complexity_test(TCase * tc, TFun fn, const char *name,
+                                const int *sizes, int nsizes,
+                                enum ck_complexity bound)
 {
     TF *tf;
 
-    if(tc == NULL || fn == NULL || name == NULL)
+    if(sizes == NULL || nsizes < 3)
         return;
+    tf = tcase_add_tfun(tc, fn, name, 0, 0, 0, 1);
+    if(tf != NULL)
+    {
+        tf->sizes = (int *)emalloc(nsizes * sizeof(int));
+        memcpy(tf->sizes, sizes, nsizes * sizeof(int));
+        tf->nsizes = nsizes;
+        tf->complexity = bound;
+    }
+}
+
+static TF *tcase_add_tfun(TCase * tc, TFun fn, const char *name,
+                          int _signal, int allowed_exit_value, int start,
+                          int end)
+{
+    TF *tf;
+
+    if(tc == NULL || fn == NULL || name == NULL)
+        return NULL;
     tf = (TF *)emalloc(sizeof(TF));   /* freed in tcase_free */
     tf->fn = fn;
     tf->loop_start = start;
@@ -191,7 +279,17 @@ void _tcase_add_test(TCase * tc, TFun fn, const char *name, int _signal,
     tf->signal = _signal;       /* 0 means no signal expected */
     tf->allowed_exit_value = (WEXITSTATUS_MASK & allowed_exit_value);   /* 0 is default successful exit */
     tf->name = name;
+    tf->failed = 0;
+    tf->nmeasured = 0;
+    tf->measured_usec = 0;
+    tf->batched = 0;
+    tf->bench = 0;
+    tf->sizes = NULL;
+    tf->nsizes = 0;
+    tf->complexity = CK_O_1;
     check_list_add_end(tc->tflst, tf);
+    test_index_changed();
+    return tf;
 }
 
 static Fixture *fixture_create(SFun fun, int ischecked)
@@ -269,16 +367,53 @@ void tcase_set_timeout(TCase * tc, double timeout)
 #endif /* HAVE_FORK */
 }
 
+void tcase_set_memory_limit(TCase * tc, long mbytes)
+{
+    tc->memory_limit = mbytes < 0 ? -1 : mbytes;
+}
+
+void tcase_set_cpu_limit(TCase * tc, long seconds)
+{
+    tc->cpu_limit = seconds < 0 ? -1 : seconds;
+}
+
+void tcase_set_core_limit(TCase * tc, long mbytes)
+{
+    tc->core_limit = mbytes < 0 ? -1 : mbytes;
+}
+
+void tcase_set_fixture_snapshot(TCase * tc, int snapshot)
+{
+    tc->snapshot = (snapshot != 0);
+}
+
+void tcase_set_loop_fail_fast(TCase * tc, int enabled)
+{
+    tc->loop_fail_fast = (enabled != 0);
+}
+
+void tcase_add_tag(TCase * tc, const char *tag)
+{
+    if(tc == NULL || tag == NULL || *tag == '\0')
+        return;
+    check_list_add_end(tc->tags, (void *)tag);
+    test_index_changed();
+}
+
 void tcase_fn_start(const char *fname CK_ATTRIBUTE_UNUSED, const char *file,
                     int line)
 {
+    alloc_pause();
     send_ctx_info(CK_CTX_TEST);
-    send_loc_info(file, line);
+    record_loc_info(file, line);
+    alloc_resume();
 }
 
 void _mark_point(const char *file, int line)
 {
-    send_loc_info(file, line);
+    alloc_pause();
+    record_loc_info(file, line);
+    alloc_resume();
 }
 
 void _ck_assert_failed(const char *file, int line, const char *expr, ...)
@@ -288,6 +423,7 @@ void _ck_assert_failed(const char *file, int line, const char *expr, ...)
     char buf[BUFSIZ];
     const char *to_send;
 
+    alloc_abort();
     send_loc_info(file, line);
 
     va_start(ap, expr);
@@ -309,7 +445,7 @@ void _ck_assert_failed(const char *file, int line, const char *expr, ...)
 
     va_end(ap);
     send_failure_info(to_send);
-    if(cur_fork_status() == CK_FORK)
+    if(cur_fork_status() == CK_FORK || cur_fork_status() == CK_FORK_BATCH)
     {
 #if defined(HAVE_FORK) && HAVE_FORK==1
         _exit(1);
@@ -326,15 +462,56 @@ SRunner *srunner_create(Suite * s)
     SRunner *sr = (SRunner *)emalloc(sizeof(SRunner));     /* freed in srunner_free */
 
     sr->slst = check_list_create();
+    sr->index = test_index_create();
     if(s != NULL)
+    {
         check_list_add_end(sr->slst, s);
+        test_index_add_suite(sr->index, s);
+    }
     sr->stats = (TestStats *)emalloc(sizeof(TestStats));     /* freed in srunner_free */
     sr->stats->n_checked = sr->stats->n_failed = sr->stats->n_errors = 0;
+    sr->stats->n_skipped = 0;
     sr->resultlst = check_list_create();
+    sr->strings = NULL;
+    sr->strings_size = sr->nstrings = 0;
     sr->log_fname = NULL;
     sr->xml_fname = NULL;
     sr->tap_fname = NULL;
+    sr->junit_fname = NULL;
+    sr->duration_fname = NULL;
+    sr->bench_fname = NULL;
+    sr->bench_save_fname = NULL;
+    sr->bench_compare_fname = NULL;
+    sr->baseline = NULL;
+    sr->new_baseline = NULL;
+    sr->bench_ratio = 0;
+    sr->bench_alpha = 0;
+    sr->history = NULL;
+    sr->junit_suite = NULL;
+    sr->filter = NULL;
+    sr->include_tags = NULL;
+    sr->exclude_tags = NULL;
+    sr->selection = NULL;
+    sr->shard_fname = NULL;
+    sr->shard = NULL;
     sr->loglst = NULL;
+    sr->log_writer = NULL;
+    sr->log_outer = NULL;
+    sr->ltrack = CK_LOC_GETENV;
+    sr->jobs = -1;
+    sr->fork_server = -1;
+    sr->fork_tcase = -1;
+    sr->perf_counters = -1;
+    sr->rusage = -1;
+    sr->alloc_tracking = -1;
+    sr->stream_results = -1;
+    sr->buffered_logs = -1;
+    sr->log_thread = -1;
+    sr->loop_chunks = -1;
+    sr->shard_index = 0;
+    sr->shard_count = -1;
+    sr->max_failures = -1;
+    sr->stopped = 0;
 
 #if defined(HAVE_FORK)
     sr->fstat = CK_FORK_GETENV;
@@ -355,12 +532,14 @@ void srunner_add_suite(SRunner * sr, Suite * s)
         return;
 
     check_list_add_end(sr->slst, s);
+    test_index_add_suite(sr->index, s);
 }
 
 void srunner_free(SRunner * sr)
 {
     List *l;
     TestResult *tr;
+    size_t i;
 
     if(sr == NULL)
         return;
@@ -372,6 +551,7 @@ void srunner_free(SRunner * sr)
         suite_free((Suite *)check_list_val(l));
     }
     check_list_free(sr->slst);
+    test_index_free(sr->index);
 
     l = sr->resultlst;
     for(check_list_front(l); !check_list_at_end(l); check_list_advance(l))
@@ -381,6 +561,12 @@ void srunner_free(SRunner * sr)
     }
     check_list_free(sr->resultlst);
 
+    for(i = 0; i < sr->strings_size; i++)
+    {
+        free(sr->strings[i]);
+    }
+    free(sr->strings);
+
     free(sr);
 }
 
@@ -394,6 +580,11 @@ int srunner_ntests_run(SRunner * sr)
     return sr->stats->n_checked;
 }
 
+int srunner_ntests_skipped(SRunner * sr)
+{
+    return sr->stats->n_skipped;
+}
+
 TestResult **srunner_failures(SRunner * sr)
 {
     int i = 0;
@@ -421,9 +612,16 @@ TestResult **srunner_results(SRunner * sr)
     TestResult **trarray;
     List *rlst;
 
-    trarray =(TestResult **) emalloc(sizeof(trarray[0]) * srunner_ntests_run(sr));
-
+    /* Streamed results have no passes, see srunner_set_stream_results */
     rlst = sr->resultlst;
+    for(check_list_front(rlst); !check_list_at_end(rlst);
+        check_list_advance(rlst))
+    {
+        i++;
+    }
+    trarray =(TestResult **) emalloc(sizeof(trarray[0]) * (i > 0 ? i : 1));
+
+    i = 0;
     for(check_list_front(rlst); !check_list_at_end(rlst);
         check_list_advance(rlst))
     {
@@ -456,12 +654,20 @@ static void tr_init(TestResult * tr)
     tr->tcname = NULL;
     tr->tname = NULL;
     tr->duration = -1;
+    memset(&tr->rusage, 0, sizeof(tr->rusage));
+    tr->rusage.utime = -1;
+    tr->bench = NULL;
+    perf_clear(&tr->perf);
+    alloc_clear(&tr->alloc);
+    tr->file_interned = 0;
 }
 
 void tr_free(TestResult * tr)
 {
-    free(tr->file);
+    if(!tr->file_interned)
+        free(tr->file);
     free(tr->msg);
+    bench_free(tr->bench);
     free(tr);
 }
 
@@ -496,11 +702,32 @@ const char *tr_tcname(TestResult * tr)
     return tr->tcname;
 }
 
+const TestRusage *tr_rusage(TestResult * tr)
+{
+    return tr->rusage.utime < 0 ? NULL : &tr->rusage;
+}
+
+const TestBench *tr_bench(TestResult * tr)
+{
+    return tr->bench;
+}
+
+const TestPerf *tr_perf(TestResult * tr)
+{
+    return tr->perf.hardware < 0 ? NULL : &tr->perf;
+}
+
+const TestAlloc *tr_alloc(TestResult * tr)
+{
+    return tr->alloc.allocations < 0 ? NULL : &tr->alloc;
+}
+
 static enum fork_status _fstat = CK_FORK;
 
 void set_fork_status(enum fork_status fstat)
 {
-    if(fstat == CK_FORK || fstat == CK_NOFORK || fstat == CK_FORK_GETENV)
+    if(fstat == CK_FORK || fstat == CK_NOFORK || fstat == CK_FORK_GETENV
+       || fstat == CK_FORK_BATCH)
         _fstat = fstat;
     else
         eprintf("Bad status in set_fork_status", __FILE__, __LINE__);
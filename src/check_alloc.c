@@ -0,0 +1,385 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "check_alloc.h"
+#include "check_msg.h"
+
+/* A block which the test allocated */
+typedef struct AllocBlock
+{
+    void *ptr;                  /* NULL for a free slot */
+    size_t size;
+} AllocBlock;
+
+static int alloc_on;
+static int alloc_wrapped;       /* whether the allocator is wrapped */
+
+static pid_t alloc_pid = -1;    /* the process which counts */
+static int alloc_depth;         /* of the test functions being run */
+static int alloc_counting;
+static int alloc_paused;
+#ifdef HAVE_PTHREAD
+static pthread_t alloc_thread;  /* the thread which is counted */
+#endif /* HAVE_PTHREAD */
+static TestAlloc alloc_counts;
+static int64_t alloc_live_bytes;
+
+/* The blocks of the test, in an open addressing table */
+static AllocBlock *alloc_table;
+static size_t alloc_table_size; /* 0 or a power of two */
+static size_t alloc_table_used;
+
+/* The budgets of the test, at the location of their checks */
+static int alloc_has_max;
+static long alloc_max;
+static const char *alloc_max_file;
+static int alloc_max_line;
+static int alloc_no_leaks;
+static const char *alloc_no_leaks_file;
+static int alloc_no_leaks_line;
+
+static void alloc_start(void);
+static int alloc_counts_here(void);
+static int alloc_counted_thread(void);
+static size_t alloc_slot(const void *ptr);
+static void alloc_insert(void *ptr, size_t size);
+static void alloc_table_grow(void);
+
+int alloc_enabled(void)
+{
+    return alloc_on;
+}
+
+void alloc_set_enabled(int enabled)
+{
+    alloc_on = enabled;
+}
+
+void alloc_begin(void)
+{
+    if(!alloc_wrapped)
+    {
+        return;
+    }
+    /* A forked process counts its own tests */
+    if(alloc_pid != getpid())
+    {
+        alloc_pid = getpid();
+        alloc_depth = 0;
+        alloc_counting = 0;
+        alloc_paused = 0;
+    }
+    /* The tests of a suite run by a test are counted with it */
+    if(alloc_depth++ > 0)
+    {
+        return;
+    }
+
+    alloc_has_max = 0;
+    alloc_no_leaks = 0;
+#ifdef HAVE_PTHREAD
+    alloc_thread = pthread_self();
+#endif /* HAVE_PTHREAD */
+    /* Otherwise counting starts with the first budget of the test */
+    alloc_counting = 0;
+    if(alloc_on)
+    {
+        alloc_start();
+    }
+}
+
+void alloc_end(void)
+{
+    TestAlloc counts;
+    size_t k;
+
+    if(alloc_depth == 0 || alloc_pid != getpid() || --alloc_depth > 0)
+    {
+        return;
+    }
+    if(!alloc_counting)
+    {
+        return;
+    }
+    alloc_counting = 0;
+
+    counts = alloc_counts;
+    for(k = 0; k < alloc_table_size; k++)
+    {
+        if(alloc_table[k].ptr != NULL)
+        {
+            counts.leaks++;
+            counts.leaked_bytes += alloc_table[k].size;
+        }
+    }
+    if(alloc_on)
+    {
+        send_alloc_info(&counts);
+    }
+
+    if(alloc_has_max && counts.allocations > alloc_max)
+    {
+        _ck_assert_failed(alloc_max_file, alloc_max_line,
+                          "Assertion 'allocations <= N' failed",
+                          "Assertion 'allocations <= %ld' failed: "
+                          "allocations == %ld", alloc_max,
+                          (long)counts.allocations, NULL);
+    }
+    if(alloc_no_leaks && counts.leaks > 0)
+    {
+        _ck_assert_failed(alloc_no_leaks_file, alloc_no_leaks_line,
+                          "Assertion 'no leaks' failed",
+                          "Assertion 'no leaks' failed: %ld blocks of "
+                          "%ld bytes leaked", (long)counts.leaks,
+                          (long)counts.leaked_bytes, NULL);
+    }
+}
+
+void alloc_abort(void)
+{
+    if(alloc_depth > 0 && alloc_pid == getpid() && --alloc_depth == 0)
+    {
+        alloc_counting = 0;
+    }
+}
+
+void alloc_pause(void)
+{
+    alloc_paused++;
+}
+
+void alloc_resume(void)
+{
+    alloc_paused--;
+}
+
+void alloc_clear(TestAlloc * alloc)
+{
+    alloc->allocations = -1;
+    alloc->frees = -1;
+    alloc->bytes = -1;
+    alloc->peak_bytes = -1;
+    alloc->leaks = -1;
+    alloc->leaked_bytes = -1;
+}
+
+void _ck_assert_alloc_count_le(const char *file, int line, long n)
+{
+    if(alloc_counts_here())
+    {
+        if(!alloc_has_max || n < alloc_max)
+        {
+            alloc_has_max = 1;
+            alloc_max = n;
+            alloc_max_file = file;
+            alloc_max_line = line;
+        }
+        _mark_point(file, line);
+        return;
+    }
+    _ck_assert_failed(file, line, "Assertion 'allocations <= N' failed",
+                      "Assertion 'allocations <= %ld' failed: "
+                      "allocations are not counted", n, NULL);
+}
+
+void _ck_assert_no_leaks(const char *file, int line)
+{
+    if(alloc_counts_here())
+    {
+        alloc_no_leaks = 1;
+        alloc_no_leaks_file = file;
+        alloc_no_leaks_line = line;
+        _mark_point(file, line);
+        return;
+    }
+    _ck_assert_failed(file, line, "Assertion 'no leaks' failed",
+                      "Assertion 'no leaks' failed: "
+                      "allocations are not counted", NULL);
+}
+
+void _ck_alloc_wrapped(void)
+{
+    alloc_wrapped = 1;
+}
+
+void _ck_alloc_note(void *ptr, size_t size)
+{
+    if(!alloc_counting || alloc_paused > 0 || !alloc_counted_thread())
+    {
+        return;
+    }
+
+    alloc_counts.allocations++;
+    alloc_counts.bytes += size;
+    alloc_live_bytes += size;
+    if(alloc_live_bytes > alloc_counts.peak_bytes)
+    {
+        alloc_counts.peak_bytes = alloc_live_bytes;
+    }
+
+    if(2 * (alloc_table_used + 1) > alloc_table_size)
+    {
+        alloc_table_grow();
+    }
+    if(2 * (alloc_table_used + 1) <= alloc_table_size)
+    {
+        alloc_insert(ptr, size);
+    }
+}
+
+void _ck_alloc_forget(void *ptr)
+{
+    size_t mask = alloc_table_size - 1;
+    size_t k;
+    size_t j;
+
+    if(!alloc_counting || alloc_table_size == 0 || !alloc_counted_thread())
+    {
+        return;
+    }
+
+    k = alloc_slot(ptr);
+    while(alloc_table[k].ptr != ptr)
+    {
+        if(alloc_table[k].ptr == NULL)
+        {
+            return;
+        }
+        k = (k + 1) & mask;
+    }
+    alloc_counts.frees++;
+    alloc_live_bytes -= alloc_table[k].size;
+
+    /* Move the blocks after it back, so that lookups find them */
+    for(j = (k + 1) & mask; alloc_table[j].ptr != NULL; j = (j + 1) & mask)
+    {
+        size_t home = alloc_slot(alloc_table[j].ptr);
+
+        if(((j - home) & mask) >= ((j - k) & mask))
+        {
+            alloc_table[k] = alloc_table[j];
+            k = j;
+        }
+    }
+    alloc_table[k].ptr = NULL;
+    alloc_table_used--;
+}
+
+/* Count the allocations of the test from now on */
+static void alloc_start(void)
+{
+    memset(&alloc_counts, 0, sizeof(alloc_counts));
+    alloc_live_bytes = 0;
+    if(alloc_table_used > 0)
+    {
+        memset(alloc_table, 0, alloc_table_size * sizeof(AllocBlock));
+        alloc_table_used = 0;
+    }
+    alloc_counting = 1;
+}
+
+/*
+ * Whether the budgets of the calling test can be checked, which starts
+ * counting if the allocations of the test are not reported
+ */
+static int alloc_counts_here(void)
+{
+    if(!alloc_wrapped || alloc_depth != 1 || alloc_pid != getpid()
+       || !alloc_counted_thread())
+    {
+        return 0;
+    }
+    if(!alloc_counting)
+    {
+        alloc_start();
+    }
+    return 1;
+}
+
+static int alloc_counted_thread(void)
+{
+#ifdef HAVE_PTHREAD
+    return pthread_equal(alloc_thread, pthread_self());
+#else
+    return 1;
+#endif /* HAVE_PTHREAD */
+}
+
+static size_t alloc_slot(const void *ptr)
+{
+    uintptr_t h = (uintptr_t)ptr;
+
+    h = (h >> 4) ^ (h >> 13) ^ (h >> 22);
+    return (size_t)h & (alloc_table_size - 1);
+}
+
+/* Add a block to a table with room for it */
+static void alloc_insert(void *ptr, size_t size)
+{
+    size_t k = alloc_slot(ptr);
+
+    /* A block freed by another thread may still be there */
+    while(alloc_table[k].ptr != NULL && alloc_table[k].ptr != ptr)
+    {
+        k = (k + 1) & (alloc_table_size - 1);
+    }
+    if(alloc_table[k].ptr == NULL)
+    {
+        alloc_table_used++;
+    }
+    alloc_table[k].ptr = ptr;
+    alloc_table[k].size = size;
+}
+
+/* The table does not count itself, as it may be wrapped too */
+static void alloc_table_grow(void)
+{
+    AllocBlock *old = alloc_table;
+    size_t old_size = alloc_table_size;
+    size_t size = old_size == 0 ? 256 : 2 * old_size;
+    AllocBlock *table;
+    size_t k;
+
+    alloc_paused++;
+    table = (AllocBlock *)calloc(size, sizeof(AllocBlock));
+    if(table == NULL)
+    {
+        alloc_paused--;
+        return;
+    }
+    alloc_table = table;
+    alloc_table_size = size;
+    alloc_table_used = 0;
+    for(k = 0; k < old_size; k++)
+    {
+        if(old[k].ptr != NULL)
+        {
+            alloc_insert(old[k].ptr, old[k].size);
+        }
+    }
+    free(old);
+    alloc_paused--;
+}
@@ -0,0 +1,55 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_ALLOC_H
+#define CHECK_ALLOC_H
+
+/*
+ * Allocation tracking (see srunner_set_alloc_tracking()): the wrappers
+ * of malloc(), calloc(), realloc() and free() in check_alloc_wrap.c
+ * call _ck_alloc_note() and _ck_alloc_forget(), which count the calls
+ * of the test function between alloc_begin() and alloc_end() if its
+ * allocations are reported or it has a budget.
+ */
+
+/* Whether the allocations of the tests of this run are reported */
+int alloc_enabled(void);
+void alloc_set_enabled(int enabled);
+
+/* Start counting the allocations of a test function */
+void alloc_begin(void);
+
+/*
+ * Stop counting, send the counts to the suite runner and check them
+ * against the budgets of the test, which may fail it
+ */
+void alloc_end(void);
+
+/* Stop counting after the test failed */
+void alloc_abort(void);
+
+/* Leave out the allocations of Check itself */
+void alloc_pause(void);
+void alloc_resume(void);
+
+/* A TestAlloc without counts */
+void alloc_clear(TestAlloc * alloc);
+
+#endif /* CHECK_ALLOC_H */
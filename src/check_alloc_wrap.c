@@ -0,0 +1,99 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * The wrappers of malloc(), calloc(), realloc() and free() which count
+ * the allocations of the tests. They are in a library of their own,
+ * check_alloc, for a test program linked with
+ * -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free, which
+ * makes its calls go to __wrap_malloc() and the others, and theirs to
+ * the functions they wrap.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <stdlib.h>
+
+#include "check.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size);
+void *__wrap_calloc(size_t nmemb, size_t size);
+void *__wrap_realloc(void *ptr, size_t size);
+void __wrap_free(void *ptr);
+
+/* Tell Check that the allocations can be counted, before main() runs */
+static void alloc_wrap_init(void) __attribute__ ((constructor));
+
+static void alloc_wrap_init(void)
+{
+    _ck_alloc_wrapped();
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+
+    if(ptr != NULL)
+    {
+        _ck_alloc_note(ptr, size);
+    }
+    return ptr;
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    void *ptr = __real_calloc(nmemb, size);
+
+    if(ptr != NULL)
+    {
+        _ck_alloc_note(ptr, nmemb * size);
+    }
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    void *new_ptr = __real_realloc(ptr, size);
+
+    /* The old block is gone unless the call failed */
+    if(ptr != NULL && (new_ptr != NULL || size == 0))
+    {
+        _ck_alloc_forget(ptr);
+    }
+    if(new_ptr != NULL)
+    {
+        _ck_alloc_note(new_ptr, size);
+    }
+    return new_ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+    if(ptr != NULL)
+    {
+        _ck_alloc_forget(ptr);
+    }
+    __real_free(ptr);
+}
@@ -0,0 +1,414 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "check_error.h"
+#include "check_str.h"
+#include "check_history.h"
+#include "check_baseline.h"
+
+/* At most this many samples of a benchmark are kept */
+#define CK_BASELINE_MAX_SAMPLES 400
+
+/*
+ * The file starts with the magic bytes, which include a version. The
+ * records follow, each one with the key of a benchmark in 8 bytes, the
+ * number of samples in 2 bytes, and the samples in 8 bytes each, in
+ * picoseconds per call. All numbers are little endian.
+ */
+static const unsigned char baseline_magic[8] =
+    { 'C', 'K', 'B', 'B', 1, 0, 0, 0 };
+
+typedef struct BaselineEntry
+{
+    uint64_t key;
+    int n;
+    double *samples;            /* in ns per call */
+} BaselineEntry;
+
+struct Baseline
+{
+    BaselineEntry *entries;
+    size_t n;
+    size_t size;
+    const char *sname;
+};
+
+/* A sample of either benchmark, when they are ranked together */
+typedef struct RankedSample
+{
+    double val;
+    int is_new;
+} RankedSample;
+
+static BaselineEntry *baseline_entry(Baseline * b, uint64_t key, int add);
+static double mann_whitney_p(const double *x, int nx, const double *y,
+                             int ny);
+static double normal_upper_tail(double z);
+static int double_cmp(const void *a, const void *b);
+static int ranked_cmp(const void *a, const void *b);
+static double median(const double *samples, int n);
+static void put_uint(unsigned char *buf, uint64_t val, int nbytes);
+static uint64_t get_uint(const unsigned char *buf, int nbytes);
+
+Baseline *baseline_load(const char *fname)
+{
+    Baseline *b = (Baseline *)emalloc(sizeof(Baseline));
+    unsigned char buf[10];
+    FILE *f;
+
+    b->entries = NULL;
+    b->n = 0;
+    b->size = 0;
+    b->sname = NULL;
+
+    f = fopen(fname, "rb");
+    if(f == NULL)
+    {
+        return b;
+    }
+
+    if(fread(buf, 1, sizeof(baseline_magic), f) == sizeof(baseline_magic)
+       && memcmp(buf, baseline_magic, sizeof(baseline_magic)) == 0)
+    {
+        /* A truncated file keeps the records before the cut */
+        while(fread(buf, 1, 10, f) == 10)
+        {
+            uint64_t key = get_uint(buf, 8);
+            int n = (int)get_uint(buf + 8, 2);
+            double *samples;
+            BaselineEntry *e;
+            int i;
+
+            if(n < 1 || n > CK_BASELINE_MAX_SAMPLES)
+            {
+                break;
+            }
+
+            samples = (double *)emalloc(n * sizeof(double));
+            for(i = 0; i < n && fread(buf, 1, 8, f) == 8; i++)
+            {
+                samples[i] = get_uint(buf, 8) / 1000.0;
+            }
+            if(i < n)
+            {
+                free(samples);
+                break;
+            }
+
+            e = baseline_entry(b, key, 1);
+            free(e->samples);
+            e->n = n;
+            e->samples = samples;
+        }
+    }
+
+    fclose(f);
+    return b;
+}
+
+int baseline_save(Baseline * b, const char *fname)
+{
+    char *tmp_name = (char *)emalloc(strlen(fname) + 5);
+    unsigned char buf[10];
+    FILE *f;
+    size_t i;
+    int rval = 0;
+
+    /* Replace the file at once, like the duration history */
+    sprintf(tmp_name, "%s.tmp", fname);
+    f = fopen(tmp_name, "wb");
+    if(f == NULL)
+    {
+        free(tmp_name);
+        return -1;
+    }
+
+    if(fwrite(baseline_magic, 1, sizeof(baseline_magic), f)
+       != sizeof(baseline_magic))
+    {
+        rval = -1;
+    }
+    for(i = 0; i < b->n && rval == 0; i++)
+    {
+        BaselineEntry *e = &b->entries[i];
+        int k;
+
+        put_uint(buf, e->key, 8);
+        put_uint(buf + 8, (uint64_t)e->n, 2);
+        if(fwrite(buf, 1, 10, f) != 10)
+        {
+            rval = -1;
+        }
+        for(k = 0; k < e->n && rval == 0; k++)
+        {
+            put_uint(buf, (uint64_t)(e->samples[k] * 1000.0 + 0.5), 8);
+            if(fwrite(buf, 1, 8, f) != 8)
+            {
+                rval = -1;
+            }
+        }
+    }
+
+    if(fclose(f) != 0)
+    {
+        rval = -1;
+    }
+    if(rval == 0)
+    {
+        rval = rename(tmp_name, fname);
+    }
+    if(rval != 0)
+    {
+        remove(tmp_name);
+    }
+    free(tmp_name);
+    return rval;
+}
+
+void baseline_free(Baseline * b)
+{
+    size_t i;
+
+    for(i = 0; i < b->n; i++)
+    {
+        free(b->entries[i].samples);
+    }
+    free(b->entries);
+    free(b);
+}
+
+void baseline_suite_start(Baseline * b, const char *sname)
+{
+    b->sname = sname;
+}
+
+void baseline_record(Baseline * b, const char *tcname, const char *tname,
+                     int iter, const TestBench * bench)
+{
+    BaselineEntry *e;
+    int n = bench->nsamples;
+
+    if(b->sname == NULL || n < 1)
+    {
+        return;
+    }
+    if(n > CK_BASELINE_MAX_SAMPLES)
+    {
+        n = CK_BASELINE_MAX_SAMPLES;
+    }
+
+    e = baseline_entry(b, history_key(b->sname, tcname, tname, iter), 1);
+    free(e->samples);
+    e->samples = (double *)emalloc(n * sizeof(double));
+    memcpy(e->samples, bench->samples, n * sizeof(double));
+    e->n = n;
+}
+
+char *baseline_compare(Baseline * b, const char *tcname, const char *tname,
+                       int iter, const TestBench * bench, double ratio,
+                       double alpha)
+{
+    BaselineEntry *e;
+    double base_median;
+    double p;
+
+    if(b->sname == NULL || bench->nsamples < 1)
+    {
+        return NULL;
+    }
+    e = baseline_entry(b, history_key(b->sname, tcname, tname, iter), 0);
+    if(e == NULL)
+    {
+        return NULL;
+    }
+
+    base_median = median(e->samples, e->n);
+    if(base_median <= 0 || bench->median < ratio * base_median)
+    {
+        return NULL;
+    }
+
+    p = mann_whitney_p(bench->samples, bench->nsamples, e->samples, e->n);
+    if(p >= alpha)
+    {
+        return NULL;
+    }
+    return ck_strdup_printf("median %.2fx slower than baseline (p<%g)",
+                            bench->median / base_median, alpha);
+}
+
+/* Look up the entry of a key, or add an empty one if 'add' is set */
+static BaselineEntry *baseline_entry(Baseline * b, uint64_t key, int add)
+{
+    size_t i;
+
+    for(i = 0; i < b->n; i++)
+    {
+        if(b->entries[i].key == key)
+        {
+            return &b->entries[i];
+        }
+    }
+
+    if(!add)
+    {
+        return NULL;
+    }
+    if(b->n == b->size)
+    {
+        b->size = b->size > 0 ? 2 * b->size : 16;
+        b->entries = (BaselineEntry *)erealloc(b->entries,
+                                               b->size *
+                                               sizeof(BaselineEntry));
+    }
+    b->entries[b->n].key = key;
+    b->entries[b->n].n = 0;
+    b->entries[b->n].samples = NULL;
+    return &b->entries[b->n++];
+}
+
+/*
+ * The p-value of the one-sided Mann-Whitney U test that the samples x
+ * tend to be larger than the samples y, with the normal approximation
+ * corrected for ties and for continuity.
+ */
+static double mann_whitney_p(const double *x, int nx, const double *y,
+                             int ny)
+{
+    int n = nx + ny;
+    RankedSample *all = (RankedSample *)emalloc(n * sizeof(RankedSample));
+    double rank_sum = 0;
+    double ties = 0;
+    double u, mean, var;
+    int i, j;
+
+    for(i = 0; i < nx; i++)
+    {
+        all[i].val = x[i];
+        all[i].is_new = 1;
+    }
+    for(i = 0; i < ny; i++)
+    {
+        all[nx + i].val = y[i];
+        all[nx + i].is_new = 0;
+    }
+    qsort(all, n, sizeof(RankedSample), ranked_cmp);
+
+    /* Equal samples all get the mean of their ranks */
+    for(i = 0; i < n; i = j)
+    {
+        double t;
+        int k;
+
+        for(j = i + 1; j < n && all[j].val == all[i].val; j++)
+            ;
+        t = j - i;
+        ties += t * t * t - t;
+        for(k = i; k < j; k++)
+        {
+            if(all[k].is_new)
+            {
+                rank_sum += (i + 1 + j) / 2.0;
+            }
+        }
+    }
+    free(all);
+
+    u = rank_sum - nx * (nx + 1) / 2.0;
+    mean = nx * (double)ny / 2.0;
+    var = nx * (double)ny / 12.0 * ((n + 1) - ties / ((double)n * (n - 1)));
+    if(var <= 0)
+    {
+        return 1.0;
+    }
+    return normal_upper_tail((u - mean - 0.5) / sqrt(var));
+}
+
+/* P(Z > z) of the standard normal distribution, to about 1e-7 */
+static double normal_upper_tail(double z)
+{
+    double x = fabs(z) / sqrt(2.0);
+    double t = 1.0 / (1.0 + 0.3275911 * x);
+    /* erfc(x), Abramowitz and Stegun 7.1.26 */
+    double erfc_x = t * (0.254829592 + t * (-0.284496736
+                                            + t * (1.421413741
+                                                   + t * (-1.453152027
+                                                          + t *
+                                                          1.061405429))))
+        * exp(-x * x);
+
+    return z >= 0 ? erfc_x / 2.0 : 1.0 - erfc_x / 2.0;
+}
+
+static int double_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int ranked_cmp(const void *a, const void *b)
+{
+    return double_cmp(&((const RankedSample *)a)->val,
+                      &((const RankedSample *)b)->val);
+}
+
+static double median(const double *samples, int n)
+{
+    double *sorted = (double *)emalloc(n * sizeof(double));
+    double m;
+
+    memcpy(sorted, samples, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), double_cmp);
+    m = n % 2 == 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    free(sorted);
+    return m;
+}
+
+static void put_uint(unsigned char *buf, uint64_t val, int nbytes)
+{
+    int i;
+
+    for(i = 0; i < nbytes; i++)
+    {
+        buf[i] = (unsigned char)(val >> (8 * i));
+    }
+}
+
+static uint64_t get_uint(const unsigned char *buf, int nbytes)
+{
+    uint64_t val = 0;
+    int i;
+
+    for(i = nbytes - 1; i >= 0; i--)
+    {
+        val = (val << 8) | buf[i];
+    }
+    return val;
+}
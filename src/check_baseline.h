@@ -0,0 +1,57 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_BASELINE_H
+#define CHECK_BASELINE_H
+
+/*
+ * The benchmark baseline (see srunner_set_bench_save() and
+ * srunner_set_bench_compare()): the samples of each benchmark of a
+ * run, kept in a file to compare later runs against. A benchmark is
+ * identified like a test in the duration history, see history_key().
+ */
+typedef struct Baseline Baseline;
+
+/* Returns an empty baseline if the file is missing or not valid */
+Baseline *baseline_load(const char *fname);
+
+/* Returns 0 on success, or -1 with errno set */
+int baseline_save(Baseline * b, const char *fname);
+
+void baseline_free(Baseline * b);
+
+/* The suite of the benchmarks passed to the functions below */
+void baseline_suite_start(Baseline * b, const char *sname);
+
+/* Keep the samples of a benchmark, in place of earlier ones */
+void baseline_record(Baseline * b, const char *tcname, const char *tname,
+                     int iter, const TestBench * bench);
+
+/*
+ * Compare a benchmark to its samples in the baseline. If its median is
+ * at least 'ratio' times the one of the baseline, and a one-sided
+ * Mann-Whitney U test finds it slower with a p-value below 'alpha',
+ * returns the message of the failure, else NULL.
+ */
+char *baseline_compare(Baseline * b, const char *tcname, const char *tname,
+                       int iter, const TestBench * bench, double ratio,
+                       double alpha);
+
+#endif /* CHECK_BASELINE_H */
@@ -0,0 +1,417 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "check_bench.h"
+#include "check_error.h"
+#include "check_list.h"
+#include "check_impl.h"
+#include "check_msg.h"
+#include "check_perf.h"
+
+/* The time of all samples, in s, unless CK_BENCH_TIME is set */
+#define CK_BENCH_TIME 0.5
+/* The number of samples, unless CK_BENCH_SAMPLES is set */
+#define CK_BENCH_SAMPLES 20
+/* Samples which are timed but not kept */
+#define CK_BENCH_WARMUP 1
+/* The number of samples of each size of a complexity test */
+#define CK_COMPLEXITY_SAMPLES 11
+/* The error a faster growing model needs, relative to a slower one */
+#define CK_COMPLEXITY_MARGIN 0.5
+/* The growth over the sizes, relative to the mean time, of a model
+   which wins over a constant time */
+#define CK_COMPLEXITY_GROWTH 0.5
+
+static int bench_running;
+static int bench_started;
+static const char *bench_file;
+static int bench_line;
+static uint64_t bench_paused_at;
+static uint64_t bench_paused_ns;
+
+static uint64_t bench_now(void);
+static uint64_t bench_time(TFun fn, int i, long n);
+static long bench_calibrate(TFun fn, int i, uint64_t target);
+static void bench_sample(TFun fn, int i, long n, int nsamples,
+                         uint64_t * sample_ns);
+static double complexity_model(enum ck_complexity c, double n);
+static const char *complexity_name(enum ck_complexity c);
+/*
+ * Find how many calls take about a sample's time, and time a warm-up
+ * sample of that many. The calls until then warm up the caches as well.
+ */
+static long bench_calibrate(TFun fn, int i, uint64_t target)
+{
+    long n = 1;
+    int k;
+
+    if(target == 0)
+    {
+        target = 1;
+    }
+
+    for(;;)
+    {
+        uint64_t t = bench_time(fn, i, n);
+        double next;
+
+        if(t >= target || n == INT_MAX)
+        {
+            break;
+        }
+        next = t > 0 ? 1.2 * n * target / t : 100.0 * n;
+        if(next > 100.0 * n)
+        {
+            next = 100.0 * n;
+        }
+        if(next > INT_MAX)
+        {
+            next = INT_MAX;
+        }
+        n = next > n ? (long)next : n + 1;
+    }
+
+    for(k = 0; k < CK_BENCH_WARMUP; k++)
+    {
+        bench_time(fn, i, n);
+    }
+    return n;
+}
+
+static void bench_sample(TFun fn, int i, long n, int nsamples,
+                         uint64_t * sample_ns)
+{
+    int k;
+
+    for(k = 0; k < nsamples; k++)
+    {
+        sample_ns[k] = bench_time(fn, i, n);
+    }
+}
+
+static double complexity_model(enum ck_complexity c, double n)
+{
+    switch (c)
+    {
+        case CK_O_1:
+            return 1;
+        case CK_O_LOG_N:
+            return log(n) / log(2.0);
+        case CK_O_N:
+            return n;
+        case CK_O_N_LOG_N:
+            return n * log(n) / log(2.0);
+        default:
+            return n * n;
+    }
+}
+
+static const char *complexity_name(enum ck_complexity c)
+{
+    switch (c)
+    {
+        case CK_O_1:
+            return "O(1)";
+        case CK_O_LOG_N:
+            return "O(log n)";
+        case CK_O_N:
+            return "O(n)";
+        case CK_O_N_LOG_N:
+            return "O(n log n)";
+        default:
+            return "O(n^2)";
+    }
+}
+
+static double bench_time_env(void);
+static int bench_samples_env(void);
+static int double_cmp(const void *a, const void *b);
+static double median_of_sorted(const double *v, int n);
+
+void _ck_bench_start(const char *fname, const char *file, int line)
+{
+    if(!bench_started)
+    {
+        bench_started = 1;
+        bench_file = file;
+        bench_line = line;
+        tcase_fn_start(fname, file, line);
+    }
+}
+
+void ck_bench_pause(void)
+{
+    if(bench_running)
+    {
+        bench_paused_at = bench_now();
+    }
+}
+
+void ck_bench_resume(void)
+{
+    if(bench_running)
+    {
+        bench_paused_ns += bench_now() - bench_paused_at;
+    }
+}
+
+void bench_run(TFun fn, int i)
+{
+    int nsamples = bench_samples_env();
+    uint64_t target = (uint64_t)(bench_time_env() * 1e9 / nsamples);
+    uint64_t *sample_ns;
+    long n;
+
+    bench_running = 1;
+    bench_started = 0;
+
+    n = bench_calibrate(fn, i, target);
+    sample_ns = (uint64_t *)emalloc(nsamples * sizeof(uint64_t));
+    /* The calibration is not counted */
+    perf_begin();
+    bench_sample(fn, i, n, nsamples, sample_ns);
+    perf_end();
+    bench_running = 0;
+
+    send_bench_info(n, nsamples, sample_ns);
+    free(sample_ns);
+}
+
+void complexity_run(TFun fn, const int *sizes, int nsizes,
+                    enum ck_complexity bound)
+{
+    uint64_t target = (uint64_t)(bench_time_env() * 1e9
+                                 / (nsizes * CK_COMPLEXITY_SAMPLES));
+    uint64_t sample_ns[CK_COMPLEXITY_SAMPLES];
+    double *t = (double *)emalloc(nsizes * sizeof(double));
+    enum ck_complexity best = CK_O_1;
+    double best_rms = -1;
+    double mean = 0;
+    int c, k;
+
+    bench_running = 1;
+    bench_started = 0;
+    for(k = 0; k < nsizes; k++)
+    {
+        double v[CK_COMPLEXITY_SAMPLES];
+        long n = bench_calibrate(fn, sizes[k], target);
+        int j;
+
+        bench_sample(fn, sizes[k], n, CK_COMPLEXITY_SAMPLES, sample_ns);
+        for(j = 0; j < CK_COMPLEXITY_SAMPLES; j++)
+        {
+            v[j] = (double)sample_ns[j] / n;
+        }
+        /* Other processes only ever add time: take the fastest */
+        qsort(v, CK_COMPLEXITY_SAMPLES, sizeof(double), double_cmp);
+        t[k] = v[0];
+        mean += t[k] / nsizes;
+    }
+    bench_running = 0;
+
+    /*
+     * Fit t = a + b * f(n) for each model by least squares, the constant
+     * a taking the fixed cost of a call. A faster growing model has to
+     * cut the error of the best slower one by CK_COMPLEXITY_MARGIN, and
+     * to grow by CK_COMPLEXITY_GROWTH at least, so that noise and drift
+     * of the times do not pick it.
+     */
+    for(c = CK_O_1; c <= CK_O_N_SQUARED; c++)
+    {
+        double fmean = 0, fmin = 0, fmax = 0, tf = 0, ff = 0, a, b;
+        double rms = 0;
+
+        for(k = 0; k < nsizes; k++)
+        {
+            double f = complexity_model((enum ck_complexity)c, sizes[k]);
+
+            fmean += f / nsizes;
+            fmin = k == 0 || f < fmin ? f : fmin;
+            fmax = k == 0 || f > fmax ? f : fmax;
+        }
+        for(k = 0; k < nsizes; k++)
+        {
+            double f = complexity_model((enum ck_complexity)c, sizes[k])
+                - fmean;
+
+            tf += (t[k] - mean) * f;
+            ff += f * f;
+        }
+        /* Times which shrink with n are constant at most */
+        b = ff > 0 && tf > 0 ? tf / ff : 0;
+        a = mean - b * fmean;
+        for(k = 0; k < nsizes; k++)
+        {
+            double d = t[k] - a - b * complexity_model((enum ck_complexity)c,
+                                                       sizes[k]);
+
+            rms += d * d / nsizes;
+        }
+        rms = sqrt(rms);
+        if(best_rms < 0 || (rms < CK_COMPLEXITY_MARGIN * best_rms
+                            && b * (fmax - fmin) >= CK_COMPLEXITY_GROWTH
+                            * mean))
+        {
+            best = (enum ck_complexity)c;
+            best_rms = rms;
+        }
+    }
+    free(t);
+
+    if(best > bound)
+    {
+        _ck_assert_failed(bench_file != NULL ? bench_file : __FILE__,
+                          bench_file != NULL ? bench_line : __LINE__,
+                          "Complexity", "Complexity %s exceeds %s "
+                          "(rms %.1f%% of mean)", complexity_name(best),
+                          complexity_name(bound),
+                          mean > 0 ? 100 * best_rms / mean : 0.0, NULL);
+    }
+}
+
+TestBench *bench_create(long iterations, int nsamples,
+                        const double *samples)
+{
+    TestBench *b = (TestBench *)emalloc(sizeof(TestBench));
+    double *sorted = (double *)emalloc(nsamples * sizeof(double));
+    double *copy = (double *)emalloc(nsamples * sizeof(double));
+    double sum = 0;
+    int k;
+
+    memcpy(copy, samples, nsamples * sizeof(double));
+    memcpy(sorted, samples, nsamples * sizeof(double));
+    qsort(sorted, nsamples, sizeof(double), double_cmp);
+    for(k = 0; k < nsamples; k++)
+    {
+        sum += sorted[k];
+    }
+
+    b->iterations = iterations;
+    b->nsamples = nsamples;
+    b->samples = copy;
+    b->min = sorted[0];
+    b->median = median_of_sorted(sorted, nsamples);
+    b->mean = sum / nsamples;
+    /* The sample of the nearest rank */
+    b->p99 = sorted[(99 * nsamples + 99) / 100 - 1];
+
+    for(k = 0; k < nsamples; k++)
+    {
+        double d = sorted[k] - b->median;
+
+        sorted[k] = d < 0 ? -d : d;
+    }
+    qsort(sorted, nsamples, sizeof(double), double_cmp);
+    b->mad = median_of_sorted(sorted, nsamples);
+
+    free(sorted);
+    return b;
+}
+
+void bench_free(TestBench * b)
+{
+    if(b != NULL)
+    {
+        free((double *)b->samples);
+        free(b);
+    }
+}
+
+static uint64_t bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(check_get_clockid(), &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* The time of n calls in ns, without the time they were paused */
+static uint64_t bench_time(TFun fn, int i, long n)
+{
+    uint64_t start;
+    uint64_t elapsed;
+    long k;
+
+    bench_paused_ns = 0;
+    start = bench_now();
+    for(k = 0; k < n; k++)
+    {
+        fn(i);
+    }
+    elapsed = bench_now() - start;
+
+    return elapsed > bench_paused_ns ? elapsed - bench_paused_ns : 0;
+}
+
+static double bench_time_env(void)
+{
+    char *env = getenv("CK_BENCH_TIME");
+
+    if(env != NULL)
+    {
+        char *endptr = NULL;
+        double tmp = strtod(env, &endptr);
+
+        if(tmp > 0 && endptr != env && (*endptr) == '\0')
+        {
+            return tmp;
+        }
+    }
+    return CK_BENCH_TIME;
+}
+
+static int bench_samples_env(void)
+{
+    char *env = getenv("CK_BENCH_SAMPLES");
+
+    if(env != NULL)
+    {
+        char *endptr = NULL;
+        long tmp = strtol(env, &endptr, 10);
+
+        if(tmp > 0 && endptr != env && (*endptr) == '\0')
+        {
+            return tmp < CK_BENCH_MAX_SAMPLES ? (int)tmp :
+                CK_BENCH_MAX_SAMPLES;
+        }
+    }
+    return CK_BENCH_SAMPLES;
+}
+
+static int double_cmp(const void *a, const void *b)
+{
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+
+    return da < db ? -1 : da > db ? 1 : 0;
+}
+
+static double median_of_sorted(const double *v, int n)
+{
+    return n % 2 == 1 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
@@ -0,0 +1,49 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_BENCH_H
+#define CHECK_BENCH_H
+
+/*
+ * Benchmarks (see tcase_add_bench()): the process of a benchmark times
+ * samples of many calls of its body and sends the time of each sample
+ * to the suite runner, which adds the statistics to its result.
+ */
+
+/* At most this many samples fit into one message */
+#define CK_BENCH_MAX_SAMPLES 400
+
+/* Run a benchmark in the process of the test, and send its samples */
+void bench_run(TFun fn, int i);
+
+/*
+ * Time a benchmark over each of the sizes, and fail if the time grows
+ * faster than the bound, see tcase_add_complexity_test()
+ */
+void complexity_run(TFun fn, const int *sizes, int nsizes,
+                    enum ck_complexity bound);
+
+/* The result of the samples, in ns per call of iterations calls each */
+TestBench *bench_create(long iterations, int nsamples,
+                        const double *samples);
+
+void bench_free(TestBench * b);
+
+#endif /* CHECK_BENCH_H */
@@ -27,6 +27,8 @@
 #include <errno.h>
 #include <setjmp.h>
 
+#include "check.h"
+#include "check_alloc.h"
 #include "check_error.h"
 
 /**
@@ -59,9 +61,11 @@ void *emalloc(size_t n)
 {
     void *p;
 
+    alloc_pause();
     p = malloc(n);
+    alloc_resume();
     if(p == NULL)
-        eprintf("malloc of %u bytes failed:", __FILE__, __LINE__ - 2, n);
+        eprintf("malloc of %u bytes failed:", __FILE__, __LINE__ - 3, n);
     return p;
 }
 
@@ -69,8 +73,10 @@ void *erealloc(void *ptr, size_t n)
 {
     void *p;
 
+    alloc_pause();
     p = realloc(ptr, n);
+    alloc_resume();
     if(p == NULL)
-        eprintf("realloc of %u bytes failed:", __FILE__, __LINE__ - 2, n);
+        eprintf("realloc of %u bytes failed:", __FILE__, __LINE__ - 3, n);
     return p;
 }
@@ -0,0 +1,415 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check_error.h"
+#include "check_history.h"
+
+/* The durations of this many runs are kept for each test */
+#define CK_HISTORY_RUNS 8
+
+/*
+ * A test is flagged when it took more than CK_HISTORY_FACTOR times, or
+ * less than a CK_HISTORY_FACTOR'th of its median, and the difference
+ * is at least CK_HISTORY_MIN_DIFF us. The median of fewer than
+ * CK_HISTORY_MIN_RUNS durations is not trusted for this.
+ */
+#define CK_HISTORY_FACTOR 3
+#define CK_HISTORY_MIN_DIFF 10000
+#define CK_HISTORY_MIN_RUNS 3
+
+/*
+ * The file starts with the magic bytes, which include a version. The
+ * records follow, each one with the key of a test in 8 bytes, the
+ * number of durations in 1 byte, and the durations in 4 bytes each,
+ * the latest first. All numbers are little endian.
+ */
+static const unsigned char history_magic[8] =
+    { 'C', 'K', 'D', 'H', 1, 0, 0, 0 };
+
+#define CK_HISTORY_RECORD_MAX (8 + 1 + 4 * CK_HISTORY_RUNS)
+
+typedef struct HistoryEntry
+{
+    uint64_t key;               /* 0 while the entry is unused */
+    int planned;                /* planned runs which have not ended */
+    int n;
+    int durations[CK_HISTORY_RUNS];
+} HistoryEntry;
+
+/* A hash table of the tests, with linear probing */
+struct History
+{
+    HistoryEntry *entries;
+    size_t size;                /* a power of two */
+    size_t used;
+    const char *sname;
+    double remaining;
+};
+
+static History *history_create(size_t size);
+static HistoryEntry *history_entry(History * h, uint64_t key, int add);
+static void history_grow(History * h);
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len);
+static int entry_median(HistoryEntry * e);
+static void put_uint(unsigned char *buf, uint64_t val, int nbytes);
+static uint64_t get_uint(const unsigned char *buf, int nbytes);
+
+History *history_load(const char *fname)
+{
+    History *h = history_create(64);
+    unsigned char buf[CK_HISTORY_RECORD_MAX];
+    FILE *f;
+
+    f = fopen(fname, "rb");
+    if(f == NULL)
+    {
+        return h;
+    }
+
+    if(fread(buf, 1, sizeof(history_magic), f) == sizeof(history_magic)
+       && memcmp(buf, history_magic, sizeof(history_magic)) == 0)
+    {
+        /* A truncated file keeps the records before the cut */
+        while(fread(buf, 1, 9, f) == 9)
+        {
+            uint64_t key = get_uint(buf, 8);
+            int n = buf[8];
+            HistoryEntry *e;
+            int i;
+
+            if(key == 0 || n < 1 || n > CK_HISTORY_RUNS
+               || fread(buf + 9, 4, n, f) != (size_t)n)
+            {
+                break;
+            }
+
+            e = history_entry(h, key, 1);
+            e->n = n;
+            for(i = 0; i < n; i++)
+            {
+                e->durations[i] = (int)get_uint(buf + 9 + 4 * i, 4);
+            }
+        }
+    }
+
+    fclose(f);
+    return h;
+}
+
+int history_save(History * h, const char *fname)
+{
+    char *tmp_name = (char *)emalloc(strlen(fname) + 5);
+    unsigned char buf[CK_HISTORY_RECORD_MAX];
+    FILE *f;
+    size_t i;
+    int rval = 0;
+
+    /* Replace the file at once, a run may be killed at any time */
+    sprintf(tmp_name, "%s.tmp", fname);
+    f = fopen(tmp_name, "wb");
+    if(f == NULL)
+    {
+        free(tmp_name);
+        return -1;
+    }
+
+    if(fwrite(history_magic, 1, sizeof(history_magic), f)
+       != sizeof(history_magic))
+    {
+        rval = -1;
+    }
+    for(i = 0; i < h->size && rval == 0; i++)
+    {
+        HistoryEntry *e = &h->entries[i];
+        size_t len;
+        int k;
+
+        if(e->key == 0 || e->n == 0)
+        {
+            continue;
+        }
+
+        put_uint(buf, e->key, 8);
+        buf[8] = (unsigned char)e->n;
+        for(k = 0; k < e->n; k++)
+        {
+            put_uint(buf + 9 + 4 * k, (uint64_t)e->durations[k], 4);
+        }
+        len = 9 + 4 * e->n;
+        if(fwrite(buf, 1, len, f) != len)
+        {
+            rval = -1;
+        }
+    }
+
+    if(fclose(f) != 0)
+    {
+        rval = -1;
+    }
+    if(rval == 0)
+    {
+        rval = rename(tmp_name, fname);
+    }
+    if(rval != 0)
+    {
+        remove(tmp_name);
+    }
+    free(tmp_name);
+    return rval;
+}
+
+void history_free(History * h)
+{
+    free(h->entries);
+    free(h);
+}
+
+int history_median(History * h, const char *sname, const char *tcname,
+                   const char *tname, int iter)
+{
+    HistoryEntry *e = history_entry(h,
+                                    history_key(sname, tcname, tname, iter),
+                                    0);
+
+    return e != NULL ? entry_median(e) : -1;
+}
+
+void history_plan(History * h, const char *sname, const char *tcname,
+                  const char *tname, int iter)
+{
+    HistoryEntry *e = history_entry(h,
+                                    history_key(sname, tcname, tname, iter),
+                                    0);
+
+    if(e != NULL && e->n > 0)
+    {
+        e->planned++;
+        h->remaining += entry_median(e);
+    }
+}
+
+void history_suite_start(History * h, const char *sname)
+{
+    h->sname = sname;
+}
+
+int history_test_end(History * h, const char *tcname, const char *tname,
+                     int iter, int duration)
+{
+    HistoryEntry *e;
+    int median;
+    int rval = -1;
+
+    if(h->sname == NULL)
+    {
+        return -1;
+    }
+
+    e = history_entry(h, history_key(h->sname, tcname, tname, iter),
+                      duration >= 0);
+    if(e == NULL)
+    {
+        return -1;
+    }
+
+    median = entry_median(e);
+    if(e->planned > 0)
+    {
+        e->planned--;
+        h->remaining -= median;
+    }
+    if(duration < 0)
+    {
+        return -1;
+    }
+
+    if(e->n >= CK_HISTORY_MIN_RUNS)
+    {
+        int diff = duration > median ? duration - median : median - duration;
+
+        if(diff >= CK_HISTORY_MIN_DIFF
+           && (duration > CK_HISTORY_FACTOR * median
+               || CK_HISTORY_FACTOR * duration < median))
+        {
+            rval = median;
+        }
+    }
+
+    memmove(e->durations + 1, e->durations,
+            (CK_HISTORY_RUNS - 1) * sizeof(e->durations[0]));
+    e->durations[0] = duration;
+    if(e->n < CK_HISTORY_RUNS)
+    {
+        e->n++;
+    }
+
+    return rval;
+}
+
+double history_remaining(History * h)
+{
+    return h->remaining > 0 ? h->remaining / 1000000.0 : 0;
+}
+
+static History *history_create(size_t size)
+{
+    History *h = (History *)emalloc(sizeof(History));
+
+    h->entries = (HistoryEntry *)emalloc(size * sizeof(HistoryEntry));
+    memset(h->entries, 0, size * sizeof(HistoryEntry));
+    h->size = size;
+    h->used = 0;
+    h->sname = NULL;
+    h->remaining = 0;
+    return h;
+}
+
+/* Look up the entry of a key, or add it if 'add' is set */
+static HistoryEntry *history_entry(History * h, uint64_t key, int add)
+{
+    size_t i;
+
+    if(add && 2 * (h->used + 1) > h->size)
+    {
+        history_grow(h);
+    }
+
+    for(i = (size_t)key & (h->size - 1); h->entries[i].key != 0;
+        i = (i + 1) & (h->size - 1))
+    {
+        if(h->entries[i].key == key)
+        {
+            return &h->entries[i];
+        }
+    }
+
+    if(!add)
+    {
+        return NULL;
+    }
+    h->entries[i].key = key;
+    h->used++;
+    return &h->entries[i];
+}
+
+static void history_grow(History * h)
+{
+    HistoryEntry *old = h->entries;
+    size_t old_size = h->size;
+    size_t i;
+
+    h->size *= 2;
+    h->entries = (HistoryEntry *)emalloc(h->size * sizeof(HistoryEntry));
+    memset(h->entries, 0, h->size * sizeof(HistoryEntry));
+    h->used = 0;
+    for(i = 0; i < old_size; i++)
+    {
+        if(old[i].key != 0)
+        {
+            *history_entry(h, old[i].key, 1) = old[i];
+        }
+    }
+    free(old);
+}
+
+uint64_t history_key(const char *sname, const char *tcname,
+                     const char *tname, int iter)
+{
+    unsigned char iter_bytes[4];
+    uint64_t key = 14695981039346656037ULL;     /* FNV-1a */
+
+    put_uint(iter_bytes, (uint64_t)(unsigned int)iter, 4);
+    key = hash_bytes(key, sname, strlen(sname) + 1);
+    key = hash_bytes(key, tcname, strlen(tcname) + 1);
+    key = hash_bytes(key, tname, strlen(tname) + 1);
+    key = hash_bytes(key, iter_bytes, sizeof(iter_bytes));
+
+    /* 0 marks unused entries */
+    return key != 0 ? key : 1;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i;
+
+    for(i = 0; i < len; i++)
+    {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int entry_median(HistoryEntry * e)
+{
+    int sorted[CK_HISTORY_RUNS];
+    int i;
+
+    if(e->n == 0)
+    {
+        return -1;
+    }
+
+    for(i = 0; i < e->n; i++)
+    {
+        int k;
+
+        for(k = i; k > 0 && sorted[k - 1] > e->durations[i]; k--)
+        {
+            sorted[k] = sorted[k - 1];
+        }
+        sorted[k] = e->durations[i];
+    }
+
+    if(e->n % 2 == 1)
+    {
+        return sorted[e->n / 2];
+    }
+    return (sorted[e->n / 2 - 1] + sorted[e->n / 2]) / 2;
+}
+
+static void put_uint(unsigned char *buf, uint64_t val, int nbytes)
+{
+    int i;
+
+    for(i = 0; i < nbytes; i++)
+    {
+        buf[i] = (unsigned char)(val >> (8 * i));
+    }
+}
+
+static uint64_t get_uint(const unsigned char *buf, int nbytes)
+{
+    uint64_t val = 0;
+    int i;
+
+    for(i = nbytes - 1; i >= 0; i--)
+    {
+        val = (val << 8) | buf[i];
+    }
+    return val;
+}
@@ -0,0 +1,67 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_HISTORY_H
+#define CHECK_HISTORY_H
+
+/*
+ * The duration history (see srunner_set_duration_file()): the
+ * durations of the last runs of each test, kept in a file from one
+ * run to the next. A test is identified by the names of its suite,
+ * test case and function, and by its iteration.
+ */
+typedef struct History History;
+
+/* The key of a test, never 0, also used to assign tests to shards */
+uint64_t history_key(const char *sname, const char *tcname,
+                     const char *tname, int iter);
+
+/* Returns an empty history if the file is missing or not valid */
+History *history_load(const char *fname);
+
+/* Returns 0 on success, or -1 with errno set */
+int history_save(History * h, const char *fname);
+
+void history_free(History * h);
+
+/* The median of the recorded durations of a test in us, or -1 */
+int history_median(History * h, const char *sname, const char *tcname,
+                   const char *tname, int iter);
+
+/* A test which is going to run, see history_remaining() */
+void history_plan(History * h, const char *sname, const char *tcname,
+                  const char *tname, int iter);
+
+/* The suite of the tests passed to history_test_end() */
+void history_suite_start(History * h, const char *sname);
+
+/*
+ * A test has ended, with a negative duration unless it passed. The
+ * duration of a passed test is recorded. Returns the median of the
+ * earlier durations if the test took far more or far less time than
+ * that, or -1.
+ */
+int history_test_end(History * h, const char *tcname, const char *tname,
+                     int iter, int duration);
+
+/* The median durations of the planned tests which have not ended, in s */
+double history_remaining(History * h);
+
+#endif /* CHECK_HISTORY_H */
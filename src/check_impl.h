@@ -42,6 +42,14 @@ typedef struct TF
     const char *name;
     int signal;
     signed char allowed_exit_value;
+    int failed;                 /* an iteration failed in this run */
+    int nmeasured;              /* iterations which ended in this run */
+    long measured_usec;         /* and their total duration */
+    int batched;                /* its iterations share a process */
+    int bench;                  /* a benchmark, see bench_run() */
+    int *sizes;                 /* the sizes of a complexity test, see */
+    int nsizes;                 /* complexity_run(), or NULL and 0 */
+    enum ck_complexity complexity;
 } TF;
 
 struct Suite
@@ -65,6 +73,12 @@ struct TCase
     List *unch_tflst;
     List *ch_sflst;
     List *ch_tflst;
+    int snapshot;               /* run the checked setup only once */
+    List *tags;                 /* list of tag strings */
+    int loop_fail_fast;         /* skip iterations after a failed one */
+    long memory_limit;          /* in megabytes, -1 if not set */
+    long cpu_limit;             /* in seconds, -1 if not set */
+    long core_limit;            /* in megabytes, -1 if not set */
 };
 
 typedef struct TestStats
@@ -72,6 +86,7 @@ typedef struct TestStats
     int n_checked;
     int n_failed;
     int n_errors;
+    int n_skipped;              /* tests which were not run */
 } TestStats;
 
 struct TestResult
@@ -82,6 +97,11 @@ struct TestResult
     int line;                   /* Line number where the test occurred */
     int iter;                   /* The iteration value for looping tests */
     int duration;               /* duration of this test in microseconds */
+    TestRusage rusage;          /* utime is -1 if it is not known */
+    TestBench *bench;           /* NULL unless the result of a benchmark */
+    TestPerf perf;              /* hardware is -1 if it was not counted */
+    TestAlloc alloc;            /* allocations is -1 if not reported */
+    int file_interned;          /* file belongs to the suite runner */
     const char *tcname;         /* Test case that generated the result */
     const char *tname;          /* Test that generated the result */
     char *msg;                  /* Failure message */
@@ -100,7 +120,8 @@ enum cl_event
     CLEND_SR,                   /* Suite runner end */
     CLEND_S,                    /* Suite end */
     CLSTART_T,                  /* A test case is about to run */
-    CLEND_T                     /* Test case end */
+    CLEND_T,                    /* Test case end */
+    CLSKIP_T                    /* A test case which is not run */
 };
 
 typedef void (*LFun) (SRunner *, FILE *, enum print_output,
@@ -112,6 +133,10 @@ typedef struct Log
     LFun lfun;
     int close;
     enum print_output mode;
+    FILE *out;                  /* the file of a buffered log, lfile being
+                                   its memory stream, or NULL */
+    char *buf;                  /* the buffer of the memory stream */
+    size_t len;
 } Log;
 
 struct SRunner
@@ -119,13 +144,103 @@ struct SRunner
     List *slst;                 /* List of Suite objects */
     TestStats *stats;           /* Run statistics */
     List *resultlst;            /* List of unit test results */
+    char **strings;             /* interned strings of the results, a
+                                   hash set with linear probing */
+    size_t strings_size;        /* a power of two, or 0 */
+    size_t nstrings;
     const char *log_fname;      /* name of log file */
     const char *xml_fname;      /* name of xml output file */
     const char *tap_fname;      /* name of tap output file */
+    const char *junit_fname;    /* name of JUnit XML output file */
+    const char *duration_fname; /* name of the duration history file */
+    const char *bench_fname;    /* name of the benchmark times file */
+    const char *bench_save_fname;       /* name of the baseline to save */
+    const char *bench_compare_fname;    /* name of the baseline to compare
+                                           to */
+    struct Baseline *baseline;  /* the baseline compared to during a run */
+    struct Baseline *new_baseline;      /* the baseline saved after a run */
+    double bench_ratio;         /* the ratio of the medians from which a
+                                   benchmark is slower than its baseline,
+                                   0 to use CK_BENCH_RATIO */
+    double bench_alpha;         /* the p-value below which a benchmark is
+                                   slower than its baseline, 0 to use
+                                   CK_BENCH_ALPHA */
+    struct History *history;    /* the duration history during a run */
+    struct JUnitSuite *junit_suite;     /* the suite being written to the
+                                           JUnit log during a run */
+    const char *filter;         /* patterns of the tests to run */
+    const char *include_tags;   /* tags of the test cases to run */
+    const char *exclude_tags;   /* tags of the test cases to skip */
+    struct TestIndex *index;    /* the suites, test cases and tests by
+                                   name and tag */
+    struct Selection *selection;        /* the tests to run during a run */
+    const char *shard_fname;    /* name of the shard summary file */
+    struct Shard *shard;        /* the tests of this shard during a run */
     List *loglst;               /* list of Log objects */
+    struct LogWriter *log_writer;       /* writes the buffered logs during
+                                           a run */
+    struct timespec log_flushed;        /* when the buffered logs were
+                                           last written */
+    struct SRunner *log_outer;  /* the run with buffered logs around this
+                                   one */
     enum fork_status fstat;     /* controls if suites are forked or not
                                    NOTE: Don't use this value directly,
                                    instead use srunner_fork_status */
+    enum loc_tracking ltrack;   /* how passing check locations are tracked
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_loc_tracking */
+    int jobs;                   /* number of tests run at the same time,
+                                   -1 to use CK_JOBS
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_jobs */
+    int fork_server;            /* whether tests are forked by a fork
+                                   server, -1 to use CK_FORK_SERVER
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_fork_server */
+    int fork_tcase;             /* whether each test case runs in its own
+                                   process, -1 to use CK_FORK_TCASE
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_fork_tcase */
+    int perf_counters;          /* whether tests are counted, -1 to use
+                                   CK_PERF_COUNTERS
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_perf_counters */
+    int rusage;                 /* whether the resource usage is kept, -1
+                                   to use CK_RUSAGE
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_rusage */
+    int alloc_tracking;         /* whether allocations are reported, -1 to
+                                   use CK_ALLOC_TRACKING
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_alloc_tracking */
+    int stream_results;         /* whether only failures are kept, -1 to
+                                   use CK_STREAM_RESULTS
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_stream_results */
+    int buffered_logs;          /* whether log files are buffered, -1 to
+                                   use CK_BUFFERED_LOGS
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_buffered_logs */
+    int log_thread;             /* whether log files are written by a
+                                   thread, -1 to use CK_LOG_THREAD
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_log_thread */
+    int loop_chunks;            /* whether loop tests run in chunks, -1 to
+                                   use CK_LOOP_CHUNKS
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_loop_chunks */
+    int shard_index;            /* the shard of the tests which are run */
+    int shard_count;            /* number of shards, -1 to use
+                                   CK_SHARD_INDEX and CK_SHARD_COUNT
+                                   NOTE: Don't use these values directly,
+                                   instead use srunner_shard_index and
+                                   srunner_shard_count */
+    int max_failures;           /* failures and errors after which the run
+                                   stops, 0 for no limit, -1 to use
+                                   CK_MAX_FAILURES
+                                   NOTE: Don't use this value directly,
+                                   instead use srunner_max_failures */
+    int stopped;                /* the run reached max_failures */
 };
 
 
@@ -28,11 +28,14 @@
 #endif
 
 #include "check_error.h"
+#include "check_baseline.h"
+#include "check_history.h"
 #include "check_list.h"
 #include "check_impl.h"
 #include "check_log.h"
 #include "check_print.h"
 #include "check_str.h"
+#include "check_writer.h"
 
 /*
  * If a log file is specified to be "-", then instead of
@@ -40,7 +43,28 @@
  */
 #define STDOUT_OVERRIDE_LOG_FILE_NAME "-"
 
+/*
+ * Buffered log files are written to memory streams, which are handed
+ * over to the log writer once one of them holds LOG_FLUSH_SIZE bytes,
+ * once LOG_FLUSH_INTERVAL seconds have passed since the last time, at
+ * the end of each suite, and at exit. Runs in CK_NOFORK mode are not
+ * buffered, as a test may crash the suite runner.
+ */
+#if defined(HAVE_OPEN_MEMSTREAM)
+#define CK_BUFFERED_LOGS 1
+#else
+#define CK_BUFFERED_LOGS 0
+#endif
+
+#define LOG_FLUSH_SIZE (64 * 1024)
+#define LOG_FLUSH_INTERVAL 1
+
 static void srunner_send_evt(SRunner * sr, void *obj, enum cl_event evt);
+#if CK_BUFFERED_LOGS
+static void srunner_buffer_logs(SRunner * sr);
+static void srunner_flush_logs(SRunner * sr, int force);
+static void srunner_unbuffer_logs(SRunner * sr);
+#endif /* CK_BUFFERED_LOGS */
 
 void srunner_set_log(SRunner * sr, const char *fname)
 {
@@ -110,6 +134,153 @@ const char *srunner_tap_fname(SRunner * sr)
     return getenv("CK_TAP_LOG_FILE_NAME");
 }
 
+void srunner_set_junit(SRunner * sr, const char *fname)
+{
+    if(sr->junit_fname)
+        return;
+    sr->junit_fname = fname;
+}
+
+int srunner_has_junit(SRunner * sr)
+{
+    return srunner_junit_fname(sr) != NULL;
+}
+
+const char *srunner_junit_fname(SRunner * sr)
+{
+    /* check if JUnit log filename have been set explicitly */
+    if(sr->junit_fname != NULL)
+    {
+        return sr->junit_fname;
+    }
+
+    return getenv("CK_JUNIT_LOG_FILE_NAME");
+}
+
+void srunner_set_duration_file(SRunner * sr, const char *fname)
+{
+    if(sr->duration_fname)
+        return;
+    sr->duration_fname = fname;
+}
+
+int srunner_has_duration_file(SRunner * sr)
+{
+    return srunner_duration_fname(sr) != NULL;
+}
+
+const char *srunner_duration_fname(SRunner * sr)
+{
+    /* check if the duration filename has been set explicitly */
+    if(sr->duration_fname != NULL)
+    {
+        return sr->duration_fname;
+    }
+
+    return getenv("CK_DURATION_FILE_NAME");
+}
+
+void srunner_set_bench_file(SRunner * sr, const char *fname)
+{
+    if(sr->bench_fname)
+        return;
+    sr->bench_fname = fname;
+}
+
+int srunner_has_bench_file(SRunner * sr)
+{
+    return srunner_bench_fname(sr) != NULL;
+}
+
+const char *srunner_bench_fname(SRunner * sr)
+{
+    /* check if the benchmark filename has been set explicitly */
+    if(sr->bench_fname != NULL)
+    {
+        return sr->bench_fname;
+    }
+
+    return getenv("CK_BENCH_FILE_NAME");
+}
+
+void srunner_set_bench_save(SRunner * sr, const char *fname)
+{
+    if(sr->bench_save_fname)
+        return;
+    sr->bench_save_fname = fname;
+}
+
+int srunner_has_bench_save(SRunner * sr)
+{
+    return srunner_bench_save_fname(sr) != NULL;
+}
+
+const char *srunner_bench_save_fname(SRunner * sr)
+{
+    /* check if the baseline filename has been set explicitly */
+    if(sr->bench_save_fname != NULL)
+    {
+        return sr->bench_save_fname;
+    }
+
+    return getenv("CK_BENCH_SAVE");
+}
+
+void srunner_set_bench_compare(SRunner * sr, const char *fname)
+{
+    if(sr->bench_compare_fname)
+        return;
+    sr->bench_compare_fname = fname;
+}
+
+int srunner_has_bench_compare(SRunner * sr)
+{
+    return srunner_bench_compare_fname(sr) != NULL;
+}
+
+const char *srunner_bench_compare_fname(SRunner * sr)
+{
+    /* check if the baseline filename has been set explicitly */
+    if(sr->bench_compare_fname != NULL)
+    {
+        return sr->bench_compare_fname;
+    }
+
+    return getenv("CK_BENCH_COMPARE");
+}
+
+int srunner_buffered_logs(SRunner * sr)
+{
+    if(sr->buffered_logs < 0)
+    {
+        char *env = getenv("CK_BUFFERED_LOGS");
+
+        return env != NULL && strcmp(env, "yes") == 0;
+    }
+    return sr->buffered_logs;
+}
+
+void srunner_set_buffered_logs(SRunner * sr, int enabled)
+{
+    sr->buffered_logs = enabled < 0 ? -1 : enabled != 0;
+}
+
+int srunner_log_thread(SRunner * sr)
+{
+    if(sr->log_thread < 0)
+    {
+        char *env = getenv("CK_LOG_THREAD");
+
+        return env != NULL && strcmp(env, "yes") == 0;
+    }
+    return sr->log_thread;
+}
+
+void srunner_set_log_thread(SRunner * sr, int enabled)
+{
+    sr->log_thread = enabled < 0 ? -1 : enabled != 0;
+}
+
 void srunner_register_lfun(SRunner * sr, FILE * lfile, int close,
                            LFun lfun, enum print_output printmode)
 {
@@ -124,6 +295,9 @@ void srunner_register_lfun(SRunner * sr, FILE * lfile, int close,
     l->lfun = lfun;
     l->close = close;
     l->mode = printmode;
+    l->out = NULL;
+    l->buf = NULL;
+    l->len = 0;
     check_list_add_end(sr->loglst, l);
     return;
 }
@@ -161,6 +335,11 @@ void log_test_end(SRunner * sr, TestResult * tr)
     srunner_send_evt(sr, tr, CLEND_T);
 }
 
+void log_test_skip(SRunner * sr, TestResult * tr)
+{
+    srunner_send_evt(sr, tr, CLSKIP_T);
+}
+
 static void srunner_send_evt(SRunner * sr, void *obj, enum cl_event evt)
 {
     List *l;
@@ -170,15 +349,27 @@ static void srunner_send_evt(SRunner * sr, void *obj, enum cl_event evt)
     for(check_list_front(l); !check_list_at_end(l); check_list_advance(l))
     {
         lg = (Log *)check_list_val(l);
+        if(lg->out != NULL)
+        {
+            lg->lfun(sr, lg->lfile, lg->mode, obj, evt);
+            continue;
+        }
         fflush(lg->lfile);
         lg->lfun(sr, lg->lfile, lg->mode, obj, evt);
         fflush(lg->lfile);
     }
+#if CK_BUFFERED_LOGS
+    if(sr->log_writer != NULL)
+    {
+        srunner_flush_logs(sr, evt == CLEND_S || evt == CLENDLOG_SR);
+    }
+#endif /* CK_BUFFERED_LOGS */
 }
 
 void stdout_lfun(SRunner * sr, FILE * file, enum print_output printmode,
                  void *obj, enum cl_event evt)
 {
+    TestResult *tr;
     Suite *s;
 
     switch (evt)
@@ -215,6 +406,15 @@ void stdout_lfun(SRunner * sr, FILE * file, enum print_output printmode,
         case CLSTART_T:
             break;
         case CLEND_T:
+            tr = (TestResult *)obj;
+            /* Streamed passes are not there to be printed at the end */
+            if(printmode >= CK_VERBOSE && tr->rtype == CK_PASS
+               && srunner_stream_results(sr))
+            {
+                tr_fprint(file, tr, printmode);
+            }
+            break;
+        case CLSKIP_T:
             break;
         default:
             eprintf("Bad event type received in stdout_lfun", __FILE__,
@@ -224,6 +424,96 @@ void stdout_lfun(SRunner * sr, FILE * file, enum print_output printmode,
 
 }
 
+/* Whether a result has more than tr_fprint() shows, see below */
+static int tr_has_details(TestResult * tr)
+{
+    return tr->rusage.utime >= 0 || tr->bench != NULL
+        || tr->perf.hardware >= 0 || tr->alloc.allocations >= 0;
+}
+
+/* The test name and iteration a line of details starts with */
+static void tr_fprint_detail_name(FILE * file, TestResult * tr, int xml)
+{
+    if(xml)
+        fprint_xml_esc(file, tr->tname);
+    else
+        fputs(tr->tname, file);
+    fprintf(file, ":%d: ", tr->iter);
+}
+
+/*
+ * The resources, benchmark statistics, perf counts and allocations of
+ * a test, a line each, after its result which has the test case name.
+ * The test name is escaped for XML if 'xml' is set.
+ */
+static void tr_fprint_details(FILE * file, TestResult * tr, int xml)
+{
+    if(tr->rusage.utime >= 0)
+    {
+        const TestRusage *ru = &tr->rusage;
+
+        tr_fprint_detail_name(file, tr, xml);
+        fprintf(file, "Usage: user %ld.%06lds, "
+                "sys %ld.%06lds, maxrss %ldkB, minflt %ld, "
+                "majflt %ld, nvcsw %ld, nivcsw %ld, inblock %ld, "
+                "oublock %ld\n",
+                ru->utime / US_PER_SEC, ru->utime % US_PER_SEC,
+                ru->stime / US_PER_SEC, ru->stime % US_PER_SEC,
+                ru->maxrss, ru->minflt, ru->majflt, ru->nvcsw,
+                ru->nivcsw, ru->inblock, ru->oublock);
+    }
+    if(tr->bench != NULL)
+    {
+        const TestBench *b = tr->bench;
+
+        tr_fprint_detail_name(file, tr, xml);
+        fprintf(file, "Bench: %ld iterations x %d samples, "
+                "min %.3f ns/op, median %.3f ns/op, "
+                "mean %.3f ns/op, MAD %.3f ns/op, p99 %.3f ns/op\n",
+                b->iterations, b->nsamples,
+                b->min, b->median, b->mean, b->mad, b->p99);
+    }
+    if(tr->perf.hardware >= 0)
+    {
+        const TestPerf *p = &tr->perf;
+        /* The counts of a benchmark are per operation */
+        double ops = tr->bench == NULL ? 1.0 :
+            (double)tr->bench->iterations * tr->bench->nsamples;
+        int digits = tr->bench != NULL;
+
+        tr_fprint_detail_name(file, tr, xml);
+        if(p->hardware)
+        {
+            fprintf(file, "Perf: cycles %.*f, "
+                    "instructions %.*f, branch-misses %.*f, "
+                    "cache-misses %.*f\n",
+                    digits, p->cycles / ops,
+                    digits, p->instructions / ops,
+                    digits, p->branch_misses / ops,
+                    digits, p->cache_misses / ops);
+        }
+        else
+        {
+            fprintf(file, "Perf: task-clock %.*fns, "
+                    "page-faults %.*f, context-switches %.*f\n",
+                    digits, p->task_clock / ops,
+                    digits, p->page_faults / ops,
+                    digits, p->context_switches / ops);
+        }
+    }
+    if(tr->alloc.allocations >= 0)
+    {
+        const TestAlloc *a = &tr->alloc;
+
+        tr_fprint_detail_name(file, tr, xml);
+        fprintf(file, "Alloc: allocations %ld, frees %ld, "
+                "bytes %ld, peak %ld bytes, leaks %ld of %ld "
+                "bytes\n", (long)a->allocations,
+                (long)a->frees, (long)a->bytes, (long)a->peak_bytes,
+                (long)a->leaks, (long)a->leaked_bytes);
+    }
+}
+
 void lfile_lfun(SRunner * sr, FILE * file,
                 enum print_output printmode CK_ATTRIBUTE_UNUSED, void *obj,
                 enum cl_event evt)
@@ -254,6 +544,12 @@ void lfile_lfun(SRunner * sr, FILE * file,
         case CLEND_T:
             tr = (TestResult *)obj;
             tr_fprint(file, tr, CK_VERBOSE);
+            tr_fprint_details(file, tr, 0);
+            break;
+        case CLSKIP_T:
+            tr = (TestResult *)obj;
+            fprintf(file, "%s:%s:%d: Skipped: %s\n", tr->tcname, tr->tname,
+                    tr->iter, tr->msg);
             break;
         default:
             eprintf("Bad event type received in lfile_lfun", __FILE__,
@@ -307,6 +603,7 @@ void xml_lfun(SRunner * sr CK_ATTRIBUTE_UNUSED, FILE * file,
             fprintf(file, "  <duration>%lu.%06lu</duration>\n",
                     duration / US_PER_SEC, duration % US_PER_SEC);
             fprintf(file, "</testsuites>\n");
+            tr_xmlprint_free();
         }
             break;
         case CLSTART_SR:
@@ -326,6 +623,7 @@ void xml_lfun(SRunner * sr CK_ATTRIBUTE_UNUSED, FILE * file,
         case CLSTART_T:
             break;
         case CLEND_T:
+        case CLSKIP_T:
             tr = (TestResult *)obj;
             tr_xmlprint(file, tr, CK_VERBOSE);
             break;
@@ -372,6 +670,23 @@ void tap_lfun(SRunner * sr CK_ATTRIBUTE_UNUSED, FILE * file,
             fprintf(file, "%s %d - %s:%s:%s: %s\n",
                     tr->rtype == CK_PASS ? "ok" : "not ok", num_tests_run,
                     tr->file, tr->tcname, tr->tname, tr->msg);
+            if(tr->bench != NULL)
+            {
+                const TestBench *b = tr->bench;
+
+                fprintf(file, "# bench: %ld iterations x %d samples, "
+                        "min %.3f ns/op, median %.3f ns/op, "
+                        "mean %.3f ns/op, MAD %.3f ns/op, p99 %.3f ns/op\n",
+                        b->iterations, b->nsamples, b->min, b->median,
+                        b->mean, b->mad, b->p99);
+            }
+            fflush(file);
+            break;
+        case CLSKIP_T:
+            num_tests_run += 1;
+            tr = (TestResult *)obj;
+            fprintf(file, "ok %d - %s:%s # SKIP %s\n", num_tests_run,
+                    tr->tcname, tr->tname, tr->msg);
             fflush(file);
             break;
         default:
@@ -380,6 +695,389 @@ void tap_lfun(SRunner * sr CK_ATTRIBUTE_UNUSED, FILE * file,
     }
 }
 
+/* The counts of a test suite in the JUnit log, see junit_lfun() */
+typedef struct JUnitSuite
+{
+    FILE *cases;                /* the test cases, if not written in place */
+    long pos;                   /* where the counts are, if written in place */
+    const char *name;
+    char timestamp[sizeof "yyyy-mm-ddThh:mm:ss"];
+    struct timespec ts_start;
+    int tests;
+    int failures;
+    int errors;
+    int skipped;
+} JUnitSuite;
+
+/*
+ * The counts are written with a fixed width if they are to be
+ * overwritten with fseek() once the suite ended.
+ */
+static void junit_fprint_counts(FILE * file, JUnitSuite * js, int width)
+{
+    struct timespec ts_end = { 0, 0 };
+    unsigned long duration;
+
+    clock_gettime(check_get_clockid(), &ts_end);
+    duration = (unsigned long)DIFF_IN_USEC(js->ts_start, ts_end);
+    fprintf(file, " tests=\"%0*d\" failures=\"%0*d\" errors=\"%0*d\""
+            " skipped=\"%0*d\" time=\"%0*lu.%06lu\">\n", width, js->tests,
+            width, js->failures, width, js->errors, width, js->skipped,
+            width, duration / US_PER_SEC, duration % US_PER_SEC);
+}
+
+static void junit_fprint_suite(FILE * file, JUnitSuite * js)
+{
+    fprintf(file, "  <testsuite name=\"");
+    fprint_xml_esc(file, js->name);
+    fprintf(file, "\" timestamp=\"%s\"", js->timestamp);
+}
+
+static void junit_fprint_case(FILE * file, JUnitSuite * js, TestResult * tr,
+                              int skipped)
+{
+    int duration = tr->duration < 0 ? 0 : tr->duration;
+
+    fprintf(file, "    <testcase classname=\"");
+    fprint_xml_esc(file, js->name);
+    fprintf(file, ".");
+    fprint_xml_esc(file, tr->tcname);
+    fprintf(file, "\" name=\"");
+    fprint_xml_esc(file, tr->tname);
+    fprintf(file, ":%d\" time=\"%d.%06d\">\n", tr->iter,
+            duration / US_PER_SEC, duration % US_PER_SEC);
+
+    if(skipped)
+    {
+        fprintf(file, "      <skipped message=\"");
+        fprint_xml_esc(file, tr->msg);
+        fprintf(file, "\"/>\n");
+    }
+    else if(tr->rtype == CK_FAILURE || tr->rtype == CK_ERROR)
+    {
+        const char *type = tr->rtype == CK_FAILURE ? "failure" : "error";
+
+        fprintf(file, "      <%s message=\"", type);
+        fprint_xml_esc(file, tr->msg);
+        fprintf(file, "\" type=\"%s\">", type);
+        fprint_xml_esc(file, tr->file != NULL ? tr->file : "");
+        fprintf(file, ":%d</%s>\n", tr->line, type);
+    }
+
+    if(!skipped && tr_has_details(tr))
+    {
+        fprintf(file, "      <system-out>");
+        tr_fprint_details(file, tr, 1);
+        fprintf(file, "</system-out>\n");
+    }
+    fprintf(file, "    </testcase>\n");
+}
+
+void junit_lfun(SRunner * sr, FILE * file,
+                enum print_output printmode CK_ATTRIBUTE_UNUSED, void *obj,
+                enum cl_event evt)
+{
+    TestResult *tr;
+    char buf[BUFSIZ];
+    size_t n;
+    JUnitSuite *js = sr->junit_suite;
+
+    switch (evt)
+    {
+        case CLINITLOG_SR:
+            fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+            fprintf(file, "<testsuites>\n");
+            sr->junit_suite = (JUnitSuite *)emalloc(sizeof(JUnitSuite));
+            break;
+        case CLENDLOG_SR:
+            fprintf(file, "</testsuites>\n");
+            tr_xmlprint_free();
+            free(js);
+            sr->junit_suite = NULL;
+            break;
+        case CLSTART_SR:
+            break;
+        case CLSTART_S:
+        {
+            struct timeval now_tv;
+            struct tm now;
+
+            js->name = ((Suite *)obj)->name;
+            js->tests = js->failures = js->errors = js->skipped = 0;
+            js->timestamp[0] = '\0';
+            gettimeofday(&now_tv, NULL);
+            if(localtime_r((const time_t *)&(now_tv.tv_sec), &now) != NULL)
+            {
+                strftime(js->timestamp, sizeof(js->timestamp),
+                         "%Y-%m-%dT%H:%M:%S", &now);
+            }
+            clock_gettime(check_get_clockid(), &js->ts_start);
+
+            /*
+             * The counts come before the test cases, but are only known
+             * once the suite ended. In a file they are written now and
+             * overwritten later; otherwise (stdout, a pipe or a buffered
+             * log) the test cases of the suite wait in a temporary file.
+             */
+            js->cases = NULL;
+            if(file != stdout && sr->log_writer == NULL && ftell(file) >= 0)
+            {
+                junit_fprint_suite(file, js);
+                js->pos = ftell(file);
+                junit_fprint_counts(file, js, 10);
+                break;
+            }
+            js->cases = tmpfile();
+            if(js->cases == NULL)
+            {
+                eprintf("Error in call to tmpfile while logging suite %s:",
+                        __FILE__, __LINE__ - 3, js->name);
+            }
+        }
+            break;
+        case CLEND_SR:
+            break;
+        case CLEND_S:
+            if(js->cases == NULL)
+            {
+                fflush(file);
+                if(fseek(file, js->pos, SEEK_SET) != 0)
+                {
+                    eprintf("Error in call to fseek while logging suite %s:",
+                            __FILE__, __LINE__ - 3, js->name);
+                }
+                junit_fprint_counts(file, js, 10);
+                fseek(file, 0, SEEK_END);
+            }
+            else
+            {
+                junit_fprint_suite(file, js);
+                junit_fprint_counts(file, js, 0);
+                rewind(js->cases);
+                while((n = fread(buf, 1, sizeof(buf), js->cases)) > 0)
+                {
+                    fwrite(buf, 1, n, file);
+                }
+                fclose(js->cases);
+                js->cases = NULL;
+            }
+            fprintf(file, "  </testsuite>\n");
+            break;
+        case CLSTART_T:
+            break;
+        case CLEND_T:
+        case CLSKIP_T:
+            tr = (TestResult *)obj;
+            js->tests += 1;
+            if(evt == CLSKIP_T)
+                js->skipped += 1;
+            else if(tr->rtype == CK_FAILURE)
+                js->failures += 1;
+            else if(tr->rtype == CK_ERROR)
+                js->errors += 1;
+            if(js->cases != NULL)
+            {
+                junit_fprint_case(js->cases, js, tr, evt == CLSKIP_T);
+                /* Nothing is left for forked tests to write at exit */
+                fflush(js->cases);
+            }
+            else
+            {
+                junit_fprint_case(file, js, tr, evt == CLSKIP_T);
+            }
+            break;
+        default:
+            eprintf("Bad event type received in junit_lfun", __FILE__,
+                    __LINE__);
+    }
+}
+
+void bench_lfun(SRunner * sr CK_ATTRIBUTE_UNUSED, FILE * file,
+                enum print_output printmode CK_ATTRIBUTE_UNUSED, void *obj,
+                enum cl_event evt)
+{
+    TestResult *tr;
+    const TestBench *b;
+    int k;
+
+    static const char *sname = "";
+    static int num_benches = 0;
+
+    switch (evt)
+    {
+        case CLINITLOG_SR:
+            num_benches = 0;
+            fprintf(file, "{\n  \"benchmarks\": [");
+            break;
+        case CLENDLOG_SR:
+            fprintf(file, "%s]\n}\n", num_benches > 0 ? "\n  " : "");
+            fflush(file);
+            break;
+        case CLSTART_SR:
+            break;
+        case CLSTART_S:
+            sname = ((Suite *)obj)->name;
+            break;
+        case CLEND_SR:
+            break;
+        case CLEND_S:
+            break;
+        case CLSTART_T:
+            break;
+        case CLEND_T:
+            tr = (TestResult *)obj;
+            b = tr->bench;
+            if(b == NULL)
+            {
+                break;
+            }
+            fprintf(file, "%s\n    {\n      \"suite\": ",
+                    num_benches > 0 ? "," : "");
+            fprint_json_str(file, sname);
+            fprintf(file, ",\n      \"tcase\": ");
+            fprint_json_str(file, tr->tcname);
+            fprintf(file, ",\n      \"name\": ");
+            fprint_json_str(file, tr->tname);
+            fprintf(file, ",\n      \"iterations\": %ld,\n"
+                    "      \"min\": %.3f,\n      \"median\": %.3f,\n"
+                    "      \"mean\": %.3f,\n      \"mad\": %.3f,\n"
+                    "      \"p99\": %.3f,\n      \"samples\": [",
+                    b->iterations, b->min, b->median, b->mean, b->mad,
+                    b->p99);
+            for(k = 0; k < b->nsamples; k++)
+            {
+                fprintf(file, "%s%.3f", k > 0 ? ", " : "", b->samples[k]);
+            }
+            fprintf(file, "]\n    }");
+            num_benches++;
+            break;
+        case CLSKIP_T:
+            break;
+        default:
+            eprintf("Bad event type received in bench_lfun", __FILE__,
+                    __LINE__);
+    }
+}
+
+void duration_lfun(SRunner * sr, FILE * file, enum print_output printmode,
+                   void *obj, enum cl_event evt)
+{
+    TestResult *tr;
+    Suite *s;
+    int median;
+
+    switch (evt)
+    {
+        case CLINITLOG_SR:
+            break;
+        case CLENDLOG_SR:
+            if(history_save(sr->history, srunner_duration_fname(sr)) != 0)
+            {
+                eprintf("Error while writing duration file %s:", __FILE__,
+                        __LINE__ - 2, srunner_duration_fname(sr));
+            }
+            break;
+        case CLSTART_SR:
+            break;
+        case CLSTART_S:
+            s = (Suite *)obj;
+            history_suite_start(sr->history, s->name);
+            if(printmode == CK_VERBOSE && history_remaining(sr->history) > 0)
+            {
+                double remaining = history_remaining(sr->history);
+
+                if(srunner_fork_status(sr) != CK_NOFORK)
+                {
+                    remaining /= srunner_jobs(sr);
+                }
+                fprintf(file, "Estimated time remaining: %.2fs\n",
+                        remaining);
+            }
+            break;
+        case CLEND_SR:
+            break;
+        case CLEND_S:
+            break;
+        case CLSTART_T:
+            break;
+        case CLEND_T:
+            tr = (TestResult *)obj;
+            median = history_test_end(sr->history, tr->tcname, tr->tname,
+                                      tr->iter, tr->rtype == CK_PASS ?
+                                      tr->duration : -1);
+            if(median >= 0 && printmode >= CK_NORMAL
+               && printmode <= CK_VERBOSE)
+            {
+                fprintf(file, "%s:%s:%d: Took %.3fs, median of earlier "
+                        "runs %.3fs\n", tr->tcname, tr->tname, tr->iter,
+                        tr->duration / 1000000.0, median / 1000000.0);
+            }
+            break;
+        case CLSKIP_T:
+            break;
+        default:
+            eprintf("Bad event type received in duration_lfun", __FILE__,
+                    __LINE__);
+    }
+}
+
+/* The comparison itself is done before the result is added */
+void baseline_lfun(SRunner * sr, FILE * file CK_ATTRIBUTE_UNUSED,
+                   enum print_output printmode CK_ATTRIBUTE_UNUSED,
+                   void *obj, enum cl_event evt)
+{
+    TestResult *tr;
+    Suite *s;
+
+    switch (evt)
+    {
+        case CLINITLOG_SR:
+            break;
+        case CLENDLOG_SR:
+            if(sr->new_baseline != NULL
+               && baseline_save(sr->new_baseline,
+                                srunner_bench_save_fname(sr)) != 0)
+            {
+                eprintf("Error while writing baseline file %s:", __FILE__,
+                        __LINE__ - 3, srunner_bench_save_fname(sr));
+            }
+            break;
+        case CLSTART_SR:
+            break;
+        case CLSTART_S:
+            s = (Suite *)obj;
+            if(sr->baseline != NULL)
+            {
+                baseline_suite_start(sr->baseline, s->name);
+            }
+            if(sr->new_baseline != NULL)
+            {
+                baseline_suite_start(sr->new_baseline, s->name);
+            }
+            break;
+        case CLEND_SR:
+            break;
+        case CLEND_S:
+            break;
+        case CLSTART_T:
+            break;
+        case CLEND_T:
+            tr = (TestResult *)obj;
+            if(sr->new_baseline != NULL && tr->bench != NULL
+               && tr->rtype == CK_PASS)
+            {
+                baseline_record(sr->new_baseline, tr->tcname, tr->tname,
+                                tr->iter, tr->bench);
+            }
+            break;
+        case CLSKIP_T:
+            break;
+        default:
+            eprintf("Bad event type received in baseline_lfun", __FILE__,
+                    __LINE__);
+    }
+}
+
 #if ENABLE_SUBUNIT
 void subunit_lfun(SRunner * sr, FILE * file, enum print_output printmode,
                   void *obj, enum cl_event evt)
@@ -438,6 +1136,16 @@ void subunit_lfun(SRunner * sr, FILE * file, enum print_output printmode,
                 }
             }
             break;
+        case CLSKIP_T:
+            tr = (TestResult *)obj;
+            {
+                char *name = ck_strdup_printf("%s:%s", tr->tcname, tr->tname);
+
+                subunit_test_start(name);
+                subunit_test_skip(name, tr->msg);
+                free(name);
+            }
+            break;
         default:
             eprintf("Bad event type received in subunit_lfun", __FILE__,
                     __LINE__);
@@ -487,6 +1195,28 @@ FILE *srunner_open_xmlfile(SRunner * sr)
     return f;
 }
 
+FILE *srunner_open_junitfile(SRunner * sr)
+{
+    FILE *f = NULL;
+
+    if(srunner_has_junit(sr))
+    {
+        f = srunner_open_file(srunner_junit_fname(sr));
+    }
+    return f;
+}
+
+FILE *srunner_open_benchfile(SRunner * sr)
+{
+    FILE *f = NULL;
+
+    if(srunner_has_bench_file(sr))
+    {
+        f = srunner_open_file(srunner_bench_fname(sr));
+    }
+    return f;
+}
+
 FILE *srunner_open_tapfile(SRunner * sr)
 {
     FILE *f = NULL;
@@ -526,6 +1256,41 @@ void srunner_init_logging(SRunner * sr, enum print_output print_mode)
     {
         srunner_register_lfun(sr, f, f != stdout, tap_lfun, print_mode);
     }
+    f = srunner_open_junitfile(sr);
+    if(f)
+    {
+        srunner_register_lfun(sr, f, f != stdout, junit_lfun, print_mode);
+    }
+    f = srunner_open_benchfile(sr);
+    if(f)
+    {
+        srunner_register_lfun(sr, f, f != stdout, bench_lfun, print_mode);
+    }
+    if(srunner_has_duration_file(sr))
+    {
+        sr->history = history_load(srunner_duration_fname(sr));
+        srunner_register_lfun(sr, stdout, 0, duration_lfun, print_mode);
+    }
+    if(srunner_has_bench_compare(sr))
+    {
+        sr->baseline = baseline_load(srunner_bench_compare_fname(sr));
+    }
+    if(srunner_has_bench_save(sr))
+    {
+        sr->new_baseline = baseline_load(srunner_bench_save_fname(sr));
+    }
+    if(sr->baseline != NULL || sr->new_baseline != NULL)
+    {
+        srunner_register_lfun(sr, stdout, 0, baseline_lfun, print_mode);
+    }
+#if CK_BUFFERED_LOGS
+    /* A test which crashes a run in CK_NOFORK mode would lose them */
+    if((srunner_buffered_logs(sr) || srunner_log_thread(sr))
+       && srunner_fork_status(sr) != CK_NOFORK)
+    {
+        srunner_buffer_logs(sr);
+    }
+#endif /* CK_BUFFERED_LOGS */
     srunner_send_evt(sr, NULL, CLINITLOG_SR);
 }
 
@@ -535,6 +1300,12 @@ void srunner_end_logging(SRunner * sr)
     int rval;
 
     srunner_send_evt(sr, NULL, CLENDLOG_SR);
+#if CK_BUFFERED_LOGS
+    if(sr->log_writer != NULL)
+    {
+        srunner_unbuffer_logs(sr);
+    }
+#endif /* CK_BUFFERED_LOGS */
 
     l = sr->loglst;
     for(check_list_front(l); !check_list_at_end(l); check_list_advance(l))
@@ -552,4 +1323,173 @@ void srunner_end_logging(SRunner * sr)
     }
     check_list_free(l);
     sr->loglst = NULL;
+    if(sr->history != NULL)
+    {
+        history_free(sr->history);
+        sr->history = NULL;
+    }
+    if(sr->baseline != NULL)
+    {
+        baseline_free(sr->baseline);
+        sr->baseline = NULL;
+    }
+    if(sr->new_baseline != NULL)
+    {
+        baseline_free(sr->new_baseline);
+        sr->new_baseline = NULL;
+    }
+}
+
+#if CK_BUFFERED_LOGS
+/* The innermost run with buffered logs, see flush_logs_at_exit() */
+static SRunner *buffering_runner = NULL;
+
+/*
+ * The output of a run which exits after an error of Check is written as
+ * it would have been without buffers. Forked processes leave the logs
+ * to the suite runner.
+ */
+static void flush_logs_at_exit(void)
+{
+    SRunner *sr;
+
+    for(sr = buffering_runner; sr != NULL; sr = sr->log_outer)
+    {
+        if(writer_owned(sr->log_writer))
+        {
+            srunner_flush_logs(sr, 1);
+            writer_sync(sr->log_writer);
+        }
+    }
+}
+
+static void log_open_buffer(Log * lg)
+{
+    lg->buf = NULL;
+    lg->len = 0;
+    lg->lfile = open_memstream(&lg->buf, &lg->len);
+    if(lg->lfile == NULL)
+    {
+        eprintf("Error in call to open_memstream:", __FILE__, __LINE__ - 3);
+    }
+}
+
+/* Hand the output of a buffered log over to the writer */
+static void log_flush_buffer(SRunner * sr, Log * lg)
+{
+    if(fclose(lg->lfile) != 0)
+    {
+        eprintf("Error in call to fclose while closing log buffer:",
+                __FILE__, __LINE__ - 2);
+    }
+    if(lg->len > 0)
+    {
+        writer_write(sr->log_writer, lg->out, lg->buf, lg->len);
+    }
+    else
+    {
+        free(lg->buf);
+    }
+    log_open_buffer(lg);
+}
+
+/* Only the log files are buffered, what goes to stdout is not */
+static void srunner_buffer_logs(SRunner * sr)
+{
+    static int at_exit_registered = 0;
+    List *l = sr->loglst;
+
+    for(check_list_front(l); !check_list_at_end(l); check_list_advance(l))
+    {
+        Log *lg = (Log *)check_list_val(l);
+
+        if(!lg->close)
+            continue;
+
+        if(sr->log_writer == NULL)
+        {
+            sr->log_writer = writer_create(srunner_log_thread(sr));
+        }
+        lg->out = lg->lfile;
+        log_open_buffer(lg);
+    }
+    if(sr->log_writer == NULL)
+    {
+        return;
+    }
+
+    clock_gettime(check_get_clockid(), &sr->log_flushed);
+    sr->log_outer = buffering_runner;
+    buffering_runner = sr;
+    if(!at_exit_registered)
+    {
+        atexit(flush_logs_at_exit);
+        at_exit_registered = 1;
+    }
+}
+
+static void srunner_flush_logs(SRunner * sr, int force)
+{
+    struct timespec now;
+    List *l = sr->loglst;
+
+    if(!force)
+    {
+        clock_gettime(check_get_clockid(), &now);
+        force = now.tv_sec - sr->log_flushed.tv_sec >= LOG_FLUSH_INTERVAL;
+    }
+
+    for(check_list_front(l); !check_list_at_end(l); check_list_advance(l))
+    {
+        Log *lg = (Log *)check_list_val(l);
+
+        if(lg->out == NULL)
+            continue;
+
+        /* Updates the length of the memory stream */
+        fflush(lg->lfile);
+        if(force || lg->len >= LOG_FLUSH_SIZE)
+        {
+            log_flush_buffer(sr, lg);
+        }
+    }
+    if(force)
+    {
+        clock_gettime(check_get_clockid(), &sr->log_flushed);
+    }
+}
+
+/* Once everything is written, the logs are closed as usual */
+static void srunner_unbuffer_logs(SRunner * sr)
+{
+    SRunner **p;
+    List *l = sr->loglst;
+
+    for(check_list_front(l); !check_list_at_end(l); check_list_advance(l))
+    {
+        Log *lg = (Log *)check_list_val(l);
+
+        if(lg->out == NULL)
+            continue;
+
+        fclose(lg->lfile);
+        free(lg->buf);
+        lg->lfile = lg->out;
+        lg->out = NULL;
+        lg->buf = NULL;
+    }
+
+    for(p = &buffering_runner; *p != NULL; p = &(*p)->log_outer)
+    {
+        if(*p == sr)
+        {
+            *p = sr->log_outer;
+            break;
+        }
+    }
+    sr->log_outer = NULL;
+
+    writer_free(sr->log_writer);
+    sr->log_writer = NULL;
 }
+#endif /* CK_BUFFERED_LOGS */
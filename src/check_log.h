@@ -27,6 +27,7 @@ void log_suite_start(SRunner * sr, Suite * s);
 void log_suite_end(SRunner * sr, Suite * s);
 void log_test_end(SRunner * sr, TestResult * tr);
 void log_test_start(SRunner * sr, TCase * tc, TF * tfun);
+void log_test_skip(SRunner * sr, TestResult * tr);
 
 void stdout_lfun(SRunner * sr, FILE * file, enum print_output,
                  void *obj, enum cl_event evt);
@@ -40,6 +41,18 @@ void xml_lfun(SRunner * sr, FILE * file, enum print_output,
 void tap_lfun(SRunner * sr, FILE * file, enum print_output,
               void *obj, enum cl_event evt);
 
+void junit_lfun(SRunner * sr, FILE * file, enum print_output,
+                void *obj, enum cl_event evt);
+
+void bench_lfun(SRunner * sr, FILE * file, enum print_output,
+                void *obj, enum cl_event evt);
+
+void duration_lfun(SRunner * sr, FILE * file, enum print_output,
+                   void *obj, enum cl_event evt);
+
+void baseline_lfun(SRunner * sr, FILE * file, enum print_output,
+                   void *obj, enum cl_event evt);
+
 void subunit_lfun(SRunner * sr, FILE * file, enum print_output,
                   void *obj, enum cl_event evt);
 
@@ -49,6 +62,8 @@ void srunner_register_lfun(SRunner * sr, FILE * lfile, int close,
 FILE *srunner_open_lfile(SRunner * sr);
 FILE *srunner_open_xmlfile(SRunner * sr);
 FILE *srunner_open_tapfile(SRunner * sr);
+FILE *srunner_open_junitfile(SRunner * sr);
+FILE *srunner_open_benchfile(SRunner * sr);
 void srunner_init_logging(SRunner * sr, enum print_output print_mode);
 void srunner_end_logging(SRunner * sr);
 
@@ -21,9 +21,14 @@
 #include "../lib/libcompat.h"
 
 #include <sys/types.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #include "check_error.h"
 #include "check.h"
@@ -34,10 +39,22 @@
 #include "check_str.h"
 
 
-/* 'Pipe' is implemented as a temporary file to overcome message
- * volume limitations outlined in bug #482012. This scheme works well
- * with the existing usage wherein the parent does not begin reading
- * until the child has done writing and exited.
+/* Messages from the test process to the suite runner are kept in a
+ * ring buffer in memory shared between the two (see MsgRing in
+ * check_pack.h). The shared memory is mapped once by setup_messaging()
+ * and inherited by each forked test process, and the ring is simply
+ * reset after a result was received. Nothing is created in the file
+ * system per test.
+ *
+ * The suite runner only reads after the test process has exited, so a
+ * test which sends more messages than fit in the ring spills the rest
+ * to an overflow file, which is also created once per suite run.
+ * That file is only truncated after a test which actually used it.
+ *
+ * Without shared memory the 'pipe' is a temporary file to overcome
+ * message volume limitations outlined in bug #482012. This scheme
+ * works well with the existing usage wherein the parent does not
+ * begin reading until the child has done writing and exited.
  *
  * Pipe life cycle:
  * - The parent creates a tmpfile().
@@ -54,97 +71,448 @@
  * reading and writing.
  */
 
-static FILE *send_file1;
-static char *send_file1_name;
-static FILE *send_file2;
-static char *send_file2_name;
+/* Shared location slots (CK_LOC_SHARED):
+ *
+ * Instead of sending a CK_MSG_LOC message for every passing check,
+ * the location is stored in a slot of a small area which is mapped
+ * shared between the parent and the forked child. Each thread uses
+ * its own slot, and a global stamp tells which slot was written last.
+ *
+ * The last recorded location is converted into a regular message
+ * before any other message is sent (a context change, a failure or
+ * the test duration), so the message stream seen by the parent is
+ * the same as in CK_LOC_MESSAGE mode except for the dropped
+ * intermediate locations. Only if the child died before doing so
+ * (signal, early exit, timeout) does the parent read the slots.
+ *
+ * The slots only hold the pointer to the file name, which is valid in
+ * the parent as the child is a fork() of it.
+ */
+#define CK_LOC_SLOTS 16
+
+/* Size of the shared memory of one channel, holding the ring buffer */
+#define CK_CHANNEL_SIZE (256 * 1024)
+
+#if GCC_VERSION_AT_LEAST(4, 1)
+#define ck_stamp_next(p) __sync_add_and_fetch((p), 1)
+#else
+#define ck_stamp_next(p) (++*(p))
+#endif
+
+#if HAVE_MMAP && !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+#define CK_SHARED_CHANNEL 1
+#else
+#define CK_SHARED_CHANNEL 0
+#endif
+
+typedef struct LocSlot
+{
+    volatile unsigned long stamp;       /* 0 while unused or being written */
+    const char *volatile file;
+    volatile int line;
+} LocSlot;
+
+typedef struct LocArea
+{
+    volatile unsigned long stamp;       /* stamp of the last recorded location */
+    volatile unsigned long sent;        /* stamp of the last location sent */
+    LocSlot slots[CK_LOC_SLOTS];
+} LocArea;
 
-static FILE *get_pipe(void);
-static void setup_pipe(void);
-static void teardown_pipe(void);
+/* Layout of the shared memory of a channel */
+typedef struct ChannelArea
+{
+    LocArea loc;
+    MsgRing ring;               /* must be last, data[] extends the mapping */
+} ChannelArea;
+
+typedef struct MsgChannel
+{
+    FILE *file;                 /* the pipe, or the overflow of the ring */
+    char *file_name;
+    ChannelArea *area;          /* NULL without shared memory */
+    LocArea *loc;               /* NULL unless in CK_LOC_SHARED mode */
+} MsgChannel;
+
+/* Nesting of suite runs: one MsgRun per running SRunner */
+#define CK_MAX_NESTING 2
+
+/*
+ * The channels of a suite run, one for each test which may be running
+ * at the same time. Tests and the runner use the selected one.
+ */
+typedef struct MsgRun
+{
+    MsgChannel *channels;
+    int nchannels;
+    int cur;
+    enum loc_tracking loc_mode;
+} MsgRun;
+
+static MsgRun runs[CK_MAX_NESTING];
+static int nruns;
+static enum loc_tracking next_loc_tracking = CK_LOC_MESSAGE;
+
+static MsgChannel *get_channel(void);
+static MsgRun *get_run(void);
+static void channel_open(MsgChannel * ch, enum loc_tracking loc_mode);
+static void channel_close(MsgChannel * ch);
+static void channel_send(MsgChannel * ch, enum ck_msg_type type,
+                         CheckMsg * msg);
+static RcvMsg *channel_receive(MsgChannel * ch);
+static ChannelArea *channel_area_create(void);
+static void channel_area_free(ChannelArea * area);
+static void setup_pipe(MsgChannel * ch);
+static void teardown_pipe(MsgChannel * ch);
+static void loc_area_reset(LocArea * area);
+static int loc_area_last(LocArea * area, const char **file, int *line);
+static void flush_loc_info(MsgChannel * ch);
 static TestResult *construct_test_result(RcvMsg * rmsg, int waserror);
 static void tr_set_loc_by_ctx(TestResult * tr, enum ck_result_ctx ctx,
                               RcvMsg * rmsg);
-static FILE *get_pipe(void)
+static MsgRun *get_run(void)
 {
-    if(send_file2 != 0)
+    if(nruns == 0)
     {
-        return send_file2;
+        eprintf("No messaging setup", __FILE__, __LINE__);
     }
 
-    if(send_file1 != 0)
-    {
-        return send_file1;
-    }
+    return &runs[nruns - 1];
+}
 
-    eprintf("No messaging setup", __FILE__, __LINE__);
+static MsgChannel *get_channel(void)
+{
+    MsgRun *run = get_run();
 
-    return NULL;
+    return &run->channels[run->cur];
+}
+
+static void channel_send(MsgChannel * ch, enum ck_msg_type type,
+                         CheckMsg * msg)
+{
+    if(ch->area != NULL)
+    {
+        ppack_ring(&ch->area->ring, ch->file, type, msg);
+    }
+    else
+    {
+        ppack(ch->file, type, msg);
+    }
 }
 
 void send_failure_info(const char *msg)
 {
     FailMsg fmsg;
+    MsgChannel *ch = get_channel();
 
+    flush_loc_info(ch);
     fmsg.msg = strdup(msg);
-    ppack(get_pipe(), CK_MSG_FAIL, (CheckMsg *) & fmsg);
+    channel_send(ch, CK_MSG_FAIL, (CheckMsg *) & fmsg);
     free(fmsg.msg);
 }
 
+/* A failure packed before the test runs, see prepare_failure_info() */
+static char *prepared_buf;
+static int prepared_len;
+static int prepared_fd = -1;
+static MsgRing *prepared_ring;
+
+void prepare_failure_info(const char *msg)
+{
+    FailMsg fmsg;
+    MsgChannel *ch = get_channel();
+
+    free(prepared_buf);
+    fmsg.msg = (char *)msg;
+    prepared_buf = NULL;
+    prepared_len = pack(CK_MSG_FAIL, &prepared_buf, (CheckMsg *) & fmsg);
+    prepared_fd = fileno(ch->file);
+    prepared_ring = ch->area != NULL ? &ch->area->ring : NULL;
+}
+
+void send_prepared_failure(void)
+{
+    ssize_t r;
+
+    if(prepared_buf == NULL)
+    {
+        return;
+    }
+    /* The file comes after what is in the ring, see punpack_ring() */
+    if(prepared_ring != NULL)
+    {
+        prepared_ring->spilled = 1;
+    }
+    r = write(prepared_fd, prepared_buf, prepared_len);
+    (void)r;
+}
+
 void send_duration_info(int duration)
 {
     DurationMsg dmsg;
+    MsgChannel *ch = get_channel();
 
+    flush_loc_info(ch);
     dmsg.duration = duration;
-    ppack(get_pipe(), CK_MSG_DURATION, (CheckMsg *) & dmsg);
+    channel_send(ch, CK_MSG_DURATION, (CheckMsg *) & dmsg);
+}
+
+void send_bench_info(long iterations, int nsamples, uint64_t * sample_ns)
+{
+    BenchMsg bmsg;
+    MsgChannel *ch = get_channel();
+
+    flush_loc_info(ch);
+    bmsg.iterations = (int)iterations;
+    bmsg.nsamples = nsamples;
+    bmsg.sample_ns = sample_ns;
+    channel_send(ch, CK_MSG_BENCH, (CheckMsg *) & bmsg);
+}
+
+void send_perf_info(const TestPerf * perf)
+{
+    PerfMsg pmsg;
+    MsgChannel *ch = get_channel();
+
+    flush_loc_info(ch);
+    pmsg.perf = *perf;
+    channel_send(ch, CK_MSG_PERF, (CheckMsg *) & pmsg);
+}
+
+void send_alloc_info(const TestAlloc * alloc)
+{
+    AllocMsg amsg;
+    MsgChannel *ch = get_channel();
+
+    flush_loc_info(ch);
+    amsg.alloc = *alloc;
+    channel_send(ch, CK_MSG_ALLOC, (CheckMsg *) & amsg);
 }
 
 void send_loc_info(const char *file, int line)
 {
     LocMsg lmsg;
+    MsgChannel *ch = get_channel();
 
+    flush_loc_info(ch);
     lmsg.file = strdup(file);
     lmsg.line = line;
-    ppack(get_pipe(), CK_MSG_LOC, (CheckMsg *) & lmsg);
+    channel_send(ch, CK_MSG_LOC, (CheckMsg *) & lmsg);
     free(lmsg.file);
 }
 
+void record_loc_info(const char *file, int line)
+{
+    MsgChannel *ch = get_channel();
+    LocArea *area = ch->loc;
+    LocSlot *slot;
+    unsigned int idx = 0;
+
+    if(area == NULL)
+    {
+        send_loc_info(file, line);
+        return;
+    }
+
+#ifdef HAVE_PTHREAD
+    {
+        pthread_t self = pthread_self();
+        const unsigned char *p = (const unsigned char *)&self;
+        size_t i;
+
+        for(i = 0; i < sizeof(self); i++)
+        {
+            idx = idx * 31 + p[i];
+        }
+    }
+#endif /* HAVE_PTHREAD */
+
+    slot = &area->slots[idx % CK_LOC_SLOTS];
+    slot->stamp = 0;
+    slot->file = file;
+    slot->line = line;
+    slot->stamp = ck_stamp_next(&area->stamp);
+}
+
 void send_ctx_info(enum ck_result_ctx ctx)
 {
     CtxMsg cmsg;
+    MsgChannel *ch = get_channel();
 
+    flush_loc_info(ch);
     cmsg.ctx = ctx;
-    ppack(get_pipe(), CK_MSG_CTX, (CheckMsg *) & cmsg);
+    channel_send(ch, CK_MSG_CTX, (CheckMsg *) & cmsg);
 }
 
 TestResult *receive_test_result(int waserror)
 {
-    FILE *fp;
+    MsgChannel *ch;
     RcvMsg *rmsg;
     TestResult *result;
 
-    fp = get_pipe();
-    if(fp == NULL)
-    {
-        eprintf("Error in call to get_pipe", __FILE__, __LINE__ - 2);
-    }
-
-    rewind(fp);
-    rmsg = punpack(fp);
+    ch = get_channel();
+    rmsg = channel_receive(ch);
 
     if(rmsg == NULL)
     {
         eprintf("Error in call to punpack", __FILE__, __LINE__ - 4);
     }
 
-    teardown_pipe();
-    setup_pipe();
+    if(ch->loc != NULL)
+    {
+        const char *file;
+        int line;
+
+        /* The test ended before its last location was sent */
+        if(rmsg->failctx == CK_CTX_INVALID
+           && loc_area_last(ch->loc, &file, &line))
+        {
+            rcvmsg_update_loc(rmsg, file, line);
+        }
+        loc_area_reset(ch->loc);
+    }
 
     result = construct_test_result(rmsg, waserror);
     rcvmsg_free(rmsg);
     return result;
 }
 
+/*
+ * Read all messages of the current test and make the channel ready
+ * for the next one.
+ */
+static RcvMsg *channel_receive(MsgChannel * ch)
+{
+    RcvMsg *rmsg;
+
+    if(ch->file == NULL)
+    {
+        eprintf("Error in call to get_pipe", __FILE__, __LINE__ - 2);
+    }
+
+#if CK_SHARED_CHANNEL
+    if(ch->area != NULL)
+    {
+        MsgRing *ring = &ch->area->ring;
+        int spilled = ring->spilled;
+
+        rmsg = punpack_ring(ring, ch->file);
+        msg_ring_init(ring, ring->size);
+        if(spilled)
+        {
+            rewind(ch->file);
+            if(ftruncate(fileno(ch->file), 0) != 0)
+            {
+                eprintf("Error in call to ftruncate:", __FILE__,
+                        __LINE__ - 2);
+            }
+        }
+        return rmsg;
+    }
+#endif /* CK_SHARED_CHANNEL */
+
+    rewind(ch->file);
+    rmsg = punpack(ch->file);
+
+    teardown_pipe(ch);
+    setup_pipe(ch);
+
+    return rmsg;
+}
+
+static void flush_loc_info(MsgChannel * ch)
+{
+    LocArea *area = ch->loc;
+    const char *file;
+    int line;
+
+    if(area == NULL || area->stamp == area->sent)
+    {
+        return;
+    }
+
+    if(loc_area_last(area, &file, &line))
+    {
+        LocMsg lmsg;
+
+        lmsg.file = (char *)file;
+        lmsg.line = line;
+        channel_send(ch, CK_MSG_LOC, (CheckMsg *) & lmsg);
+    }
+    area->sent = area->stamp;
+}
+
+/*
+ * Find the location which was recorded last and not sent yet.
+ * Returns 1 if there is one, 0 otherwise.
+ */
+static int loc_area_last(LocArea * area, const char **file, int *line)
+{
+    unsigned long best = area->sent;
+    int found = 0;
+    int i;
+
+    for(i = 0; i < CK_LOC_SLOTS; i++)
+    {
+        LocSlot *slot = &area->slots[i];
+        unsigned long stamp = slot->stamp;
+        const char *slot_file = slot->file;
+        int slot_line = slot->line;
+
+        /* Skip slots which were rewritten while being read */
+        if(stamp > best && slot->stamp == stamp)
+        {
+            *file = slot_file;
+            *line = slot_line;
+            best = stamp;
+            found = 1;
+        }
+    }
+
+    return found;
+}
+
+static void loc_area_reset(LocArea * area)
+{
+    memset((void *)area, 0, sizeof(LocArea));
+}
+
+static ChannelArea *channel_area_create(void)
+{
+    ChannelArea *area = NULL;
+
+#if CK_SHARED_CHANNEL
+    area = (ChannelArea *)mmap(NULL, CK_CHANNEL_SIZE,
+                               PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(area == MAP_FAILED)
+    {
+        eprintf("Error in call to mmap:", __FILE__, __LINE__ - 5);
+    }
+    loc_area_reset(&area->loc);
+    msg_ring_init(&area->ring, CK_CHANNEL_SIZE - offsetof(ChannelArea, ring)
+                  - offsetof(MsgRing, data));
+#endif /* CK_SHARED_CHANNEL */
+
+    return area;
+}
+
+static void channel_area_free(ChannelArea * area)
+{
+#if CK_SHARED_CHANNEL
+    if(area != NULL)
+    {
+        munmap((void *)area, CK_CHANNEL_SIZE);
+    }
+#else
+    (void)area;
+#endif /* CK_SHARED_CHANNEL */
+}
+
 static void tr_set_loc_by_ctx(TestResult * tr, enum ck_result_ctx ctx,
                               RcvMsg * rmsg)
 {
@@ -199,6 +567,10 @@ static TestResult *construct_test_result(RcvMsg * rmsg, int waserror)
         tr->ctx = CK_CTX_TEST;
         tr->msg = NULL;
         tr->duration = rmsg->duration;
+        tr->bench = rmsg->bench;
+        rmsg->bench = NULL;
+        tr->perf = rmsg->perf;
+        tr->alloc = rmsg->alloc;
         tr_set_loc_by_ctx(tr, CK_CTX_TEST, rmsg);
     }
 
@@ -207,12 +579,113 @@ static TestResult *construct_test_result(RcvMsg * rmsg, int waserror)
 
 void setup_messaging(void)
 {
-    setup_pipe();
+    MsgRun *run;
+
+    if(nruns == CK_MAX_NESTING)
+    {
+        eprintf("Only one nesting of suite runs supported", __FILE__,
+                __LINE__);
+    }
+
+    run = &runs[nruns++];
+    run->channels = (MsgChannel *)emalloc(sizeof(MsgChannel));
+    run->nchannels = 1;
+    run->cur = 0;
+    run->loc_mode = next_loc_tracking;
+    channel_open(&run->channels[0], run->loc_mode);
 }
 
 void teardown_messaging(void)
 {
-    teardown_pipe();
+    MsgRun *run = get_run();
+    int i;
+
+    for(i = 0; i < run->nchannels; i++)
+    {
+        channel_close(&run->channels[i]);
+    }
+    free(run->channels);
+    run->channels = NULL;
+    run->nchannels = 0;
+    nruns--;
+}
+
+void set_msg_slots(int n)
+{
+    MsgRun *run = get_run();
+
+    if(n <= run->nchannels)
+    {
+        return;
+    }
+
+    run->channels =
+        (MsgChannel *)erealloc(run->channels, n * sizeof(MsgChannel));
+    while(run->nchannels < n)
+    {
+        channel_open(&run->channels[run->nchannels++], run->loc_mode);
+    }
+}
+
+void select_msg_slot(int slot)
+{
+    MsgRun *run = get_run();
+
+    if(slot < 0 || slot >= run->nchannels)
+    {
+        eprintf("Bad slot %d in select_msg_slot", __FILE__, __LINE__, slot);
+    }
+    run->cur = slot;
+}
+
+void keep_msg_slot(int slot)
+{
+    MsgRun *run = get_run();
+    MsgChannel ch;
+
+    select_msg_slot(slot);
+    ch = run->channels[slot];
+
+    /* The other channels are still used by the suite runner */
+    free(run->channels);
+    run->channels = (MsgChannel *)emalloc(sizeof(MsgChannel));
+    run->channels[0] = ch;
+    run->nchannels = 1;
+    run->cur = 0;
+}
+
+int msg_slots_shared(void)
+{
+    MsgRun *run = get_run();
+
+    return run->channels[0].area != NULL;
+}
+
+static void channel_open(MsgChannel * ch, enum loc_tracking loc_mode)
+{
+    setup_pipe(ch);
+    ch->area = channel_area_create();
+    ch->loc = NULL;
+    if(ch->area != NULL && loc_mode == CK_LOC_SHARED)
+    {
+        ch->loc = &ch->area->loc;
+    }
+}
+
+static void channel_close(MsgChannel * ch)
+{
+    teardown_pipe(ch);
+    channel_area_free(ch->area);
+    ch->area = NULL;
+    ch->loc = NULL;
+}
+
+void set_loc_tracking(enum loc_tracking mode)
+{
+    if(mode == CK_LOC_MESSAGE || mode == CK_LOC_SHARED)
+        next_loc_tracking = mode;
+    else
+        eprintf("Bad mode in set_loc_tracking", __FILE__, __LINE__);
 }
 
 /**
@@ -285,47 +758,24 @@ FILE *open_tmp_file(char **name)
     return file;
 }
 
-static void setup_pipe(void)
+static void setup_pipe(MsgChannel * ch)
 {
-    if(send_file1 == NULL)
-    {
-        send_file1 = open_tmp_file(&send_file1_name);
-        return;
-    }
-    if(send_file2 == NULL)
-    {
-        send_file2 = open_tmp_file(&send_file2_name);
-        return;
-    }
-    eprintf("Only one nesting of suite runs supported", __FILE__, __LINE__);
+    ch->file = open_tmp_file(&ch->file_name);
 }
 
-static void teardown_pipe(void)
+static void teardown_pipe(MsgChannel * ch)
 {
-    if(send_file2 != 0)
-    {
-        fclose(send_file2);
-        send_file2 = 0;
-        if(send_file2_name != NULL)
-        {
-            unlink(send_file2_name);
-            free(send_file2_name);
-            send_file2_name = NULL;
-        }
-    }
-    else if(send_file1 != 0)
+    if(ch->file == NULL)
     {
-        fclose(send_file1);
-        send_file1 = 0;
-        if(send_file1_name != NULL)
-        {
-            unlink(send_file1_name);
-            free(send_file1_name);
-            send_file1_name = NULL;
-        }
+        eprintf("No messaging setup", __FILE__, __LINE__);
     }
-    else
+
+    fclose(ch->file);
+    ch->file = NULL;
+    if(ch->file_name != NULL)
     {
-        eprintf("No messaging setup", __FILE__, __LINE__);
+        unlink(ch->file_name);
+        free(ch->file_name);
+        ch->file_name = NULL;
     }
 }
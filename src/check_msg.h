@@ -25,15 +25,45 @@
 /* Functions implementing messaging during test runs */
 
 void send_failure_info(const char *msg);
+
+/*
+ * Pack a failure while it is still safe to, and send it from a signal
+ * handler with nothing but write(2): the test may have broken the heap
+ * and hold the locks of stdio and of the message channel.
+ */
+void prepare_failure_info(const char *msg);
+void send_prepared_failure(void);
 void send_loc_info(const char *file, int line);
+void record_loc_info(const char *file, int line);
 void send_ctx_info(enum ck_result_ctx ctx);
 void send_duration_info(int duration);
+void send_bench_info(long iterations, int nsamples, uint64_t * sample_ns);
+void send_perf_info(const TestPerf * perf);
+void send_alloc_info(const TestAlloc * alloc);
 
 TestResult *receive_test_result(int waserror);
 
 void setup_messaging(void);
 void teardown_messaging(void);
 
+/* Use separate channels for up to n tests running at the same time */
+void set_msg_slots(int n);
+void select_msg_slot(int slot);
+
+/*
+ * To be called in a process forked by the suite runner, which runs
+ * tests of its own: the channel of the slot becomes its only one.
+ */
+void keep_msg_slot(int slot);
+
+/*
+ * Returns 1 if the channels of the current run are in shared memory,
+ * so that tests forked by any process of the run can use them.
+ */
+int msg_slots_shared(void);
+
+void set_loc_tracking(enum loc_tracking mode);
+
 FILE *open_tmp_file(char **name);
 
 #endif /*CHECK_MSG_NEW_H */
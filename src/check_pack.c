@@ -25,6 +25,9 @@
 #include <stdio.h>
 
 #include "check.h"
+#include "check_bench.h"
+#include "check_perf.h"
+#include "check_alloc.h"
 #include "check_error.h"
 #include "check_list.h"
 #include "check_impl.h"
@@ -52,6 +55,17 @@
 /* typedef an unsigned int that has at least 4 bytes */
 typedef uint32_t ck_uint32;
 
+/* Size of the length field in front of each frame of a MsgRing */
+#define CK_FRAME_HDR 4
+/* Frames are padded so that the length fields stay aligned */
+#define CK_FRAME_ALIGN(n) (((size_t)(n) + 3) & ~(size_t)3)
+
+#if GCC_VERSION_AT_LEAST(4, 1)
+#define ck_memory_barrier() __sync_synchronize()
+#else
+#define ck_memory_barrier()
+#endif
+
 
 static void pack_int(char **buf, int val);
 static int upack_int(char **buf);
@@ -62,19 +76,29 @@ static int pack_ctx(char **buf, CtxMsg * cmsg);
 static int pack_loc(char **buf, LocMsg * lmsg);
 static int pack_fail(char **buf, FailMsg * fmsg);
 static int pack_duration(char **buf, DurationMsg * fmsg);
+static int pack_bench(char **buf, BenchMsg * bmsg);
+static int pack_perf(char **buf, PerfMsg * pmsg);
+static int pack_alloc(char **buf, AllocMsg * amsg);
 static void upack_ctx(char **buf, CtxMsg * cmsg);
 static void upack_loc(char **buf, LocMsg * lmsg);
 static void upack_fail(char **buf, FailMsg * fmsg);
 static void upack_duration(char **buf, DurationMsg * fmsg);
+static void upack_bench(char **buf, BenchMsg * bmsg);
+static void upack_perf(char **buf, PerfMsg * pmsg);
+static void upack_alloc(char **buf, AllocMsg * amsg);
+static void pack_int64(char **buf, int64_t val);
+static int64_t upack_int64(char **buf);
 
 static void check_type(int type, const char *file, int line);
 static enum ck_msg_type upack_type(char **buf);
 static void pack_type(char **buf, enum ck_msg_type type);
 
 static int read_buf(FILE * fdes, int size, char *buf);
+static void punpack_file(FILE * fdes, RcvMsg * rmsg);
+static int ring_put(MsgRing * ring, const char *buf, int n);
+static void ring_get_all(MsgRing * ring, RcvMsg * rmsg);
 static int get_result(char *buf, RcvMsg * rmsg);
 static void rcvmsg_update_ctx(RcvMsg * rmsg, enum ck_result_ctx ctx);
-static void rcvmsg_update_loc(RcvMsg * rmsg, const char *file, int line);
 static RcvMsg *rcvmsg_create(void);
 void rcvmsg_free(RcvMsg * rmsg);
 
@@ -85,14 +109,20 @@ static pfun pftab[] = {
     (pfun) pack_ctx,
     (pfun) pack_fail,
     (pfun) pack_loc,
-    (pfun) pack_duration
+    (pfun) pack_duration,
+    (pfun) pack_bench,
+    (pfun) pack_perf,
+    (pfun) pack_alloc
 };
 
 static upfun upftab[] = {
     (upfun) upack_ctx,
     (upfun) upack_fail,
     (upfun) upack_loc,
-    (upfun) upack_duration
+    (upfun) upack_duration,
+    (upfun) upack_bench,
+    (upfun) upack_perf,
+    (upfun) upack_alloc
 };
 
 int pack(enum ck_msg_type type, char **buf, CheckMsg * msg)
@@ -242,6 +272,117 @@ static void upack_duration(char **buf, DurationMsg * cmsg)
     cmsg->duration = upack_int(buf);
 }
 
+static int pack_bench(char **buf, BenchMsg * bmsg)
+{
+    char *ptr;
+    int len;
+    int k;
+
+    len = 4 + 4 + 4 + 8 * bmsg->nsamples;
+    *buf = ptr = (char *)emalloc(len);
+
+    pack_type(&ptr, CK_MSG_BENCH);
+    pack_int(&ptr, bmsg->iterations);
+    pack_int(&ptr, bmsg->nsamples);
+    for(k = 0; k < bmsg->nsamples; k++)
+    {
+        pack_int64(&ptr, (int64_t)bmsg->sample_ns[k]);
+    }
+
+    return len;
+}
+
+static void upack_bench(char **buf, BenchMsg * bmsg)
+{
+    int k;
+
+    bmsg->iterations = upack_int(buf);
+    bmsg->nsamples = upack_int(buf);
+    bmsg->sample_ns =
+        (uint64_t *)emalloc((bmsg->nsamples + 1) * sizeof(uint64_t));
+    for(k = 0; k < bmsg->nsamples; k++)
+    {
+        bmsg->sample_ns[k] = (uint64_t)upack_int64(buf);
+    }
+}
+
+static int pack_perf(char **buf, PerfMsg * pmsg)
+{
+    char *ptr;
+    int len;
+
+    len = 4 + 4 + 7 * 8;
+    *buf = ptr = (char *)emalloc(len);
+
+    pack_type(&ptr, CK_MSG_PERF);
+    pack_int(&ptr, pmsg->perf.hardware);
+    pack_int64(&ptr, pmsg->perf.cycles);
+    pack_int64(&ptr, pmsg->perf.instructions);
+    pack_int64(&ptr, pmsg->perf.branch_misses);
+    pack_int64(&ptr, pmsg->perf.cache_misses);
+    pack_int64(&ptr, pmsg->perf.task_clock);
+    pack_int64(&ptr, pmsg->perf.page_faults);
+    pack_int64(&ptr, pmsg->perf.context_switches);
+
+    return len;
+}
+
+static void upack_perf(char **buf, PerfMsg * pmsg)
+{
+    pmsg->perf.hardware = upack_int(buf);
+    pmsg->perf.cycles = upack_int64(buf);
+    pmsg->perf.instructions = upack_int64(buf);
+    pmsg->perf.branch_misses = upack_int64(buf);
+    pmsg->perf.cache_misses = upack_int64(buf);
+    pmsg->perf.task_clock = upack_int64(buf);
+    pmsg->perf.page_faults = upack_int64(buf);
+    pmsg->perf.context_switches = upack_int64(buf);
+}
+
+static int pack_alloc(char **buf, AllocMsg * amsg)
+{
+    char *ptr;
+    int len;
+
+    len = 4 + 6 * 8;
+    *buf = ptr = (char *)emalloc(len);
+
+    pack_type(&ptr, CK_MSG_ALLOC);
+    pack_int64(&ptr, amsg->alloc.allocations);
+    pack_int64(&ptr, amsg->alloc.frees);
+    pack_int64(&ptr, amsg->alloc.bytes);
+    pack_int64(&ptr, amsg->alloc.peak_bytes);
+    pack_int64(&ptr, amsg->alloc.leaks);
+    pack_int64(&ptr, amsg->alloc.leaked_bytes);
+
+    return len;
+}
+
+static void upack_alloc(char **buf, AllocMsg * amsg)
+{
+    amsg->alloc.allocations = upack_int64(buf);
+    amsg->alloc.frees = upack_int64(buf);
+    amsg->alloc.bytes = upack_int64(buf);
+    amsg->alloc.peak_bytes = upack_int64(buf);
+    amsg->alloc.leaks = upack_int64(buf);
+    amsg->alloc.leaked_bytes = upack_int64(buf);
+}
+
+/* A 64 bit value is packed as its high and its low 32 bits */
+static void pack_int64(char **buf, int64_t val)
+{
+    pack_int(buf, (int)((uint64_t)val >> 32));
+    pack_int(buf, (int)((uint64_t)val & 0xFFFFFFFF));
+}
+
+static int64_t upack_int64(char **buf)
+{
+    uint64_t hi = (ck_uint32) upack_int(buf);
+    uint64_t lo = (ck_uint32) upack_int(buf);
+
+    return (int64_t)((hi << 32) | lo);
+}
+
 static int pack_loc(char **buf, LocMsg * lmsg)
 {
     char *ptr;
@@ -380,6 +521,35 @@ static int get_result(char *buf, RcvMsg * rmsg)
 
         rmsg->duration = cmsg->duration;
     }
+    else if(type == CK_MSG_PERF)
+    {
+        PerfMsg *pmsg = (PerfMsg *) & msg;
+
+        rmsg->perf = pmsg->perf;
+    }
+    else if(type == CK_MSG_ALLOC)
+    {
+        AllocMsg *amsg = (AllocMsg *) & msg;
+
+        rmsg->alloc = amsg->alloc;
+    }
+    else if(type == CK_MSG_BENCH)
+    {
+        BenchMsg *bmsg = (BenchMsg *) & msg;
+        double *samples;
+        int k;
+
+        samples = (double *)emalloc((bmsg->nsamples + 1) * sizeof(double));
+        for(k = 0; k < bmsg->nsamples; k++)
+        {
+            samples[k] = (double)bmsg->sample_ns[k] / bmsg->iterations;
+        }
+        bench_free(rmsg->bench);
+        rmsg->bench = bmsg->nsamples > 0 && bmsg->iterations > 0 ?
+            bench_create(bmsg->iterations, bmsg->nsamples, samples) : NULL;
+        free(samples);
+        free(bmsg->sample_ns);
+    }
     else
         check_type(type, __FILE__, __LINE__);
 
@@ -407,6 +577,9 @@ static RcvMsg *rcvmsg_create(void)
     rmsg->failctx = CK_CTX_INVALID;
     rmsg->msg = NULL;
     rmsg->duration = -1;
+    rmsg->bench = NULL;
+    perf_clear(&rmsg->perf);
+    alloc_clear(&rmsg->alloc);
     reset_rcv_test(rmsg);
     reset_rcv_fixture(rmsg);
     return rmsg;
@@ -417,6 +590,7 @@ void rcvmsg_free(RcvMsg * rmsg)
     free(rmsg->fixture_file);
     free(rmsg->test_file);
     free(rmsg->msg);
+    bench_free(rmsg->bench);
     free(rmsg);
 }
 
@@ -430,7 +604,7 @@ static void rcvmsg_update_ctx(RcvMsg * rmsg, enum ck_result_ctx ctx)
     rmsg->lastctx = ctx;
 }
 
-static void rcvmsg_update_loc(RcvMsg * rmsg, const char *file, int line)
+void rcvmsg_update_loc(RcvMsg * rmsg, const char *file, int line)
 {
     if(rmsg->lastctx == CK_CTX_TEST)
     {
@@ -448,11 +622,24 @@ static void rcvmsg_update_loc(RcvMsg * rmsg, const char *file, int line)
 
 RcvMsg *punpack(FILE * fdes)
 {
-    int nread, nparse, n;
-    char *buf;
     RcvMsg *rmsg;
 
     rmsg = rcvmsg_create();
+    punpack_file(fdes, rmsg);
+
+    if(rmsg->lastctx == CK_CTX_INVALID)
+    {
+        free(rmsg);
+        rmsg = NULL;
+    }
+
+    return rmsg;
+}
+
+static void punpack_file(FILE * fdes, RcvMsg * rmsg)
+{
+    int nread, nparse, n;
+    char *buf;
 
     /* Allcate a buffer */
     buf = (char *)emalloc(CK_MAX_MSG_SIZE);
@@ -478,6 +665,123 @@ RcvMsg *punpack(FILE * fdes)
         }
     }
     free(buf);
+}
+
+void msg_ring_init(MsgRing * ring, size_t size)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->spilled = 0;
+    ring->size = size & ~(size_t)3;
+}
+
+/*
+ * Append one frame to the ring. Returns 0 if there is no room for it.
+ */
+static int ring_put(MsgRing * ring, const char *buf, int n)
+{
+    size_t frame = CK_FRAME_HDR + CK_FRAME_ALIGN(n);
+    size_t pos = ring->tail % ring->size;
+    size_t skip = 0;
+    ck_uint32 len;
+
+    /* Frames never wrap, so the rest of the data is skipped */
+    if(ring->size - pos < frame)
+    {
+        skip = ring->size - pos;
+    }
+
+    if(ring->tail + skip + frame - ring->head > ring->size)
+    {
+        return 0;
+    }
+
+    if(skip > 0)
+    {
+        /* A zero length tells the reader to start over at the beginning */
+        len = 0;
+        memcpy(ring->data + pos, &len, CK_FRAME_HDR);
+        pos = 0;
+    }
+
+    len = n;
+    memcpy(ring->data + pos + CK_FRAME_HDR, buf, n);
+    memcpy(ring->data + pos, &len, CK_FRAME_HDR);
+
+    /* Only publish the frame once it is complete */
+    ck_memory_barrier();
+    ring->tail += skip + frame;
+
+    return 1;
+}
+
+static void ring_get_all(MsgRing * ring, RcvMsg * rmsg)
+{
+    size_t tail = ring->tail;
+
+    ck_memory_barrier();
+    while(ring->head != tail)
+    {
+        size_t pos = ring->head % ring->size;
+        ck_uint32 len;
+        int n;
+
+        memcpy(&len, ring->data + pos, CK_FRAME_HDR);
+        if(len == 0)
+        {
+            ring->head += ring->size - pos;
+            continue;
+        }
+
+        n = get_result(ring->data + pos + CK_FRAME_HDR, rmsg);
+        if(n != (int)len)
+            eprintf("Error in call to get_result", __FILE__, __LINE__ - 2);
+
+        ring->head += CK_FRAME_HDR + CK_FRAME_ALIGN(len);
+    }
+}
+
+void ppack_ring(MsgRing * ring, FILE * overflow, enum ck_msg_type type,
+                CheckMsg * msg)
+{
+    char *buf = NULL;
+    int n;
+    int sent;
+
+    n = pack(type, &buf, msg);
+    /* Keep it on the safe side to not send too much data. */
+    if(n > (CK_MAX_MSG_SIZE / 2))
+        eprintf("Message string too long", __FILE__, __LINE__ - 2);
+
+    pthread_cleanup_push(ppack_cleanup, &ck_mutex_lock);
+    pthread_mutex_lock(&ck_mutex_lock);
+    /* Once a frame did not fit all later ones go to the file, to keep order */
+    sent = !ring->spilled && ring_put(ring, buf, n);
+    if(!sent && overflow != NULL)
+    {
+        ring->spilled = 1;
+        sent = (fwrite(buf, 1, n, overflow) == (size_t)n);
+        fflush(overflow);
+    }
+    pthread_mutex_unlock(&ck_mutex_lock);
+    pthread_cleanup_pop(0);
+    if(!sent)
+        eprintf("Error in call to fwrite:", __FILE__, __LINE__ - 6);
+
+    free(buf);
+}
+
+RcvMsg *punpack_ring(MsgRing * ring, FILE * overflow)
+{
+    RcvMsg *rmsg;
+
+    rmsg = rcvmsg_create();
+    ring_get_all(ring, rmsg);
+    if(ring->spilled && overflow != NULL)
+    {
+        rewind(overflow);
+        punpack_file(overflow, rmsg);
+    }
 
     if(rmsg->lastctx == CK_CTX_INVALID)
     {
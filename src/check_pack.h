@@ -28,6 +28,9 @@ enum ck_msg_type
     CK_MSG_FAIL,
     CK_MSG_LOC,
     CK_MSG_DURATION,
+    CK_MSG_BENCH,
+    CK_MSG_PERF,
+    CK_MSG_ALLOC,
     CK_MSG_LAST
 };
 
@@ -52,12 +55,32 @@ typedef struct DurationMsg
     int duration;
 } DurationMsg;
 
+typedef struct BenchMsg
+{
+    int iterations;             /* calls in each sample */
+    int nsamples;
+    uint64_t *sample_ns;
+} BenchMsg;
+
+typedef struct PerfMsg
+{
+    TestPerf perf;
+} PerfMsg;
+
+typedef struct AllocMsg
+{
+    TestAlloc alloc;
+} AllocMsg;
+
 typedef union
 {
     CtxMsg ctx_msg;
     FailMsg fail_msg;
     LocMsg loc_msg;
     DurationMsg duration_msg;
+    BenchMsg bench_msg;
+    PerfMsg perf_msg;
+    AllocMsg alloc_msg;
 } CheckMsg;
 
 typedef struct RcvMsg
@@ -70,9 +93,29 @@ typedef struct RcvMsg
     int test_line;
     char *msg;
     int duration;
+    TestBench *bench;           /* NULL unless a benchmark sent its samples */
+    TestPerf perf;              /* hardware is -1 unless counts were sent */
+    TestAlloc alloc;            /* allocations is -1 unless they were sent */
 } RcvMsg;
 
+/*
+ * Ring buffer of framed messages, placed in memory shared between the
+ * suite runner and the test process. Each frame is a 4 byte length
+ * followed by a packed message, padded to 4 bytes. Frames never wrap
+ * around the end of data[], so they can be parsed in place. head and
+ * tail are byte counts which only grow until the ring is reset.
+ */
+typedef struct MsgRing
+{
+    volatile size_t head;       /* read position */
+    volatile size_t tail;       /* write position */
+    volatile int spilled;       /* later frames went to the overflow file */
+    size_t size;                /* size of data[], a multiple of 4 */
+    char data[1];
+} MsgRing;
+
 void rcvmsg_free(RcvMsg * rmsg);
+void rcvmsg_update_loc(RcvMsg * rmsg, const char *file, int line);
 
 
 int pack(enum ck_msg_type type, char **buf, CheckMsg * msg);
@@ -81,4 +124,9 @@ int upack(char *buf, CheckMsg * msg, enum ck_msg_type *type);
 void ppack(FILE * fdes, enum ck_msg_type type, CheckMsg * msg);
 RcvMsg *punpack(FILE * fdes);
 
+void msg_ring_init(MsgRing * ring, size_t size);
+void ppack_ring(MsgRing * ring, FILE * overflow, enum ck_msg_type type,
+                CheckMsg * msg);
+RcvMsg *punpack_ring(MsgRing * ring, FILE * overflow);
+
 #endif /*CHECK_PACK_H */
@@ -0,0 +1,229 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <string.h>
+#if HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif /* HAVE_LINUX_PERF_EVENT_H */
+
+#include "check.h"
+#include "check_msg.h"
+#include "check_perf.h"
+
+#if HAVE_LINUX_PERF_EVENT_H && defined(SYS_perf_event_open)
+#define CK_PERF_EVENTS 1
+#else
+#define CK_PERF_EVENTS 0
+#endif
+
+static int perf_on;
+
+#if CK_PERF_EVENTS
+/* The events of a group, the first one leads it */
+typedef struct PerfEvent
+{
+    unsigned int type;
+    unsigned long long config;
+    size_t offset;              /* of the count in a TestPerf */
+} PerfEvent;
+
+#define CK_PERF_MAX_EVENTS 4
+
+static const PerfEvent hardware_events[] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,
+     offsetof(TestPerf, cycles)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS,
+     offsetof(TestPerf, instructions)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES,
+     offsetof(TestPerf, branch_misses)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES,
+     offsetof(TestPerf, cache_misses)}
+};
+
+static const PerfEvent software_events[] = {
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK,
+     offsetof(TestPerf, task_clock)},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,
+     offsetof(TestPerf, page_faults)},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES,
+     offsetof(TestPerf, context_switches)}
+};
+
+/* The group of the process which opened it, or -1 */
+static pid_t perf_pid = -1;
+static int perf_fds[CK_PERF_MAX_EVENTS];
+static int perf_nfds;
+static const PerfEvent *perf_events;
+
+static void perf_open(void);
+static int perf_open_group(const PerfEvent * events, int n);
+static int perf_open_event(const PerfEvent * event, int group_fd);
+static void perf_close(void);
+#endif /* CK_PERF_EVENTS */
+
+int perf_enabled(void)
+{
+    return perf_on;
+}
+
+void perf_set_enabled(int enabled)
+{
+    perf_on = enabled;
+}
+
+void perf_begin(void)
+{
+#if CK_PERF_EVENTS
+    if(!perf_on)
+    {
+        return;
+    }
+    /* A forked process has the counters of its parent */
+    if(perf_pid != getpid())
+    {
+        perf_open();
+    }
+    if(perf_nfds > 0)
+    {
+        ioctl(perf_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(perf_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif /* CK_PERF_EVENTS */
+}
+
+void perf_end(void)
+{
+#if CK_PERF_EVENTS
+    uint64_t buf[1 + CK_PERF_MAX_EVENTS];
+    TestPerf perf;
+    int k;
+
+    if(!perf_on || perf_pid != getpid() || perf_nfds == 0)
+    {
+        return;
+    }
+    ioctl(perf_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    /* The number of events, and then their counts */
+    if(read(perf_fds[0], buf, sizeof(buf)) < (ssize_t)(8 * (1 + perf_nfds))
+       || buf[0] != (uint64_t)perf_nfds)
+    {
+        return;
+    }
+
+    perf_clear(&perf);
+    perf.hardware = perf_events == hardware_events;
+    for(k = 0; k < perf_nfds; k++)
+    {
+        *(int64_t *)((char *)&perf + perf_events[k].offset) =
+            (int64_t)buf[1 + k];
+    }
+    send_perf_info(&perf);
+#endif /* CK_PERF_EVENTS */
+}
+
+void perf_clear(TestPerf * perf)
+{
+    perf->hardware = -1;
+    perf->cycles = -1;
+    perf->instructions = -1;
+    perf->branch_misses = -1;
+    perf->cache_misses = -1;
+    perf->task_clock = -1;
+    perf->page_faults = -1;
+    perf->context_switches = -1;
+}
+
+#if CK_PERF_EVENTS
+/* Open the hardware events, or else the software ones */
+static void perf_open(void)
+{
+    perf_close();
+    perf_pid = getpid();
+    if(perf_open_group(hardware_events,
+                       sizeof(hardware_events) / sizeof(PerfEvent)) == 0)
+    {
+        perf_events = hardware_events;
+    }
+    else if(perf_open_group(software_events,
+                            sizeof(software_events) / sizeof(PerfEvent))
+            == 0)
+    {
+        perf_events = software_events;
+    }
+}
+
+static int perf_open_group(const PerfEvent * events, int n)
+{
+    int k;
+
+    for(k = 0; k < n; k++)
+    {
+        int fd = perf_open_event(&events[k], k > 0 ? perf_fds[0] : -1);
+
+        if(fd == -1)
+        {
+            perf_close();
+            return -1;
+        }
+        perf_fds[perf_nfds++] = fd;
+    }
+    return 0;
+}
+
+static int perf_open_event(const PerfEvent * event, int group_fd)
+{
+    struct perf_event_attr attr;
+    int fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event->type;
+    attr.config = event->config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    if(fd == -1)
+    {
+        /* Unprivileged processes may only count user space */
+        attr.exclude_kernel = 1;
+        fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+    return fd;
+}
+
+/* Closing the counters of a parent only closes the copies of its fds */
+static void perf_close(void)
+{
+    int k;
+
+    for(k = 0; k < perf_nfds; k++)
+    {
+        close(perf_fds[k]);
+    }
+    perf_nfds = 0;
+}
+#endif /* CK_PERF_EVENTS */
@@ -0,0 +1,43 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_PERF_H
+#define CHECK_PERF_H
+
+/*
+ * Performance counters (see srunner_set_perf_counters()): the process
+ * of a test opens a group of perf events, which counts the test
+ * function between perf_begin() and perf_end().
+ */
+
+/* Whether the tests of this run are counted */
+int perf_enabled(void);
+void perf_set_enabled(int enabled);
+
+/* Start counting in the calling process, opening the counters if needed */
+void perf_begin(void);
+
+/* Stop counting, and send the counts to the suite runner */
+void perf_end(void);
+
+/* A TestPerf without counts */
+void perf_clear(TestPerf * perf);
+
+#endif /* CHECK_PERF_H */
@@ -20,11 +20,13 @@
 
 #include "../lib/libcompat.h"
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include "check.h"
+#include "check_error.h"
 #include "check_list.h"
 #include "check_impl.h"
 #include "check_str.h"
@@ -93,7 +95,185 @@ static void srunner_fprint_results(FILE * file, SRunner * sr,
     return;
 }
 
-void fprint_xml_esc(FILE * file, const char *str)
+/*
+ * XML records are put together in a buffer kept from one to the next,
+ * and written with a single call.
+ */
+static char *xml_buf = NULL;
+static size_t xml_size = 0;
+static size_t xml_len = 0;
+
+static void xml_reserve(size_t n)
+{
+    size_t size = xml_size > 0 ? xml_size : 1024;
+
+    if(xml_len + n <= xml_size)
+    {
+        return;
+    }
+    while(size < xml_len + n)
+    {
+        size *= 2;
+    }
+    xml_buf = (char *)erealloc(xml_buf, size);
+    xml_size = size;
+}
+
+static void xml_put(const char *str, size_t n)
+{
+    xml_reserve(n);
+    memcpy(xml_buf + xml_len, str, n);
+    xml_len += n;
+}
+
+static void xml_puts(const char *str)
+{
+    xml_put(str, strlen(str));
+}
+
+static void xml_printf(const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    xml_reserve(64);
+    for(;;)
+    {
+        va_start(ap, fmt);
+        n = vsnprintf(xml_buf + xml_len, xml_size - xml_len, fmt, ap);
+        va_end(ap);
+        if(n < 0)
+        {
+            eprintf("Error in call to vsnprintf:", __FILE__, __LINE__ - 4);
+        }
+        if((size_t)n < xml_size - xml_len)
+        {
+            xml_len += n;
+            return;
+        }
+        xml_reserve(n + 1);
+    }
+}
+
+static void xml_write(FILE * file)
+{
+    fwrite(xml_buf, 1, xml_len, file);
+    xml_len = 0;
+}
+
+void tr_xmlprint_free(void)
+{
+    free(xml_buf);
+    xml_buf = NULL;
+    xml_size = 0;
+    xml_len = 0;
+}
+
+/*
+ * The bytes copied to XML as they are: printable ASCII, but for the
+ * special characters. They are looked for 16 or 32 at a time where the
+ * compiler has SSE2 or AVX2. The loads are aligned, so that they do
+ * not reach a page past the end of the string; sanitizers would still
+ * report the bytes read past it, and get the byte by byte loop.
+ */
+#if defined(__SANITIZE_ADDRESS__)
+#define CK_XML_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define CK_XML_ASAN 1
+#endif
+#endif
+
+#if defined(__GNUC__) && !defined(CK_XML_ASAN) \
+    && (defined(__AVX2__) || defined(__SSE2__))
+#define CK_XML_SIMD 1
+#include <immintrin.h>
+#else
+#define CK_XML_SIMD 0
+#endif
+
+static int xml_is_plain(unsigned char c)
+{
+    return c >= 0x20 && c <= 0x7E && c != '"' && c != '\'' && c != '<'
+        && c != '>' && c != '&';
+}
+
+#if CK_XML_SIMD && defined(__AVX2__)
+#define XML_SIMD_WIDTH 32
+
+/* A bit for each of the 32 bytes at p which is not plain */
+static unsigned int xml_special_mask(const char *p)
+{
+    __m256i v = _mm256_load_si256((const __m256i *)p);
+    __m256i plain = _mm256_and_si256(
+        _mm256_cmpgt_epi8(v, _mm256_set1_epi8(0x1F)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8(0x7F), v));
+    __m256i special = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                        _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\''))),
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('<')),
+                            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('>'))),
+            _mm256_cmpeq_epi8(v, _mm256_set1_epi8('&'))));
+
+    return ~(unsigned int)_mm256_movemask_epi8(
+        _mm256_andnot_si256(special, plain));
+}
+#elif CK_XML_SIMD
+#define XML_SIMD_WIDTH 16
+
+/* A bit for each of the 16 bytes at p which is not plain */
+static unsigned int xml_special_mask(const char *p)
+{
+    __m128i v = _mm_load_si128((const __m128i *)p);
+    __m128i plain = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1F)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8(0x7F)));
+    __m128i special = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\''))),
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('<')),
+                                  _mm_cmpeq_epi8(v, _mm_set1_epi8('>'))),
+                     _mm_cmpeq_epi8(v, _mm_set1_epi8('&'))));
+
+    return ~(unsigned int)_mm_movemask_epi8(_mm_andnot_si128(special, plain))
+        & 0xFFFF;
+}
+#endif /* CK_XML_SIMD */
+
+/* The number of plain bytes at the start of str */
+static size_t xml_plain_span(const char *str)
+{
+    const char *p = str;
+
+#if CK_XML_SIMD
+    while(((size_t)p & (XML_SIMD_WIDTH - 1)) != 0)
+    {
+        if(!xml_is_plain((unsigned char)*p))
+        {
+            return p - str;
+        }
+        p++;
+    }
+    for(;;)
+    {
+        unsigned int mask = xml_special_mask(p);
+
+        if(mask != 0)
+        {
+            return p - str + __builtin_ctz(mask);
+        }
+        p += XML_SIMD_WIDTH;
+    }
+#else
+    while(xml_is_plain((unsigned char)*p))
+    {
+        p++;
+    }
+    return p - str;
+#endif /* CK_XML_SIMD */
+}
+
+static void xml_put_esc(const char *str)
 {
     /* The valid XML characters are as follows:
      *   #x9 | #xA | #xD | [#x20-#xD7FF] | [#xE000-#xFFFD] | [#x10000-#x10FFFF]
@@ -103,46 +283,75 @@ void fprint_xml_esc(FILE * file, const char *str)
      * must be encoded. We assume that the incoming string may be a multibyte
      * character.
      */
+    for(;;)
+    {
+        size_t n = xml_plain_span(str);
+
+        xml_put(str, n);
+        str += n;
+        switch (*str)
+        {
+            case '\0':
+                return;
+            case '"':
+                xml_puts("&quot;");
+                break;
+            case '\'':
+                xml_puts("&apos;");
+                break;
+            case '<':
+                xml_puts("&lt;");
+                break;
+            case '>':
+                xml_puts("&gt;");
+                break;
+            case '&':
+                xml_puts("&amp;");
+                break;
+            /* Non-printable character */
+            case 0x9:
+            case 0xA:
+            case 0xD:
+            case 0x7F:
+                xml_printf("&#x%X;", *str);
+                break;
+            default:
+                /* If it did not get printed, it is not a valid XML character */
+                break;
+        }
+        str++;
+    }
+}
 
+void fprint_xml_esc(FILE * file, const char *str)
+{
+    xml_put_esc(str);
+    xml_write(file);
+}
+
+void fprint_json_str(FILE * file, const char *str)
+{
+    fputc('"', file);
     for(; *str != '\0'; str++)
     {
-        char next = *str;
+        unsigned char next = (unsigned char)*str;
 
-        /* handle special characters that must be escaped */
-        if(next == '"' || next == '\'' || next == '<' || next == '>' || next == '&')
+        if(next == '"' || next == '\\')
         {
-            switch (next)
-            {
-                case '"':
-                    fputs("&quot;", file);
-                    break;
-                case '\'':
-                    fputs("&apos;", file);
-                    break;
-                case '<':
-                    fputs("&lt;", file);
-                    break;
-                case '>':
-                    fputs("&gt;", file);
-                    break;
-                case '&':
-                    fputs("&amp;", file);
-                    break;
-            }
+            fputc('\\', file);
+            fputc(next, file);
         }
-        /* printable ASCII */
-        else if(next >= ' ' && next <= '~')
+        else if(next < 0x20)
         {
-            fputc(next, file);
+            fprintf(file, "\\u%04x", next);
         }
-        /* Non-printable character */
-        else if(next == 0x9 || next == 0xA || next == 0xD ||
-                next >= 0x20)
+        else
         {
-            fprintf(file, "&#x%X;", next);
+            /* Anything else, UTF-8 included, is copied */
+            fputc(next, file);
         }
-        /* If it did not get printed, it is not a valid XML character*/
     }
+    fputc('"', file);
 }
 
 void tr_fprint(FILE * file, TestResult * tr, enum print_output print_mode)
@@ -165,28 +374,33 @@ void tr_fprint(FILE * file, TestResult * tr, enum print_output print_mode)
 void tr_xmlprint(FILE * file, TestResult * tr,
                  enum print_output print_mode CK_ATTRIBUTE_UNUSED)
 {
-    char result[10];
-    char *path_name = NULL;
-    char *file_name = NULL;
-    char *slash = NULL;
+    const char *result;
+    const char *file_name = "";
+    const char *slash = NULL;
 
     switch (tr->rtype)
     {
         case CK_PASS:
-            snprintf(result, sizeof(result), "%s", "success");
+            result = "success";
             break;
         case CK_FAILURE:
-            snprintf(result, sizeof(result), "%s", "failure");
+            result = "failure";
             break;
         case CK_ERROR:
-            snprintf(result, sizeof(result), "%s", "error");
+            result = "error";
             break;
         case CK_TEST_RESULT_INVALID:
+            /* A test which was not run, see log_test_skip() */
+            result = "skipped";
+            break;
         default:
             abort();
             break;
     }
 
+    xml_puts("    <test result=\"");
+    xml_puts(result);
+    xml_puts("\">\n      <path>");
     if(tr->file)
     {
         slash = strrchr(tr->file, '/');
@@ -197,37 +411,80 @@ void tr_xmlprint(FILE * file, TestResult * tr,
 
         if(slash == NULL)
         {
-            path_name = strdup(".");
+            xml_puts(".");
             file_name = tr->file;
         }
         else
         {
-            path_name = strdup(tr->file);
-            path_name[slash - tr->file] = 0;    /* Terminate the temporary string. */
+            xml_put(tr->file, slash - tr->file);
             file_name = slash + 1;
         }
     }
+    xml_puts("</path>\n      <fn>");
+    xml_puts(file_name);
+    xml_printf(":%d</fn>\n", tr->line);
+    xml_puts("      <id>");
+    xml_puts(tr->tname);
+    xml_printf("</id>\n      <iteration>%d</iteration>\n"
+               "      <duration>%d.%06d</duration>\n", tr->iter,
+               tr->duration < 0 ? -1 : tr->duration / US_PER_SEC,
+               tr->duration < 0 ? 0 : tr->duration % US_PER_SEC);
+    if(tr->rusage.utime >= 0)
+    {
+        const TestRusage *ru = &tr->rusage;
+
+        xml_printf("      <rusage utime=\"%ld.%06ld\" stime=\"%ld.%06ld\""
+                   " maxrss=\"%ld\" minflt=\"%ld\" majflt=\"%ld\""
+                   " nvcsw=\"%ld\" nivcsw=\"%ld\" inblock=\"%ld\""
+                   " oublock=\"%ld\"/>\n",
+                   ru->utime / US_PER_SEC, ru->utime % US_PER_SEC,
+                   ru->stime / US_PER_SEC, ru->stime % US_PER_SEC,
+                   ru->maxrss, ru->minflt, ru->majflt, ru->nvcsw, ru->nivcsw,
+                   ru->inblock, ru->oublock);
+    }
+    if(tr->bench != NULL)
+    {
+        const TestBench *b = tr->bench;
+
+        xml_printf("      <bench iterations=\"%ld\" samples=\"%d\""
+                   " min=\"%.3f\" median=\"%.3f\" mean=\"%.3f\""
+                   " mad=\"%.3f\" p99=\"%.3f\"/>\n", b->iterations,
+                   b->nsamples, b->min, b->median, b->mean, b->mad, b->p99);
+    }
+    if(tr->perf.hardware > 0)
+    {
+        const TestPerf *p = &tr->perf;
+
+        xml_printf("      <perf cycles=\"%.0f\" instructions=\"%.0f\""
+                   " branch-misses=\"%.0f\" cache-misses=\"%.0f\"/>\n",
+                   (double)p->cycles, (double)p->instructions,
+                   (double)p->branch_misses, (double)p->cache_misses);
+    }
+    else if(tr->perf.hardware == 0)
+    {
+        const TestPerf *p = &tr->perf;
+
+        xml_printf("      <perf task-clock=\"%.0f\" page-faults=\"%.0f\""
+                   " context-switches=\"%.0f\"/>\n", (double)p->task_clock,
+                   (double)p->page_faults, (double)p->context_switches);
+    }
+    if(tr->alloc.allocations >= 0)
+    {
+        const TestAlloc *a = &tr->alloc;
 
+        xml_printf("      <alloc allocations=\"%ld\" frees=\"%ld\""
+                   " bytes=\"%ld\" peak-bytes=\"%ld\" leaks=\"%ld\""
+                   " leaked-bytes=\"%ld\"/>\n", (long)a->allocations,
+                   (long)a->frees, (long)a->bytes, (long)a->peak_bytes,
+                   (long)a->leaks, (long)a->leaked_bytes);
+    }
+    xml_puts("      <description>");
+    xml_put_esc(tr->tcname);
+    xml_puts("</description>\n      <message>");
+    xml_put_esc(tr->msg);
+    xml_puts("</message>\n    </test>\n");
 
-    fprintf(file, "    <test result=\"%s\">\n", result);
-    fprintf(file, "      <path>%s</path>\n",
-            (path_name == NULL ? "" : path_name));
-    fprintf(file, "      <fn>%s:%d</fn>\n",
-            (file_name == NULL ? "" : file_name), tr->line);
-    fprintf(file, "      <id>%s</id>\n", tr->tname);
-    fprintf(file, "      <iteration>%d</iteration>\n", tr->iter);
-    fprintf(file, "      <duration>%d.%06d</duration>\n",
-            tr->duration < 0 ? -1 : tr->duration / US_PER_SEC,
-            tr->duration < 0 ? 0 : tr->duration % US_PER_SEC);
-    fprintf(file, "      <description>");
-    fprint_xml_esc(file, tr->tcname);
-    fprintf(file, "</description>\n");
-    fprintf(file, "      <message>");
-    fprint_xml_esc(file, tr->msg);
-    fprintf(file, "</message>\n");
-    fprintf(file, "    </test>\n");
-
-    free(path_name);
+    xml_write(file);
 }
 
 enum print_output get_env_printmode(void)
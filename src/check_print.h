@@ -23,8 +23,12 @@
 
 /* escape XML special characters (" ' < > &) in str and print to file */
 void fprint_xml_esc(FILE * file, const char *str);
+/* print str as a JSON string, with the quotes */
+void fprint_json_str(FILE * file, const char *str);
 void tr_fprint(FILE * file, TestResult * tr, enum print_output print_mode);
 void tr_xmlprint(FILE * file, TestResult * tr, enum print_output print_mode);
+/* free the buffer kept by tr_xmlprint() and fprint_xml_esc() */
+void tr_xmlprint_free(void);
 void srunner_fprint(FILE * file, SRunner * sr, enum print_output print_mode);
 enum print_output get_env_printmode(void);
 
@@ -28,13 +28,54 @@
 #include <stdarg.h>
 #include <signal.h>
 #include <setjmp.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 
 #include "check.h"
+#include "check_baseline.h"
+#include "check_bench.h"
 #include "check_error.h"
+#include "check_history.h"
 #include "check_list.h"
 #include "check_impl.h"
 #include "check_msg.h"
+#include "check_perf.h"
+#include "check_alloc.h"
 #include "check_log.h"
+#include "check_select.h"
+#include "check_shard.h"
+#include "check_str.h"
+#include "check_supervisor.h"
+#include "check_zygote.h"
+
+#if defined(HAVE_FORK) && HAVE_FORK==1
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#if HAVE_SETRLIMIT && HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#define CK_LIMITS 1
+/* Also counts anonymous mappings on Linux, unlike RLIMIT_AS it leaves
+   the address space which sanitizers reserve alone */
+#ifdef RLIMIT_DATA
+#define CK_RLIMIT_MEMORY RLIMIT_DATA
+#else
+#define CK_RLIMIT_MEMORY RLIMIT_AS
+#endif
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#if HAVE_MMAP && !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#else
+#define CK_LIMITS 0
+#endif
+#endif /* HAVE_FORK */
 
 enum rinfo
 {
@@ -61,8 +102,36 @@ static void srunner_run_end(SRunner * sr, enum print_output print_mode);
 static void srunner_iterate_suites(SRunner * sr,
                                    const char *sname, const char *tcname,
                                    enum print_output print_mode);
-static void srunner_iterate_tcase_tfuns(SRunner * sr, TCase * tc);
+static void srunner_shard_tests(SRunner * sr, SelectedTCase * sts,
+                                size_t nsts);
+static int srunner_selects(SRunner * sr, Suite * s, TCase * tc, TF * tfun,
+                           int i);
+static int srunner_selects_tcase(SRunner * sr, Suite * s, TCase * tc);
+static int shard_getenv(int *index, int *count);
+static void srunner_plan_history(SRunner * sr, SelectedTCase * sts,
+                                 size_t nsts);
+static void srunner_iterate_tcase_tfuns(SRunner * sr, Suite * s, TCase * tc);
+static void srunner_log_suite(SRunner * sr, Suite * s, int end);
+static void srunner_wait_all(SRunner * sr);
+static void srunner_fork_server_reset(void);
+static void srunner_snapshot_start(SRunner * sr, TCase * tc);
+static void srunner_snapshot_end(SRunner * sr);
+static int fixture_list_empty(List * fixture_list);
 static void srunner_add_failure(SRunner * sr, TestResult * tf);
+static char *srunner_intern(SRunner * sr, char *str);
+static void srunner_grow_strings(SRunner * sr);
+static size_t hash_string(const char *str);
+static void srunner_stop(SRunner * sr);
+static int srunner_skips_test(SRunner * sr, TCase * tc, TF * tfun);
+static TestResult *skip_result(SRunner * sr, TCase * tc, TF * tfun, int i);
+static void tfun_set_result(TF * tfun, TestResult * tr);
+static void tfun_call(TF * tfun, int i);
+static void srunner_log_test_start(SRunner * sr, TCase * tc, TF * tfun);
+static void srunner_report_result(SRunner * sr, TF * tfun, TestResult * tr);
+static void srunner_compare_bench(SRunner * sr, TF * tfun, TestResult * tr);
+static double srunner_bench_ratio(SRunner * sr);
+static double srunner_bench_alpha(SRunner * sr);
+static double env_double(const char *name, double default_val);
 static TestResult * srunner_run_setup(List * func_list,
     enum fork_status fork_usage, const char * test_name,
     const char * setup_name);
@@ -71,7 +140,7 @@ static TestResult *tcase_run_checked_setup(SRunner * sr, TCase * tc);
 static void srunner_run_teardown(List * fixture_list, enum fork_status fork_usage);
 static void srunner_run_unchecked_teardown(SRunner * sr, TCase * tc);
 static void tcase_run_checked_teardown(TCase * tc);
-static void srunner_run_tcase(SRunner * sr, TCase * tc);
+static void srunner_run_tcase(SRunner * sr, Suite * s, TCase * tc);
 static TestResult *tcase_run_tfun_nofork(SRunner * sr, TCase * tc, TF * tf,
                                          int i);
 static TestResult *receive_result_info_nofork(const char *tcname,
@@ -83,19 +152,227 @@ static char *pass_msg(void);
 #if defined(HAVE_FORK) && HAVE_FORK==1
 static TestResult *tcase_run_tfun_fork(SRunner * sr, TCase * tc, TF * tf,
                                        int i);
-static TestResult *receive_result_info_fork(const char *tcname,
+static void tcase_run_tfun_child(SRunner * sr, TCase * tc, TF * tfun, int i);
+static void tcase_run_tfun_body(SRunner * sr, TCase * tc, TF * tfun, int i);
+static void tcase_run_snapshot_setup(SRunner * sr, TCase * tc);
+static void tcase_set_limits(TCase * tc);
+#if CK_LIMITS
+static void set_limit(int resource, rlim_t value);
+static void memory_limit_handler(int sig);
+#endif /* CK_LIMITS */
+static void srunner_fork_test(SRunner * sr, TCase * tc, TF * tfun, int i,
+                              int slot);
+static int srunner_wait_test(int *status, int *timed_out,
+                             TestRusage * rusage);
+static void fork_child_init(void);
+static void fork_server_init(void);
+static TestResult *receive_result_info_fork(TCase * tc,
                                             const char *tname, int iter,
-                                            int status, int expected_signal,
+                                            int status, int timed_out,
+                                            int expected_signal,
                                             signed char allowed_exit_value);
-static void set_fork_info(TestResult * tr, int status, int expected_signal,
-                          signed char allowed_exit_value);
-static char *signal_msg(int sig);
-static char *signal_error_msg(int signal_received, int signal_expected);
+static void set_fork_info(TestResult * tr, int status, int timed_out,
+                          int expected_signal,
+                          signed char allowed_exit_value,
+                          int memory_limited);
+static char *signal_msg(int sig, int timed_out);
+static char *signal_error_msg(int signal_received, int signal_expected,
+                              int timed_out);
 static char *exit_msg(int exitstatus);
 static int waserror(int status, int expected_signal);
+static void srunner_fork_init(SRunner * sr, int njobs);
+static void srunner_fork_end(SRunner * sr);
+
+/*
+ * Batch runs (CK_FORK_BATCH): one forked process runs the tests of a
+ * test case one after another. Before each test it waits for a byte
+ * from the suite runner on a socket, and it answers with a byte once
+ * the test has ended. The suite runner takes the results of the test
+ * from the message channel before it lets the next test start. When
+ * the process ends instead, the test which was running gets the
+ * result of a forked test, and a new process continues with the test
+ * after it.
+ */
+typedef struct BatchTest
+{
+    TF *tfun;
+    int iter;
+} BatchTest;
+
+static void srunner_run_batch(SRunner * sr, Suite * s, TCase * tc);
+static int srunner_batches_tfun(SRunner * sr, TCase * tc, TF * tfun);
+static void srunner_run_batch_loop(SRunner * sr, Suite * s, TCase * tc,
+                                   TF * tfun);
+static void srunner_run_batch_tests(SRunner * sr, TCase * tc,
+                                    BatchTest * tests, int ntests);
+static int srunner_run_batch_process(SRunner * sr, TCase * tc,
+                                     BatchTest * tests, int first,
+                                     int ntests);
+static void tcase_run_batch_child(SRunner * sr, TCase * tc,
+                                  BatchTest * tests, int ntests, int fd);
+static int srunner_wait_batch(int fd, int *status, int *timed_out);
+static int batch_send(int fd);
+static int batch_receive(int fd);
+
+/*
+ * Parallel runs (see srunner_set_jobs()): tests are forked without
+ * waiting for the previous ones, each into a free job slot with its
+ * own message channel (see set_msg_slots()) and supervisor slot. The
+ * tests and the suite start and end events are queued in the order of
+ * a serial run, and passed on to the log functions once everything
+ * before them is done, so the output does not depend on the number of
+ * jobs.
+ */
+enum pending_type
+{
+    CK_PENDING_TEST,
+    CK_PENDING_TCASE,
+    CK_PENDING_CHUNK,
+    CK_PENDING_SUITE_START,
+    CK_PENDING_SUITE_END
+};
+
+/* A result which the process of a test case reported */
+typedef struct Report
+{
+    TF *tfun;                   /* NULL for the result of a fixture */
+    TestResult *tr;
+    struct Report *next;
+} Report;
+
+typedef struct Pending
+{
+    enum pending_type type;
+    Suite *s;
+    TCase *tc;
+    TF *tfun;
+    int iter;                   /* the next iteration to run of a chunk */
+    int iter_end;               /* the end of the iterations of a chunk */
+    int estimate;               /* the expected duration, see jobs_dispatch() */
+    int order;
+    TestResult *tr;             /* NULL while the test is running */
+    Report *reports;            /* results of a test case not logged yet */
+    Report *reports_tail;
+    int nreported;              /* results of tests which were reported */
+    int done;                   /* the process of a test case has ended */
+    int cancelled;              /* killed as the run stopped */
+    struct Pending *next;
+} Pending;
+
+typedef struct JobPool
+{
+    Pending **jobs;             /* the test running in each slot, or NULL */
+    int njobs;
+    int running;
+    Pending *head;
+    Pending *tail;
+    Pending **waiting;          /* queued, but not started yet */
+    int nwaiting;
+    int max_waiting;
+} JobPool;
+
+static void srunner_jobs_start(SRunner * sr, int njobs);
+static void srunner_jobs_end(SRunner * sr);
+static void srunner_queue_test(SRunner * sr, Suite * s, TCase * tc,
+                               TF * tfun, int i);
+static Pending *pending_create(enum pending_type type);
+static int jobs_free_slot(SRunner * sr);
+static void jobs_queue(Pending * p);
+static void jobs_submit(SRunner * sr, Pending * p);
+static void jobs_start(SRunner * sr, Pending * p);
+static int jobs_skip(SRunner * sr, Pending * p);
+static void jobs_dispatch(SRunner * sr);
+static int pending_estimate(SRunner * sr, Pending * p);
+static int pending_cmp(const void *a, const void *b);
+static void srunner_wait_jobs(SRunner * sr, int all);
+static void srunner_collect_job(SRunner * sr, int slot, int status,
+                                int timed_out, const TestRusage * rusage);
+static void srunner_emit_pending(SRunner * sr);
+
+/*
+ * Test cases in processes of their own (see srunner_set_fork_tcase()):
+ * each one is forked into a job slot like a test, and keeps only the
+ * message channel of the slot. It runs the test case as the suite
+ * runner would, but sends each result to the suite runner instead,
+ * through a datagram socket which all of them share. The suite runner
+ * logs the results as they arrive, in the order of a serial run.
+ */
+typedef struct TCaseReport
+{
+    int slot;
+    TF *tfun;                   /* NULL for the result of a fixture */
+    const char *tname;
+    int iter;
+    enum test_result rtype;
+    enum ck_result_ctx ctx;
+    int line;
+    int duration;
+    TestRusage rusage;
+    TestPerf perf;
+    TestAlloc alloc;
+    long bench_iterations;
+    int bench_nsamples;         /* 0 unless the result has samples */
+    int file_len;               /* -1 if there is no file */
+    int msg_len;                /* -1 if there is no message */
+} TCaseReport;
+
+/* The strings of a report are cut to this length */
+#define CK_REPORT_STR_MAX 8192
+/* A report has its strings and then the samples of a benchmark */
+#define CK_REPORT_MAX (sizeof(TCaseReport) + 2 * CK_REPORT_STR_MAX \
+                       + CK_BENCH_MAX_SAMPLES * sizeof(double))
+
+static void srunner_tcase_init(SRunner * sr, int njobs);
+static void srunner_queue_tcase(SRunner * sr, Suite * s, TCase * tc);
+static void srunner_fork_tcase_process(SRunner * sr, Suite * s, TCase * tc,
+                                       int slot);
+static void tcase_run_child(SRunner * sr, Suite * s, TCase * tc);
+static void tcase_send_report(TF * tfun, TestResult * tr);
+static int report_put_string(char *buf, size_t * len, const char *str);
+static char *report_get_string(const char *buf, size_t * pos,
+                               size_t len, int str_len);
+static void srunner_receive_reports(SRunner * sr);
+static void srunner_collect_tcase(SRunner * sr, Pending * p, int slot,
+                                  int status, int timed_out);
+static void pending_add_report(Pending * p, TF * tfun, TestResult * tr);
+static void pending_skip_tests(SRunner * sr, Pending * p, int first);
+
+/*
+ * Loop tests in chunks (see srunner_set_loop_chunks()): a range of
+ * iterations is forked into a job slot as one process, which runs
+ * them one after another and reports each result like a test case
+ * process. When the process ends before the end of the range, the
+ * iteration which was running gets the result of a forked test, and
+ * a new process continues with the next one in the same slot.
+ */
+
+/* The duration which a chunk should take, in us */
+#define CK_CHUNK_USEC 10000
+
+static int srunner_chunks_tfun(SRunner * sr, TCase * tc, TF * tfun);
+static void srunner_queue_chunks(SRunner * sr, Suite * s, TCase * tc,
+                                 TF * tfun);
+static int chunk_size(SRunner * sr, Suite * s, TCase * tc, TF * tfun,
+                      int i);
+static void srunner_fork_chunk(SRunner * sr, Pending * p, int slot);
+static void tcase_run_chunk_child(SRunner * sr, Pending * p);
+static int chunk_next(SRunner * sr, Pending * p);
+static void srunner_collect_chunk(SRunner * sr, Pending * p, int slot,
+                                  int status, int timed_out);
+static void chunk_skip_rest(SRunner * sr, Pending * p);
+static void report_socket_open(void);
+
+static Supervisor *supervisor; /* NULL unless running in CK_FORK mode */
+static JobPool *job_pool;       /* NULL unless running in parallel */
+static Zygote *zygote;          /* NULL unless a fork server can be used */
+static int use_fork_server;     /* fork all tests from the fork server */
+static TCase *snapshot_tc;      /* its tests are forked from the fork server */
+static int snapshot_taken;      /* the checked setup already ran */
+static int fork_tcase;          /* the job slots run test cases */
+static int report_fds[2] = { -1, -1 };  /* the reports of test cases */
+static int report_slot = -1;    /* the slot of this test case process */
+static long memory_limit = -1;  /* of the test in this process, in MB */
 
-static int alarm_received;
-static pid_t group_pid;
 static struct sigaction sigint_old_action;
 static struct sigaction sigterm_old_action;
 
@@ -103,10 +380,6 @@ static void CK_ATTRIBUTE_UNUSED sig_handler(int sig_nr)
 {
     switch (sig_nr)
     {
-        case SIGALRM:
-            alarm_received = 1;
-            killpg(group_pid, SIGKILL);
-            break;
         case SIGTERM:
         case SIGINT:
         {
@@ -123,7 +396,27 @@ static void CK_ATTRIBUTE_UNUSED sig_handler(int sig_nr)
                 sigaction(SIGTERM, &sigterm_old_action, NULL);
             }
 
-            killpg(group_pid, child_sig);
+            /* Test case processes stop their tests on the killpg() */
+            if(supervisor != NULL && !fork_tcase)
+            {
+                supervisor_kill_all(supervisor, child_sig);
+            }
+
+            /*
+             * A test case process which is killed ends alone. The old
+             * action may be this handler, if the suite runner runs in
+             * a test.
+             */
+            if(report_slot != -1)
+            {
+                struct sigaction default_action;
+
+                memset(&default_action, 0, sizeof(default_action));
+                default_action.sa_handler = SIG_DFL;
+                sigaction(sig_nr, &default_action, NULL);
+                raise(sig_nr);
+                break;
+            }
 
             /* POSIX says that calling killpg(0)
              * does not necessarily mean to call it on the callers
@@ -144,17 +437,33 @@ static void CK_ATTRIBUTE_UNUSED sig_handler(int sig_nr)
 static void srunner_run_init(SRunner * sr, enum print_output print_mode)
 {
     set_fork_status(srunner_fork_status(sr));
+    set_loc_tracking(srunner_loc_tracking(sr));
+    sr->stopped = 0;
     setup_messaging();
     srunner_init_logging(sr, print_mode);
     log_srunner_start(sr);
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    if(srunner_fork_status(sr) != CK_NOFORK && srunner_fork_tcase(sr))
+    {
+        srunner_tcase_init(sr, srunner_jobs(sr));
+    }
+    else
+    {
+        srunner_fork_init(sr, srunner_jobs(sr));
+    }
+#endif /* HAVE_FORK */
 }
 
 static void srunner_run_end(SRunner * sr,
                             enum print_output CK_ATTRIBUTE_UNUSED print_mode)
 {
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    srunner_fork_end(sr);
+#endif /* HAVE_FORK */
     log_srunner_end(sr);
     srunner_end_logging(sr);
     teardown_messaging();
+    set_loc_tracking(CK_LOC_MESSAGE);
     set_fork_status(CK_FORK);
 }
 
@@ -163,48 +472,204 @@ static void srunner_iterate_suites(SRunner * sr,
                                    enum print_output CK_ATTRIBUTE_UNUSED
                                    print_mode)
 {
-    List *slst;
-    List *tcl;
-    TCase *tc;
+    SelectedTCase *sts;
+    size_t nsts;
+    size_t i;
 
-    slst = sr->slst;
+    sr->selection = selection_create(sr->index, sr->slst, sname, tcname,
+                                     srunner_filter(sr),
+                                     srunner_include_tags(sr),
+                                     srunner_exclude_tags(sr));
+    sts = selection_tcases(sr->selection, &nsts);
 
-    for(check_list_front(slst); !check_list_at_end(slst);
-        check_list_advance(slst))
+    if(srunner_shard_count(sr) > 1 || srunner_has_shard_file(sr))
     {
-        Suite *s = (Suite *)check_list_val(slst);
+        size_t n = 0;
 
-        if(((sname != NULL) && (strcmp(sname, s->name) != 0))
-           || ((tcname != NULL) && (!suite_tcase(s, tcname))))
-            continue;
+        /* Only the suites with tests in this shard are logged */
+        srunner_shard_tests(sr, sts, nsts);
+        for(i = 0; i < nsts; i++)
+        {
+            if(sts[i].tc != NULL
+               && srunner_selects_tcase(sr, sts[i].s, sts[i].tc))
+            {
+                sts[n++] = sts[i];
+            }
+        }
+        nsts = n;
+    }
+    if(sr->history != NULL)
+    {
+        srunner_plan_history(sr, sts, nsts);
+    }
 
-        log_suite_start(sr, s);
+    for(i = 0; i < nsts; i++)
+    {
+        Suite *s = sts[i].s;
+
+        if(i == 0 || sts[i].suite_no != sts[i - 1].suite_no)
+        {
+            srunner_log_suite(sr, s, 0);
+        }
+        if(sts[i].tc != NULL)
+        {
+            srunner_run_tcase(sr, s, sts[i].tc);
+        }
+        if(i + 1 == nsts || sts[i].suite_no != sts[i + 1].suite_no)
+        {
+            srunner_log_suite(sr, s, 1);
+        }
+    }
+
+    if(sr->shard != NULL)
+    {
+        shard_free(sr->shard);
+        sr->shard = NULL;
+    }
+    selection_free(sr->selection);
+    sr->selection = NULL;
+}
+
+/* Assign the selected tests to the shards */
+static void srunner_shard_tests(SRunner * sr, SelectedTCase * sts,
+                                size_t nsts)
+{
+    size_t k;
 
-        tcl = s->tclst;
+    sr->shard = shard_create(srunner_shard_index(sr),
+                             srunner_shard_count(sr));
 
-        for(check_list_front(tcl); !check_list_at_end(tcl);
-            check_list_advance(tcl))
+    for(k = 0; k < nsts; k++)
+    {
+        Suite *s = sts[k].s;
+        TCase *tc = sts[k].tc;
+        List *tfl;
+
+        if(tc == NULL)
+            continue;
+
+        tfl = tc->tflst;
+        for(check_list_front(tfl); !check_list_at_end(tfl);
+            check_list_advance(tfl))
         {
-            tc = (TCase *)check_list_val(tcl);
+            TF *tfun = (TF *)check_list_val(tfl);
+            int i;
 
-            if((tcname != NULL) && (strcmp(tcname, tc->name) != 0))
-            {
+            if(!selection_selects(sr->selection, s, tc, tfun))
                 continue;
+
+            for(i = tfun->loop_start; i < tfun->loop_end; i++)
+            {
+                int estimate = -1;
+
+                if(sr->history != NULL)
+                {
+                    estimate = history_median(sr->history, s->name,
+                                              tc->name, tfun->name, i);
+                }
+                shard_add(sr->shard, s->name, tc->name, tfun->name, i,
+                          estimate);
             }
+        }
+    }
+
+    shard_assign(sr->shard);
+    if(srunner_has_shard_file(sr)
+       && shard_save(sr->shard, srunner_shard_fname(sr)) != 0)
+    {
+        eprintf("Error while writing shard file %s:", __FILE__,
+                __LINE__ - 3, srunner_shard_fname(sr));
+    }
+}
 
-            srunner_run_tcase(sr, tc);
+/* Whether a test is run, by the selection and the shard */
+static int srunner_selects(SRunner * sr, Suite * s, TCase * tc, TF * tfun,
+                           int i)
+{
+    if(sr->selection != NULL
+       && !selection_selects(sr->selection, s, tc, tfun))
+    {
+        return 0;
+    }
+    return sr->shard == NULL
+        || shard_selects(sr->shard, s->name, tc->name, tfun->name, i);
+}
+
+static int srunner_selects_tcase(SRunner * sr, Suite * s, TCase * tc)
+{
+    List *tfl = tc->tflst;
+
+    if(sr->shard == NULL)
+    {
+        return 1;
+    }
+
+    for(check_list_front(tfl); !check_list_at_end(tfl);
+        check_list_advance(tfl))
+    {
+        TF *tfun = (TF *)check_list_val(tfl);
+        int i;
+
+        for(i = tfun->loop_start; i < tfun->loop_end; i++)
+        {
+            if(srunner_selects(sr, s, tc, tfun, i))
+            {
+                return 1;
+            }
         }
+    }
+    return 0;
+}
 
-        log_suite_end(sr, s);
+/* Tell the duration history which tests are going to run */
+static void srunner_plan_history(SRunner * sr, SelectedTCase * sts,
+                                 size_t nsts)
+{
+    size_t k;
+
+    for(k = 0; k < nsts; k++)
+    {
+        Suite *s = sts[k].s;
+        TCase *tc = sts[k].tc;
+        List *tfl;
+
+        if(tc == NULL)
+            continue;
+
+        tfl = tc->tflst;
+        for(check_list_front(tfl); !check_list_at_end(tfl);
+            check_list_advance(tfl))
+        {
+            TF *tfun = (TF *)check_list_val(tfl);
+            int i;
+
+            for(i = tfun->loop_start; i < tfun->loop_end; i++)
+            {
+                if(srunner_selects(sr, s, tc, tfun, i))
+                {
+                    history_plan(sr->history, s->name, tc->name,
+                                 tfun->name, i);
+                }
+            }
+        }
     }
 }
 
-static void srunner_iterate_tcase_tfuns(SRunner * sr, TCase * tc)
+static void srunner_iterate_tcase_tfuns(SRunner * sr, Suite * s, TCase * tc)
 {
     List *tfl;
     TF *tfun;
     TestResult *tr = NULL;
 
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    /* The tests have to send their results while the process lives on */
+    if(srunner_fork_status(sr) == CK_FORK_BATCH && msg_slots_shared())
+    {
+        srunner_run_batch(sr, s, tc);
+        return;
+    }
+#endif /* HAVE_FORK */
+
     tfl = tc->tflst;
 
     for(check_list_front(tfl); !check_list_at_end(tfl);
@@ -213,13 +678,46 @@ static void srunner_iterate_tcase_tfuns(SRunner * sr, TCase * tc)
         int i;
 
         tfun = (TF *)check_list_val(tfl);
+        tfun->failed = 0;
+        tfun->nmeasured = 0;
+        tfun->measured_usec = 0;
+
+#if defined(HAVE_FORK) && HAVE_FORK==1
+        if(job_pool != NULL && srunner_chunks_tfun(sr, tc, tfun))
+        {
+            srunner_queue_chunks(sr, s, tc, tfun);
+            continue;
+        }
+        if(srunner_batches_tfun(sr, tc, tfun))
+        {
+            srunner_run_batch_loop(sr, s, tc, tfun);
+            continue;
+        }
+#endif /* HAVE_FORK */
 
         for(i = tfun->loop_start; i < tfun->loop_end; i++)
         {
-            log_test_start(sr, tc, tfun);
+            if(!srunner_selects(sr, s, tc, tfun, i))
+            {
+                continue;
+            }
+#if defined(HAVE_FORK) && HAVE_FORK==1
+            if(job_pool != NULL)
+            {
+                srunner_queue_test(sr, s, tc, tfun, i);
+                continue;
+            }
+#endif /* HAVE_FORK */
+            if(srunner_skips_test(sr, tc, tfun))
+            {
+                srunner_report_result(sr, tfun, skip_result(sr, tc, tfun, i));
+                continue;
+            }
+            srunner_log_test_start(sr, tc, tfun);
             switch (srunner_fork_status(sr))
             {
                 case CK_FORK:
+                case CK_FORK_BATCH:
 #if defined(HAVE_FORK) && HAVE_FORK==1
                     tr = tcase_run_tfun_fork(sr, tc, tfun, i);
 #else /* HAVE_FORK */
@@ -237,102 +735,465 @@ static void srunner_iterate_tcase_tfuns(SRunner * sr, TCase * tc)
 
             if(NULL != tr)
             {
-                srunner_add_failure(sr, tr);
-                log_test_end(sr, tr);
+                tfun_set_result(tfun, tr);
+                srunner_report_result(sr, tfun, tr);
             }
         }
     }
+
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    if(job_pool != NULL)
+    {
+        jobs_dispatch(sr);
+    }
+#endif /* HAVE_FORK */
 }
 
-static void srunner_add_failure(SRunner * sr, TestResult * tr)
+static void srunner_log_suite(SRunner * sr, Suite * s, int end)
 {
-    check_list_add_end(sr->resultlst, tr);
-    sr->stats->n_checked++;     /* count checks during setup, test, and teardown */
-    if(tr->rtype == CK_FAILURE)
-        sr->stats->n_failed++;
-    else if(tr->rtype == CK_ERROR)
-        sr->stats->n_errors++;
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    /* Keep the order with tests which are still running */
+    if(job_pool != NULL && job_pool->head != NULL)
+    {
+        Pending *p = pending_create(end ? CK_PENDING_SUITE_END
+                                    : CK_PENDING_SUITE_START);
+
+        p->s = s;
+        jobs_queue(p);
+        return;
+    }
+#endif /* HAVE_FORK */
 
+    if(end)
+        log_suite_end(sr, s);
+    else
+        log_suite_start(sr, s);
 }
 
-static TestResult * srunner_run_setup(List * fixture_list, enum fork_status fork_usage,
-    const char * test_name, const char * setup_name)
+/*
+ * Wait for all running tests. Unchecked fixtures run in this process,
+ * and may be shared with the tests in ways that the forked tests do
+ * not isolate, e.g. a server or files.
+ */
+static void srunner_wait_all(SRunner * sr CK_ATTRIBUTE_UNUSED)
 {
-    TestResult *tr = NULL;
-    Fixture *setup_fixture;
-
-    if(fork_usage == CK_FORK)
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    if(job_pool != NULL)
     {
-        send_ctx_info(CK_CTX_SETUP);
+        srunner_wait_jobs(sr, 1);
     }
+#endif /* HAVE_FORK */
+}
 
-    for(check_list_front(fixture_list); !check_list_at_end(fixture_list);
-        check_list_advance(fixture_list))
+/*
+ * Tests have to see what unchecked fixtures did in the suite runner,
+ * so the fork server is restarted after they ran.
+ */
+static void srunner_fork_server_reset(void)
+{
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    if(zygote != NULL)
     {
-        setup_fixture = (Fixture *)check_list_val(fixture_list);
-
-        if(fork_usage == CK_NOFORK)
-        {
-            send_ctx_info(CK_CTX_SETUP);
-
-            if(0 == setjmp(error_jmp_buffer))
-            {
-                setup_fixture->fun();
-            }
-
-            /* Stop the setup and return the failure in nofork mode. */
-            tr = receive_result_info_nofork(test_name, setup_name, 0, -1);
-            if(tr->rtype != CK_PASS)
-            {
-                break;
-            }
-
-            free(tr->file);
-            free(tr->msg);
-            free(tr);
-            tr = NULL;
-        }
-        else
-        {
-            setup_fixture->fun();
-        }
+        zygote_reset(zygote);
     }
-
-    return tr;
+#endif /* HAVE_FORK */
 }
 
-static int srunner_run_unchecked_setup(SRunner * sr, TCase * tc)
+/*
+ * Tests of a test case with a fixture snapshot are forked from a fork
+ * server which ran their checked setup, see tcase_set_fixture_snapshot().
+ */
+static void srunner_snapshot_start(SRunner * sr CK_ATTRIBUTE_UNUSED,
+                                   TCase * tc CK_ATTRIBUTE_UNUSED)
 {
-    TestResult *tr = NULL;
-    int rval = 1;
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    TestResult *tr;
 
-    set_fork_status(CK_NOFORK);
-    tr = srunner_run_setup(tc->unch_sflst, CK_NOFORK, tc->name, "unchecked_setup");
-    set_fork_status(srunner_fork_status(sr));
+    if(zygote == NULL || !tc->snapshot || fixture_list_empty(tc->ch_sflst))
+    {
+        return;
+    }
 
-    if(tr != NULL && tr->rtype != CK_PASS)
+    /* The fork server holds the state of one test case at a time */
+    srunner_wait_all(sr);
+    zygote_reset(zygote);
+    if(zygote_start(zygote, tc))
     {
-        srunner_add_failure(sr, tr);
-        rval = 0;
+        snapshot_tc = tc;
     }
 
-    return rval;
+    /* The messages of the setup, every test sends its own */
+    tr = receive_test_result(0);
+    free(tr->file);
+    free(tr->msg);
+    free(tr);
+#endif /* HAVE_FORK */
 }
 
-static TestResult *tcase_run_checked_setup(SRunner * sr, TCase * tc)
+static void srunner_snapshot_end(SRunner * sr CK_ATTRIBUTE_UNUSED)
 {
-    TestResult *tr = srunner_run_setup(tc->ch_sflst, srunner_fork_status(sr),
-        tc->name, "checked_setup");
-
-    return tr;
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    if(snapshot_tc != NULL)
+    {
+        srunner_wait_all(sr);
+        zygote_reset(zygote);
+        snapshot_tc = NULL;
+    }
+#endif /* HAVE_FORK */
 }
 
-static void srunner_run_teardown(List * fixture_list, enum fork_status fork_usage)
+static int fixture_list_empty(List * fixture_list)
 {
-    Fixture * fixture;
+    check_list_front(fixture_list);
+    return check_list_at_end(fixture_list);
+}
 
-    for(check_list_front(fixture_list); !check_list_at_end(fixture_list);
-        check_list_advance(fixture_list))
+/* Whether the results of this run are streamed, see srunner_run */
+static int stream_results;
+
+/* Whether the resource usage of the tests is kept, see srunner_run */
+static int keep_rusage;
+
+static void srunner_add_failure(SRunner * sr, TestResult * tr)
+{
+    /* Streamed passes are freed once they are logged */
+    if(!stream_results)
+    {
+        check_list_add_end(sr->resultlst, tr);
+    }
+    else if(tr->rtype != CK_PASS)
+    {
+        tr->file = srunner_intern(sr, tr->file);
+        tr->file_interned = 1;
+        check_list_add_end(sr->resultlst, tr);
+    }
+    sr->stats->n_checked++;     /* count checks during setup, test, and teardown */
+    if(tr->rtype == CK_FAILURE)
+        sr->stats->n_failed++;
+    else if(tr->rtype == CK_ERROR)
+        sr->stats->n_errors++;
+
+    if(!sr->stopped && srunner_max_failures(sr) > 0
+       && sr->stats->n_failed + sr->stats->n_errors
+       >= srunner_max_failures(sr))
+    {
+        srunner_stop(sr);
+    }
+}
+
+/*
+ * The strings of the kept results which are the same are only kept
+ * once. Takes the string, and returns the one to keep.
+ */
+static char *srunner_intern(SRunner * sr, char *str)
+{
+    size_t i;
+
+    if(str == NULL)
+    {
+        return NULL;
+    }
+    if(2 * (sr->nstrings + 1) > sr->strings_size)
+    {
+        srunner_grow_strings(sr);
+    }
+    for(i = hash_string(str) & (sr->strings_size - 1);
+        sr->strings[i] != NULL; i = (i + 1) & (sr->strings_size - 1))
+    {
+        if(strcmp(sr->strings[i], str) == 0)
+        {
+            free(str);
+            return sr->strings[i];
+        }
+    }
+    sr->strings[i] = str;
+    sr->nstrings++;
+    return str;
+}
+
+static void srunner_grow_strings(SRunner * sr)
+{
+    char **old = sr->strings;
+    size_t old_size = sr->strings_size;
+    size_t i;
+
+    sr->strings_size = old_size == 0 ? 16 : 2 * old_size;
+    sr->strings = (char **)emalloc(sr->strings_size * sizeof(char *));
+    memset(sr->strings, 0, sr->strings_size * sizeof(char *));
+    for(i = 0; i < old_size; i++)
+    {
+        if(old[i] != NULL)
+        {
+            size_t k;
+
+            for(k = hash_string(old[i]) & (sr->strings_size - 1);
+                sr->strings[k] != NULL; k = (k + 1) & (sr->strings_size - 1))
+            {
+            }
+            sr->strings[k] = old[i];
+        }
+    }
+    free(old);
+}
+
+/* FNV-1a of a string */
+static size_t hash_string(const char *str)
+{
+    const unsigned char *p = (const unsigned char *)str;
+    size_t hash = 2166136261U;
+
+    for(; *p != '\0'; p++)
+    {
+        hash ^= *p;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+/*
+ * No more tests are started, and the running ones are killed. Their
+ * results and those of the tests which were not run yet are logged as
+ * skipped.
+ */
+static void srunner_stop(SRunner * sr)
+{
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    int slot;
+#endif /* HAVE_FORK */
+
+    sr->stopped = 1;
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    if(job_pool == NULL)
+    {
+        return;
+    }
+
+    for(slot = 0; slot < job_pool->njobs; slot++)
+    {
+        if(job_pool->jobs[slot] != NULL)
+        {
+            job_pool->jobs[slot]->cancelled = 1;
+        }
+    }
+    /* Test case processes kill their running test, see sig_handler() */
+    supervisor_kill_all(supervisor, fork_tcase ? SIGTERM : SIGKILL);
+#endif /* HAVE_FORK */
+}
+
+/* Whether a test is skipped instead of run, see skip_result() */
+static int srunner_skips_test(SRunner * sr, TCase * tc, TF * tfun)
+{
+    return sr->stopped || (tc->loop_fail_fast && tfun->failed);
+}
+
+/* The result of a test which is not run, it has no result type */
+static TestResult *skip_result(SRunner * sr, TCase * tc, TF * tfun, int i)
+{
+    TestResult *tr = tr_create();
+
+    tr->tcname = tc->name;
+    tr->tname = tfun->name;
+    tr->iter = i;
+    tr->ctx = CK_CTX_TEST;
+    tr->line = 0;
+    if(sr->stopped)
+    {
+        tr->msg = ck_strdup_printf("Not run after %d failures",
+                                   srunner_max_failures(sr));
+    }
+    else
+    {
+        tr->msg = strdup("Not run after a failed iteration");
+    }
+    return tr;
+}
+
+/*
+ * Remember a failed iteration (see tcase_set_loop_fail_fast()) and the
+ * durations of the iterations (see chunk_size()).
+ */
+static void tfun_set_result(TF * tfun, TestResult * tr)
+{
+    if(tr->rtype == CK_FAILURE || tr->rtype == CK_ERROR)
+    {
+        tfun->failed = 1;
+    }
+    if(tr->duration >= 0)
+    {
+        tfun->nmeasured++;
+        tfun->measured_usec += tr->duration;
+    }
+}
+
+/* Run a test, or time a benchmark */
+static void tfun_call(TF * tfun, int i)
+{
+    if(tfun->bench)
+    {
+        bench_run(tfun->fn, i);
+    }
+    else if(tfun->sizes != NULL)
+    {
+        complexity_run(tfun->fn, tfun->sizes, tfun->nsizes,
+                       tfun->complexity);
+    }
+    else
+    {
+        alloc_begin();
+        perf_begin();
+        tfun->fn(i);
+        perf_end();
+        alloc_end();
+    }
+}
+
+/* In a test case process the suite runner logs it with the result */
+static void srunner_log_test_start(SRunner * sr, TCase * tc, TF * tfun)
+{
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    if(report_slot != -1)
+    {
+        return;
+    }
+#endif /* HAVE_FORK */
+    log_test_start(sr, tc, tfun);
+}
+
+/*
+ * Add the result of a test and log its end, or the result of a fixture
+ * if tfun is NULL, which is only added.
+ */
+static void srunner_report_result(SRunner * sr, TF * tfun, TestResult * tr)
+{
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    if(report_slot != -1)
+    {
+        tcase_send_report(tfun, tr);
+        tr_free(tr);
+        return;
+    }
+#endif /* HAVE_FORK */
+    if(tr->rtype == CK_TEST_RESULT_INVALID)
+    {
+        sr->stats->n_skipped++;
+        log_test_skip(sr, tr);
+        tr_free(tr);
+        return;
+    }
+    if(tr->bench != NULL && sr->baseline != NULL && tr->rtype == CK_PASS)
+    {
+        srunner_compare_bench(sr, tfun, tr);
+    }
+    srunner_add_failure(sr, tr);
+    if(tfun != NULL)
+    {
+        log_test_end(sr, tr);
+    }
+    if(stream_results && tr->rtype == CK_PASS)
+    {
+        tr_free(tr);
+    }
+}
+
+/* A benchmark which is slower than its baseline fails */
+static void srunner_compare_bench(SRunner * sr, TF * tfun, TestResult * tr)
+{
+    char *msg = baseline_compare(sr->baseline, tr->tcname, tr->tname,
+                                 tr->iter, tr->bench,
+                                 srunner_bench_ratio(sr),
+                                 srunner_bench_alpha(sr));
+
+    if(msg == NULL)
+    {
+        return;
+    }
+    tr->rtype = CK_FAILURE;
+    free(tr->msg);
+    tr->msg = msg;
+    if(tfun != NULL)
+    {
+        tfun->failed = 1;
+    }
+}
+
+static TestResult * srunner_run_setup(List * fixture_list, enum fork_status fork_usage,
+    const char * test_name, const char * setup_name)
+{
+    TestResult *tr = NULL;
+    Fixture *setup_fixture;
+
+    if(fork_usage != CK_NOFORK)
+    {
+        send_ctx_info(CK_CTX_SETUP);
+    }
+
+    for(check_list_front(fixture_list); !check_list_at_end(fixture_list);
+        check_list_advance(fixture_list))
+    {
+        setup_fixture = (Fixture *)check_list_val(fixture_list);
+
+        if(fork_usage == CK_NOFORK)
+        {
+            send_ctx_info(CK_CTX_SETUP);
+
+            if(0 == setjmp(error_jmp_buffer))
+            {
+                setup_fixture->fun();
+            }
+
+            /* Stop the setup and return the failure in nofork mode. */
+            tr = receive_result_info_nofork(test_name, setup_name, 0, -1);
+            if(tr->rtype != CK_PASS)
+            {
+                break;
+            }
+
+            free(tr->file);
+            free(tr->msg);
+            free(tr);
+            tr = NULL;
+        }
+        else
+        {
+            setup_fixture->fun();
+        }
+    }
+
+    return tr;
+}
+
+static int srunner_run_unchecked_setup(SRunner * sr, TCase * tc)
+{
+    TestResult *tr = NULL;
+    int rval = 1;
+
+    set_fork_status(CK_NOFORK);
+    tr = srunner_run_setup(tc->unch_sflst, CK_NOFORK, tc->name, "unchecked_setup");
+    set_fork_status(srunner_fork_status(sr));
+
+    if(tr != NULL && tr->rtype != CK_PASS)
+    {
+        srunner_report_result(sr, NULL, tr);
+        rval = 0;
+    }
+
+    return rval;
+}
+
+static TestResult *tcase_run_checked_setup(SRunner * sr, TCase * tc)
+{
+    TestResult *tr = srunner_run_setup(tc->ch_sflst, srunner_fork_status(sr),
+        tc->name, "checked_setup");
+
+    return tr;
+}
+
+static void srunner_run_teardown(List * fixture_list, enum fork_status fork_usage)
+{
+    Fixture * fixture;
+
+    for(check_list_front(fixture_list); !check_list_at_end(fixture_list);
+        check_list_advance(fixture_list))
     {
         fixture = (Fixture *)check_list_val(fixture_list);
         send_ctx_info(CK_CTX_TEARDOWN);
@@ -366,12 +1227,43 @@ static void tcase_run_checked_teardown(TCase * tc)
     srunner_run_teardown(tc->ch_tflst, CK_NOFORK);
 }
 
-static void srunner_run_tcase(SRunner * sr, TCase * tc)
+static void srunner_run_tcase(SRunner * sr, Suite * s, TCase * tc)
 {
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    if(fork_tcase)
+    {
+        srunner_queue_tcase(sr, s, tc);
+        return;
+    }
+#endif /* HAVE_FORK */
+
+    if(!fixture_list_empty(tc->unch_sflst))
+    {
+        srunner_wait_all(sr);
+    }
+
+    /* Neither the fixtures nor the tests run, the tests are logged */
+    if(sr->stopped)
+    {
+        srunner_iterate_tcase_tfuns(sr, s, tc);
+        return;
+    }
+
     if(srunner_run_unchecked_setup(sr, tc))
     {
-        srunner_iterate_tcase_tfuns(sr, tc);
-        srunner_run_unchecked_teardown(sr, tc);
+        if(!fixture_list_empty(tc->unch_sflst))
+        {
+            srunner_fork_server_reset();
+        }
+        srunner_snapshot_start(sr, tc);
+        srunner_iterate_tcase_tfuns(sr, s, tc);
+        srunner_snapshot_end(sr);
+        if(!fixture_list_empty(tc->unch_tflst))
+        {
+            srunner_wait_all(sr);
+            srunner_run_unchecked_teardown(sr, tc);
+            srunner_fork_server_reset();
+        }
     }
 }
 
@@ -387,7 +1279,7 @@ static TestResult *tcase_run_tfun_nofork(SRunner * sr, TCase * tc, TF * tfun,
         clock_gettime(check_get_clockid(), &ts_start);
         if(0 == setjmp(error_jmp_buffer))
         {
-            tfun->fn(i);
+            tfun_call(tfun, i);
         }
         clock_gettime(check_get_clockid(), &ts_end);
         tcase_run_checked_teardown(tc);
@@ -443,78 +1335,1464 @@ static char *pass_msg(void)
 static TestResult *tcase_run_tfun_fork(SRunner * sr, TCase * tc, TF * tfun,
                                        int i)
 {
-    pid_t pid_w;
-    pid_t pid;
     int status = 0;
+    int timed_out = 0;
+    TestRusage rusage;
+    TestResult *tr;
+
+    srunner_fork_test(sr, tc, tfun, i, 0);
+    srunner_wait_test(&status, &timed_out, &rusage);
+
+    tr = receive_result_info_fork(tc, tfun->name, i, status,
+                                  timed_out, tfun->signal,
+                                  tfun->allowed_exit_value);
+    if(keep_rusage)
+        tr->rusage = rusage;
+    return tr;
+}
+
+/* Run in the forked process, never returns */
+static void tcase_run_tfun_child(SRunner * sr, TCase * tc, TF * tfun, int i)
+{
+    setpgid(0, 0);
+    tcase_run_tfun_body(sr, tc, tfun, i);
+    exit(EXIT_SUCCESS);
+}
+
+/* Run a test with its checked fixtures in a forked process */
+static void tcase_run_tfun_body(SRunner * sr, TCase * tc, TF * tfun, int i)
+{
     struct timespec ts_start = { 0, 0 }, ts_end ={ 0, 0 };
 
-    timer_t timerid;
-    struct itimerspec timer_spec;
-    TestResult *tr;
+    tcase_set_limits(tc);
+    if(!snapshot_taken)
+    {
+        free(tcase_run_checked_setup(sr, tc));
+    }
+    clock_gettime(check_get_clockid(), &ts_start);
+    tfun_call(tfun, i);
+    clock_gettime(check_get_clockid(), &ts_end);
+    tcase_run_checked_teardown(tc);
+    send_duration_info(DIFF_IN_USEC(ts_start, ts_end));
+}
+
+/*
+ * Apply the resource limits of a test case to this process. The CPU
+ * time counts from now, for processes which run several tests.
+ */
+static void tcase_set_limits(TCase * tc)
+{
+#if CK_LIMITS
+    if(tc->memory_limit >= 0 && tc->memory_limit != memory_limit)
+    {
+        struct sigaction action;
+
+        set_limit(CK_RLIMIT_MEMORY, (rlim_t)tc->memory_limit * 1024 * 1024);
+        memory_limit = tc->memory_limit;
+
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = memory_limit_handler;
+        action.sa_flags = SA_RESETHAND;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, NULL);
+        sigaction(SIGBUS, &action, NULL);
+        sigaction(SIGABRT, &action, NULL);
+    }
+    if(tc->memory_limit >= 0)
+    {
+        char msg[MSG_LEN];
+
+        /* The handler has no memory to spare for the message */
+        snprintf(msg, MSG_LEN,
+                 "Resource limit exceeded: memory limit of %ld MB",
+                 memory_limit);
+        prepare_failure_info(msg);
+    }
+    if(tc->cpu_limit >= 0)
+    {
+        struct rusage ru;
+        long used_usec;
+
+        getrusage(RUSAGE_SELF, &ru);
+        used_usec = (long)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)
+            * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+        set_limit(RLIMIT_CPU, (rlim_t)((used_usec + 999999) / 1000000
+                                       + tc->cpu_limit));
+    }
+    if(tc->core_limit >= 0)
+    {
+        set_limit(RLIMIT_CORE, (rlim_t)tc->core_limit * 1024 * 1024);
+    }
+#else
+    (void)tc;
+#endif /* CK_LIMITS */
+}
+
+#if CK_LIMITS
+/* Set the soft limit, which may not be raised above the hard limit */
+static void set_limit(int resource, rlim_t value)
+{
+    struct rlimit rl;
+
+    if(getrlimit(resource, &rl) != 0)
+        eprintf("Error in call to getrlimit:", __FILE__, __LINE__ - 1);
+    if(rl.rlim_max != RLIM_INFINITY && value > rl.rlim_max)
+    {
+        value = rl.rlim_max;
+    }
+    rl.rlim_cur = value;
+    if(setrlimit(resource, &rl) != 0)
+        eprintf("Error in call to setrlimit:", __FILE__, __LINE__ - 1);
+}
+
+/*
+ * A test which crashes or aborts when its memory limit leaves no room
+ * ran out of memory. It gets the reason prepared by tcase_set_limits(),
+ * and the signal, reset to its default action, ends it as usual. The
+ * heap and the locks of the test may be broken here: the room is asked
+ * from the kernel with mmap(), and the reason is sent with write(2).
+ */
+static void memory_limit_handler(int sig)
+{
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+    /* A test within a sixteenth of its limit was out of memory */
+    size_t room = (size_t)memory_limit * 1024 * 1024 / 16;
+    void *probe = mmap(NULL, room, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(probe == MAP_FAILED)
+    {
+        send_prepared_failure();
+    }
+    else
+    {
+        munmap(probe, room);
+    }
+#endif /* HAVE_MMAP && MAP_ANONYMOUS */
+    raise(sig);
+}
+#endif /* CK_LIMITS */
+
+/* Run in the fork server of a test case with a fixture snapshot */
+static void tcase_run_snapshot_setup(SRunner * sr, TCase * tc)
+{
+    free(tcase_run_checked_setup(sr, tc));
+    snapshot_taken = 1;
+}
+
+/* Start a test in the given slot, see srunner_wait_test() */
+static void srunner_fork_test(SRunner * sr, TCase * tc, TF * tfun, int i,
+                              int slot)
+{
+    sigset_t term_mask;
+    sigset_t old_mask;
+    pid_t pid;
+
+    if(zygote != NULL && (use_fork_server || tc == snapshot_tc))
+    {
+        zygote_submit(zygote, slot, tc, tfun, i);
+        return;
+    }
+
+    /*
+     * A test case process killed by srunner_stop() kills the tests it
+     * knows of, see sig_handler(), so the SIGTERM must wait until the
+     * new test is added to the supervisor.
+     */
+    sigemptyset(&term_mask);
+    sigaddset(&term_mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &term_mask, &old_mask);
+    select_msg_slot(slot);
+    pid = fork();
+    if(pid == -1)
+        eprintf("Error in call to fork:", __FILE__, __LINE__ - 2);
+    if(pid == 0)
+    {
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+        fork_child_init();
+        tcase_run_tfun_child(sr, tc, tfun, i);
+    }
+    select_msg_slot(0);
+
+    supervisor_add(supervisor, slot, pid, &tc->timeout);
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+}
+
+/*
+ * Wait until a test has ended, returns its slot. The resources it used
+ * are only known for a process of its own.
+ */
+static int srunner_wait_test(int *status, int *timed_out,
+                             TestRusage * rusage)
+{
+    int slot = supervisor_wait(supervisor, status, timed_out);
+
+    /* Otherwise it is the socket of srunner_receive_reports() */
+    if(slot == SUPERVISOR_READABLE && zygote != NULL
+       && zygote_running(zygote))
+    {
+        zygote_receive(zygote, &slot, status, timed_out);
+        zygote_rusage(zygote, rusage);
+    }
+    else if(slot >= 0)
+    {
+        supervisor_rusage(supervisor, slot, rusage);
+    }
+    return slot;
+}
+
+static void srunner_jobs_start(SRunner * sr CK_ATTRIBUTE_UNUSED, int njobs)
+{
+    int i;
+
+    job_pool = (JobPool *)emalloc(sizeof(JobPool));
+    job_pool->jobs = (Pending **)emalloc(njobs * sizeof(Pending *));
+    job_pool->njobs = njobs;
+    job_pool->running = 0;
+    job_pool->head = NULL;
+    job_pool->tail = NULL;
+    job_pool->waiting = NULL;
+    job_pool->nwaiting = 0;
+    job_pool->max_waiting = 0;
+    for(i = 0; i < njobs; i++)
+    {
+        job_pool->jobs[i] = NULL;
+    }
+
+    set_msg_slots(njobs);
+}
+
+static void srunner_jobs_end(SRunner * sr)
+{
+    srunner_wait_jobs(sr, 1);
+
+    free(job_pool->jobs);
+    free(job_pool);
+    job_pool = NULL;
+}
+
+static void srunner_queue_test(SRunner * sr, Suite * s, TCase * tc,
+                               TF * tfun, int i)
+{
+    Pending *p = pending_create(CK_PENDING_TEST);
+
+    p->s = s;
+    p->tc = tc;
+    p->tfun = tfun;
+    p->iter = i;
+    jobs_queue(p);
+    jobs_submit(sr, p);
+}
+
+static Pending *pending_create(enum pending_type type)
+{
+    Pending *p = (Pending *)emalloc(sizeof(Pending));
+
+    p->type = type;
+    p->s = NULL;
+    p->tc = NULL;
+    p->tfun = NULL;
+    p->iter = 0;
+    p->iter_end = 0;
+    p->estimate = -1;
+    p->order = 0;
+    p->tr = NULL;
+    p->reports = NULL;
+    p->reports_tail = NULL;
+    p->nreported = 0;
+    p->done = 0;
+    p->cancelled = 0;
+    p->next = NULL;
+    return p;
+}
+
+/* Wait until a job slot is free, and return it */
+static int jobs_free_slot(SRunner * sr)
+{
+    int slot;
+
+    while(job_pool->running == job_pool->njobs)
+    {
+        srunner_wait_jobs(sr, 0);
+    }
+
+    for(slot = 0; job_pool->jobs[slot] != NULL; slot++)
+    {
+        /* Find a free slot */
+    }
+    return slot;
+}
+
+/*
+ * Start a queued test or test case. With a duration history it waits
+ * for jobs_dispatch() instead, which starts the longest ones first, so
+ * that a long one does not run on alone at the end.
+ */
+static void jobs_submit(SRunner * sr, Pending * p)
+{
+    if(sr->history == NULL)
+    {
+        jobs_start(sr, p);
+        return;
+    }
+
+    if(job_pool->nwaiting == job_pool->max_waiting)
+    {
+        job_pool->max_waiting = 2 * job_pool->max_waiting + 16;
+        job_pool->waiting = (Pending **)erealloc(job_pool->waiting,
+                                                 job_pool->max_waiting *
+                                                 sizeof(Pending *));
+    }
+    job_pool->waiting[job_pool->nwaiting++] = p;
+}
+
+static void jobs_start(SRunner * sr, Pending * p)
+{
+    int slot;
+
+    if(jobs_skip(sr, p))
+    {
+        return;
+    }
+    slot = jobs_free_slot(sr);
+    /* The run may have stopped while waiting for the slot */
+    if(jobs_skip(sr, p))
+    {
+        return;
+    }
+
+    job_pool->jobs[slot] = p;
+    job_pool->running++;
+    if(p->type == CK_PENDING_TCASE)
+    {
+        srunner_fork_tcase_process(sr, p->s, p->tc, slot);
+    }
+    else if(p->type == CK_PENDING_CHUNK)
+    {
+        srunner_fork_chunk(sr, p, slot);
+    }
+    else
+    {
+        srunner_fork_test(sr, p->tc, p->tfun, p->iter, slot);
+    }
+}
+
+/* Log a test or test case which is not started as skipped */
+static int jobs_skip(SRunner * sr, Pending * p)
+{
+    if(p->type == CK_PENDING_TCASE)
+    {
+        if(!sr->stopped)
+        {
+            return 0;
+        }
+        pending_skip_tests(sr, p, 0);
+        p->done = 1;
+        return 1;
+    }
+
+    if(p->type == CK_PENDING_CHUNK)
+    {
+        if(!srunner_skips_test(sr, p->tc, p->tfun))
+        {
+            return 0;
+        }
+        chunk_skip_rest(sr, p);
+        return 1;
+    }
+
+    if(!srunner_skips_test(sr, p->tc, p->tfun))
+    {
+        return 0;
+    }
+    p->tr = skip_result(sr, p->tc, p->tfun, p->iter);
+    return 1;
+}
+
+static void jobs_dispatch(SRunner * sr)
+{
+    Pending **waiting = job_pool->waiting;
+    int nwaiting = job_pool->nwaiting;
+    int i;
+
+    job_pool->waiting = NULL;
+    job_pool->nwaiting = 0;
+    job_pool->max_waiting = 0;
+
+    for(i = 0; i < nwaiting; i++)
+    {
+        waiting[i]->estimate = pending_estimate(sr, waiting[i]);
+        waiting[i]->order = i;
+    }
+    if(nwaiting > 1)
+    {
+        qsort(waiting, nwaiting, sizeof(Pending *), pending_cmp);
+    }
+
+    for(i = 0; i < nwaiting; i++)
+    {
+        jobs_start(sr, waiting[i]);
+    }
+    free(waiting);
+}
+
+/* The median duration of a test or test case in us, or -1 if unknown */
+static int pending_estimate(SRunner * sr, Pending * p)
+{
+    List *tfl = p->tc->tflst;
+    int estimate = 0;
+
+    if(p->type == CK_PENDING_TEST)
+    {
+        return history_median(sr->history, p->s->name, p->tc->name,
+                              p->tfun->name, p->iter);
+    }
+
+    if(p->type == CK_PENDING_CHUNK)
+    {
+        int i;
+
+        for(i = p->iter; i < p->iter_end; i++)
+        {
+            int median;
+
+            if(!srunner_selects(sr, p->s, p->tc, p->tfun, i))
+            {
+                continue;
+            }
+            median = history_median(sr->history, p->s->name, p->tc->name,
+                                    p->tfun->name, i);
+            if(median < 0)
+            {
+                return -1;
+            }
+            estimate += median;
+        }
+        return estimate;
+    }
+
+    for(check_list_front(tfl); !check_list_at_end(tfl);
+        check_list_advance(tfl))
+    {
+        TF *tfun = (TF *)check_list_val(tfl);
+        int i;
+
+        for(i = tfun->loop_start; i < tfun->loop_end; i++)
+        {
+            int median;
+
+            if(!srunner_selects(sr, p->s, p->tc, tfun, i))
+            {
+                continue;
+            }
+            median = history_median(sr->history, p->s->name, p->tc->name,
+                                    tfun->name, i);
+            if(median < 0)
+            {
+                return -1;
+            }
+            estimate += median;
+        }
+    }
+    return estimate;
+}
+
+/* Unknown durations first, as they may be long, then the longest */
+static int pending_cmp(const void *a, const void *b)
+{
+    const Pending *pa = *(Pending * const *)a;
+    const Pending *pb = *(Pending * const *)b;
+
+    if(pa->estimate != pb->estimate)
+    {
+        if(pa->estimate < 0)
+            return -1;
+        if(pb->estimate < 0)
+            return 1;
+        return pa->estimate > pb->estimate ? -1 : 1;
+    }
+    return pa->order - pb->order;
+}
+
+static void jobs_queue(Pending * p)
+{
+    p->next = NULL;
+    if(job_pool->tail != NULL)
+    {
+        job_pool->tail->next = p;
+    }
+    else
+    {
+        job_pool->head = p;
+    }
+    job_pool->tail = p;
+}
+
+/*
+ * Wait until a running test has finished, or all of them if 'all' is
+ * set, and log the results which are ready.
+ */
+static void srunner_wait_jobs(SRunner * sr, int all)
+{
+    if(all)
+    {
+        jobs_dispatch(sr);
+    }
+
+    while(job_pool->running > 0)
+    {
+        int status = 0;
+        int timed_out = 0;
+        TestRusage rusage;
+        int slot = srunner_wait_test(&status, &timed_out, &rusage);
+
+        if(slot == SUPERVISOR_READABLE)
+        {
+            /* Reports of test cases, the first may be logged already */
+            srunner_receive_reports(sr);
+            srunner_emit_pending(sr);
+            continue;
+        }
+        srunner_collect_job(sr, slot, status, timed_out, &rusage);
+        /* A failure may stop the run, which kills the other jobs */
+        srunner_emit_pending(sr);
+        if(!all)
+        {
+            break;
+        }
+    }
+
+    srunner_emit_pending(sr);
+}
+
+static void srunner_collect_job(SRunner * sr, int slot,
+                                int status, int timed_out,
+                                const TestRusage * rusage)
+{
+    Pending *p = job_pool->jobs[slot];
+
+    if(p->type == CK_PENDING_TCASE)
+    {
+        srunner_collect_tcase(sr, p, slot, status, timed_out);
+    }
+    else if(p->type == CK_PENDING_CHUNK)
+    {
+        srunner_collect_chunk(sr, p, slot, status, timed_out);
+        if(!p->done)
+        {
+            /* A new process runs the rest of the chunk in the slot */
+            return;
+        }
+    }
+    else if(p->cancelled && WIFSIGNALED(status)
+            && WTERMSIG(status) == SIGKILL)
+    {
+        /* It may not even have sent its context, nothing runs after it */
+        p->tr = skip_result(sr, p->tc, p->tfun, p->iter);
+    }
+    else
+    {
+        select_msg_slot(slot);
+        p->tr = receive_result_info_fork(p->tc, p->tfun->name,
+                                         p->iter, status, timed_out,
+                                         p->tfun->signal,
+                                         p->tfun->allowed_exit_value);
+        select_msg_slot(0);
+        if(keep_rusage)
+            p->tr->rusage = *rusage;
+        tfun_set_result(p->tfun, p->tr);
+    }
+
+    job_pool->jobs[slot] = NULL;
+    job_pool->running--;
+}
+
+/* Log everything up to the first test which is still running */
+static void srunner_emit_pending(SRunner * sr)
+{
+    while(job_pool->head != NULL)
+    {
+        Pending *p = job_pool->head;
+
+        if(p->type == CK_PENDING_TEST)
+        {
+            if(p->tr == NULL)
+            {
+                break;
+            }
+            if(p->tr->rtype != CK_TEST_RESULT_INVALID)
+            {
+                log_test_start(sr, p->tc, p->tfun);
+            }
+            srunner_report_result(sr, p->tfun, p->tr);
+        }
+        else if(p->type == CK_PENDING_TCASE || p->type == CK_PENDING_CHUNK)
+        {
+            while(p->reports != NULL)
+            {
+                Report *r = p->reports;
+
+                if(r->tfun != NULL && r->tr->rtype != CK_TEST_RESULT_INVALID)
+                {
+                    log_test_start(sr, p->tc, r->tfun);
+                }
+                srunner_report_result(sr, r->tfun, r->tr);
+                p->reports = r->next;
+                free(r);
+            }
+            if(!p->done)
+            {
+                break;
+            }
+        }
+        else if(p->type == CK_PENDING_SUITE_START)
+        {
+            log_suite_start(sr, p->s);
+        }
+        else
+        {
+            log_suite_end(sr, p->s);
+        }
+
+        job_pool->head = p->next;
+        free(p);
+    }
+
+    if(job_pool->head == NULL)
+    {
+        job_pool->tail = NULL;
+    }
+}
+
+static void srunner_tcase_init(SRunner * sr, int njobs)
+{
+    supervisor = supervisor_create(njobs);
+    srunner_jobs_start(sr, njobs);
+
+    report_socket_open();
+    supervisor_watch(supervisor, report_fds[0]);
+    fork_tcase = 1;
+}
+
+static void srunner_queue_tcase(SRunner * sr, Suite * s, TCase * tc)
+{
+    Pending *p = pending_create(CK_PENDING_TCASE);
+
+    p->s = s;
+    p->tc = tc;
+    jobs_queue(p);
+    jobs_submit(sr, p);
+}
+
+static void srunner_fork_tcase_process(SRunner * sr, Suite * s, TCase * tc,
+                                       int slot)
+{
+    struct timespec no_timeout = { 0, 0 };
+    sigset_t term_mask;
+    sigset_t old_mask;
+    pid_t pid;
+
+    /*
+     * A SIGTERM from srunner_stop() must not reach the process before
+     * it knows that it runs a test case, see sig_handler().
+     */
+    sigemptyset(&term_mask);
+    sigaddset(&term_mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &term_mask, &old_mask);
+    pid = fork();
+    if(pid == -1)
+        eprintf("Error in call to fork:", __FILE__, __LINE__ - 2);
+    if(pid == 0)
+    {
+        report_slot = slot;
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+        fork_child_init();
+        tcase_run_child(sr, s, tc);
+    }
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    /* The tests of the test case have their own timeouts */
+    supervisor_add(supervisor, slot, pid, &no_timeout);
+}
+
+/* Run in the process of a test case, never returns */
+static void tcase_run_child(SRunner * sr, Suite * s, TCase * tc)
+{
+    close(report_fds[0]);
+    report_fds[0] = -1;
+    fork_tcase = 0;
+    keep_msg_slot(report_slot);
+
+    srunner_fork_init(sr, 1);
+    srunner_run_tcase(sr, s, tc);
+    srunner_fork_end(sr);
+    exit(EXIT_SUCCESS);
+}
+
+static void tcase_send_report(TF * tfun, TestResult * tr)
+{
+    char buf[CK_REPORT_MAX];
+    TCaseReport rep;
+    size_t len = sizeof(rep);
+
+    rep.slot = report_slot;
+    rep.tfun = tfun;
+    rep.tname = tr->tname;
+    rep.iter = tr->iter;
+    rep.rtype = tr->rtype;
+    rep.ctx = tr->ctx;
+    rep.line = tr->line;
+    rep.duration = tr->duration;
+    rep.rusage = tr->rusage;
+    rep.perf = tr->perf;
+    rep.alloc = tr->alloc;
+    rep.file_len = report_put_string(buf, &len, tr->file);
+    rep.msg_len = report_put_string(buf, &len, tr->msg);
+    rep.bench_iterations = 0;
+    rep.bench_nsamples = 0;
+    if(tr->bench != NULL)
+    {
+        rep.bench_iterations = tr->bench->iterations;
+        rep.bench_nsamples = tr->bench->nsamples;
+        memcpy(buf + len, tr->bench->samples,
+               rep.bench_nsamples * sizeof(double));
+        len += rep.bench_nsamples * sizeof(double);
+    }
+    memcpy(buf, &rep, sizeof(rep));
+
+    while(send(report_fds[1], buf, len, 0) == -1)
+    {
+        if(errno != EINTR)
+            eprintf("Error in call to send:", __FILE__, __LINE__ - 3);
+    }
+}
+
+/* Append str to a report, returns its length or -1 if it is NULL */
+static int report_put_string(char *buf, size_t * len, const char *str)
+{
+    size_t n;
+
+    if(str == NULL)
+    {
+        return -1;
+    }
+
+    n = strlen(str);
+    if(n > CK_REPORT_STR_MAX)
+    {
+        n = CK_REPORT_STR_MAX;
+    }
+    memcpy(buf + *len, str, n);
+    *len += n;
+    return (int)n;
+}
+
+static char *report_get_string(const char *buf, size_t * pos, size_t len,
+                               int str_len)
+{
+    char *str;
+
+    if(str_len < 0 || *pos + str_len > len)
+    {
+        return NULL;
+    }
+
+    str = (char *)emalloc(str_len + 1);
+    memcpy(str, buf + *pos, str_len);
+    str[str_len] = '\0';
+    *pos += str_len;
+    return str;
+}
+
+/* Take the reports which arrived, and queue them for their test case */
+static void srunner_receive_reports(SRunner * sr CK_ATTRIBUTE_UNUSED)
+{
+    char buf[CK_REPORT_MAX];
+    ssize_t n;
+
+    while((n = recv(report_fds[0], buf, sizeof(buf), 0)) != -1
+          || errno == EINTR)
+    {
+        TCaseReport rep;
+        TestResult *tr;
+        size_t pos = sizeof(rep);
+        Pending *p;
+
+        if(n < (ssize_t)sizeof(rep))
+        {
+            continue;
+        }
+        memcpy(&rep, buf, sizeof(rep));
+        if(rep.slot < 0 || rep.slot >= job_pool->njobs
+           || job_pool->jobs[rep.slot] == NULL)
+        {
+            continue;
+        }
+        p = job_pool->jobs[rep.slot];
+
+        tr = tr_create();
+        tr->tcname = p->tc->name;
+        tr->tname = rep.tname;
+        tr->iter = rep.iter;
+        tr->rtype = rep.rtype;
+        tr->ctx = rep.ctx;
+        tr->line = rep.line;
+        tr->duration = rep.duration;
+        tr->rusage = rep.rusage;
+        tr->perf = rep.perf;
+        tr->alloc = rep.alloc;
+        tr->file = report_get_string(buf, &pos, n, rep.file_len);
+        tr->msg = report_get_string(buf, &pos, n, rep.msg_len);
+        if(rep.bench_nsamples > 0
+           && pos + rep.bench_nsamples * sizeof(double) <= (size_t)n)
+        {
+            double *samples = (double *)emalloc(rep.bench_nsamples *
+                                                sizeof(double));
+
+            memcpy(samples, buf + pos, rep.bench_nsamples * sizeof(double));
+            tr->bench = bench_create(rep.bench_iterations,
+                                     rep.bench_nsamples, samples);
+            free(samples);
+        }
+        if(p->type == CK_PENDING_CHUNK)
+        {
+            /* The next iteration has a timeout of its own */
+            tfun_set_result(p->tfun, tr);
+            p->iter = rep.iter + 1;
+            supervisor_set_timeout(supervisor, rep.slot, &p->tc->timeout);
+        }
+        pending_add_report(p, rep.tfun, tr);
+    }
+}
+
+/*
+ * The process of a test case has ended. Unless it exited normally, the
+ * unchecked fixture which was running gets the result of a forked test.
+ */
+static void srunner_collect_tcase(SRunner * sr, Pending * p, int slot,
+                                  int status, int timed_out)
+{
+    /* It sent everything before it ended */
+    srunner_receive_reports(sr);
+
+    if(p->cancelled && waserror(status, 0))
+    {
+        /* The tests which did not report ran after the killed one */
+        pending_skip_tests(sr, p, p->nreported);
+    }
+    else if(waserror(status, 0))
+    {
+        TestResult *tr;
+
+        select_msg_slot(slot);
+        tr = receive_result_info_fork(p->tc, "unchecked_setup", 0,
+                                      status, timed_out, 0, 0);
+        select_msg_slot(0);
+        if(tr->ctx == CK_CTX_TEARDOWN)
+        {
+            tr->tname = "unchecked_teardown";
+        }
+        pending_add_report(p, NULL, tr);
+    }
+    p->done = 1;
+}
+
+static void pending_add_report(Pending * p, TF * tfun, TestResult * tr)
+{
+    Report *r = (Report *)emalloc(sizeof(Report));
+
+    r->tfun = tfun;
+    r->tr = tr;
+    r->next = NULL;
+    if(tfun != NULL)
+    {
+        p->nreported++;
+    }
+    if(p->reports != NULL)
+    {
+        p->reports_tail->next = r;
+    }
+    else
+    {
+        p->reports = r;
+    }
+    p->reports_tail = r;
+}
+
+/*
+ * Add skipped results for the tests of a test case, from the given
+ * one on in the order in which they run.
+ */
+static void pending_skip_tests(SRunner * sr, Pending * p, int first)
+{
+    List *tfl = p->tc->tflst;
+    int n = 0;
+
+    for(check_list_front(tfl); !check_list_at_end(tfl);
+        check_list_advance(tfl))
+    {
+        TF *tfun = (TF *)check_list_val(tfl);
+        int i;
+
+        for(i = tfun->loop_start; i < tfun->loop_end; i++)
+        {
+            if(srunner_selects(sr, p->s, p->tc, tfun, i) && n++ >= first)
+            {
+                pending_add_report(p, tfun, skip_result(sr, p->tc, tfun,
+                                                        i));
+            }
+        }
+    }
+}
+
+/* Whether the iterations of a loop test run in chunks */
+static int srunner_chunks_tfun(SRunner * sr, TCase * tc, TF * tfun)
+{
+    /* A fork server runs the tests of its test case by itself */
+    return (srunner_loop_chunks(sr) || tfun->batched)
+        && tfun->loop_end - tfun->loop_start > 1
+        && tfun->signal == 0 && tfun->allowed_exit_value == 0
+        && !use_fork_server && tc != snapshot_tc;
+}
+
+static void srunner_queue_chunks(SRunner * sr, Suite * s, TCase * tc,
+                                 TF * tfun)
+{
+    int i = tfun->loop_start;
+
+    for(;;)
+    {
+        Pending *p;
+
+        while(i < tfun->loop_end && !srunner_selects(sr, s, tc, tfun, i))
+        {
+            i++;
+        }
+        if(i == tfun->loop_end)
+        {
+            break;
+        }
+
+        /* The chunk is sized once it can start, by the latest durations */
+        if(sr->history == NULL)
+        {
+            jobs_free_slot(sr);
+        }
+
+        p = pending_create(CK_PENDING_CHUNK);
+        p->s = s;
+        p->tc = tc;
+        p->tfun = tfun;
+        p->iter = i;
+        p->iter_end = i + chunk_size(sr, s, tc, tfun, i);
+        i = p->iter_end;
+        jobs_queue(p);
+        jobs_submit(sr, p);
+    }
+}
+
+/*
+ * The number of iterations of the chunk which starts with iteration i:
+ * they take about CK_CHUNK_USEC by the mean duration of the iterations
+ * which ended, or else by the duration history, but each job gets at
+ * most its share of the iterations left, so that the jobs end at about
+ * the same time. With no duration known yet, the one iteration of the
+ * chunk is measured.
+ */
+static int chunk_size(SRunner * sr, Suite * s, TCase * tc, TF * tfun,
+                      int i)
+{
+    int share = (tfun->loop_end - i) / job_pool->njobs;
+    long usec = -1;
+    long n;
+
+    if(tfun->nmeasured > 0)
+    {
+        usec = tfun->measured_usec / tfun->nmeasured;
+    }
+    else if(sr->history != NULL)
+    {
+        usec = history_median(sr->history, s->name, tc->name, tfun->name,
+                              i);
+    }
+    if(usec < 0)
+    {
+        return 1;
+    }
+
+    n = CK_CHUNK_USEC / (usec > 0 ? usec : 1);
+    if(n > share)
+    {
+        n = share;
+    }
+    return n > 1 ? (int)n : 1;
+}
+
+static void srunner_fork_chunk(SRunner * sr, Pending * p, int slot)
+{
+    pid_t pid;
+
+    if(report_fds[0] == -1)
+    {
+        report_socket_open();
+    }
+    /* A fork server which ran since may have watched its own socket */
+    supervisor_watch(supervisor, report_fds[0]);
+
+    select_msg_slot(slot);
+    pid = fork();
+    if(pid == -1)
+        eprintf("Error in call to fork:", __FILE__, __LINE__ - 2);
+    if(pid == 0)
+    {
+        report_slot = slot;
+        fork_child_init();
+        tcase_run_chunk_child(sr, p);
+    }
+    select_msg_slot(0);
+
+    /* Restarted for each iteration, see srunner_receive_reports() */
+    supervisor_add(supervisor, slot, pid, &p->tc->timeout);
+}
+
+/* Run in the process of a chunk, never returns */
+static void tcase_run_chunk_child(SRunner * sr, Pending * p)
+{
+    int i;
+
+    close(report_fds[0]);
+    report_fds[0] = -1;
+    setpgid(0, 0);
+
+    for(i = p->iter; i < p->iter_end; i++)
+    {
+        TestResult *tr;
+
+        if(!srunner_selects(sr, p->s, p->tc, p->tfun, i))
+        {
+            continue;
+        }
+
+        /* A failure ends the process, so the iteration passed */
+        tcase_run_tfun_body(sr, p->tc, p->tfun, i);
+        tr = receive_result_info_fork(p->tc, p->tfun->name, i, 0, 0,
+                                      0, 0);
+        tcase_send_report(p->tfun, tr);
+        free(tr->file);
+        free(tr->msg);
+        free(tr);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+/* The first iteration of a chunk which has not ended, or iter_end */
+static int chunk_next(SRunner * sr, Pending * p)
+{
+    int i = p->iter;
+
+    while(i < p->iter_end
+          && !srunner_selects(sr, p->s, p->tc, p->tfun, i))
+    {
+        i++;
+    }
+    return i;
+}
+
+/*
+ * The process of a chunk has ended. Unless it ran all the iterations,
+ * the one which was running gets the result of a forked test, and the
+ * rest is forked again into the slot.
+ */
+static void srunner_collect_chunk(SRunner * sr, Pending * p, int slot,
+                                  int status, int timed_out)
+{
+    TestResult *tr;
+    int i;
+
+    /* It sent everything before it ended */
+    srunner_receive_reports(sr);
+
+    i = chunk_next(sr, p);
+    if(i == p->iter_end)
+    {
+        p->done = 1;
+        return;
+    }
+    if(p->cancelled && WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL)
+    {
+        chunk_skip_rest(sr, p);
+        return;
+    }
+
+    select_msg_slot(slot);
+    tr = receive_result_info_fork(p->tc, p->tfun->name, i, status,
+                                  timed_out, 0, 0);
+    select_msg_slot(0);
+    tfun_set_result(p->tfun, tr);
+    pending_add_report(p, p->tfun, tr);
+
+    p->iter = i + 1;
+    if(chunk_next(sr, p) == p->iter_end)
+    {
+        p->done = 1;
+    }
+    else if(srunner_skips_test(sr, p->tc, p->tfun))
+    {
+        chunk_skip_rest(sr, p);
+    }
+    else
+    {
+        srunner_fork_chunk(sr, p, slot);
+    }
+}
+
+/* Add skipped results for the iterations of a chunk which did not run */
+static void chunk_skip_rest(SRunner * sr, Pending * p)
+{
+    int i;
+
+    for(i = p->iter; i < p->iter_end; i++)
+    {
+        if(srunner_selects(sr, p->s, p->tc, p->tfun, i))
+        {
+            pending_add_report(p, p->tfun, skip_result(sr, p->tc, p->tfun,
+                                                       i));
+        }
+    }
+    p->iter = p->iter_end;
+    p->done = 1;
+}
+
+/* The socket through which test case and chunk processes report */
+static void report_socket_open(void)
+{
+    if(socketpair(AF_UNIX, SOCK_DGRAM, 0, report_fds) != 0)
+        eprintf("Error in call to socketpair:", __FILE__, __LINE__ - 1);
+    fcntl(report_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(report_fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(report_fds[1], F_SETFD, FD_CLOEXEC);
+}
+
+static void srunner_run_batch(SRunner * sr, Suite * s, TCase * tc)
+{
+    List *tfl = tc->tflst;
+    BatchTest *tests;
+    int ntests = 0;
+    int next = 0;
+
+    for(check_list_front(tfl); !check_list_at_end(tfl);
+        check_list_advance(tfl))
+    {
+        TF *tfun = (TF *)check_list_val(tfl);
+
+        tfun->failed = 0;
+        if(tfun->loop_end > tfun->loop_start)
+        {
+            ntests += tfun->loop_end - tfun->loop_start;
+        }
+    }
+    if(ntests == 0)
+    {
+        return;
+    }
+
+    tests = (BatchTest *)emalloc(ntests * sizeof(BatchTest));
+    for(check_list_front(tfl); !check_list_at_end(tfl);
+        check_list_advance(tfl))
+    {
+        TF *tfun = (TF *)check_list_val(tfl);
+        int i;
+
+        for(i = tfun->loop_start; i < tfun->loop_end; i++)
+        {
+            if(srunner_selects(sr, s, tc, tfun, i))
+            {
+                tests[next].tfun = tfun;
+                tests[next].iter = i;
+                next++;
+            }
+        }
+    }
+
+    srunner_run_batch_tests(sr, tc, tests, next);
+    free(tests);
+}
+
+/*
+ * Whether the iterations of a loop test run in a batch in a serial run,
+ * see tcase_add_batched_loop_test()
+ */
+static int srunner_batches_tfun(SRunner * sr, TCase * tc, TF * tfun)
+{
+    /* The batch process has the watched descriptor of a fork server */
+    return tfun->batched && job_pool == NULL
+        && srunner_fork_status(sr) == CK_FORK && msg_slots_shared()
+        && !use_fork_server && tc != snapshot_tc;
+}
+
+static void srunner_run_batch_loop(SRunner * sr, Suite * s, TCase * tc,
+                                   TF * tfun)
+{
+    BatchTest *tests;
+    int ntests = 0;
+    int i;
+
+    if(tfun->loop_end <= tfun->loop_start)
+    {
+        return;
+    }
+
+    tests = (BatchTest *)emalloc((tfun->loop_end - tfun->loop_start) *
+                                 sizeof(BatchTest));
+    for(i = tfun->loop_start; i < tfun->loop_end; i++)
+    {
+        if(srunner_selects(sr, s, tc, tfun, i))
+        {
+            tests[ntests].tfun = tfun;
+            tests[ntests].iter = i;
+            ntests++;
+        }
+    }
+
+    srunner_run_batch_tests(sr, tc, tests, ntests);
+    free(tests);
+}
+
+/* Run the tests in as few processes as they let */
+static void srunner_run_batch_tests(SRunner * sr, TCase * tc,
+                                    BatchTest * tests, int ntests)
+{
+    int next = 0;
+
+    while(next < ntests)
+    {
+        if(srunner_skips_test(sr, tc, tests[next].tfun))
+        {
+            srunner_report_result(sr, tests[next].tfun,
+                                  skip_result(sr, tc, tests[next].tfun,
+                                              tests[next].iter));
+            next++;
+            continue;
+        }
+        next = srunner_run_batch_process(sr, tc, tests, next, ntests);
+    }
+}
+
+/*
+ * Fork a process which runs the tests from 'first' on, until one of
+ * them ends it or the next one is skipped. Returns the index of the
+ * next test to run.
+ */
+static int srunner_run_batch_process(SRunner * sr, TCase * tc,
+                                     BatchTest * tests, int first,
+                                     int ntests)
+{
+    struct timespec no_timeout = { 0, 0 };
+    int status = 0;
+    int timed_out = 0;
+    int fds[2];
+    pid_t pid;
+    int k;
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        eprintf("Error in call to socketpair:", __FILE__, __LINE__ - 1);
+
+    pid = fork();
+    if(pid == -1)
+        eprintf("Error in call to fork:", __FILE__, __LINE__ - 2);
+    if(pid == 0)
+    {
+        close(fds[0]);
+        fork_child_init();
+        tcase_run_batch_child(sr, tc, tests + first, ntests - first,
+                              fds[1]);
+    }
+    close(fds[1]);
+
+    supervisor_add(supervisor, 0, pid, &no_timeout);
+    supervisor_watch(supervisor, fds[0]);
+
+    for(k = first; k < ntests; k++)
+    {
+        TF *tfun = tests[k].tfun;
+        TestResult *tr;
+        int running;
+
+        if(srunner_skips_test(sr, tc, tfun))
+        {
+            break;
+        }
+        srunner_log_test_start(sr, tc, tfun);
+        supervisor_set_timeout(supervisor, 0, &tc->timeout);
+        batch_send(fds[0]);
+        running = srunner_wait_batch(fds[0], &status, &timed_out);
+
+        tr = receive_result_info_fork(tc, tfun->name, tests[k].iter,
+                                      status, timed_out, tfun->signal,
+                                      tfun->allowed_exit_value);
+        tfun_set_result(tfun, tr);
+        srunner_report_result(sr, tfun, tr);
+
+        if(!running)
+        {
+            close(fds[0]);
+            return k + 1;
+        }
+    }
+
+    /* The process exits once the socket is closed */
+    supervisor_watch(supervisor, -1);
+    close(fds[0]);
+    supervisor_wait(supervisor, &status, &timed_out);
+
+    return k;
+}
+
+/* Run in the forked process of a batch, never returns */
+static void tcase_run_batch_child(SRunner * sr, TCase * tc,
+                                  BatchTest * tests, int ntests, int fd)
+{
+    int k;
+
+    setpgid(0, 0);
+    for(k = 0; k < ntests && batch_receive(fd); k++)
+    {
+        tcase_run_tfun_body(sr, tc, tests[k].tfun, tests[k].iter);
+        batch_send(fd);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+/*
+ * Wait until the running test of a batch has ended. Returns 1 if the
+ * process is ready for the next test, with a status as if it had
+ * exited normally, or 0 with the wait status of the process if it
+ * ended.
+ */
+static int srunner_wait_batch(int fd, int *status, int *timed_out)
+{
+    for(;;)
+    {
+        if(supervisor_wait(supervisor, status, timed_out)
+           != SUPERVISOR_READABLE)
+        {
+            supervisor_watch(supervisor, -1);
+            return 0;
+        }
+        if(batch_receive(fd))
+        {
+            *status = 0;
+            *timed_out = 0;
+            return 1;
+        }
+        /* The process is exiting */
+        supervisor_watch(supervisor, -1);
+    }
+}
+
+/* Returns 1 on success, 0 if the other process is gone */
+static int batch_send(int fd)
+{
+    char c = 0;
+    ssize_t n;
+
+    while((n = send(fd, &c, 1, MSG_NOSIGNAL)) == -1 && errno == EINTR)
+    {
+        /* Try again */
+    }
+    return n == 1;
+}
 
+static int batch_receive(int fd)
+{
+    char c;
+    ssize_t n;
 
-    pid = fork();
-    if(pid == -1)
-        eprintf("Error in call to fork:", __FILE__, __LINE__ - 2);
-    if(pid == 0)
+    while((n = read(fd, &c, 1)) == -1 && errno == EINTR)
     {
-        setpgid(0, 0);
-        group_pid = getpgrp();
-        tr = tcase_run_checked_setup(sr, tc);
-        free(tr);
-        clock_gettime(check_get_clockid(), &ts_start);
-        tfun->fn(i);
-        clock_gettime(check_get_clockid(), &ts_end);
-        tcase_run_checked_teardown(tc);
-        send_duration_info(DIFF_IN_USEC(ts_start, ts_end));
-        exit(EXIT_SUCCESS);
+        /* Try again */
     }
-    else
+    return n == 1;
+}
+
+/* Set up the forking of tests in CK_FORK and CK_FORK_BATCH mode */
+static void srunner_fork_init(SRunner * sr, int njobs)
+{
+    if(srunner_fork_status(sr) == CK_FORK_BATCH)
     {
-        group_pid = pid;
+        supervisor = supervisor_create(1);
     }
-
-    alarm_received = 0;
-
-    if(timer_create(check_get_clockid(),
-                    NULL /* fire SIGALRM if timer expires */ ,
-                    &timerid) == 0)
+    else if(srunner_fork_status(sr) == CK_FORK)
     {
-        /* Set the timer to fire once */
-        timer_spec.it_value = tc->timeout;
-        timer_spec.it_interval.tv_sec = 0;
-        timer_spec.it_interval.tv_nsec = 0;
-        if(timer_settime(timerid, 0, &timer_spec, NULL) == 0)
+        supervisor = supervisor_create(njobs);
+        if(njobs > 1)
         {
-            do
-            {
-                pid_w = waitpid(pid, &status, 0);
-            }
-            while(pid_w == -1);
+            srunner_jobs_start(sr, njobs);
         }
-        else
+        if(msg_slots_shared())
         {
-            eprintf("Error in call to timer_settime:", __FILE__, __LINE__);
+            zygote = zygote_create(sr, supervisor, njobs,
+                                   tcase_run_tfun_child,
+                                   tcase_run_snapshot_setup,
+                                   fork_server_init);
+            use_fork_server = srunner_fork_server(sr);
         }
+    }
+}
 
-        /* If the timer has not fired, disable it */
-        timer_delete(timerid);
+static void srunner_fork_end(SRunner * sr)
+{
+    if(job_pool != NULL)
+    {
+        srunner_jobs_end(sr);
     }
-    else
+    if(report_fds[0] != -1)
+    {
+        close(report_fds[0]);
+        close(report_fds[1]);
+        report_fds[0] = report_fds[1] = -1;
+    }
+    fork_tcase = 0;
+    if(zygote != NULL)
     {
-        eprintf("Error in call to timer_create:", __FILE__, __LINE__);
+        zygote_free(zygote);
+        zygote = NULL;
     }
+    if(supervisor != NULL)
+    {
+        supervisor_free(supervisor);
+        supervisor = NULL;
+    }
+}
 
-    killpg(pid, SIGKILL);       /* Kill remaining processes. */
+/* Forget about the tests of the suite runner in a forked test */
+static void fork_child_init(void)
+{
+    if(supervisor != NULL)
+    {
+        supervisor_child_init(supervisor);
+        supervisor = NULL;
+    }
+    if(zygote != NULL)
+    {
+        zygote_child_init(zygote);
+        zygote = NULL;
+    }
+    job_pool = NULL;
+}
 
-    return receive_result_info_fork(tc->name, tfun->name, i, status,
-                                    tfun->signal, tfun->allowed_exit_value);
+/* The same in the fork server, which keeps its own end of the socket */
+static void fork_server_init(void)
+{
+    zygote = NULL;
+    fork_child_init();
 }
 
-static TestResult *receive_result_info_fork(const char *tcname,
+static TestResult *receive_result_info_fork(TCase * tc,
                                             const char *tname,
                                             int iter,
-                                            int status, int expected_signal,
+                                            int status, int timed_out,
+                                            int expected_signal,
                                             signed char allowed_exit_value)
 {
     TestResult *tr;
@@ -526,17 +2804,20 @@ static TestResult *receive_result_info_fork(const char *tcname,
     }
     else
     {
-        tr->tcname = tcname;
+        tr->tcname = tc->name;
         tr->tname = tname;
         tr->iter = iter;
-        set_fork_info(tr, status, expected_signal, allowed_exit_value);
+        set_fork_info(tr, status, timed_out, expected_signal,
+                      allowed_exit_value, tc->memory_limit >= 0);
     }
 
     return tr;
 }
 
-static void set_fork_info(TestResult * tr, int status, int signal_expected,
-                          signed char allowed_exit_value)
+static void set_fork_info(TestResult * tr, int status, int timed_out,
+                          int signal_expected,
+                          signed char allowed_exit_value,
+                          int memory_limited)
 {
     int was_sig = WIFSIGNALED(status);
     int was_exit = WIFEXITED(status);
@@ -547,15 +2828,16 @@ static void set_fork_info(TestResult * tr, int status, int signal_expected,
     {
         if(signal_expected == signal_received)
         {
-            if(alarm_received)
+            if(timed_out)
             {
-                /* Got alarm instead of signal */
+                /* Got killed for the timeout instead of the signal */
                 tr->rtype = CK_ERROR;
                 if(tr->msg != NULL)
                 {
                     free(tr->msg);
                 }
-                tr->msg = signal_error_msg(signal_received, signal_expected);
+                tr->msg = signal_error_msg(signal_received, signal_expected,
+                                           timed_out);
             }
             else
             {
@@ -575,7 +2857,15 @@ static void set_fork_info(TestResult * tr, int status, int signal_expected,
             {
                 free(tr->msg);
             }
-            tr->msg = signal_error_msg(signal_received, signal_expected);
+            tr->msg = signal_error_msg(signal_received, signal_expected,
+                                       timed_out);
+        }
+        else if(memory_limited && !timed_out && tr->msg != NULL
+                && (signal_received == SIGSEGV || signal_received == SIGBUS
+                    || signal_received == SIGABRT))
+        {
+            /* the test sent the reason, see memory_limit_handler() */
+            tr->rtype = CK_ERROR;
         }
         else
         {
@@ -585,7 +2875,7 @@ static void set_fork_info(TestResult * tr, int status, int signal_expected,
             {
                 free(tr->msg);
             }
-            tr->msg = signal_msg(signal_received);
+            tr->msg = signal_msg(signal_received, timed_out);
         }
     }
     else if(signal_expected == 0)
@@ -633,14 +2923,20 @@ static void set_fork_info(TestResult * tr, int status, int signal_expected,
     }
 }
 
-static char *signal_msg(int signal)
+static char *signal_msg(int signal, int timed_out)
 {
     char *msg = (char *)emalloc(MSG_LEN);       /* free'd by caller */
 
-    if(alarm_received)
+    if(timed_out)
     {
         snprintf(msg, MSG_LEN, "Test timeout expired");
     }
+#ifdef SIGXCPU
+    else if(signal == SIGXCPU)
+    {
+        snprintf(msg, MSG_LEN, "Resource limit exceeded: CPU time limit");
+    }
+#endif /* SIGXCPU */
     else
     {
         snprintf(msg, MSG_LEN, "Received signal %d (%s)",
@@ -649,7 +2945,8 @@ static char *signal_msg(int signal)
     return msg;
 }
 
-static char *signal_error_msg(int signal_received, int signal_expected)
+static char *signal_error_msg(int signal_received, int signal_expected,
+                              int timed_out)
 {
     char *sig_r_str;
     char *sig_e_str;
@@ -657,7 +2954,7 @@ static char *signal_error_msg(int signal_received, int signal_expected)
 
     sig_r_str = strdup(strsignal(signal_received));
     sig_e_str = strdup(strsignal(signal_expected));
-    if(alarm_received)
+    if(timed_out)
     {
         snprintf(msg, MSG_LEN,
                  "Test timeout expired, expected signal %d (%s)",
@@ -710,6 +3007,8 @@ enum fork_status srunner_fork_status(SRunner * sr)
         else
         {
 #if defined(HAVE_FORK) && HAVE_FORK==1
+            if(strcmp(env, "batch") == 0)
+                return CK_FORK_BATCH;
             return CK_FORK;
 #else /* HAVE_FORK */
             /* Ignoring, as Check is not compiled with fork support. */
@@ -734,6 +3033,389 @@ void srunner_set_fork_status(SRunner * sr, enum fork_status fstat)
     sr->fstat = fstat;
 }
 
+enum loc_tracking srunner_loc_tracking(SRunner * sr)
+{
+    if(sr->ltrack == CK_LOC_GETENV)
+    {
+        char *env = getenv("CK_LOC_TRACKING");
+
+        if(env != NULL && strcmp(env, "shared") == 0)
+            return CK_LOC_SHARED;
+        return CK_LOC_MESSAGE;
+    }
+    else
+        return sr->ltrack;
+}
+
+void srunner_set_loc_tracking(SRunner * sr, enum loc_tracking mode)
+{
+    sr->ltrack = mode;
+}
+
+int srunner_jobs(SRunner * sr)
+{
+    int jobs = sr->jobs;
+
+    if(jobs < 0)
+    {
+        char *env = getenv("CK_JOBS");
+
+        jobs = 1;
+        if(env != NULL)
+        {
+            char *endptr = NULL;
+            long tmp = strtol(env, &endptr, 10);
+
+            if(endptr != env && *endptr == '\0' && tmp >= 0 && tmp <= 4096)
+            {
+                jobs = (int)tmp;
+            }
+        }
+    }
+
+    if(jobs == 0)
+    {
+#if defined(_SC_NPROCESSORS_ONLN)
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+        jobs = ncpu > 0 ? (int)ncpu : 1;
+#else
+        jobs = 1;
+#endif /* _SC_NPROCESSORS_ONLN */
+    }
+
+    return jobs;
+}
+
+void srunner_set_jobs(SRunner * sr, int jobs)
+{
+    sr->jobs = jobs < 0 ? -1 : jobs;
+}
+
+int srunner_fork_server(SRunner * sr)
+{
+    if(sr->fork_server < 0)
+    {
+        char *env = getenv("CK_FORK_SERVER");
+
+        return env != NULL && strcmp(env, "yes") == 0;
+    }
+    return sr->fork_server;
+}
+
+void srunner_set_fork_server(SRunner * sr, int enabled)
+{
+    sr->fork_server = enabled < 0 ? -1 : enabled != 0;
+}
+
+int srunner_fork_tcase(SRunner * sr)
+{
+    if(sr->fork_tcase < 0)
+    {
+        char *env = getenv("CK_FORK_TCASE");
+
+        return env != NULL && strcmp(env, "yes") == 0;
+    }
+    return sr->fork_tcase;
+}
+
+void srunner_set_fork_tcase(SRunner * sr, int enabled)
+{
+    sr->fork_tcase = enabled < 0 ? -1 : enabled != 0;
+}
+
+int srunner_perf_counters(SRunner * sr)
+{
+    if(sr->perf_counters < 0)
+    {
+        char *env = getenv("CK_PERF_COUNTERS");
+
+        return env != NULL && strcmp(env, "yes") == 0;
+    }
+    return sr->perf_counters;
+}
+
+void srunner_set_perf_counters(SRunner * sr, int enabled)
+{
+    sr->perf_counters = enabled < 0 ? -1 : enabled != 0;
+}
+
+int srunner_rusage(SRunner * sr)
+{
+    if(sr->rusage < 0)
+    {
+        char *env = getenv("CK_RUSAGE");
+
+        return env != NULL && strcmp(env, "yes") == 0;
+    }
+    return sr->rusage;
+}
+
+void srunner_set_rusage(SRunner * sr, int enabled)
+{
+    sr->rusage = enabled < 0 ? -1 : enabled != 0;
+}
+
+int srunner_alloc_tracking(SRunner * sr)
+{
+    if(sr->alloc_tracking < 0)
+    {
+        char *env = getenv("CK_ALLOC_TRACKING");
+
+        return env != NULL && strcmp(env, "yes") == 0;
+    }
+    return sr->alloc_tracking;
+}
+
+void srunner_set_alloc_tracking(SRunner * sr, int enabled)
+{
+    sr->alloc_tracking = enabled < 0 ? -1 : enabled != 0;
+}
+
+int srunner_stream_results(SRunner * sr)
+{
+    if(sr->stream_results < 0)
+    {
+        char *env = getenv("CK_STREAM_RESULTS");
+
+        return env != NULL && strcmp(env, "yes") == 0;
+    }
+    return sr->stream_results;
+}
+
+void srunner_set_stream_results(SRunner * sr, int enabled)
+{
+    sr->stream_results = enabled < 0 ? -1 : enabled != 0;
+}
+
+int srunner_loop_chunks(SRunner * sr)
+{
+    if(sr->loop_chunks < 0)
+    {
+        char *env = getenv("CK_LOOP_CHUNKS");
+
+        return env != NULL && strcmp(env, "yes") == 0;
+    }
+    return sr->loop_chunks;
+}
+
+void srunner_set_loop_chunks(SRunner * sr, int enabled)
+{
+    sr->loop_chunks = enabled < 0 ? -1 : enabled != 0;
+}
+
+const char *srunner_filter(SRunner * sr)
+{
+    if(sr->filter != NULL)
+    {
+        return sr->filter;
+    }
+    return getenv("CK_RUN_FILTER");
+}
+
+void srunner_set_filter(SRunner * sr, const char *filter)
+{
+    sr->filter = filter;
+}
+
+const char *srunner_include_tags(SRunner * sr)
+{
+    if(sr->include_tags != NULL)
+    {
+        return sr->include_tags;
+    }
+    return getenv("CK_INCLUDE_TAGS");
+}
+
+const char *srunner_exclude_tags(SRunner * sr)
+{
+    if(sr->exclude_tags != NULL)
+    {
+        return sr->exclude_tags;
+    }
+    return getenv("CK_EXCLUDE_TAGS");
+}
+
+void srunner_set_tags(SRunner * sr, const char *include_tags,
+                      const char *exclude_tags)
+{
+    sr->include_tags = include_tags;
+    sr->exclude_tags = exclude_tags;
+}
+
+/* Reads CK_SHARD_INDEX and CK_SHARD_COUNT, returns 0 unless both are valid */
+static int shard_getenv(int *index, int *count)
+{
+    char *index_env = getenv("CK_SHARD_INDEX");
+    char *count_env = getenv("CK_SHARD_COUNT");
+    char *endptr = NULL;
+    long tmp_index;
+    long tmp_count;
+
+    if(index_env == NULL || count_env == NULL)
+    {
+        return 0;
+    }
+
+    tmp_index = strtol(index_env, &endptr, 10);
+    if(endptr == index_env || *endptr != '\0')
+    {
+        return 0;
+    }
+    tmp_count = strtol(count_env, &endptr, 10);
+    if(endptr == count_env || *endptr != '\0')
+    {
+        return 0;
+    }
+    if(tmp_count < 1 || tmp_count > 1000000 || tmp_index < 0
+       || tmp_index >= tmp_count)
+    {
+        return 0;
+    }
+
+    *index = (int)tmp_index;
+    *count = (int)tmp_count;
+    return 1;
+}
+
+int srunner_shard_index(SRunner * sr)
+{
+    int index = 0;
+    int count = 1;
+
+    if(sr->shard_count < 0)
+    {
+        shard_getenv(&index, &count);
+        return index;
+    }
+    return sr->shard_index;
+}
+
+int srunner_shard_count(SRunner * sr)
+{
+    int index = 0;
+    int count = 1;
+
+    if(sr->shard_count < 0)
+    {
+        shard_getenv(&index, &count);
+        return count;
+    }
+    return sr->shard_count;
+}
+
+void srunner_set_shard(SRunner * sr, int index, int count)
+{
+    if(count < 0)
+    {
+        sr->shard_index = 0;
+        sr->shard_count = -1;
+    }
+    else if(count == 0 || index < 0 || index >= count)
+    {
+        eprintf("Bad shard %d of %d", __FILE__, __LINE__, index, count);
+    }
+    else
+    {
+        sr->shard_index = index;
+        sr->shard_count = count;
+    }
+}
+
+void srunner_set_shard_file(SRunner * sr, const char *fname)
+{
+    if(sr->shard_fname)
+        return;
+    sr->shard_fname = fname;
+}
+
+int srunner_has_shard_file(SRunner * sr)
+{
+    return srunner_shard_fname(sr) != NULL;
+}
+
+const char *srunner_shard_fname(SRunner * sr)
+{
+    /* check if the shard filename has been set explicitly */
+    if(sr->shard_fname != NULL)
+    {
+        return sr->shard_fname;
+    }
+
+    return getenv("CK_SHARD_FILE_NAME");
+}
+
+int srunner_max_failures(SRunner * sr)
+{
+    int max_failures = sr->max_failures;
+
+    if(max_failures < 0)
+    {
+        char *env = getenv("CK_MAX_FAILURES");
+
+        max_failures = 0;
+        if(env != NULL)
+        {
+            char *endptr = NULL;
+            long tmp = strtol(env, &endptr, 10);
+
+            if(endptr != env && *endptr == '\0' && tmp >= 0
+               && tmp <= INT_MAX)
+            {
+                max_failures = (int)tmp;
+            }
+        }
+    }
+
+    return max_failures;
+}
+
+void srunner_set_max_failures(SRunner * sr, int max_failures)
+{
+    sr->max_failures = max_failures < 0 ? -1 : max_failures;
+}
+
+static double srunner_bench_ratio(SRunner * sr)
+{
+    if(sr->bench_ratio > 0)
+    {
+        return sr->bench_ratio;
+    }
+    return env_double("CK_BENCH_RATIO", 1.1);
+}
+
+static double srunner_bench_alpha(SRunner * sr)
+{
+    if(sr->bench_alpha > 0)
+    {
+        return sr->bench_alpha;
+    }
+    return env_double("CK_BENCH_ALPHA", 0.01);
+}
+
+static double env_double(const char *name, double default_val)
+{
+    char *env = getenv(name);
+
+    if(env != NULL)
+    {
+        char *endptr = NULL;
+        double tmp = strtod(env, &endptr);
+
+        if(tmp > 0 && endptr != env && *endptr == '\0')
+        {
+            return tmp;
+        }
+    }
+    return default_val;
+}
+
+void srunner_set_bench_thresholds(SRunner * sr, double ratio, double alpha)
+{
+    sr->bench_ratio = ratio > 0 ? ratio : 0;
+    sr->bench_alpha = alpha > 0 ? alpha : 0;
+}
+
 void srunner_run_all(SRunner * sr, enum print_output print_mode)
 {
     srunner_run(sr, NULL,       /* All test suites.  */
@@ -745,11 +3427,28 @@ void srunner_run(SRunner * sr, const char *sname, const char *tcname,
                  enum print_output print_mode)
 {
 #if defined(HAVE_SIGACTION) && defined(HAVE_FORK)
-    static struct sigaction sigalarm_old_action;
-    static struct sigaction sigalarm_new_action;
     static struct sigaction sigint_new_action;
     static struct sigaction sigterm_new_action;
 #endif /* HAVE_SIGACTION && HAVE_FORK */
+    int outer_perf_enabled = perf_enabled();
+    int outer_alloc_enabled = alloc_enabled();
+    int outer_stream_results = stream_results;
+    int outer_keep_rusage = keep_rusage;
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    /* A suite run in an unchecked fixture must not touch these */
+    Supervisor *outer_supervisor = supervisor;
+    JobPool *outer_job_pool = job_pool;
+    Zygote *outer_zygote = zygote;
+    int outer_use_fork_server = use_fork_server;
+    TCase *outer_snapshot_tc = snapshot_tc;
+    int outer_snapshot_taken = snapshot_taken;
+    int outer_fork_tcase = fork_tcase;
+    int outer_report_fds[2];
+    int outer_report_slot = report_slot;
+
+    outer_report_fds[0] = report_fds[0];
+    outer_report_fds[1] = report_fds[1];
+#endif /* HAVE_FORK */
 
     /*  Get the selected test suite and test case from the
        environment.  */
@@ -766,10 +3465,6 @@ void srunner_run(SRunner * sr, const char *sname, const char *tcname,
                 __FILE__, __LINE__, print_mode);
     }
 #if defined(HAVE_SIGACTION) && defined(HAVE_FORK)
-    memset(&sigalarm_new_action, 0, sizeof(sigalarm_new_action));
-    sigalarm_new_action.sa_handler = sig_handler;
-    sigaction(SIGALRM, &sigalarm_new_action, &sigalarm_old_action);
-
     memset(&sigint_new_action, 0, sizeof(sigint_new_action));
     sigint_new_action.sa_handler = sig_handler;
     sigaction(SIGINT, &sigint_new_action, &sigint_old_action);
@@ -778,11 +3473,41 @@ void srunner_run(SRunner * sr, const char *sname, const char *tcname,
     sigterm_new_action.sa_handler = sig_handler;
     sigaction(SIGTERM, &sigterm_new_action, &sigterm_old_action);
 #endif /* HAVE_SIGACTION && HAVE_FORK */
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    supervisor = NULL;
+    job_pool = NULL;
+    zygote = NULL;
+    use_fork_server = 0;
+    snapshot_tc = NULL;
+    snapshot_taken = 0;
+    fork_tcase = 0;
+    report_fds[0] = report_fds[1] = -1;
+    report_slot = -1;
+#endif /* HAVE_FORK */
+    perf_set_enabled(srunner_perf_counters(sr));
+    alloc_set_enabled(srunner_alloc_tracking(sr));
+    stream_results = srunner_stream_results(sr);
+    keep_rusage = srunner_rusage(sr);
     srunner_run_init(sr, print_mode);
     srunner_iterate_suites(sr, sname, tcname, print_mode);
     srunner_run_end(sr, print_mode);
+    perf_set_enabled(outer_perf_enabled);
+    alloc_set_enabled(outer_alloc_enabled);
+    stream_results = outer_stream_results;
+    keep_rusage = outer_keep_rusage;
+#if defined(HAVE_FORK) && HAVE_FORK==1
+    supervisor = outer_supervisor;
+    job_pool = outer_job_pool;
+    zygote = outer_zygote;
+    use_fork_server = outer_use_fork_server;
+    snapshot_tc = outer_snapshot_tc;
+    snapshot_taken = outer_snapshot_taken;
+    fork_tcase = outer_fork_tcase;
+    report_fds[0] = outer_report_fds[0];
+    report_fds[1] = outer_report_fds[1];
+    report_slot = outer_report_slot;
+#endif /* HAVE_FORK */
 #if defined(HAVE_SIGACTION) && defined(HAVE_FORK)
-    sigaction(SIGALRM, &sigalarm_old_action, NULL);
     sigaction(SIGINT, &sigint_old_action, NULL);
     sigaction(SIGTERM, &sigterm_old_action, NULL);
 #endif /* HAVE_SIGACTION && HAVE_FORK */
@@ -791,14 +3516,11 @@ void srunner_run(SRunner * sr, const char *sname, const char *tcname,
 pid_t check_fork(void)
 {
 #if defined(HAVE_FORK) && HAVE_FORK==1
-    pid_t pid = fork();
-
-    /* Set the process to a process group to be able to kill it easily. */
-    if(pid >= 0)
-    {
-        setpgid(pid, group_pid);
-    }
-    return pid;
+    /*
+     * The process inherits the process group of the test, which is
+     * killed as a whole once the test has ended.
+     */
+    return fork();
 #else /* HAVE_FORK */
     /* Ignoring, as Check is not compiled with fork support. */
     return -1;
@@ -0,0 +1,912 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "check_error.h"
+#include "check_list.h"
+#include "check_impl.h"
+#include "check_select.h"
+
+/*
+ * A pattern of the filter, with the patterns of the suite, test case
+ * and test names. A NULL part matches every name.
+ */
+typedef struct Pattern
+{
+    char *parts[3];
+    int literal[3];             /* the part has no wildcards */
+    int exclude;
+} Pattern;
+
+enum
+{
+    PART_SUITE,
+    PART_TCASE,
+    PART_TEST
+};
+
+/* What a name in the index stands for */
+enum index_kind
+{
+    INDEX_SUITE = 'S',          /* the numbers of the suites by name */
+    INDEX_TCASE = 'C',          /* the numbers of the test cases by name */
+    INDEX_TAG = 'G',            /* the numbers of the test cases by tag */
+    INDEX_TEST = 'T'            /* the numbers of the test cases by test */
+};
+
+typedef struct IndexEntry
+{
+    const char *name;           /* owned by the suites, NULL if unused */
+    int kind;
+    int *items;
+    size_t nitems;
+    size_t max_items;
+} IndexEntry;
+
+typedef struct SuiteInfo
+{
+    Suite *s;
+    int first;                  /* the number of its first test case */
+    int ntcases;
+} SuiteInfo;
+
+struct TestIndex
+{
+    SuiteInfo *suites;          /* all suites of the runner */
+    int nsuites;
+    int max_suites;
+    SelectedTCase *tcases;      /* all of their test cases */
+    int ntcases;
+    int max_tcases;
+    IndexEntry *entries;        /* a hash table with linear probing */
+    size_t size;                /* a power of two */
+    size_t used;
+    unsigned long changes;      /* index_changes when it was complete */
+};
+
+struct Selection
+{
+    const char *sname;
+    const char *tcname;
+    Pattern *patterns;
+    int npatterns;
+    int nincludes;
+    int test_level;             /* a pattern has a test part */
+    char **include_tags;
+    int ninclude_tags;
+    char **exclude_tags;
+    int nexclude_tags;
+    char *buf;                  /* the strings of the patterns and tags */
+
+    TestIndex *index;
+    SelectedTCase *selected;
+    size_t nselected;
+};
+
+/*
+ * Suites, test cases, tests and tags added anywhere, which the index
+ * of a runner may not have seen yet
+ */
+static unsigned long index_changes;
+
+static char *selection_parse_filter(Selection * sel, char *buf);
+static char *selection_parse_tags(char *buf, char ***tags, int *ntags);
+static void test_index_update(TestIndex * idx, List * slst);
+static void test_index_reset(TestIndex * idx);
+static void selection_all(Selection * sel);
+static int *selection_candidates(Selection * sel, size_t * ncand);
+static int *add_suite_tcases(Selection * sel, int suite_no, int *cand,
+                             size_t * ncand, size_t * max_cand);
+static int *add_item(int *items, size_t * n, size_t * max, int item);
+static int *add_entry_items(int *items, size_t * n, size_t * max,
+                            IndexEntry * e);
+static int selects_tcase(Selection * sel, SelectedTCase * st);
+static int pattern_matches(Pattern * p, Suite * s, TCase * tc, TF * tfun);
+static int tcase_has_tag(TCase * tc, char **tags, int ntags);
+static int glob_match(const char *pattern, const char *name);
+static int int_cmp(const void *a, const void *b);
+static IndexEntry *index_entry(TestIndex * idx, enum index_kind kind,
+                               const char *name, int add);
+static void index_add_item(TestIndex * idx, enum index_kind kind,
+                           const char *name, int item);
+static void index_grow(TestIndex * idx);
+static size_t hash_name(int kind, const char *name);
+
+TestIndex *test_index_create(void)
+{
+    TestIndex *idx = (TestIndex *)emalloc(sizeof(TestIndex));
+
+    memset(idx, 0, sizeof(TestIndex));
+    idx->size = 64;
+    idx->entries = (IndexEntry *)emalloc(idx->size * sizeof(IndexEntry));
+    memset(idx->entries, 0, idx->size * sizeof(IndexEntry));
+    idx->changes = index_changes;
+    return idx;
+}
+
+/*
+ * Number the suite and its test cases after those already indexed, and
+ * index them by name, test name and tag.
+ */
+void test_index_add_suite(TestIndex * idx, Suite * s)
+{
+    List *tcl = s->tclst;
+    SuiteInfo *si;
+
+    if(idx->nsuites == idx->max_suites)
+    {
+        idx->max_suites = 2 * idx->max_suites + 16;
+        idx->suites = (SuiteInfo *)erealloc(idx->suites, idx->max_suites *
+                                            sizeof(SuiteInfo));
+    }
+    si = &idx->suites[idx->nsuites];
+    si->s = s;
+    si->first = idx->ntcases;
+    si->ntcases = 0;
+    index_add_item(idx, INDEX_SUITE, s->name, idx->nsuites);
+
+    for(check_list_front(tcl); !check_list_at_end(tcl);
+        check_list_advance(tcl))
+    {
+        TCase *tc = (TCase *)check_list_val(tcl);
+        List *tags = tc->tags;
+        List *tfl = tc->tflst;
+        SelectedTCase *st;
+
+        if(idx->ntcases == idx->max_tcases)
+        {
+            idx->max_tcases = 2 * idx->max_tcases + 16;
+            idx->tcases = (SelectedTCase *)erealloc(idx->tcases,
+                                                    idx->max_tcases *
+                                                    sizeof(SelectedTCase));
+        }
+        st = &idx->tcases[idx->ntcases];
+        st->s = s;
+        st->tc = tc;
+        st->suite_no = idx->nsuites;
+        index_add_item(idx, INDEX_TCASE, tc->name, idx->ntcases);
+
+        for(check_list_front(tags); !check_list_at_end(tags);
+            check_list_advance(tags))
+        {
+            index_add_item(idx, INDEX_TAG,
+                           (const char *)check_list_val(tags),
+                           idx->ntcases);
+        }
+        for(check_list_front(tfl); !check_list_at_end(tfl);
+            check_list_advance(tfl))
+        {
+            index_add_item(idx, INDEX_TEST, ((TF *)check_list_val(tfl))->name,
+                           idx->ntcases);
+        }
+
+        idx->ntcases++;
+        si->ntcases++;
+    }
+    idx->nsuites++;
+}
+
+void test_index_changed(void)
+{
+    index_changes++;
+}
+
+void test_index_free(TestIndex * idx)
+{
+    test_index_reset(idx);
+    free(idx->entries);
+    free(idx->tcases);
+    free(idx->suites);
+    free(idx);
+}
+
+/*
+ * The index is complete unless suites, test cases, tests or tags were
+ * added since it was, to suites which may be indexed. It is then built
+ * again, once.
+ */
+static void test_index_update(TestIndex * idx, List * slst)
+{
+    if(idx->changes == index_changes)
+    {
+        return;
+    }
+
+    test_index_reset(idx);
+    for(check_list_front(slst); !check_list_at_end(slst);
+        check_list_advance(slst))
+    {
+        test_index_add_suite(idx, (Suite *)check_list_val(slst));
+    }
+    idx->changes = index_changes;
+}
+
+static void test_index_reset(TestIndex * idx)
+{
+    size_t i;
+
+    for(i = 0; i < idx->size; i++)
+    {
+        free(idx->entries[i].items);
+    }
+    memset(idx->entries, 0, idx->size * sizeof(IndexEntry));
+    idx->used = 0;
+    idx->nsuites = 0;
+    idx->ntcases = 0;
+}
+
+Selection *selection_create(TestIndex * idx, List * slst,
+                            const char *sname, const char *tcname,
+                            const char *filter, const char *include_tags,
+                            const char *exclude_tags)
+{
+    Selection *sel = (Selection *)emalloc(sizeof(Selection));
+    size_t len = 3;
+    char *buf;
+
+    memset(sel, 0, sizeof(Selection));
+    sel->index = idx;
+    sel->sname = sname;
+    sel->tcname = tcname;
+
+    /* One copy of the strings, cut into patterns and tags */
+    len += filter != NULL ? strlen(filter) : 0;
+    len += include_tags != NULL ? strlen(include_tags) : 0;
+    len += exclude_tags != NULL ? strlen(exclude_tags) : 0;
+    sel->buf = (char *)emalloc(len);
+    buf = sel->buf;
+    strcpy(buf, filter != NULL ? filter : "");
+    buf = selection_parse_filter(sel, buf);
+    strcpy(buf, include_tags != NULL ? include_tags : "");
+    buf = selection_parse_tags(buf, &sel->include_tags,
+                               &sel->ninclude_tags);
+    strcpy(buf, exclude_tags != NULL ? exclude_tags : "");
+    selection_parse_tags(buf, &sel->exclude_tags, &sel->nexclude_tags);
+
+    test_index_update(idx, slst);
+
+    if(tcname == NULL && sel->npatterns == 0 && sel->ninclude_tags == 0
+       && sel->nexclude_tags == 0)
+    {
+        selection_all(sel);
+    }
+    else
+    {
+        size_t ncand = 0;
+        int *cand = selection_candidates(sel, &ncand);
+        size_t i;
+
+        /* In the order of the runner, each test case once */
+        qsort(cand, ncand, sizeof(int), int_cmp);
+        sel->selected = (SelectedTCase *)emalloc((ncand + 1) *
+                                                 sizeof(SelectedTCase));
+        for(i = 0; i < ncand; i++)
+        {
+            SelectedTCase *st = &idx->tcases[cand[i]];
+
+            if((i == 0 || cand[i] != cand[i - 1]) && selects_tcase(sel, st))
+            {
+                sel->selected[sel->nselected++] = *st;
+            }
+        }
+        free(cand);
+    }
+
+    return sel;
+}
+
+void selection_free(Selection * sel)
+{
+    free(sel->selected);
+    free(sel->patterns);
+    free(sel->include_tags);
+    free(sel->exclude_tags);
+    free(sel->buf);
+    free(sel);
+}
+
+SelectedTCase *selection_tcases(Selection * sel, size_t * n)
+{
+    *n = sel->nselected;
+    return sel->selected;
+}
+
+int selection_selects(Selection * sel, Suite * s, TCase * tc, TF * tfun)
+{
+    int i;
+
+    if(!sel->test_level)
+    {
+        return 1;
+    }
+
+    for(i = 0; i < sel->npatterns; i++)
+    {
+        Pattern *p = &sel->patterns[i];
+
+        if(p->exclude && pattern_matches(p, s, tc, tfun))
+        {
+            return 0;
+        }
+    }
+    if(sel->nincludes == 0)
+    {
+        return 1;
+    }
+    for(i = 0; i < sel->npatterns; i++)
+    {
+        Pattern *p = &sel->patterns[i];
+
+        if(!p->exclude && pattern_matches(p, s, tc, tfun))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * The filter is a list of patterns separated by commas. A pattern
+ * is SUITE[:TCASE[:TEST]], and excludes tests if it starts with '-'.
+ * Returns the rest of the buffer.
+ */
+static char *selection_parse_filter(Selection * sel, char *buf)
+{
+    size_t len = strlen(buf);
+    char *next = buf;
+    int max_patterns = 1;
+    char *c;
+
+    for(c = buf; *c != '\0'; c++)
+    {
+        if(*c == ',')
+        {
+            max_patterns++;
+        }
+    }
+    sel->patterns = (Pattern *)emalloc(max_patterns * sizeof(Pattern));
+
+    while(next != NULL)
+    {
+        char *entry = next;
+        Pattern *p = &sel->patterns[sel->npatterns];
+        int part;
+
+        next = strchr(entry, ',');
+        if(next != NULL)
+        {
+            *next++ = '\0';
+        }
+
+        entry += strspn(entry, " \t");
+        p->exclude = (*entry == '-');
+        if(p->exclude)
+        {
+            entry++;
+        }
+        if(*entry == '\0')
+        {
+            continue;
+        }
+
+        for(part = PART_SUITE; part <= PART_TEST; part++)
+        {
+            char *end = part < PART_TEST ? strchr(entry, ':') : NULL;
+            char *trim;
+
+            if(end != NULL)
+            {
+                *end = '\0';
+            }
+            entry += strspn(entry, " \t");
+            for(trim = entry + strlen(entry);
+                trim > entry && (trim[-1] == ' ' || trim[-1] == '\t');
+                trim--)
+            {
+                trim[-1] = '\0';
+            }
+
+            if(*entry == '\0' || strcmp(entry, "*") == 0)
+            {
+                p->parts[part] = NULL;
+                p->literal[part] = 0;
+            }
+            else
+            {
+                p->parts[part] = entry;
+                p->literal[part] = strpbrk(entry, "*?") == NULL;
+            }
+            entry = end != NULL ? end + 1 : NULL;
+            if(entry == NULL)
+            {
+                for(part++; part <= PART_TEST; part++)
+                {
+                    p->parts[part] = NULL;
+                    p->literal[part] = 0;
+                }
+            }
+        }
+
+        if(p->parts[PART_TEST] != NULL)
+        {
+            sel->test_level = 1;
+        }
+        if(!p->exclude)
+        {
+            sel->nincludes++;
+        }
+        sel->npatterns++;
+    }
+
+    return buf + len + 1;
+}
+
+/* Tags are separated by whitespace or commas */
+static char *selection_parse_tags(char *buf, char ***tags, int *ntags)
+{
+    static const char sep[] = " \t\n,";
+    size_t len = strlen(buf);
+    char *tag = buf;
+
+    *tags = (char **)emalloc((len / 2 + 1) * sizeof(char *));
+    *ntags = 0;
+    for(;;)
+    {
+        size_t tag_len;
+
+        tag += strspn(tag, sep);
+        if(*tag == '\0')
+        {
+            break;
+        }
+        tag_len = strcspn(tag, sep);
+        (*tags)[(*ntags)++] = tag;
+        if(tag[tag_len] == '\0')
+        {
+            break;
+        }
+        tag[tag_len] = '\0';
+        tag += tag_len + 1;
+    }
+
+    return buf + len + 1;
+}
+
+/*
+ * Without test case names, patterns or tags, every test case of the
+ * named suite or of all suites is run, and a suite without test cases
+ * is still logged.
+ */
+static void selection_all(Selection * sel)
+{
+    TestIndex *idx = sel->index;
+    IndexEntry *e = NULL;
+    int nsuites = idx->nsuites;
+    int k;
+
+    if(sel->sname != NULL)
+    {
+        e = index_entry(idx, INDEX_SUITE, sel->sname, 0);
+        nsuites = e != NULL ? (int)e->nitems : 0;
+    }
+
+    sel->selected = (SelectedTCase *)emalloc((idx->ntcases + nsuites + 1) *
+                                             sizeof(SelectedTCase));
+    for(k = 0; k < nsuites; k++)
+    {
+        SuiteInfo *si = &idx->suites[e != NULL ? e->items[k] : k];
+        int i;
+
+        if(si->ntcases == 0)
+        {
+            SelectedTCase *st = &sel->selected[sel->nselected++];
+
+            st->s = si->s;
+            st->tc = NULL;
+            st->suite_no = (int)(si - idx->suites);
+        }
+        for(i = 0; i < si->ntcases; i++)
+        {
+            sel->selected[sel->nselected++] = idx->tcases[si->first + i];
+        }
+    }
+}
+
+/*
+ * The numbers of the test cases which may be selected, from the index
+ * where the names or tags allow it, possibly with duplicates.
+ */
+static int *selection_candidates(Selection * sel, size_t * ncand)
+{
+    TestIndex *idx = sel->index;
+    size_t max_cand = 0;
+    int *cand = NULL;
+    int i;
+
+    *ncand = 0;
+    if(sel->tcname != NULL)
+    {
+        cand = add_entry_items(cand, ncand, &max_cand,
+                         index_entry(idx, INDEX_TCASE, sel->tcname, 0));
+    }
+    else if(sel->sname != NULL)
+    {
+        IndexEntry *e = index_entry(idx, INDEX_SUITE, sel->sname, 0);
+        size_t k;
+
+        for(k = 0; e != NULL && k < e->nitems; k++)
+        {
+            cand = add_suite_tcases(sel, e->items[k], cand, ncand,
+                                    &max_cand);
+        }
+    }
+    else if(sel->nincludes > 0)
+    {
+        for(i = 0; i < sel->npatterns; i++)
+        {
+            Pattern *p = &sel->patterns[i];
+            IndexEntry *e;
+            size_t k;
+
+            if(p->exclude)
+            {
+                continue;
+            }
+            if(p->literal[PART_TCASE])
+            {
+                cand = add_entry_items(cand, ncand, &max_cand,
+                                 index_entry(idx, INDEX_TCASE,
+                                             p->parts[PART_TCASE], 0));
+            }
+            else if(p->literal[PART_SUITE])
+            {
+                e = index_entry(idx, INDEX_SUITE, p->parts[PART_SUITE], 0);
+                for(k = 0; e != NULL && k < e->nitems; k++)
+                {
+                    cand = add_suite_tcases(sel, e->items[k], cand, ncand,
+                                            &max_cand);
+                }
+            }
+            else if(p->literal[PART_TEST])
+            {
+                cand = add_entry_items(cand, ncand, &max_cand,
+                                 index_entry(idx, INDEX_TEST,
+                                             p->parts[PART_TEST], 0));
+            }
+            else
+            {
+                /* Only a pattern with wildcards in every name needs all */
+                int n;
+
+                for(n = 0; n < idx->nsuites; n++)
+                {
+                    cand = add_suite_tcases(sel, n, cand, ncand, &max_cand);
+                }
+                break;
+            }
+        }
+    }
+    else if(sel->ninclude_tags > 0)
+    {
+        for(i = 0; i < sel->ninclude_tags; i++)
+        {
+            cand = add_entry_items(cand, ncand, &max_cand,
+                             index_entry(idx, INDEX_TAG,
+                                         sel->include_tags[i], 0));
+        }
+    }
+    else
+    {
+        for(i = 0; i < idx->nsuites; i++)
+        {
+            cand = add_suite_tcases(sel, i, cand, ncand, &max_cand);
+        }
+    }
+
+    return cand;
+}
+
+static int *add_suite_tcases(Selection * sel, int suite_no, int *cand,
+                             size_t * ncand, size_t * max_cand)
+{
+    TestIndex *idx = sel->index;
+    SuiteInfo *si = &idx->suites[suite_no];
+    int i;
+
+    for(i = 0; i < si->ntcases; i++)
+    {
+        cand = add_item(cand, ncand, max_cand, si->first + i);
+    }
+    return cand;
+}
+
+static int *add_item(int *items, size_t * n, size_t * max, int item)
+{
+    if(*n == *max)
+    {
+        *max = 2 * *max + 8;
+        items = (int *)erealloc(items, *max * sizeof(int));
+    }
+    items[(*n)++] = item;
+    return items;
+}
+
+/* Append the items of an index entry, if there is one */
+static int *add_entry_items(int *items, size_t * n, size_t * max,
+                            IndexEntry * e)
+{
+    if(e == NULL || e->nitems == 0)
+    {
+        return items;
+    }
+    if(*n + e->nitems > *max)
+    {
+        *max = 2 * (*n + e->nitems) + 8;
+        items = (int *)erealloc(items, *max * sizeof(int));
+    }
+    memcpy(items + *n, e->items, e->nitems * sizeof(int));
+    *n += e->nitems;
+    return items;
+}
+
+/* Whether a candidate meets every criterion and has a selected test */
+static int selects_tcase(Selection * sel, SelectedTCase * st)
+{
+    int included = sel->nincludes == 0;
+    List *tfl;
+    int i;
+
+    if((sel->sname != NULL && strcmp(sel->sname, st->s->name) != 0)
+       || (sel->tcname != NULL && strcmp(sel->tcname, st->tc->name) != 0))
+    {
+        return 0;
+    }
+    if((sel->ninclude_tags > 0
+        && !tcase_has_tag(st->tc, sel->include_tags, sel->ninclude_tags))
+       || tcase_has_tag(st->tc, sel->exclude_tags, sel->nexclude_tags))
+    {
+        return 0;
+    }
+
+    for(i = 0; i < sel->npatterns; i++)
+    {
+        Pattern *p = &sel->patterns[i];
+
+        if(!pattern_matches(p, st->s, st->tc, NULL))
+        {
+            continue;
+        }
+        if(!p->exclude)
+        {
+            included = 1;
+        }
+        else if(p->parts[PART_TEST] == NULL)
+        {
+            return 0;
+        }
+    }
+    if(!included)
+    {
+        return 0;
+    }
+    if(!sel->test_level)
+    {
+        return 1;
+    }
+
+    tfl = st->tc->tflst;
+    for(check_list_front(tfl); !check_list_at_end(tfl);
+        check_list_advance(tfl))
+    {
+        if(selection_selects(sel, st->s, st->tc,
+                             (TF *)check_list_val(tfl)))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Without a test, only the names of the suite and test case count */
+static int pattern_matches(Pattern * p, Suite * s, TCase * tc, TF * tfun)
+{
+    const char *names[3];
+    int part;
+
+    names[PART_SUITE] = s->name;
+    names[PART_TCASE] = tc->name;
+    names[PART_TEST] = tfun != NULL ? tfun->name : NULL;
+
+    for(part = PART_SUITE; part <= PART_TEST; part++)
+    {
+        if(p->parts[part] == NULL || names[part] == NULL)
+        {
+            continue;
+        }
+        if(p->literal[part] ? strcmp(p->parts[part], names[part]) != 0
+           : !glob_match(p->parts[part], names[part]))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int tcase_has_tag(TCase * tc, char **tags, int ntags)
+{
+    List *tl = tc->tags;
+    int i;
+
+    if(ntags == 0)
+    {
+        return 0;
+    }
+
+    for(check_list_front(tl); !check_list_at_end(tl);
+        check_list_advance(tl))
+    {
+        const char *tag = (const char *)check_list_val(tl);
+
+        for(i = 0; i < ntags; i++)
+        {
+            if(strcmp(tag, tags[i]) == 0)
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* '*' matches any string and '?' any character */
+static int glob_match(const char *pattern, const char *name)
+{
+    const char *star = NULL;
+    const char *retry = NULL;
+
+    while(*name != '\0')
+    {
+        if(*pattern == '*')
+        {
+            star = ++pattern;
+            retry = name;
+        }
+        else if(*pattern == '?' || *pattern == *name)
+        {
+            pattern++;
+            name++;
+        }
+        else if(star != NULL)
+        {
+            pattern = star;
+            name = ++retry;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    while(*pattern == '*')
+    {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+static int int_cmp(const void *a, const void *b)
+{
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+
+    return ia < ib ? -1 : ia > ib;
+}
+
+/* Look up the entry of a name, or add it if 'add' is set */
+static IndexEntry *index_entry(TestIndex * idx, enum index_kind kind,
+                               const char *name, int add)
+{
+    size_t i;
+
+    if(add && 2 * (idx->used + 1) > idx->size)
+    {
+        index_grow(idx);
+    }
+
+    for(i = hash_name(kind, name) & (idx->size - 1);
+        idx->entries[i].name != NULL; i = (i + 1) & (idx->size - 1))
+    {
+        if(idx->entries[i].kind == (int)kind
+           && strcmp(idx->entries[i].name, name) == 0)
+        {
+            return &idx->entries[i];
+        }
+    }
+
+    if(!add)
+    {
+        return NULL;
+    }
+    idx->entries[i].name = name;
+    idx->entries[i].kind = kind;
+    idx->used++;
+    return &idx->entries[i];
+}
+
+/*
+ * The items are added in increasing order, so that a test case with a
+ * tag or test name twice is listed once
+ */
+static void index_add_item(TestIndex * idx, enum index_kind kind,
+                           const char *name, int item)
+{
+    IndexEntry *e = index_entry(idx, kind, name, 1);
+
+    if(e->nitems == 0 || e->items[e->nitems - 1] != item)
+    {
+        e->items = add_item(e->items, &e->nitems, &e->max_items, item);
+    }
+}
+
+static void index_grow(TestIndex * idx)
+{
+    IndexEntry *old = idx->entries;
+    size_t old_size = idx->size;
+    size_t i;
+
+    idx->size *= 2;
+    idx->entries = (IndexEntry *)emalloc(idx->size * sizeof(IndexEntry));
+    memset(idx->entries, 0, idx->size * sizeof(IndexEntry));
+    for(i = 0; i < old_size; i++)
+    {
+        if(old[i].name != NULL)
+        {
+            size_t k;
+
+            for(k = hash_name(old[i].kind, old[i].name) & (idx->size - 1);
+                idx->entries[k].name != NULL; k = (k + 1) & (idx->size - 1))
+            {
+            }
+            idx->entries[k] = old[i];
+        }
+    }
+    free(old);
+}
+
+/* FNV-1a of the kind and the name */
+static size_t hash_name(int kind, const char *name)
+{
+    const unsigned char *p = (const unsigned char *)name;
+    uint32_t hash = 2166136261U;
+
+    hash ^= (unsigned char)kind;
+    hash *= 16777619U;
+    for(; *p != '\0'; p++)
+    {
+        hash ^= *p;
+        hash *= 16777619U;
+    }
+    return hash;
+}
@@ -0,0 +1,78 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_SELECT_H
+#define CHECK_SELECT_H
+
+/*
+ * The suites, test cases and tests of a runner, numbered in its order
+ * and indexed by suite, test case and test name and by tag. The index
+ * is built as suites are added to the runner, and kept between runs.
+ */
+typedef struct TestIndex TestIndex;
+
+/*
+ * The tests selected for a run: by the suite and test case names
+ * passed to srunner_run(), by the patterns of srunner_set_filter() and
+ * by the tags of srunner_set_tags(). The patterns are parsed once, and
+ * the test cases are looked up in the index where the pattern allows
+ * it, so that selecting a few tests of many does not compare every
+ * name with every pattern.
+ */
+typedef struct Selection Selection;
+
+/* A test case to run, or a suite without test cases if tc is NULL */
+typedef struct SelectedTCase
+{
+    Suite *s;
+    TCase *tc;
+    int suite_no;               /* the position of the suite in the runner */
+} SelectedTCase;
+
+TestIndex *test_index_create(void);
+
+void test_index_add_suite(TestIndex * idx, Suite * s);
+
+/*
+ * A test case, test or tag was added to a suite, which may be indexed
+ * already. The indexes are then built again at their next run.
+ */
+void test_index_changed(void);
+
+void test_index_free(TestIndex * idx);
+
+/*
+ * The suites are those of the runner, which the index is brought up
+ * to date with. Any of the strings may be NULL, to select everything.
+ */
+Selection *selection_create(TestIndex * idx, List * slst,
+                            const char *sname, const char *tcname,
+                            const char *filter, const char *include_tags,
+                            const char *exclude_tags);
+
+void selection_free(Selection * sel);
+
+/* The selected test cases, in the order of the suite runner */
+SelectedTCase *selection_tcases(Selection * sel, size_t * n);
+
+/* Whether a test of a selected test case is selected */
+int selection_selects(Selection * sel, Suite * s, TCase * tc, TF * tfun);
+
+#endif /* CHECK_SELECT_H */
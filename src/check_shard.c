@@ -0,0 +1,266 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check_error.h"
+#include "check_history.h"
+#include "check_shard.h"
+
+typedef struct ShardTest
+{
+    uint64_t key;               /* see history_key() */
+    const char *sname;
+    const char *tcname;
+    const char *tname;
+    int iter;
+    int estimate;               /* the median duration in us, or -1 */
+    int shard;
+} ShardTest;
+
+struct Shard
+{
+    int index;
+    int count;
+    ShardTest *tests;           /* in the order in which they run */
+    size_t ntests;
+    size_t max_tests;
+    ShardTest **by_key;         /* the tests sorted by key, once assigned */
+    size_t nselected;
+};
+
+static int shard_of_key(uint64_t key, int count);
+static int test_cmp_estimate(const void *a, const void *b);
+static int test_cmp_key(const void *a, const void *b);
+
+Shard *shard_create(int index, int count)
+{
+    Shard *sh = (Shard *)emalloc(sizeof(Shard));
+
+    sh->index = index;
+    sh->count = count;
+    sh->tests = NULL;
+    sh->ntests = 0;
+    sh->max_tests = 0;
+    sh->by_key = NULL;
+    sh->nselected = 0;
+    return sh;
+}
+
+void shard_free(Shard * sh)
+{
+    free(sh->tests);
+    free(sh->by_key);
+    free(sh);
+}
+
+void shard_add(Shard * sh, const char *sname, const char *tcname,
+               const char *tname, int iter, int estimate)
+{
+    ShardTest *t;
+
+    if(sh->ntests == sh->max_tests)
+    {
+        sh->max_tests = 2 * sh->max_tests + 64;
+        sh->tests = (ShardTest *)erealloc(sh->tests,
+                                          sh->max_tests * sizeof(ShardTest));
+    }
+
+    t = &sh->tests[sh->ntests++];
+    t->key = history_key(sname, tcname, tname, iter);
+    t->sname = sname;
+    t->tcname = tcname;
+    t->tname = tname;
+    t->iter = iter;
+    t->estimate = estimate;
+    t->shard = -1;
+}
+
+void shard_assign(Shard * sh)
+{
+    ShardTest **known;
+    uint64_t *load;
+    size_t nknown = 0;
+    size_t i;
+
+    free(sh->by_key);
+    sh->by_key = (ShardTest **)emalloc((sh->ntests + 1) *
+                                       sizeof(ShardTest *));
+    known = (ShardTest **)emalloc((sh->ntests + 1) * sizeof(ShardTest *));
+    load = (uint64_t *)emalloc(sh->count * sizeof(uint64_t));
+    memset(load, 0, sh->count * sizeof(uint64_t));
+
+    for(i = 0; i < sh->ntests; i++)
+    {
+        ShardTest *t = &sh->tests[i];
+
+        sh->by_key[i] = t;
+        if(t->estimate >= 0)
+        {
+            known[nknown++] = t;
+        }
+        else
+        {
+            t->shard = shard_of_key(t->key, sh->count);
+        }
+    }
+
+    /*
+     * The longest test goes to the shard with the least time so far.
+     * The order only depends on the names and the durations, so every
+     * shard comes to the same result.
+     */
+    qsort(known, nknown, sizeof(ShardTest *), test_cmp_estimate);
+    for(i = 0; i < nknown; i++)
+    {
+        int best = 0;
+        int k;
+
+        /* A test added twice has one key, and goes with the first */
+        if(i > 0 && known[i]->key == known[i - 1]->key)
+        {
+            known[i]->shard = known[i - 1]->shard;
+            continue;
+        }
+
+        for(k = 1; k < sh->count; k++)
+        {
+            if(load[k] < load[best])
+            {
+                best = k;
+            }
+        }
+        known[i]->shard = best;
+        load[best] += known[i]->estimate;
+    }
+
+    sh->nselected = 0;
+    for(i = 0; i < sh->ntests; i++)
+    {
+        if(sh->tests[i].shard == sh->index)
+        {
+            sh->nselected++;
+        }
+    }
+
+    qsort(sh->by_key, sh->ntests, sizeof(ShardTest *), test_cmp_key);
+    free(load);
+    free(known);
+}
+
+int shard_selects(Shard * sh, const char *sname, const char *tcname,
+                  const char *tname, int iter)
+{
+    uint64_t key = history_key(sname, tcname, tname, iter);
+    size_t lo = 0;
+    size_t hi = sh->ntests;
+
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if(sh->by_key[mid]->key < key)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return lo < sh->ntests && sh->by_key[lo]->key == key
+        && sh->by_key[lo]->shard == sh->index;
+}
+
+int shard_save(Shard * sh, const char *fname)
+{
+    FILE *f;
+    size_t i;
+    int rval = 0;
+
+    f = fopen(fname, "w");
+    if(f == NULL)
+    {
+        return -1;
+    }
+
+    /*
+     * One line per test, with tabs between the names. The lines of all
+     * the shards together name every test of the run once.
+     */
+    fprintf(f, "# Check shard %d of %d: %lu of %lu tests\n", sh->index,
+            sh->count, (unsigned long)sh->nselected,
+            (unsigned long)sh->ntests);
+    for(i = 0; i < sh->ntests; i++)
+    {
+        ShardTest *t = &sh->tests[i];
+
+        if(t->shard == sh->index)
+        {
+            fprintf(f, "%s\t%s\t%s\t%d\n", t->sname, t->tcname, t->tname,
+                    t->iter);
+        }
+    }
+
+    if(ferror(f))
+    {
+        rval = -1;
+    }
+    if(fclose(f) != 0)
+    {
+        rval = -1;
+    }
+    return rval;
+}
+
+static int shard_of_key(uint64_t key, int count)
+{
+    return (int)((key ^ (key >> 32)) % (uint64_t)count);
+}
+
+/* The longest first, ties by key */
+static int test_cmp_estimate(const void *a, const void *b)
+{
+    const ShardTest *ta = *(ShardTest * const *)a;
+    const ShardTest *tb = *(ShardTest * const *)b;
+
+    if(ta->estimate != tb->estimate)
+    {
+        return ta->estimate > tb->estimate ? -1 : 1;
+    }
+    return test_cmp_key(a, b);
+}
+
+static int test_cmp_key(const void *a, const void *b)
+{
+    const ShardTest *ta = *(ShardTest * const *)a;
+    const ShardTest *tb = *(ShardTest * const *)b;
+
+    if(ta->key != tb->key)
+    {
+        return ta->key < tb->key ? -1 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_SHARD_H
+#define CHECK_SHARD_H
+
+/*
+ * The tests of one shard of a run (see srunner_set_shard()). All the
+ * tests of the run are added, then assigned to the shards, the same
+ * way in every shard.
+ */
+typedef struct Shard Shard;
+
+Shard *shard_create(int index, int count);
+
+void shard_free(Shard * sh);
+
+/* A test of the run, with its median duration in us or -1 */
+void shard_add(Shard * sh, const char *sname, const char *tcname,
+               const char *tname, int iter, int estimate);
+
+/*
+ * Assign the tests to the shards. Tests with a known duration are
+ * spread so that the shards take about the same time, the others by
+ * the hash of their names.
+ */
+void shard_assign(Shard * sh);
+
+/* Whether a test belongs to this shard, once assigned */
+int shard_selects(Shard * sh, const char *sname, const char *tcname,
+                  const char *tname, int iter);
+
+/*
+ * Write the tests of this shard and the number of tests of the run to
+ * a file. Returns 0 on success, or -1 with errno set.
+ */
+int shard_save(Shard * sh, const char *fname);
+
+#endif /* CHECK_SHARD_H */
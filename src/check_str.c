@@ -67,9 +67,19 @@ char *sr_stat_str(SRunner * sr)
 
     ts = sr->stats;
 
-    str = ck_strdup_printf("%d%%: Checks: %d, Failures: %d, Errors: %d",
-                           percent_passed(ts), ts->n_checked, ts->n_failed,
-                           ts->n_errors);
+    if(ts->n_skipped > 0)
+    {
+        str = ck_strdup_printf("%d%%: Checks: %d, Failures: %d, Errors: %d, "
+                               "Skipped: %d", percent_passed(ts),
+                               ts->n_checked, ts->n_failed, ts->n_errors,
+                               ts->n_skipped);
+    }
+    else
+    {
+        str = ck_strdup_printf("%d%%: Checks: %d, Failures: %d, Errors: %d",
+                               percent_passed(ts), ts->n_checked,
+                               ts->n_failed, ts->n_errors);
+    }
 
     return str;
 }
@@ -0,0 +1,759 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+#include "check_error.h"
+#include "check_list.h"
+#include "check_impl.h"
+#include "check_supervisor.h"
+
+#if defined(HAVE_FORK) && HAVE_FORK==1
+
+/*
+ * On Linux the supervisor sleeps in epoll_wait() on
+ * - a pidfd for each running test, which becomes readable once the
+ *   test process exits, or a signalfd for SIGCHLD on kernels without
+ *   pidfd_open(),
+ * - a single timerfd, armed for the earliest deadline of all tests.
+ * Elsewhere it sleeps in poll() on a pipe which a SIGCHLD handler
+ * writes to, with the time until the earliest deadline as timeout.
+ *
+ * The deadlines are kept in a binary min-heap of slots, so adding,
+ * expiring and removing a test is O(log n).
+ */
+#if HAVE_SYS_EPOLL_H && HAVE_SYS_TIMERFD_H && HAVE_SYS_SIGNALFD_H
+#define CK_SUPERVISOR_EPOLL 1
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+#include <sys/syscall.h>
+#else
+#define CK_SUPERVISOR_EPOLL 0
+#include <poll.h>
+#endif
+
+/* The resources used by a test are taken when it is reaped */
+#if HAVE_WAIT4 && HAVE_SYS_RESOURCE_H
+#define CK_SUPERVISOR_RUSAGE 1
+#include <sys/resource.h>
+#else
+#define CK_SUPERVISOR_RUSAGE 0
+#endif
+
+/* Maximum number of events taken from one epoll_wait() call */
+#define CK_SV_EVENTS 64
+
+/* epoll tokens which are not slots */
+#define CK_SV_TOKEN_TIMER 0
+#define CK_SV_TOKEN_SIGNAL 1
+#define CK_SV_TOKEN_WATCH 2
+#define CK_SV_TOKEN_SLOT 3
+
+typedef struct SvChild
+{
+    pid_t pid;                  /* 0 while the slot is free */
+    int reaped;                 /* pid has exited, not reported yet */
+    int status;
+    int timed_out;
+    struct timespec deadline;
+    int heap_pos;               /* position in the deadline heap, or -1 */
+    int pidfd;                  /* -1 unless pidfds are used */
+#if CK_SUPERVISOR_RUSAGE
+    struct rusage rusage;       /* once reaped */
+#endif
+} SvChild;
+
+struct Supervisor
+{
+    SvChild *children;
+    int nslots;
+    int running;                /* number of children not reaped yet */
+    int *heap;                  /* slots with a deadline, earliest first */
+    int nheap;
+    int *done;                  /* ring of reaped slots, in reaping order */
+    int done_head;
+    int ndone;
+    int watch_fd;               /* see supervisor_watch(), -1 if none */
+    int watch_ready;
+#if CK_SUPERVISOR_EPOLL
+    int epfd;
+    int timerfd;
+    struct timespec armed;      /* expiration of timerfd, 0 if disarmed */
+    int use_pidfd;
+    int sigfd;                  /* -1 if pidfds are used */
+    sigset_t old_mask;
+#else
+    int wake_pipe[2];
+    int old_wake_fd;
+    struct sigaction old_action;
+#endif
+};
+
+static void sv_reap(Supervisor * sv, int slot);
+static int sv_expire(Supervisor * sv);
+static void sv_wait_events(Supervisor * sv);
+static void sv_kill(pid_t pid, int sig);
+static int ts_cmp(const struct timespec *a, const struct timespec *b);
+static void heap_swap(Supervisor * sv, int i, int j);
+static void heap_up(Supervisor * sv, int i);
+static void heap_down(Supervisor * sv, int i);
+static void heap_push(Supervisor * sv, int slot);
+static void heap_remove(Supervisor * sv, int slot);
+#if CK_SUPERVISOR_EPOLL
+static int sv_pidfd_open(pid_t pid);
+static void sv_epoll_add(Supervisor * sv, int fd, unsigned int token);
+static void sv_arm_timer(Supervisor * sv, int force);
+#else
+static void sv_sigchld_handler(int sig);
+static int sv_next_timeout(Supervisor * sv);
+
+/* Write end of the pipe of the current supervisor, for the handler */
+static volatile int sv_wake_fd = -1;
+#endif
+
+Supervisor *supervisor_create(int nslots)
+{
+    Supervisor *sv = (Supervisor *)emalloc(sizeof(Supervisor));
+    int i;
+
+    sv->children = (SvChild *)emalloc(nslots * sizeof(SvChild));
+    sv->nslots = nslots;
+    sv->running = 0;
+    sv->heap = (int *)emalloc(nslots * sizeof(int));
+    sv->nheap = 0;
+    sv->done = (int *)emalloc(nslots * sizeof(int));
+    sv->done_head = 0;
+    sv->ndone = 0;
+    sv->watch_fd = -1;
+    sv->watch_ready = 0;
+    for(i = 0; i < nslots; i++)
+    {
+        sv->children[i].pid = 0;
+        sv->children[i].heap_pos = -1;
+        sv->children[i].pidfd = -1;
+    }
+
+#if CK_SUPERVISOR_EPOLL
+    sv->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if(sv->epfd == -1)
+        eprintf("Error in call to epoll_create1:", __FILE__, __LINE__ - 2);
+
+    sv->timerfd = timerfd_create(check_get_clockid(),
+                                 TFD_NONBLOCK | TFD_CLOEXEC);
+    if(sv->timerfd == -1)
+        eprintf("Error in call to timerfd_create:", __FILE__, __LINE__ - 3);
+    sv->armed.tv_sec = 0;
+    sv->armed.tv_nsec = 0;
+    sv_epoll_add(sv, sv->timerfd, CK_SV_TOKEN_TIMER);
+
+    sv->sigfd = -1;
+    sv->use_pidfd = 0;
+    i = sv_pidfd_open(getpid());
+    if(i != -1)
+    {
+        close(i);
+        sv->use_pidfd = 1;
+    }
+    else
+    {
+        sigset_t mask;
+
+        /* SIGCHLD is only delivered through the signalfd */
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &mask, &sv->old_mask);
+        sv->sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if(sv->sigfd == -1)
+            eprintf("Error in call to signalfd:", __FILE__, __LINE__ - 2);
+        sv_epoll_add(sv, sv->sigfd, CK_SV_TOKEN_SIGNAL);
+    }
+#else
+    {
+        struct sigaction sigchld_new_action;
+
+        if(pipe(sv->wake_pipe) != 0)
+            eprintf("Error in call to pipe:", __FILE__, __LINE__ - 1);
+        for(i = 0; i < 2; i++)
+        {
+            fcntl(sv->wake_pipe[i], F_SETFL,
+                  fcntl(sv->wake_pipe[i], F_GETFL) | O_NONBLOCK);
+            fcntl(sv->wake_pipe[i], F_SETFD, FD_CLOEXEC);
+        }
+        sv->old_wake_fd = sv_wake_fd;
+        sv_wake_fd = sv->wake_pipe[1];
+
+        memset(&sigchld_new_action, 0, sizeof(sigchld_new_action));
+        sigchld_new_action.sa_handler = sv_sigchld_handler;
+        sigchld_new_action.sa_flags = SA_NOCLDSTOP;
+        sigaction(SIGCHLD, &sigchld_new_action, &sv->old_action);
+    }
+#endif /* CK_SUPERVISOR_EPOLL */
+
+    return sv;
+}
+
+void supervisor_free(Supervisor * sv)
+{
+    int i;
+
+    for(i = 0; i < sv->nslots; i++)
+    {
+        if(sv->children[i].pidfd != -1)
+        {
+            close(sv->children[i].pidfd);
+        }
+    }
+#if CK_SUPERVISOR_EPOLL
+    close(sv->epfd);
+    close(sv->timerfd);
+    if(sv->sigfd != -1)
+    {
+        close(sv->sigfd);
+        sigprocmask(SIG_SETMASK, &sv->old_mask, NULL);
+    }
+#else
+    sigaction(SIGCHLD, &sv->old_action, NULL);
+    sv_wake_fd = sv->old_wake_fd;
+    close(sv->wake_pipe[0]);
+    close(sv->wake_pipe[1]);
+#endif /* CK_SUPERVISOR_EPOLL */
+
+    free(sv->children);
+    free(sv->heap);
+    free(sv->done);
+    free(sv);
+}
+
+void supervisor_add(Supervisor * sv, int slot, pid_t pid,
+                    const struct timespec *timeout)
+{
+    SvChild *c = &sv->children[slot];
+
+    if(c->pid != 0)
+        eprintf("Slot %d is in use", __FILE__, __LINE__ - 1, slot);
+
+    /* The test does this too, but it may not have run yet */
+    setpgid(pid, pid);
+
+    c->pid = pid;
+    c->reaped = 0;
+    c->status = 0;
+    c->timed_out = 0;
+    c->pidfd = -1;
+    sv->running++;
+
+#if CK_SUPERVISOR_EPOLL
+    if(sv->use_pidfd)
+    {
+        c->pidfd = sv_pidfd_open(pid);
+        if(c->pidfd == -1)
+            eprintf("Error in call to pidfd_open:", __FILE__, __LINE__ - 2);
+        sv_epoll_add(sv, c->pidfd, CK_SV_TOKEN_SLOT + slot);
+    }
+#endif /* CK_SUPERVISOR_EPOLL */
+
+    supervisor_set_timeout(sv, slot, timeout);
+}
+
+void supervisor_set_timeout(Supervisor * sv, int slot,
+                            const struct timespec *timeout)
+{
+    SvChild *c = &sv->children[slot];
+
+    if(c->heap_pos != -1)
+    {
+        heap_remove(sv, slot);
+    }
+    if(c->reaped || (timeout->tv_sec == 0 && timeout->tv_nsec == 0))
+    {
+        return;
+    }
+
+    clock_gettime(check_get_clockid(), &c->deadline);
+    c->deadline.tv_sec += timeout->tv_sec;
+    c->deadline.tv_nsec += timeout->tv_nsec;
+    if(c->deadline.tv_nsec >= 1000000000)
+    {
+        c->deadline.tv_sec++;
+        c->deadline.tv_nsec -= 1000000000;
+    }
+    heap_push(sv, slot);
+#if CK_SUPERVISOR_EPOLL
+    sv_arm_timer(sv, 0);
+#endif
+}
+
+int supervisor_wait(Supervisor * sv, int *status, int *timed_out)
+{
+    SvChild *c;
+    int slot;
+
+    while(sv->ndone == 0)
+    {
+        if(sv->watch_ready)
+        {
+            sv->watch_ready = 0;
+            return SUPERVISOR_READABLE;
+        }
+        if(sv->running == 0 && sv->watch_fd == -1)
+        {
+            return -1;
+        }
+        sv_wait_events(sv);
+    }
+
+    slot = sv->done[sv->done_head];
+    sv->done_head = (sv->done_head + 1) % sv->nslots;
+    sv->ndone--;
+
+    c = &sv->children[slot];
+    *status = c->status;
+    *timed_out = c->timed_out;
+    c->pid = 0;
+
+    return slot;
+}
+
+void supervisor_watch(Supervisor * sv, int fd)
+{
+#if CK_SUPERVISOR_EPOLL
+    if(sv->watch_fd != -1)
+    {
+        epoll_ctl(sv->epfd, EPOLL_CTL_DEL, sv->watch_fd, NULL);
+    }
+    if(fd != -1)
+    {
+        sv_epoll_add(sv, fd, CK_SV_TOKEN_WATCH);
+    }
+#endif /* CK_SUPERVISOR_EPOLL */
+    sv->watch_fd = fd;
+    sv->watch_ready = 0;
+}
+
+int supervisor_running(Supervisor * sv)
+{
+    return sv->running + sv->ndone;
+}
+
+void supervisor_rusage(Supervisor * sv, int slot, TestRusage * ru)
+{
+#if CK_SUPERVISOR_RUSAGE
+    const struct rusage *r = &sv->children[slot].rusage;
+
+    ru->utime = (long)r->ru_utime.tv_sec * 1000000 + r->ru_utime.tv_usec;
+    ru->stime = (long)r->ru_stime.tv_sec * 1000000 + r->ru_stime.tv_usec;
+    ru->maxrss = r->ru_maxrss;
+    ru->minflt = r->ru_minflt;
+    ru->majflt = r->ru_majflt;
+    ru->nvcsw = r->ru_nvcsw;
+    ru->nivcsw = r->ru_nivcsw;
+    ru->inblock = r->ru_inblock;
+    ru->oublock = r->ru_oublock;
+#else
+    (void)sv;
+    (void)slot;
+    memset(ru, 0, sizeof(TestRusage));
+    ru->utime = -1;
+#endif /* CK_SUPERVISOR_RUSAGE */
+}
+
+void supervisor_kill_all(Supervisor * sv, int sig)
+{
+    int i;
+
+    for(i = 0; i < sv->nslots; i++)
+    {
+        if(sv->children[i].pid != 0 && !sv->children[i].reaped)
+        {
+            sv_kill(sv->children[i].pid, sig);
+        }
+    }
+}
+
+void supervisor_child_init(Supervisor * sv)
+{
+    int i;
+
+    for(i = 0; i < sv->nslots; i++)
+    {
+        if(sv->children[i].pidfd != -1)
+        {
+            close(sv->children[i].pidfd);
+        }
+    }
+#if CK_SUPERVISOR_EPOLL
+    close(sv->epfd);
+    close(sv->timerfd);
+    if(sv->sigfd != -1)
+    {
+        close(sv->sigfd);
+        sigprocmask(SIG_SETMASK, &sv->old_mask, NULL);
+    }
+#else
+    sigaction(SIGCHLD, &sv->old_action, NULL);
+    sv_wake_fd = -1;
+    close(sv->wake_pipe[0]);
+    close(sv->wake_pipe[1]);
+#endif /* CK_SUPERVISOR_EPOLL */
+}
+
+static void sv_reap(Supervisor * sv, int slot)
+{
+    SvChild *c = &sv->children[slot];
+    int status = 0;
+
+    if(c->pid == 0 || c->reaped)
+    {
+        return;
+    }
+#if CK_SUPERVISOR_RUSAGE
+    if(wait4(c->pid, &status, WNOHANG, &c->rusage) != c->pid)
+#else
+    if(waitpid(c->pid, &status, WNOHANG) != c->pid)
+#endif
+    {
+        return;
+    }
+
+    killpg(c->pid, SIGKILL);    /* Kill remaining processes. */
+    c->reaped = 1;
+    c->status = status;
+    if(c->heap_pos != -1)
+    {
+        heap_remove(sv, slot);
+    }
+    if(c->pidfd != -1)
+    {
+        /* Closing it also removes it from the epoll set */
+        close(c->pidfd);
+        c->pidfd = -1;
+    }
+    sv->running--;
+
+    sv->done[(sv->done_head + sv->ndone) % sv->nslots] = slot;
+    sv->ndone++;
+}
+
+/*
+ * Kill the tests whose deadline has passed. Returns the number of
+ * tests killed.
+ */
+static int sv_expire(Supervisor * sv)
+{
+    struct timespec now;
+    int killed = 0;
+
+    clock_gettime(check_get_clockid(), &now);
+    while(sv->nheap > 0)
+    {
+        int slot = sv->heap[0];
+        SvChild *c = &sv->children[slot];
+
+        if(ts_cmp(&c->deadline, &now) > 0)
+        {
+            break;
+        }
+
+        heap_remove(sv, slot);
+        c->timed_out = 1;
+        sv_kill(c->pid, SIGKILL);
+        killed++;
+    }
+
+    return killed;
+}
+
+#if CK_SUPERVISOR_EPOLL
+static void sv_wait_events(Supervisor * sv)
+{
+    struct epoll_event events[CK_SV_EVENTS];
+    int n;
+    int i;
+
+    n = epoll_wait(sv->epfd, events, CK_SV_EVENTS, -1);
+    if(n == -1)
+    {
+        if(errno != EINTR)
+            eprintf("Error in call to epoll_wait:", __FILE__, __LINE__ - 4);
+        return;
+    }
+
+    for(i = 0; i < n; i++)
+    {
+        unsigned int token = events[i].data.u32;
+
+        if(token == CK_SV_TOKEN_TIMER)
+        {
+            uint64_t expirations;
+            ssize_t CK_ATTRIBUTE_UNUSED r;
+
+            r = read(sv->timerfd, &expirations, sizeof(expirations));
+            sv_expire(sv);
+            sv_arm_timer(sv, 1);
+        }
+        else if(token == CK_SV_TOKEN_WATCH)
+        {
+            sv->watch_ready = 1;
+        }
+        else if(token == CK_SV_TOKEN_SIGNAL)
+        {
+            struct signalfd_siginfo info;
+            int slot;
+
+            while(read(sv->sigfd, &info, sizeof(info)) == sizeof(info))
+            {
+                /* Drain, SIGCHLDs may have been merged anyway */
+            }
+            for(slot = 0; slot < sv->nslots; slot++)
+            {
+                sv_reap(sv, slot);
+            }
+        }
+        else
+        {
+            sv_reap(sv, token - CK_SV_TOKEN_SLOT);
+        }
+    }
+}
+
+static int sv_pidfd_open(pid_t pid)
+{
+#if defined(SYS_pidfd_open)
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif /* SYS_pidfd_open */
+}
+
+static void sv_epoll_add(Supervisor * sv, int fd, unsigned int token)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = token;
+    if(epoll_ctl(sv->epfd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        eprintf("Error in call to epoll_ctl:", __FILE__, __LINE__ - 1);
+}
+
+/*
+ * Arm the timer for the earliest deadline. Unless forced, the timer
+ * is left alone if it fires earlier already; it is then armed again
+ * when it fires, which saves a system call for most tests.
+ */
+static void sv_arm_timer(Supervisor * sv, int force)
+{
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    if(sv->nheap > 0)
+    {
+        spec.it_value = sv->children[sv->heap[0]].deadline;
+    }
+
+    if(!force && (sv->armed.tv_sec != 0 || sv->armed.tv_nsec != 0)
+       && ts_cmp(&sv->armed, &spec.it_value) <= 0)
+    {
+        return;
+    }
+
+    if(timerfd_settime(sv->timerfd, TFD_TIMER_ABSTIME, &spec, NULL) != 0)
+        eprintf("Error in call to timerfd_settime:", __FILE__, __LINE__ - 1);
+    sv->armed = spec.it_value;
+}
+#else /* !CK_SUPERVISOR_EPOLL */
+static void sv_wait_events(Supervisor * sv)
+{
+    struct pollfd pfd[2];
+    char buf[64];
+    int slot;
+
+    for(slot = 0; slot < sv->nslots; slot++)
+    {
+        sv_reap(sv, slot);
+    }
+    if(sv->ndone > 0 || sv_expire(sv) > 0)
+    {
+        return;
+    }
+
+    /* A SIGCHLD since the waitpid() calls above makes this return */
+    pfd[0].fd = sv->wake_pipe[0];
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    pfd[1].fd = sv->watch_fd;
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+    if(poll(pfd, sv->watch_fd != -1 ? 2 : 1, sv_next_timeout(sv)) == -1
+       && errno != EINTR)
+        eprintf("Error in call to poll:", __FILE__, __LINE__ - 2);
+    if(pfd[1].revents != 0)
+    {
+        sv->watch_ready = 1;
+    }
+    while(read(sv->wake_pipe[0], buf, sizeof(buf)) > 0)
+    {
+        /* Drain the wake up bytes */
+    }
+}
+
+static void sv_sigchld_handler(int CK_ATTRIBUTE_UNUSED sig)
+{
+    int saved_errno = errno;
+
+    if(sv_wake_fd != -1)
+    {
+        ssize_t CK_ATTRIBUTE_UNUSED r = write(sv_wake_fd, "", 1);
+    }
+    errno = saved_errno;
+}
+
+/* Milliseconds until the earliest deadline, -1 if there is none */
+static int sv_next_timeout(Supervisor * sv)
+{
+    struct timespec now;
+    const struct timespec *deadline;
+    long left;
+
+    if(sv->nheap == 0)
+    {
+        return -1;
+    }
+
+    clock_gettime(check_get_clockid(), &now);
+    deadline = &sv->children[sv->heap[0]].deadline;
+    left = (deadline->tv_sec - now.tv_sec) * 1000
+        + (deadline->tv_nsec - now.tv_nsec + 999999) / 1000000;
+
+    /* Wake up at least once a minute, poll() takes an int */
+    if(left < 0)
+        return 0;
+    return left < 60000 ? (int)left : 60000;
+}
+#endif /* CK_SUPERVISOR_EPOLL */
+
+static void sv_kill(pid_t pid, int sig)
+{
+    /* Kill the whole group, the test may have forked */
+    if(killpg(pid, sig) != 0)
+    {
+        kill(pid, sig);
+    }
+}
+
+static int ts_cmp(const struct timespec *a, const struct timespec *b)
+{
+    if(a->tv_sec != b->tv_sec)
+        return a->tv_sec < b->tv_sec ? -1 : 1;
+    if(a->tv_nsec != b->tv_nsec)
+        return a->tv_nsec < b->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static void heap_swap(Supervisor * sv, int i, int j)
+{
+    int tmp = sv->heap[i];
+
+    sv->heap[i] = sv->heap[j];
+    sv->heap[j] = tmp;
+    sv->children[sv->heap[i]].heap_pos = i;
+    sv->children[sv->heap[j]].heap_pos = j;
+}
+
+static void heap_up(Supervisor * sv, int i)
+{
+    while(i > 0)
+    {
+        int parent = (i - 1) / 2;
+
+        if(ts_cmp(&sv->children[sv->heap[parent]].deadline,
+                  &sv->children[sv->heap[i]].deadline) <= 0)
+        {
+            break;
+        }
+        heap_swap(sv, i, parent);
+        i = parent;
+    }
+}
+
+static void heap_down(Supervisor * sv, int i)
+{
+    for(;;)
+    {
+        int smallest = i;
+        int child = 2 * i + 1;
+
+        if(child < sv->nheap
+           && ts_cmp(&sv->children[sv->heap[child]].deadline,
+                     &sv->children[sv->heap[smallest]].deadline) < 0)
+        {
+            smallest = child;
+        }
+        child++;
+        if(child < sv->nheap
+           && ts_cmp(&sv->children[sv->heap[child]].deadline,
+                     &sv->children[sv->heap[smallest]].deadline) < 0)
+        {
+            smallest = child;
+        }
+        if(smallest == i)
+        {
+            break;
+        }
+        heap_swap(sv, i, smallest);
+        i = smallest;
+    }
+}
+
+static void heap_push(Supervisor * sv, int slot)
+{
+    sv->heap[sv->nheap] = slot;
+    sv->children[slot].heap_pos = sv->nheap;
+    sv->nheap++;
+    heap_up(sv, sv->nheap - 1);
+}
+
+static void heap_remove(Supervisor * sv, int slot)
+{
+    int i = sv->children[slot].heap_pos;
+
+    sv->nheap--;
+    if(i != sv->nheap)
+    {
+        heap_swap(sv, i, sv->nheap);
+        heap_up(sv, i);
+        heap_down(sv, sv->children[sv->heap[i]].heap_pos);
+    }
+    sv->children[slot].heap_pos = -1;
+}
+
+#endif /* HAVE_FORK */
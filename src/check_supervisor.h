@@ -0,0 +1,74 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_SUPERVISOR_H
+#define CHECK_SUPERVISOR_H
+
+/*
+ * Waiting for forked tests and enforcing their timeouts.
+ *
+ * Each running test occupies one of a fixed number of slots. The
+ * supervisor reports which slot finished, with the wait status of
+ * its process and whether it was killed because its timeout expired.
+ */
+typedef struct Supervisor Supervisor;
+
+Supervisor *supervisor_create(int nslots);
+void supervisor_free(Supervisor * sv);
+
+/* Start supervising a forked test, a zero timeout means none */
+void supervisor_add(Supervisor * sv, int slot, pid_t pid,
+                    const struct timespec *timeout);
+
+/*
+ * Restart the timeout of a running test from now, e.g. when a process
+ * which runs several tests starts the next one.
+ */
+void supervisor_set_timeout(Supervisor * sv, int slot,
+                            const struct timespec *timeout);
+
+/* Returned by supervisor_wait() when the watched descriptor is readable */
+#define SUPERVISOR_READABLE -2
+
+/*
+ * Wait until a test has finished. Returns its slot, -1 if no test is
+ * running and no descriptor is watched, or SUPERVISOR_READABLE.
+ */
+int supervisor_wait(Supervisor * sv, int *status, int *timed_out);
+
+/* Also wake up supervisor_wait() when fd is readable, -1 for none */
+void supervisor_watch(Supervisor * sv, int fd);
+
+int supervisor_running(Supervisor * sv);
+
+/*
+ * The resources used by the test which supervisor_wait() returned for
+ * the slot, until another one is added to it. The utime is -1 if they
+ * are not known, on systems without wait4().
+ */
+void supervisor_rusage(Supervisor * sv, int slot, TestRusage * ru);
+
+/* Send a signal to all running tests, safe to call in a signal handler */
+void supervisor_kill_all(Supervisor * sv, int sig);
+
+/* To be called in a forked test, releases what the supervisor holds */
+void supervisor_child_init(Supervisor * sv);
+
+#endif /* CHECK_SUPERVISOR_H */
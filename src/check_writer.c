@@ -0,0 +1,225 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "check_error.h"
+#include "check_writer.h"
+
+/* A block of log output waiting to be written */
+typedef struct Block
+{
+    struct Block *next;
+    int fd;
+    char *buf;
+    size_t len;
+} Block;
+
+struct LogWriter
+{
+    pid_t pid;                  /* the process which created the writer */
+    Block *first;
+    Block *last;
+#ifdef HAVE_PTHREAD
+    int threaded;               /* whether the thread was started */
+    int busy;                   /* the thread writes blocks it took */
+    int stop;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work;        /* signaled when blocks are added */
+    pthread_cond_t idle;        /* signaled when no block is left */
+#endif                          /* HAVE_PTHREAD */
+};
+
+/*
+ * The blocks are written to the file descriptor directly. Nothing is
+ * left in the buffer of the FILE, which forked processes would write
+ * again when they exit.
+ */
+static void block_write(Block * b)
+{
+    size_t done = 0;
+
+    while(done < b->len)
+    {
+        ssize_t n = write(b->fd, b->buf + done, b->len - done);
+
+        if(n < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        done += (size_t)n;
+    }
+    free(b->buf);
+    free(b);
+}
+
+/* Write a chain of blocks in order */
+static void blocks_write(Block * b)
+{
+    while(b != NULL)
+    {
+        Block *next = b->next;
+
+        block_write(b);
+        b = next;
+    }
+}
+
+#ifdef HAVE_PTHREAD
+static void *writer_thread(void *arg)
+{
+    LogWriter *w = (LogWriter *)arg;
+
+    pthread_mutex_lock(&w->lock);
+    for(;;)
+    {
+        Block *b;
+
+        while(w->first == NULL && !w->stop)
+        {
+            pthread_cond_wait(&w->work, &w->lock);
+        }
+        if(w->first == NULL)
+        {
+            break;
+        }
+
+        b = w->first;
+        w->first = w->last = NULL;
+        w->busy = 1;
+        pthread_mutex_unlock(&w->lock);
+
+        blocks_write(b);
+
+        pthread_mutex_lock(&w->lock);
+        w->busy = 0;
+        if(w->first == NULL)
+        {
+            pthread_cond_broadcast(&w->idle);
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+#endif /* HAVE_PTHREAD */
+
+LogWriter *writer_create(int threaded)
+{
+    LogWriter *w = (LogWriter *)emalloc(sizeof(LogWriter));
+
+    w->pid = getpid();
+    w->first = w->last = NULL;
+#ifdef HAVE_PTHREAD
+    w->threaded = 0;
+    w->busy = 0;
+    w->stop = 0;
+    if(threaded)
+    {
+        pthread_mutex_init(&w->lock, NULL);
+        pthread_cond_init(&w->work, NULL);
+        pthread_cond_init(&w->idle, NULL);
+        if(pthread_create(&w->thread, NULL, writer_thread, w) != 0)
+        {
+            eprintf("Error in call to pthread_create:", __FILE__,
+                    __LINE__ - 2);
+        }
+        w->threaded = 1;
+    }
+#else
+    (void)threaded;
+#endif /* HAVE_PTHREAD */
+    return w;
+}
+
+void writer_write(LogWriter * w, FILE * file, char *buf, size_t len)
+{
+    Block *b = (Block *)emalloc(sizeof(Block));
+
+    b->next = NULL;
+    b->fd = fileno(file);
+    b->buf = buf;
+    b->len = len;
+
+#ifdef HAVE_PTHREAD
+    if(w->threaded)
+    {
+        pthread_mutex_lock(&w->lock);
+        if(w->last != NULL)
+            w->last->next = b;
+        else
+            w->first = b;
+        w->last = b;
+        pthread_cond_signal(&w->work);
+        pthread_mutex_unlock(&w->lock);
+        return;
+    }
+#else
+    (void)w;
+#endif /* HAVE_PTHREAD */
+    block_write(b);
+}
+
+void writer_sync(LogWriter * w)
+{
+#ifdef HAVE_PTHREAD
+    if(w->threaded)
+    {
+        pthread_mutex_lock(&w->lock);
+        while(w->first != NULL || w->busy)
+        {
+            pthread_cond_wait(&w->idle, &w->lock);
+        }
+        pthread_mutex_unlock(&w->lock);
+    }
+#else
+    (void)w;
+#endif /* HAVE_PTHREAD */
+}
+
+int writer_owned(LogWriter * w)
+{
+    return w->pid == getpid();
+}
+
+void writer_free(LogWriter * w)
+{
+#ifdef HAVE_PTHREAD
+    if(w->threaded)
+    {
+        pthread_mutex_lock(&w->lock);
+        w->stop = 1;
+        pthread_cond_signal(&w->work);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->thread, NULL);
+
+        pthread_cond_destroy(&w->idle);
+        pthread_cond_destroy(&w->work);
+        pthread_mutex_destroy(&w->lock);
+    }
+#endif /* HAVE_PTHREAD */
+    free(w);
+}
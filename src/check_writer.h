@@ -0,0 +1,46 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_WRITER_H
+#define CHECK_WRITER_H
+
+/*
+ * The writer of buffered logs (see srunner_set_buffered_logs()): the
+ * output of the logs is handed over in blocks, which are written in
+ * order with write(), by a thread of their own if there is one.
+ */
+typedef struct LogWriter LogWriter;
+
+/* A thread is only started if the writer is threaded and threads exist */
+LogWriter *writer_create(int threaded);
+
+/* Write the first len bytes of buf to the file, and free buf */
+void writer_write(LogWriter * w, FILE * file, char *buf, size_t len);
+
+/* Wait until every block handed over has been written */
+void writer_sync(LogWriter * w);
+
+/* Whether the writer was created by this process, and not a parent */
+int writer_owned(LogWriter * w);
+
+/* Write what is left, and stop the thread */
+void writer_free(LogWriter * w);
+
+#endif /* CHECK_WRITER_H */
@@ -0,0 +1,487 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <sys/types.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "check.h"
+#include "check_error.h"
+#include "check_list.h"
+#include "check_impl.h"
+#include "check_msg.h"
+#include "check_supervisor.h"
+#include "check_zygote.h"
+
+#if defined(HAVE_FORK) && HAVE_FORK==1
+#include <sys/socket.h>
+
+/*
+ * The suite runner sends a ZygoteJob over a socket for each test, and
+ * the zygote answers with a ZygoteDone once the test has ended. The
+ * zygote is a fork() of the suite runner, so the pointers in a job are
+ * valid in it. A job without a test case tells the zygote to exit.
+ * Every zygote gets a new socket, so that the suite runner sees the end
+ * of the file if it exits unexpectedly.
+ *
+ * A zygote started for the tests of one test case runs their checked
+ * setup first, and then answers with a ZygoteDone for slot -1. The
+ * tests are forked from the state the setup left behind.
+ *
+ * The zygote keeps up to CK_ZYGOTE_IDLE idle processes forked, each
+ * waiting for a job on its own socket. When a job arrives it is passed
+ * to one of them and a replacement is forked while the test runs.
+ */
+#define CK_ZYGOTE_IDLE 16
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+typedef struct ZygoteJob
+{
+    TCase *tc;
+    TF *tfun;
+    int iter;
+    int slot;
+} ZygoteJob;
+
+typedef struct ZygoteDone
+{
+    int slot;
+    int status;
+    int timed_out;
+    TestRusage rusage;
+} ZygoteDone;
+
+typedef struct Idle
+{
+    pid_t pid;
+    int fd;                     /* socket the process waits on */
+} Idle;
+
+struct Zygote
+{
+    pid_t pid;                  /* 0 while no zygote is running */
+    int fd;                     /* this process' end of the socket, or -1 */
+    Supervisor *runner_sv;      /* the suite runner's, watches fd */
+    int nslots;
+    SRunner *sr;
+    zygote_run_fn run;
+    zygote_setup_fn setup;
+    void (*child_init) (void);
+    TCase *tc;                  /* test case set up in the zygote, or NULL */
+    /* Only used in the zygote */
+    Supervisor *sv;
+    Idle *idle;
+    int nidle;
+    int max_idle;
+    TestRusage rusage;          /* of the last test received */
+};
+
+static void zygote_fork(Zygote * zg, TCase * tc);
+static void zygote_stopped(Zygote * zg);
+static void zygote_main(Zygote * zg, int fd);
+static void zygote_dispatch(Zygote * zg, const ZygoteJob * job);
+static void zygote_prefork(Zygote * zg);
+static void zygote_idle_child(Zygote * zg, int fd);
+static void zygote_sig_handler(int sig);
+static int read_all(int fd, void *buf, size_t size);
+static int send_all(int fd, const void *buf, size_t size);
+
+/* The supervisor of the zygote, for zygote_sig_handler() */
+static Supervisor *zygote_sv;
+static struct sigaction zygote_sigint_old_action;
+static struct sigaction zygote_sigterm_old_action;
+
+Zygote *zygote_create(SRunner * sr, Supervisor * sv, int nslots,
+                      zygote_run_fn run, zygote_setup_fn setup,
+                      void (*child_init) (void))
+{
+    Zygote *zg = (Zygote *)emalloc(sizeof(Zygote));
+
+    zg->pid = 0;
+    zg->fd = -1;
+    zg->runner_sv = sv;
+    zg->nslots = nslots;
+    zg->sr = sr;
+    zg->run = run;
+    zg->setup = setup;
+    zg->child_init = child_init;
+    zg->tc = NULL;
+    zg->sv = NULL;
+    zg->idle = NULL;
+    zg->nidle = 0;
+    zg->max_idle = nslots < CK_ZYGOTE_IDLE ? nslots : CK_ZYGOTE_IDLE;
+    memset(&zg->rusage, 0, sizeof(TestRusage));
+    zg->rusage.utime = -1;
+
+    return zg;
+}
+
+void zygote_free(Zygote * zg)
+{
+    zygote_reset(zg);
+    free(zg);
+}
+
+void zygote_reset(Zygote * zg)
+{
+    ZygoteJob job;
+
+    if(zg->pid == 0)
+    {
+        return;
+    }
+
+    memset(&job, 0, sizeof(job));
+    send_all(zg->fd, &job, sizeof(job));
+    zygote_stopped(zg);
+}
+
+int zygote_start(Zygote * zg, TCase * tc)
+{
+    ZygoteDone ready;
+    struct pollfd pfd;
+    int timeout_ms = -1;
+    int r;
+
+    if(tc->timeout.tv_sec < INT_MAX / 1000
+       && (tc->timeout.tv_sec != 0 || tc->timeout.tv_nsec != 0))
+    {
+        timeout_ms = tc->timeout.tv_sec * 1000
+            + (tc->timeout.tv_nsec + 999999) / 1000000;
+    }
+
+    zygote_fork(zg, tc);
+
+    pfd.fd = zg->fd;
+    pfd.events = POLLIN;
+    while((r = poll(&pfd, 1, timeout_ms)) == -1 && errno == EINTR)
+    {
+        /* Try again */
+    }
+    if(r == 1 && read_all(zg->fd, &ready, sizeof(ready)))
+    {
+        return 1;
+    }
+
+    /* The setup failed, crashed or timed out */
+    kill(zg->pid, SIGKILL);
+    zygote_stopped(zg);
+    return 0;
+}
+
+void zygote_submit(Zygote * zg, int slot, TCase * tc, TF * tfun, int i)
+{
+    ZygoteJob job;
+
+    if(zg->pid == 0)
+    {
+        zygote_fork(zg, NULL);
+    }
+
+    memset(&job, 0, sizeof(job));
+    job.tc = tc;
+    job.tfun = tfun;
+    job.iter = i;
+    job.slot = slot;
+    if(!send_all(zg->fd, &job, sizeof(job)))
+        eprintf("Error sending a test to the fork server:", __FILE__,
+                __LINE__ - 1);
+}
+
+int zygote_running(Zygote * zg)
+{
+    return zg->pid != 0;
+}
+
+void zygote_receive(Zygote * zg, int *slot, int *status, int *timed_out)
+{
+    ZygoteDone done;
+
+    if(!read_all(zg->fd, &done, sizeof(done)))
+        eprintf("The fork server exited unexpectedly", __FILE__,
+                __LINE__ - 1);
+    *slot = done.slot;
+    *status = done.status;
+    *timed_out = done.timed_out;
+    zg->rusage = done.rusage;
+}
+
+void zygote_rusage(Zygote * zg, TestRusage * ru)
+{
+    *ru = zg->rusage;
+}
+
+void zygote_child_init(Zygote * zg)
+{
+    if(zg->fd != -1)
+    {
+        close(zg->fd);
+    }
+}
+
+static void zygote_fork(Zygote * zg, TCase * tc)
+{
+    int fds[2];
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        eprintf("Error in call to socketpair:", __FILE__, __LINE__ - 1);
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+
+    zg->tc = tc;
+    zg->pid = fork();
+    if(zg->pid == -1)
+        eprintf("Error in call to fork:", __FILE__, __LINE__ - 2);
+    if(zg->pid == 0)
+    {
+        close(fds[0]);
+        zygote_main(zg, fds[1]);
+    }
+
+    close(fds[1]);
+    zg->fd = fds[0];
+    supervisor_watch(zg->runner_sv, zg->fd);
+}
+
+/* Wait for the zygote, which has been told to exit */
+static void zygote_stopped(Zygote * zg)
+{
+    while(waitpid(zg->pid, NULL, 0) == -1 && errno == EINTR)
+    {
+        /* Try again */
+    }
+    supervisor_watch(zg->runner_sv, -1);
+    close(zg->fd);
+    zg->fd = -1;
+    zg->pid = 0;
+}
+
+/* Runs in the zygote, never returns */
+static void zygote_main(Zygote * zg, int fd)
+{
+    struct sigaction sig_new_action;
+    int i;
+
+    zg->child_init();
+    zg->fd = fd;
+
+    if(zg->tc != NULL)
+    {
+        ZygoteDone ready;
+
+        zg->setup(zg->sr, zg->tc);
+        memset(&ready, 0, sizeof(ready));
+        ready.slot = -1;
+        send_all(zg->fd, &ready, sizeof(ready));
+    }
+
+    zg->sv = supervisor_create(zg->nslots);
+    supervisor_watch(zg->sv, zg->fd);
+    zygote_sv = zg->sv;
+
+    memset(&sig_new_action, 0, sizeof(sig_new_action));
+    sig_new_action.sa_handler = zygote_sig_handler;
+    sigaction(SIGINT, &sig_new_action, &zygote_sigint_old_action);
+    sigaction(SIGTERM, &sig_new_action, &zygote_sigterm_old_action);
+
+    zg->idle = (Idle *)emalloc(zg->max_idle * sizeof(Idle));
+    zygote_prefork(zg);
+
+    for(;;)
+    {
+        ZygoteDone done;
+
+        memset(&done, 0, sizeof(done));
+        done.slot = supervisor_wait(zg->sv, &done.status, &done.timed_out);
+        if(done.slot == SUPERVISOR_READABLE)
+        {
+            ZygoteJob job;
+
+            if(!read_all(zg->fd, &job, sizeof(job)) || job.tc == NULL)
+            {
+                /* Stopped, or the suite runner went away */
+                break;
+            }
+            zygote_dispatch(zg, &job);
+            zygote_prefork(zg);
+        }
+        else if(done.slot >= 0)
+        {
+            supervisor_rusage(zg->sv, done.slot, &done.rusage);
+            send_all(zg->fd, &done, sizeof(done));
+        }
+    }
+
+    /* Only left running if the suite runner went away */
+    supervisor_kill_all(zg->sv, SIGKILL);
+    supervisor_free(zg->sv);
+
+    /* Idle processes exit when their socket is closed */
+    for(i = 0; i < zg->nidle; i++)
+    {
+        close(zg->idle[i].fd);
+    }
+    for(i = 0; i < zg->nidle; i++)
+    {
+        waitpid(zg->idle[i].pid, NULL, 0);
+    }
+
+    _exit(EXIT_SUCCESS);
+}
+
+static void zygote_dispatch(Zygote * zg, const ZygoteJob * job)
+{
+    Idle idle;
+
+    if(zg->nidle == 0)
+    {
+        zygote_prefork(zg);
+    }
+
+    /* The oldest one, the others may still be starting up */
+    idle = zg->idle[0];
+    zg->nidle--;
+    memmove(&zg->idle[0], &zg->idle[1], zg->nidle * sizeof(Idle));
+
+    if(!send_all(idle.fd, job, sizeof(*job)))
+        eprintf("Error sending a test to an idle process:", __FILE__,
+                __LINE__ - 1);
+    close(idle.fd);
+
+    supervisor_add(zg->sv, job->slot, idle.pid, &job->tc->timeout);
+}
+
+static void zygote_prefork(Zygote * zg)
+{
+    while(zg->nidle < zg->max_idle)
+    {
+        int fds[2];
+        pid_t pid;
+
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+            eprintf("Error in call to socketpair:", __FILE__, __LINE__ - 1);
+
+        pid = fork();
+        if(pid == -1)
+            eprintf("Error in call to fork:", __FILE__, __LINE__ - 2);
+        if(pid == 0)
+        {
+            close(fds[1]);
+            zygote_idle_child(zg, fds[0]);
+        }
+
+        close(fds[0]);
+        zg->idle[zg->nidle].pid = pid;
+        zg->idle[zg->nidle].fd = fds[1];
+        zg->nidle++;
+    }
+}
+
+/* Runs in an idle process, never returns */
+static void zygote_idle_child(Zygote * zg, int fd)
+{
+    ZygoteJob job;
+    int i;
+
+    /* Only the zygote may hold the sockets of the other idle processes */
+    for(i = 0; i < zg->nidle; i++)
+    {
+        close(zg->idle[i].fd);
+    }
+    close(zg->fd);
+    supervisor_child_init(zg->sv);
+    sigaction(SIGINT, &zygote_sigint_old_action, NULL);
+    sigaction(SIGTERM, &zygote_sigterm_old_action, NULL);
+
+    if(!read_all(fd, &job, sizeof(job)))
+    {
+        _exit(EXIT_SUCCESS);
+    }
+    close(fd);
+
+    select_msg_slot(job.slot);
+    zg->run(zg->sr, job.tc, job.tfun, job.iter);
+    _exit(EXIT_SUCCESS);
+}
+
+static void zygote_sig_handler(int sig)
+{
+    supervisor_kill_all(zygote_sv, sig == SIGINT ? SIGKILL : SIGTERM);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+/* Returns 1 on success, 0 at the end of the file or on errors */
+static int read_all(int fd, void *buf, size_t size)
+{
+    char *p = (char *)buf;
+
+    while(size > 0)
+    {
+        ssize_t n = read(fd, p, size);
+
+        if(n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            return 0;
+        }
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
+static int send_all(int fd, const void *buf, size_t size)
+{
+    const char *p = (const char *)buf;
+
+    while(size > 0)
+    {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+
+        if(n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if(n <= 0)
+        {
+            return 0;
+        }
+        p += n;
+        size -= n;
+    }
+    return 1;
+}
+
+#endif /* HAVE_FORK */
@@ -0,0 +1,76 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CHECK_ZYGOTE_H
+#define CHECK_ZYGOTE_H
+
+/*
+ * The fork server (see srunner_set_fork_server()): a process forked
+ * from the suite runner, which forks the tests on request, supervises
+ * them and reports back how they ended.
+ */
+typedef struct Zygote Zygote;
+
+/* Runs a test in the forked process, never returns */
+typedef void (*zygote_run_fn) (SRunner * sr, TCase * tc, TF * tfun, int i);
+
+/* Runs the checked setup of a test case in the fork server */
+typedef void (*zygote_setup_fn) (SRunner * sr, TCase * tc);
+
+/*
+ * The fork server process is started by the first zygote_submit(), or
+ * by zygote_start(). child_init is called in it right after the fork.
+ * The suite runner's supervisor sv watches the socket of the fork
+ * server process while one is running, see zygote_receive().
+ */
+Zygote *zygote_create(SRunner * sr, Supervisor * sv, int nslots,
+                      zygote_run_fn run, zygote_setup_fn setup,
+                      void (*child_init) (void));
+void zygote_free(Zygote * zg);
+
+/*
+ * Start the fork server process for the tests of one test case, which
+ * first runs their checked setup. Returns 1 once the tests may be
+ * submitted, or 0 if the setup ended the fork server or did not finish
+ * within the timeout of the test case. No fork server may be running.
+ */
+int zygote_start(Zygote * zg, TCase * tc);
+
+/*
+ * Stop the fork server process, so that the next test is forked from
+ * the current state of the suite runner. No test may be running.
+ */
+void zygote_reset(Zygote * zg);
+
+void zygote_submit(Zygote * zg, int slot, TCase * tc, TF * tfun, int i);
+
+/* Whether the fork server process runs, and its socket is watched */
+int zygote_running(Zygote * zg);
+
+/* To be called when the supervisor reports SUPERVISOR_READABLE */
+void zygote_receive(Zygote * zg, int *slot, int *status, int *timed_out);
+
+/* The resources used by the test of the last zygote_receive() */
+void zygote_rusage(Zygote * zg, TestRusage * ru);
+
+/* To be called in a process forked by the suite runner */
+void zygote_child_init(Zygote * zg);
+
+#endif /* CHECK_ZYGOTE_H */
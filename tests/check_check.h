@@ -34,6 +34,14 @@
 #define MEMORY_LEAKING_TESTS_ENABLED 1
 #endif
 
+/*
+ * Allocations are only counted in a program linked with the check_alloc
+ * library, which the build only does where the linker supports --wrap.
+ */
+#ifndef ALLOC_COUNTING_ENABLED
+#define ALLOC_COUNTING_ENABLED 0
+#endif
+
 extern int sub_ntests;
 
 void fork_setup (void);
@@ -55,6 +63,7 @@ Suite *make_fixture_suite(void);
 Suite *make_pack_suite(void);
 Suite *make_exit_suite(void);
 Suite *make_selective_suite(void);
+Suite *make_jobs_suite(void);
 
 extern int master_tests_lineno[];
 void init_master_tests_lineno(int num_master_tests);
@@ -80,4 +89,7 @@ void record_failure_line_num(const int line);
  */
 int get_next_failure_line_num(FILE * file);
 
+/* A file name of this process, which parallel runs do not share */
+const char *pid_fname(char *buf, size_t size, const char *name);
+
 #endif /* CHECK_CHECK_H */
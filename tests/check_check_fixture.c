@@ -603,6 +603,92 @@ START_TEST(test_ch_teardown_two_teardowns_fork)
   srunner_free(sr);
 }
 END_TEST
+
+#if defined(HAVE_MMAP) && HAVE_MMAP==1
+#include <unistd.h>
+#include <fcntl.h>
+
+static int snapshot_pipe[2];
+static int snapshot_value;
+static pid_t snapshot_setup_pid;
+
+static void sub_ch_setup_snapshot (void)
+{
+  char c = 's';
+
+  ck_assert_int_eq(write(snapshot_pipe[1], &c, 1), 1);
+  snapshot_setup_pid = getpid();
+  snapshot_value = 1;
+}
+
+static void sub_ch_teardown_snapshot (void)
+{
+  ck_assert_int_eq(snapshot_value, 2);
+}
+
+START_TEST(test_sub_snapshot)
+{
+  ck_assert_int_ne(snapshot_setup_pid, getpid());
+  ck_assert_int_eq(snapshot_value, 1);
+  snapshot_value++;
+}
+END_TEST
+
+/*
+ * The checked setup runs once for each test case, every test starts
+ * from a copy of the state it left behind. With 1 or 4 jobs.
+ */
+START_TEST(test_ch_setup_snapshot)
+{
+  TCase *tc;
+  TCase *tc_fail;
+  Suite *s;
+  SRunner *sr;
+  TestResult **tr;
+  char buf[16];
+  int i;
+
+  ck_assert_int_eq(pipe(snapshot_pipe), 0);
+  fcntl(snapshot_pipe[0], F_SETFL, O_NONBLOCK);
+
+  s = suite_create("Snapshot");
+  tc = tcase_create("Snapshot");
+  suite_add_tcase(s, tc);
+  tcase_add_loop_test(tc, test_sub_snapshot, 0, 5);
+  tcase_add_checked_fixture(tc, sub_ch_setup_snapshot,
+                            sub_ch_teardown_snapshot);
+  tcase_set_fixture_snapshot(tc, 1);
+
+  tc_fail = tcase_create("Snapshot Fail");
+  suite_add_tcase(s, tc_fail);
+  tcase_add_loop_test(tc_fail, test_sub_fail, 0, 2);
+  tcase_add_checked_fixture(tc_fail, setup_sub_fail, NULL);
+  tcase_set_fixture_snapshot(tc_fail, 1);
+
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, CK_FORK);
+  srunner_set_jobs(sr, _i == 0 ? 1 : 4);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(read(snapshot_pipe[0], buf, sizeof(buf)), 1);
+  close(snapshot_pipe[0]);
+  close(snapshot_pipe[1]);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 7);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 2);
+
+  /* A failed snapshot setup is reported for each test */
+  tr = srunner_failures(sr);
+  for(i = 0; i < 2; i++)
+  {
+    ck_assert_int_eq(tr_ctx(tr[i]), CK_CTX_SETUP);
+    ck_assert_str_eq(tr_msg(tr[i]), "Failed setup");
+  }
+  free(tr);
+  srunner_free(sr);
+}
+END_TEST
+#endif /* HAVE_MMAP */
 #endif /* HAVE_FORK */
 
 Suite *make_fixture_suite (void)
@@ -637,6 +723,9 @@ Suite *make_fixture_suite (void)
   tcase_add_test(tc,test_ch_teardown_fail_nofork);
   tcase_add_test(tc,test_ch_teardown_sig);
   tcase_add_test(tc,test_ch_teardown_two_teardowns_fork);
+#if defined(HAVE_MMAP) && HAVE_MMAP==1
+  tcase_add_loop_test(tc,test_ch_setup_snapshot,0,2);
+#endif /* HAVE_MMAP */
 #endif
 
   return s;
@@ -21,9 +21,17 @@
 #include "../lib/libcompat.h"
 
 #include <sys/types.h>
+#include <signal.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if HAVE_SETRLIMIT && HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
 #include <check.h>
 #include "check_check.h"
+#include "check_list.h"
+#include "check_impl.h"
 
 
 static int counter;
@@ -132,6 +140,15 @@ START_TEST(test_env)
 }
 END_TEST
 
+START_TEST(test_env_batch)
+{
+  char envvar[] = "CK_FORK=batch";
+  putenv(envvar);
+  ck_assert_msg(srunner_fork_status(fork_dummy_sr) == CK_FORK_BATCH,
+	      "Fork status does not obey environment variable");
+}
+END_TEST
+
 START_TEST(test_env_and_set)
 {
   char envvar[] = "CK_FORK=no";
@@ -141,6 +158,599 @@ START_TEST(test_env_and_set)
 	      "Explicit setting of fork status should override env");
 }
 END_TEST
+
+/* Counts the tests run by the current process of a batch */
+static int batch_count;
+
+START_TEST(test_batch_count)
+{
+  ck_assert_int_eq(batch_count, _i);
+  batch_count++;
+}
+END_TEST
+
+START_TEST(test_batch_fresh)
+{
+  ck_assert_int_eq(batch_count, 0);
+  batch_count++;
+}
+END_TEST
+
+START_TEST(test_batch_fail)
+{
+  batch_count++;
+  ck_abort_msg("batch failure");
+}
+END_TEST
+
+START_TEST(test_batch_exit)
+{
+  exit(3);
+}
+END_TEST
+
+START_TEST(test_batch_signal)
+{
+  raise(SIGUSR1);
+}
+END_TEST
+
+START_TEST(test_batch_sleep)
+{
+  usleep(150 * 1000);
+}
+END_TEST
+
+START_TEST(test_batch_timeout)
+{
+  for(;;)
+    sleep(1);
+}
+END_TEST
+
+static Suite *make_batch_sub_suite (void)
+{
+  Suite *s;
+  TCase *tc_core;
+  TCase *tc_timeout;
+
+  s = suite_create("Batch Sub");
+
+  tc_core = tcase_create("Core");
+  tcase_add_loop_test(tc_core, test_batch_count, 0, 3);
+  tcase_add_test(tc_core, test_batch_fail);
+  tcase_add_test(tc_core, test_batch_fresh);
+  tcase_add_test(tc_core, test_batch_exit);
+  tcase_add_test(tc_core, test_batch_fresh);
+  tcase_add_test_raise_signal(tc_core, test_batch_signal, SIGUSR1);
+  tcase_add_loop_test(tc_core, test_batch_count, 0, 2);
+  suite_add_tcase(s, tc_core);
+
+  tc_timeout = tcase_create("Timeout");
+  tcase_set_timeout(tc_timeout, 0.4);
+  tcase_add_loop_test(tc_timeout, test_batch_sleep, 0, 4);
+  tcase_add_test(tc_timeout, test_batch_timeout);
+  tcase_add_test(tc_timeout, test_batch_fresh);
+  suite_add_tcase(s, tc_timeout);
+
+  return s;
+}
+
+/*
+ * Tests share a process until one of them ends it, each test keeps
+ * its own timeout.
+ */
+START_TEST(test_fork_batch)
+{
+  const char *expected[][3] = {
+    { "test_batch_count", "P", "Passed" },
+    { "test_batch_count", "P", "Passed" },
+    { "test_batch_count", "P", "Passed" },
+    { "test_batch_fail", "F", "batch failure" },
+    { "test_batch_fresh", "P", "Passed" },
+    { "test_batch_exit", "E", "Early exit with return value 3" },
+    { "test_batch_fresh", "P", "Passed" },
+    { "test_batch_signal", "P", "Passed" },
+    { "test_batch_count", "P", "Passed" },
+    { "test_batch_count", "P", "Passed" },
+    { "test_batch_sleep", "P", "Passed" },
+    { "test_batch_sleep", "P", "Passed" },
+    { "test_batch_sleep", "P", "Passed" },
+    { "test_batch_sleep", "P", "Passed" },
+    { "test_batch_timeout", "E", "Test timeout expired" },
+    { "test_batch_fresh", "P", "Passed" }
+  };
+  int nexpected = sizeof(expected) / sizeof(expected[0]);
+  TestResult **trs;
+  SRunner *sr;
+  int i;
+
+  batch_count = 0;
+  sr = srunner_create(make_batch_sub_suite());
+  srunner_set_fork_status(sr, CK_FORK_BATCH);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), nexpected);
+  trs = srunner_results(sr);
+  for(i = 0; i < nexpected; i++)
+  {
+    const char *rtype = tr_rtype(trs[i]) == CK_PASS ? "P" :
+      tr_rtype(trs[i]) == CK_FAILURE ? "F" : "E";
+
+    ck_assert_str_eq(trs[i]->tname, expected[i][0]);
+    ck_assert_str_eq(rtype, expected[i][1]);
+    ck_assert_str_eq(tr_msg(trs[i]), expected[i][2]);
+  }
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+#define RUSAGE_BYTES (8 * 1024 * 1024)
+
+START_TEST(test_sub_rusage)
+{
+  char *mem = (char *)malloc(RUSAGE_BYTES);
+  size_t j;
+
+  ck_assert_ptr_ne(mem, NULL);
+  for(j = 0; j < RUSAGE_BYTES; j += 512)
+    mem[j] = (char)j;
+  free(mem);
+}
+END_TEST
+
+/*
+ * The resources used by a test are known when it had a process of its
+ * own, serial or parallel, but not in a shared or in the main process.
+ */
+START_TEST(test_rusage)
+{
+  TestResult **trs;
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+  int i;
+
+  s = suite_create("Rusage Sub");
+  tc = tcase_create("Core");
+  suite_add_tcase(s, tc);
+  tcase_add_loop_test(tc, test_sub_rusage, 0, 2);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, _i == 2 ? CK_NOFORK :
+                          _i == 3 ? CK_FORK_BATCH : CK_FORK);
+  srunner_set_jobs(sr, _i == 1 ? 2 : 1);
+  srunner_set_rusage(sr, 1);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_failed(sr), 0);
+  trs = srunner_results(sr);
+  for(i = 0; i < 2; i++)
+  {
+    const TestRusage *ru = tr_rusage(trs[i]);
+
+#if HAVE_WAIT4 && HAVE_SYS_RESOURCE_H
+    if(_i < 2)
+    {
+      ck_assert_ptr_ne(ru, NULL);
+      ck_assert_int_ge(ru->utime, 0);
+      ck_assert_int_ge(ru->stime, 0);
+      ck_assert_int_ge(ru->maxrss, RUSAGE_BYTES / 1024);
+      ck_assert_int_ge(ru->minflt, RUSAGE_BYTES / 4096 / 2);
+      continue;
+    }
+#endif
+    ck_assert_ptr_eq(ru, NULL);
+  }
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+START_BENCH(test_sub_bench)
+{
+  char buf[64];
+
+  ck_bench_pause();
+  memset(buf, _i, sizeof(buf));
+  ck_bench_resume();
+  ck_assert_int_eq(buf[0], _i);
+}
+END_BENCH
+
+START_BENCH(test_sub_bench_fail)
+{
+  ck_assert_int_eq(_i, 1);
+}
+END_BENCH
+
+/*
+ * A benchmark has its statistics in every mode, and one which fails
+ * has none.
+ */
+START_TEST(test_bench)
+{
+  TestResult **trs;
+  const TestBench *b;
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+  int i;
+
+  s = suite_create("Bench Sub");
+  tc = tcase_create("Core");
+  suite_add_tcase(s, tc);
+  tcase_add_bench(tc, test_sub_bench);
+  tcase_add_bench(tc, test_sub_bench_fail);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, _i == 2 ? CK_NOFORK :
+                          _i == 3 ? CK_FORK_BATCH : CK_FORK);
+  srunner_set_jobs(sr, _i == 1 ? 2 : 1);
+  setenv("CK_BENCH_TIME", "0.02", 1);
+  setenv("CK_BENCH_SAMPLES", "7", 1);
+  srunner_run_all(sr, CK_SILENT);
+  unsetenv("CK_BENCH_TIME");
+  unsetenv("CK_BENCH_SAMPLES");
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 2);
+  trs = srunner_results(sr);
+  ck_assert_msg(tr_rtype(trs[0]) == CK_PASS, "%s", tr_msg(trs[0]));
+  b = tr_bench(trs[0]);
+  ck_assert_ptr_ne(b, NULL);
+  ck_assert_int_ge(b->iterations, 1);
+  ck_assert_int_eq(b->nsamples, 7);
+  for(i = 0; i < b->nsamples; i++)
+    ck_assert(b->samples[i] >= b->min);
+  ck_assert(b->min > 0);
+  ck_assert(b->min <= b->median && b->median <= b->p99);
+  ck_assert(b->min <= b->mean && b->mean <= b->p99);
+  ck_assert(b->mad >= 0);
+  ck_assert_int_eq(tr_rtype(trs[1]), CK_FAILURE);
+  ck_assert_ptr_eq(tr_bench(trs[1]), NULL);
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+static volatile int complexity_sink;
+
+START_BENCH(test_sub_constant)
+{
+  complexity_sink = _i;
+}
+END_BENCH
+
+START_BENCH(test_sub_quadratic)
+{
+  int j, k, sum = 0;
+
+  for(j = 0; j < _i; j++)
+    for(k = 0; k < _i; k++)
+      sum += j ^ k;
+  complexity_sink = sum;
+}
+END_BENCH
+
+/*
+ * A complexity test fails when its time grows faster than its bound,
+ * and is not added with too few sizes.
+ */
+START_TEST(test_complexity)
+{
+  static const int sizes[] = { 64, 128, 256, 512, 1024, 2048, 4096 };
+  TestResult **trs;
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+
+  s = suite_create("Complexity Sub");
+  tc = tcase_create("Core");
+  suite_add_tcase(s, tc);
+  tcase_add_complexity_test(tc, test_sub_constant, sizes, 7, CK_O_LOG_N);
+  tcase_add_complexity_test(tc, test_sub_quadratic, sizes, 7, CK_O_N);
+  tcase_add_complexity_test(tc, test_sub_constant, sizes, 2, CK_O_1);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, _i == 0 ? CK_FORK : CK_NOFORK);
+  setenv("CK_BENCH_TIME", "0.1", 1);
+  srunner_run_all(sr, CK_SILENT);
+  unsetenv("CK_BENCH_TIME");
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 2);
+  trs = srunner_results(sr);
+  ck_assert_msg(tr_rtype(trs[0]) == CK_PASS, "%s", tr_msg(trs[0]));
+  ck_assert_int_eq(tr_rtype(trs[1]), CK_FAILURE);
+  ck_assert_msg(strncmp(tr_msg(trs[1]), "Complexity O(n^2) exceeds O(n) ",
+                        31) == 0, "%s", tr_msg(trs[1]));
+  ck_assert_str_eq(tr_lfile(trs[1]), __FILE__);
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+START_TEST(test_sub_perf)
+{
+  int j, sum = 0;
+
+  for(j = 0; j < 100000; j++)
+    sum += j ^ _i;
+  complexity_sink = sum;
+}
+END_TEST
+
+START_TEST(test_sub_perf_fail)
+{
+  ck_assert_int_eq(_i, 1);
+}
+END_TEST
+
+/*
+ * The counters of a test are there when it passed with them enabled,
+ * if the kernel lets the tests open them.
+ */
+START_TEST(test_perf)
+{
+  TestResult **trs;
+  const TestPerf *p;
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+  int i;
+
+  s = suite_create("Perf Sub");
+  tc = tcase_create("Core");
+  suite_add_tcase(s, tc);
+  tcase_add_test(tc, test_sub_perf);
+  tcase_add_bench(tc, test_sub_bench);
+  tcase_add_test(tc, test_sub_perf_fail);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, _i == 2 ? CK_NOFORK : CK_FORK);
+  srunner_set_jobs(sr, _i == 1 ? 2 : 1);
+  srunner_set_perf_counters(sr, _i != 3);
+  setenv("CK_BENCH_TIME", "0.02", 1);
+  srunner_run_all(sr, CK_SILENT);
+  unsetenv("CK_BENCH_TIME");
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 3);
+  trs = srunner_results(sr);
+  for(i = 0; i < 2; i++)
+  {
+    ck_assert_msg(tr_rtype(trs[i]) == CK_PASS, "%s", tr_msg(trs[i]));
+    p = tr_perf(trs[i]);
+#if HAVE_LINUX_PERF_EVENT_H
+    if(_i != 3 && p != NULL)
+    {
+      if(p->hardware)
+      {
+        ck_assert(p->cycles > 0);
+        ck_assert(p->instructions > 0);
+        ck_assert(p->task_clock == -1);
+      }
+      else
+      {
+        ck_assert(p->task_clock > 0);
+        ck_assert(p->page_faults >= 0);
+        ck_assert(p->cycles == -1);
+      }
+      continue;
+    }
+#endif
+    ck_assert_ptr_eq(p, NULL);
+  }
+  ck_assert_int_eq(tr_rtype(trs[2]), CK_FAILURE);
+  ck_assert_ptr_eq(tr_perf(trs[2]), NULL);
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+static void *alloc_kept;
+
+START_TEST(test_sub_alloc_none)
+{
+  ck_assert_alloc_count_le(0);
+  ck_assert_no_leaks();
+  ck_assert_int_eq(_i, 0);
+}
+END_TEST
+
+START_TEST(test_sub_alloc_some)
+{
+  char *a = (char *)malloc(100);
+  char *b = (char *)calloc(10, 4);
+
+  ck_assert_ptr_ne(a, NULL);
+  ck_assert_ptr_ne(b, NULL);
+  a = (char *)realloc(a, 200);
+  ck_assert_ptr_ne(a, NULL);
+  free(b);
+  free(a);
+}
+END_TEST
+
+START_TEST(test_sub_alloc_budget)
+{
+  ck_assert_alloc_count_le(1);
+  free(malloc(1));
+  free(malloc(2));
+}
+END_TEST
+
+START_TEST(test_sub_alloc_leak)
+{
+  ck_assert_no_leaks();
+  alloc_kept = malloc(16);
+}
+END_TEST
+
+/*
+ * The allocations of a test are counted without Check's own, and its
+ * budgets fail it when it returns, whether or not the allocations are
+ * reported. Without the wrappers of check_alloc the budgets can't be
+ * checked.
+ */
+START_TEST(test_alloc)
+{
+  TestResult **trs;
+  const TestAlloc *a;
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+
+  s = suite_create("Alloc Sub");
+  tc = tcase_create("Core");
+  suite_add_tcase(s, tc);
+  tcase_add_test(tc, test_sub_alloc_none);
+  tcase_add_test(tc, test_sub_alloc_some);
+  tcase_add_test(tc, test_sub_alloc_budget);
+  tcase_add_test(tc, test_sub_alloc_leak);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, _i == 2 ? CK_FORK_BATCH : CK_FORK);
+  srunner_set_jobs(sr, _i == 1 ? 2 : 1);
+  srunner_set_alloc_tracking(sr, _i != 3);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 4);
+  trs = srunner_results(sr);
+  a = tr_alloc(trs[1]);
+#if ALLOC_COUNTING_ENABLED
+  ck_assert_msg(tr_rtype(trs[0]) == CK_PASS, "%s", tr_msg(trs[0]));
+  ck_assert_str_eq(tr_msg(trs[2]), "Assertion 'allocations <= 1' failed: "
+                   "allocations == 2");
+  ck_assert_str_eq(tr_msg(trs[3]), "Assertion 'no leaks' failed: "
+                   "1 blocks of 16 bytes leaked");
+  ck_assert_ptr_eq(tr_alloc(trs[3]), NULL);
+  if(_i == 3)
+  {
+    /* The budgets are still checked, but nothing is reported */
+    ck_assert_ptr_eq(a, NULL);
+    ck_assert_ptr_eq(tr_alloc(trs[0]), NULL);
+  }
+  else
+  {
+    ck_assert_msg(a != NULL, "Allocations were not counted");
+    ck_assert_int_eq(tr_alloc(trs[0])->allocations, 0);
+    ck_assert_int_eq(a->allocations, 3);
+    ck_assert_int_eq(a->frees, 3);
+    ck_assert_int_eq(a->bytes, 340);
+    ck_assert_int_eq(a->peak_bytes, 240);
+    ck_assert_int_eq(a->leaks, 0);
+    ck_assert_int_eq(a->leaked_bytes, 0);
+  }
+#else
+  ck_assert_ptr_eq(a, NULL);
+  ck_assert_int_eq(tr_rtype(trs[0]), CK_FAILURE);
+  ck_assert_str_eq(tr_msg(trs[0]), "Assertion 'allocations <= 0' failed: "
+                   "allocations are not counted");
+#endif
+  ck_assert_int_eq(tr_rtype(trs[2]), CK_FAILURE);
+  ck_assert_int_eq(tr_rtype(trs[3]), CK_FAILURE);
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+#if HAVE_SETRLIMIT && HAVE_SYS_RESOURCE_H
+#ifdef RLIMIT_DATA
+#define MEMORY_RLIMIT RLIMIT_DATA
+#else
+#define MEMORY_RLIMIT RLIMIT_AS
+#endif
+
+#define MB (1024 * 1024)
+
+START_TEST(test_sub_alloc)
+{
+  char *mem = (char *)malloc(8 * MB);
+
+  memset(mem, 1, 8 * MB);
+  free(mem);
+  /* Grows until it crashes once an allocation over the limit failed */
+  while (_i == 1)
+  {
+    mem = (char *)malloc(MB);
+    memset(mem, 1, MB);
+  }
+}
+END_TEST
+
+START_TEST(test_sub_crash)
+{
+  raise(SIGSEGV);
+}
+END_TEST
+
+START_TEST(test_sub_spin)
+{
+  volatile unsigned long n = 0;
+
+  for(;;)
+    n++;
+}
+END_TEST
+
+START_TEST(test_sub_rlimits)
+{
+  struct rlimit rl;
+
+  ck_assert_int_eq(getrlimit(RLIMIT_CORE, &rl), 0);
+  ck_assert(rl.rlim_cur == 0);
+  ck_assert_int_eq(getrlimit(MEMORY_RLIMIT, &rl), 0);
+  ck_assert(rl.rlim_cur == 512 * (rlim_t)MB);
+}
+END_TEST
+
+/*
+ * Tests over their limits end with an error of their own, also when
+ * they share a process.
+ */
+START_TEST(test_limits)
+{
+  TestResult **trs;
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+
+  s = suite_create("Limits Sub");
+  tc = tcase_create("Memory");
+  tcase_set_memory_limit(tc, 64);
+  tcase_add_loop_test(tc, test_sub_alloc, 0, 2);
+  tcase_add_test(tc, test_sub_crash);
+  suite_add_tcase(s, tc);
+  tc = tcase_create("CPU");
+  tcase_set_cpu_limit(tc, 1);
+  tcase_set_timeout(tc, 30);
+  tcase_add_test(tc, test_sub_spin);
+  suite_add_tcase(s, tc);
+  setenv("CK_MEMORY_LIMIT", "512", 1);
+  setenv("CK_CORE_LIMIT", "0", 1);
+  tc = tcase_create("Env");
+  unsetenv("CK_MEMORY_LIMIT");
+  unsetenv("CK_CORE_LIMIT");
+  tcase_add_test(tc, test_sub_rlimits);
+  suite_add_tcase(s, tc);
+
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, _i == 2 ? CK_FORK_BATCH : CK_FORK);
+  srunner_set_jobs(sr, _i == 1 ? 2 : 1);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 5);
+  trs = srunner_results(sr);
+  ck_assert_int_eq(tr_rtype(trs[0]), CK_PASS);
+  ck_assert_int_eq(tr_rtype(trs[1]), CK_ERROR);
+  ck_assert_str_eq(tr_msg(trs[1]),
+                   "Resource limit exceeded: memory limit of 64 MB");
+  /* A crash with room left is not blamed on the limit */
+  ck_assert_int_eq(tr_rtype(trs[2]), CK_ERROR);
+  ck_assert_str_eq(tr_msg(trs[2]), "Received signal 11 (Segmentation fault)");
+  ck_assert_int_eq(tr_rtype(trs[3]), CK_ERROR);
+  ck_assert_str_eq(tr_msg(trs[3]), "Resource limit exceeded: CPU time limit");
+  ck_assert_msg(tr_rtype(trs[4]) == CK_PASS, "%s", tr_msg(trs[4]));
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+#endif /* HAVE_SETRLIMIT && HAVE_SYS_RESOURCE_H */
 #endif /* HAVE_FORK */
 
 START_TEST(test_nofork)
@@ -164,9 +774,26 @@ Suite *make_fork_suite(void)
 #if defined(HAVE_FORK) && HAVE_FORK==1
   tcase_add_test(tc,test_set_fork);
   tcase_add_test(tc,test_env);
+  tcase_add_test(tc,test_env_batch);
   tcase_add_test(tc,test_env_and_set);
+  tcase_add_test(tc,test_fork_batch);
+  tcase_add_loop_test(tc,test_rusage,0,4);
+  tcase_add_loop_test(tc,test_bench,0,4);
+  tcase_add_loop_test(tc,test_complexity,0,2);
+  tcase_add_loop_test(tc,test_perf,0,4);
+  tcase_add_loop_test(tc,test_alloc,0,4);
 #endif /* HAVE_FORK */
   tcase_add_test(tc,test_nofork);
-  
+
+#if defined(HAVE_FORK) && HAVE_FORK==1
+#if HAVE_SETRLIMIT && HAVE_SYS_RESOURCE_H
+  /* Spins up to the CPU time limit, on a busy machine as well */
+  tc = tcase_create("Limits");
+  tcase_set_timeout(tc, 30);
+  suite_add_tcase(s, tc);
+  tcase_add_loop_test(tc,test_limits,0,3);
+#endif
+#endif /* HAVE_FORK */
+
   return s;
 }
@@ -0,0 +1,851 @@
+/*
+ * Check: a unit test framework for C
+ * Copyright (C) 2001, 2002 Arien Malec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include "../lib/libcompat.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "check.h"
+#include "check_check.h"
+#include "check_list.h"
+#include "check_impl.h"
+
+static SRunner *jobs_sr;
+
+static void jobs_setup (void)
+{
+  jobs_sr = srunner_create(NULL);
+}
+
+static void jobs_teardown (void)
+{
+  srunner_free(jobs_sr);
+}
+
+START_TEST(test_jobs_default)
+{
+  unsetenv("CK_JOBS");
+  ck_assert_int_eq(srunner_jobs(jobs_sr), 1);
+}
+END_TEST
+
+START_TEST(test_jobs_env)
+{
+  setenv("CK_JOBS", "3", 1);
+  ck_assert_int_eq(srunner_jobs(jobs_sr), 3);
+  setenv("CK_JOBS", "bogus", 1);
+  ck_assert_int_eq(srunner_jobs(jobs_sr), 1);
+  setenv("CK_JOBS", "0", 1);
+  ck_assert_int_ge(srunner_jobs(jobs_sr), 1);
+}
+END_TEST
+
+START_TEST(test_fork_server_env)
+{
+  unsetenv("CK_FORK_SERVER");
+  ck_assert_int_eq(srunner_fork_server(jobs_sr), 0);
+  setenv("CK_FORK_SERVER", "yes", 1);
+  ck_assert_int_eq(srunner_fork_server(jobs_sr), 1);
+  srunner_set_fork_server(jobs_sr, 0);
+  ck_assert_int_eq(srunner_fork_server(jobs_sr), 0);
+  srunner_set_fork_server(jobs_sr, -1);
+  setenv("CK_FORK_SERVER", "no", 1);
+  ck_assert_int_eq(srunner_fork_server(jobs_sr), 0);
+  srunner_set_fork_server(jobs_sr, 1);
+  ck_assert_int_eq(srunner_fork_server(jobs_sr), 1);
+}
+END_TEST
+
+START_TEST(test_fork_tcase_env)
+{
+  unsetenv("CK_FORK_TCASE");
+  ck_assert_int_eq(srunner_fork_tcase(jobs_sr), 0);
+  setenv("CK_FORK_TCASE", "yes", 1);
+  ck_assert_int_eq(srunner_fork_tcase(jobs_sr), 1);
+  srunner_set_fork_tcase(jobs_sr, 0);
+  ck_assert_int_eq(srunner_fork_tcase(jobs_sr), 0);
+  srunner_set_fork_tcase(jobs_sr, -1);
+  setenv("CK_FORK_TCASE", "no", 1);
+  ck_assert_int_eq(srunner_fork_tcase(jobs_sr), 0);
+}
+END_TEST
+
+START_TEST(test_loop_chunks_env)
+{
+  unsetenv("CK_LOOP_CHUNKS");
+  ck_assert_int_eq(srunner_loop_chunks(jobs_sr), 0);
+  setenv("CK_LOOP_CHUNKS", "yes", 1);
+  ck_assert_int_eq(srunner_loop_chunks(jobs_sr), 1);
+  srunner_set_loop_chunks(jobs_sr, 0);
+  ck_assert_int_eq(srunner_loop_chunks(jobs_sr), 0);
+  srunner_set_loop_chunks(jobs_sr, -1);
+  setenv("CK_LOOP_CHUNKS", "no", 1);
+  ck_assert_int_eq(srunner_loop_chunks(jobs_sr), 0);
+}
+END_TEST
+
+START_TEST(test_max_failures_env)
+{
+  unsetenv("CK_MAX_FAILURES");
+  ck_assert_int_eq(srunner_max_failures(jobs_sr), 0);
+  setenv("CK_MAX_FAILURES", "3", 1);
+  ck_assert_int_eq(srunner_max_failures(jobs_sr), 3);
+  setenv("CK_MAX_FAILURES", "bogus", 1);
+  ck_assert_int_eq(srunner_max_failures(jobs_sr), 0);
+  setenv("CK_MAX_FAILURES", "3", 1);
+  srunner_set_max_failures(jobs_sr, 1);
+  ck_assert_int_eq(srunner_max_failures(jobs_sr), 1);
+  srunner_set_max_failures(jobs_sr, -1);
+  ck_assert_int_eq(srunner_max_failures(jobs_sr), 3);
+  unsetenv("CK_MAX_FAILURES");
+}
+END_TEST
+
+START_TEST(test_stream_results_env)
+{
+  unsetenv("CK_STREAM_RESULTS");
+  ck_assert_int_eq(srunner_stream_results(jobs_sr), 0);
+  setenv("CK_STREAM_RESULTS", "yes", 1);
+  ck_assert_int_eq(srunner_stream_results(jobs_sr), 1);
+  srunner_set_stream_results(jobs_sr, 0);
+  ck_assert_int_eq(srunner_stream_results(jobs_sr), 0);
+  srunner_set_stream_results(jobs_sr, -1);
+  ck_assert_int_eq(srunner_stream_results(jobs_sr), 1);
+  unsetenv("CK_STREAM_RESULTS");
+}
+END_TEST
+
+START_TEST(test_jobs_env_and_set)
+{
+  setenv("CK_JOBS", "3", 1);
+  srunner_set_jobs(jobs_sr, 5);
+  ck_assert_msg(srunner_jobs(jobs_sr) == 5,
+                "Explicit setting of jobs should override env");
+  srunner_set_jobs(jobs_sr, -1);
+  ck_assert_int_eq(srunner_jobs(jobs_sr), 3);
+}
+END_TEST
+
+#if defined(HAVE_FORK) && HAVE_FORK==1
+static int unchecked_setup_count;
+
+static void jobs_sub_unchecked_setup (void)
+{
+  unchecked_setup_count++;
+}
+
+/* The slowest test comes first, results must still be in order */
+START_TEST(test_sub_slow_fail)
+{
+  usleep(200 * 1000);
+  ck_abort_msg("slow failure");
+}
+END_TEST
+
+START_TEST(test_sub_pass)
+{
+  ck_assert_int_eq(unchecked_setup_count, 1);
+}
+END_TEST
+
+START_TEST(test_sub_exit)
+{
+  exit(2);
+}
+END_TEST
+
+START_TEST(test_sub_loop)
+{
+  ck_assert_int_ne(_i, 2);
+}
+END_TEST
+
+START_TEST(test_sub_timeout)
+{
+  for(;;)
+    sleep(1);
+}
+END_TEST
+
+static Suite *make_jobs_sub_suite (void)
+{
+  Suite *s;
+  TCase *tc_core;
+  TCase *tc_fixture;
+  TCase *tc_timeout;
+
+  s = suite_create("Jobs Sub");
+
+  tc_core = tcase_create("Core");
+  tcase_add_test(tc_core, test_sub_slow_fail);
+  tcase_add_test(tc_core, test_sub_exit);
+  tcase_add_loop_test(tc_core, test_sub_loop, 0, 4);
+  suite_add_tcase(s, tc_core);
+
+  tc_fixture = tcase_create("Fixture");
+  tcase_add_unchecked_fixture(tc_fixture, jobs_sub_unchecked_setup, NULL);
+  tcase_add_test(tc_fixture, test_sub_pass);
+  suite_add_tcase(s, tc_fixture);
+
+  tc_timeout = tcase_create("Timeout");
+  tcase_set_timeout(tc_timeout, 0.2);
+  tcase_add_test(tc_timeout, test_sub_timeout);
+  tcase_add_test(tc_timeout, test_sub_pass);
+  suite_add_tcase(s, tc_timeout);
+
+  return s;
+}
+
+/* Run with 1 or 4 jobs, and without or with a fork server */
+START_TEST(test_jobs_results_in_order)
+{
+  const char *expected[][3] = {
+    { "test_sub_slow_fail", "F", "slow failure" },
+    { "test_sub_exit", "E", "Early exit with return value 2" },
+    { "test_sub_loop", "P", "Passed" },
+    { "test_sub_loop", "P", "Passed" },
+    { "test_sub_loop", "F", "Assertion '_i != 2' failed: _i == 2, 2 == 2" },
+    { "test_sub_loop", "P", "Passed" },
+    { "test_sub_pass", "P", "Passed" },
+    { "test_sub_timeout", "E", "Test timeout expired" },
+    { "test_sub_pass", "P", "Passed" }
+  };
+  int nexpected = sizeof(expected) / sizeof(expected[0]);
+  TestResult **trs;
+  SRunner *sr;
+  int i;
+
+  unchecked_setup_count = 0;
+  sr = srunner_create(make_jobs_sub_suite());
+  srunner_set_fork_status(sr, CK_FORK);
+  srunner_set_jobs(sr, _i % 2 == 0 ? 1 : 4);
+  srunner_set_fork_server(sr, _i >= 2);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), nexpected);
+  trs = srunner_results(sr);
+  for(i = 0; i < nexpected; i++)
+  {
+    const char *rtype = tr_rtype(trs[i]) == CK_PASS ? "P" :
+      tr_rtype(trs[i]) == CK_FAILURE ? "F" : "E";
+
+    ck_assert_str_eq(trs[i]->tname, expected[i][0]);
+    ck_assert_str_eq(rtype, expected[i][1]);
+    ck_assert_str_eq(tr_msg(trs[i]), expected[i][2]);
+  }
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+START_TEST(test_sub_odd_sleep)
+{
+  if(_i % 2 == 1)
+    for(;;)
+      sleep(1);
+}
+END_TEST
+
+START_TEST(test_sub_short_sleep)
+{
+  usleep(400 * 1000);
+}
+END_TEST
+
+START_TEST(test_sub_signal_sleep)
+{
+  for(;;)
+    sleep(1);
+}
+END_TEST
+
+static Suite *make_jobs_timeout_suite (void)
+{
+  Suite *s;
+  TCase *tc_short;
+  TCase *tc_long;
+
+  s = suite_create("Jobs Timeout");
+
+  tc_short = tcase_create("Short");
+  tcase_set_timeout(tc_short, 0.2);
+  tcase_add_loop_test(tc_short, test_sub_odd_sleep, 0, 12);
+  tcase_add_test_raise_signal(tc_short, test_sub_signal_sleep, SIGUSR1);
+  suite_add_tcase(s, tc_short);
+
+  tc_long = tcase_create("Long");
+  tcase_set_timeout(tc_long, 5);
+  tcase_add_test(tc_long, test_sub_short_sleep);
+  suite_add_tcase(s, tc_long);
+
+  return s;
+}
+
+/* Each test is killed at its own deadline, and only that test */
+START_TEST(test_jobs_timeouts)
+{
+  char signal_timeout_msg[100];
+  TestResult **trs;
+  SRunner *sr;
+  int i;
+
+  snprintf(signal_timeout_msg, sizeof(signal_timeout_msg),
+           "Test timeout expired, expected signal %d (%s)",
+           SIGUSR1, strsignal(SIGUSR1));
+
+  sr = srunner_create(make_jobs_timeout_suite());
+  srunner_set_fork_status(sr, CK_FORK);
+  srunner_set_jobs(sr, _i % 2 == 0 ? 1 : 16);
+  srunner_set_fork_server(sr, _i >= 2);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 14);
+  trs = srunner_results(sr);
+  for(i = 0; i < 12; i++)
+  {
+    ck_assert_int_eq(tr_rtype(trs[i]), i % 2 == 1 ? CK_ERROR : CK_PASS);
+    ck_assert_str_eq(tr_msg(trs[i]),
+                     i % 2 == 1 ? "Test timeout expired" : "Passed");
+  }
+  ck_assert_int_eq(tr_rtype(trs[12]), CK_ERROR);
+  ck_assert_str_eq(tr_msg(trs[12]), signal_timeout_msg);
+  ck_assert_int_eq(tr_rtype(trs[13]), CK_PASS);
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+static void tcase_sub_crash_setup (void)
+{
+  raise(SIGSEGV);
+}
+
+static void tcase_sub_fail_teardown (void)
+{
+  ck_abort_msg("unchecked teardown failure");
+}
+
+static Suite *make_tcase_sub_suite (void)
+{
+  Suite *s;
+  TCase *tc;
+  int i;
+
+  s = suite_create("Tcase Sub");
+
+  /* Each one sees only its own unchecked setup */
+  for(i = 0; i < 3; i++)
+  {
+    tc = tcase_create("Fixture");
+    tcase_add_unchecked_fixture(tc, jobs_sub_unchecked_setup, NULL);
+    tcase_add_test(tc, test_sub_slow_fail);
+    tcase_add_test(tc, test_sub_pass);
+    suite_add_tcase(s, tc);
+  }
+
+  tc = tcase_create("Crash");
+  tcase_add_unchecked_fixture(tc, tcase_sub_crash_setup, NULL);
+  tcase_add_test(tc, test_sub_pass);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("Teardown");
+  tcase_add_unchecked_fixture(tc, jobs_sub_unchecked_setup,
+                              tcase_sub_fail_teardown);
+  tcase_set_timeout(tc, 0.2);
+  tcase_add_loop_test(tc, test_sub_loop, 1, 3);
+  tcase_add_test(tc, test_sub_timeout);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+/* Run with 1 or 4 jobs, and in CK_FORK or CK_FORK_BATCH mode */
+START_TEST(test_fork_tcase)
+{
+  const char *expected[][3] = {
+    { "test_sub_slow_fail", "F", "slow failure" },
+    { "test_sub_pass", "P", "Passed" },
+    { "test_sub_slow_fail", "F", "slow failure" },
+    { "test_sub_pass", "P", "Passed" },
+    { "test_sub_slow_fail", "F", "slow failure" },
+    { "test_sub_pass", "P", "Passed" },
+    { "unchecked_setup", "E", "Received signal 11 (Segmentation fault)" },
+    { "test_sub_loop", "P", "Passed" },
+    { "test_sub_loop", "F", "Assertion '_i != 2' failed: _i == 2, 2 == 2" },
+    { "test_sub_timeout", "E", "Test timeout expired" },
+    { "unchecked_teardown", "F", "unchecked teardown failure" }
+  };
+  int nexpected = sizeof(expected) / sizeof(expected[0]);
+  TestResult **trs;
+  SRunner *sr;
+  int i;
+
+  unchecked_setup_count = 0;
+  sr = srunner_create(make_tcase_sub_suite());
+  srunner_set_fork_status(sr, _i < 2 ? CK_FORK : CK_FORK_BATCH);
+  srunner_set_jobs(sr, _i % 2 == 0 ? 1 : 4);
+  srunner_set_fork_tcase(sr, 1);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(unchecked_setup_count, 0);
+  ck_assert_int_eq(srunner_ntests_run(sr), nexpected);
+  trs = srunner_results(sr);
+  for(i = 0; i < nexpected; i++)
+  {
+    const char *rtype = tr_rtype(trs[i]) == CK_PASS ? "P" :
+      tr_rtype(trs[i]) == CK_FAILURE ? "F" : "E";
+
+    ck_assert_str_eq(trs[i]->tname, expected[i][0]);
+    ck_assert_str_eq(rtype, expected[i][1]);
+    ck_assert_str_eq(tr_msg(trs[i]), expected[i][2]);
+  }
+  ck_assert_int_eq(tr_ctx(trs[6]), CK_CTX_SETUP);
+  ck_assert_int_eq(tr_ctx(trs[10]), CK_CTX_TEARDOWN);
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+static int lpt_pipe[2];
+
+static void lpt_record (char c)
+{
+  ck_assert_int_eq(write(lpt_pipe[1], &c, 1), 1);
+}
+
+/* Records when it ends, the long one when it starts */
+START_TEST(test_sub_lpt_short)
+{
+  usleep(50 * 1000);
+  lpt_record('s');
+}
+END_TEST
+
+START_TEST(test_sub_lpt_long)
+{
+  lpt_record('L');
+  usleep(150 * 1000);
+}
+END_TEST
+
+/*
+ * With a duration history the longest tests start first, the results
+ * keep their order. With 2 jobs, or with a process per test case.
+ */
+START_TEST(test_jobs_longest_first)
+{
+  char fname[64];
+  char order[8];
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+  int run;
+
+  pid_fname(fname, sizeof(fname), "test_durations_lpt");
+  remove(fname);
+  ck_assert_int_eq(pipe(lpt_pipe), 0);
+
+  for(run = 0; run < 2; run++)
+  {
+    TestResult **trs;
+    int n;
+
+    s = suite_create("Lpt Sub");
+    tc = tcase_create("Short");
+    tcase_add_test(tc, test_sub_lpt_short);
+    suite_add_tcase(s, tc);
+    tc = tcase_create("Mixed");
+    tcase_add_test(tc, test_sub_lpt_short);
+    tcase_add_test(tc, test_sub_lpt_short);
+    tcase_add_test(tc, test_sub_lpt_long);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_FORK);
+    srunner_set_jobs(sr, _i == 0 ? 2 : 1);
+    srunner_set_fork_tcase(sr, _i);
+    srunner_set_duration_file(sr, fname);
+    srunner_run(sr, "Lpt Sub", NULL, CK_SILENT);
+
+    ck_assert_int_eq(srunner_ntests_failed(sr), 0);
+    trs = srunner_results(sr);
+    ck_assert_str_eq(trs[3]->tname, "test_sub_lpt_long");
+    free(trs);
+    srunner_free(sr);
+
+    n = read(lpt_pipe[0], order, sizeof(order) - 1);
+    ck_assert_int_eq(n, 4);
+    order[n] = '\0';
+    if(run == 0)
+      ck_assert_msg(order[0] == 's', "Started in order %s", order);
+    else
+      ck_assert_str_eq(order, _i == 0 ? "Lsss" : "ssLs");
+  }
+
+  close(lpt_pipe[0]);
+  close(lpt_pipe[1]);
+  remove(fname);
+}
+END_TEST
+
+START_TEST(test_sub_stop_pass)
+{
+}
+END_TEST
+
+START_TEST(test_sub_stop_fail)
+{
+  ck_abort_msg("stop failure");
+}
+END_TEST
+
+/* Runs until it is killed, unless the run stopped before it */
+START_TEST(test_sub_stop_hang)
+{
+  for(;;)
+    sleep(1);
+}
+END_TEST
+
+static Suite *make_stop_sub_suite (void)
+{
+  Suite *s;
+  TCase *tc;
+
+  s = suite_create("Stop Sub");
+
+  tc = tcase_create("First");
+  tcase_add_test(tc, test_sub_stop_pass);
+  tcase_add_test(tc, test_sub_stop_fail);
+  tcase_add_test(tc, test_sub_stop_pass);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("Second");
+  tcase_set_timeout(tc, 30);
+  tcase_add_test(tc, test_sub_stop_fail);
+  tcase_add_test(tc, test_sub_stop_hang);
+  tcase_add_test(tc, test_sub_stop_hang);
+  suite_add_tcase(s, tc);
+
+  tc = tcase_create("Third");
+  tcase_set_timeout(tc, 30);
+  tcase_add_unchecked_fixture(tc, jobs_sub_unchecked_setup, NULL);
+  tcase_add_test(tc, test_sub_stop_hang);
+  suite_add_tcase(s, tc);
+
+  return s;
+}
+
+/*
+ * The run stops at the second failure, in every mode. The tests which
+ * run at the time are killed, and logged as skipped like the rest.
+ */
+START_TEST(test_max_failures)
+{
+  const char *fname = "test_max_failures.tap";
+  char line[256];
+  int nskip_lines = 0;
+  TestResult **trs;
+  SRunner *sr;
+  FILE *f;
+
+  unchecked_setup_count = 0;
+  sr = srunner_create(make_stop_sub_suite());
+  srunner_set_fork_status(sr, _i == 0 ? CK_NOFORK :
+                          _i == 3 ? CK_FORK_BATCH : CK_FORK);
+  srunner_set_jobs(sr, _i == 2 || _i == 5 ? 4 : 1);
+  srunner_set_fork_tcase(sr, _i >= 4);
+  srunner_set_max_failures(sr, 2);
+  srunner_set_tap(sr, fname);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(unchecked_setup_count, 0);
+  ck_assert_int_eq(srunner_ntests_run(sr), 4);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 2);
+  ck_assert_int_eq(srunner_ntests_skipped(sr), 3);
+  trs = srunner_results(sr);
+  ck_assert_str_eq(trs[3]->tcname, "Second");
+  ck_assert_int_eq(tr_rtype(trs[3]), CK_FAILURE);
+  free(trs);
+  srunner_free(sr);
+
+  f = fopen(fname, "r");
+  ck_assert_ptr_ne(f, NULL);
+  while(fgets(line, sizeof(line), f) != NULL)
+  {
+    if(strstr(line, " # SKIP Not run after 2 failures") != NULL)
+      nskip_lines++;
+  }
+  ck_assert_str_eq(line, "1..7\n");
+  fclose(f);
+  remove(fname);
+  ck_assert_int_eq(nskip_lines, 3);
+}
+END_TEST
+
+/* The iterations before the failing one pass, but take longer */
+START_TEST(test_sub_loop_fail_fast)
+{
+  if(_i < 3)
+    usleep(100 * 1000);
+  ck_assert_int_lt(_i, 3);
+}
+END_TEST
+
+START_TEST(test_loop_fail_fast)
+{
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+
+  s = suite_create("Loop Sub");
+  tc = tcase_create("Loop");
+  tcase_set_loop_fail_fast(tc, 1);
+  tcase_add_loop_test(tc, test_sub_loop_fail_fast, 0, 10);
+  tcase_add_test(tc, test_sub_stop_pass);
+  suite_add_tcase(s, tc);
+
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, _i == 0 ? CK_NOFORK :
+                          _i == 3 ? CK_FORK_BATCH : CK_FORK);
+  srunner_set_jobs(sr, _i == 2 ? 4 : 1);
+  srunner_set_fork_tcase(sr, _i == 4);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 5);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 1);
+  ck_assert_int_eq(srunner_ntests_skipped(sr), 6);
+  srunner_free(sr);
+}
+END_TEST
+
+START_TEST(test_sub_chunk_loop)
+{
+  if(_i == 7)
+    ck_abort_msg("chunk failure");
+  if(_i == 20)
+    raise(SIGSEGV);
+  if(_i == 33)
+    for(;;)
+      sleep(1);
+  if(_i == 45)
+    exit(3);
+}
+END_TEST
+
+START_TEST(test_loop_chunks)
+{
+  TestResult **trs;
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+  int i;
+
+  s = suite_create("Chunk Sub");
+  tc = tcase_create("Chunk");
+  tcase_set_timeout(tc, 1);
+  tcase_add_loop_test(tc, test_sub_chunk_loop, 0, 60);
+  suite_add_tcase(s, tc);
+
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, CK_FORK);
+  srunner_set_jobs(sr, 4);
+  srunner_set_loop_chunks(sr, _i != 0);
+  srunner_set_fork_server(sr, _i == 2);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 60);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 4);
+  trs = srunner_results(sr);
+  for(i = 0; i < 60; i++)
+  {
+    ck_assert_int_eq(trs[i]->iter, i);
+    if(i != 7 && i != 20 && i != 33 && i != 45)
+      ck_assert_int_eq(tr_rtype(trs[i]), CK_PASS);
+  }
+  ck_assert_str_eq(tr_msg(trs[7]), "chunk failure");
+  ck_assert_int_eq(tr_rtype(trs[20]), CK_ERROR);
+  ck_assert_str_eq(tr_msg(trs[33]), "Test timeout expired");
+  ck_assert_str_eq(tr_msg(trs[45]), "Early exit with return value 3");
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+
+START_TEST(test_sub_batch_count)
+{
+  static int runs;
+
+  /* Fails in every second iteration of a process */
+  ck_assert_int_eq(++runs % 2, 1);
+}
+END_TEST
+
+START_TEST(test_batched_loop)
+{
+  const char *batched = "PFPFP";
+  TestResult **trs;
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+  int i;
+
+  s = suite_create("Batch Sub");
+  tc = tcase_create("Batch");
+  tcase_set_timeout(tc, 1);
+  tcase_add_batched_loop_test(tc, test_sub_chunk_loop, 0, 60);
+  tcase_add_batched_loop_test(tc, test_sub_batch_count, 0, 5);
+  suite_add_tcase(s, tc);
+
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, CK_FORK);
+  srunner_set_jobs(sr, _i == 1 ? 4 : 1);
+  srunner_set_fork_tcase(sr, _i == 2);
+  srunner_set_fork_server(sr, _i == 3);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 65);
+  trs = srunner_results(sr);
+  for(i = 0; i < 60; i++)
+  {
+    ck_assert_int_eq(trs[i]->iter, i);
+    if(i != 7 && i != 20 && i != 33 && i != 45)
+      ck_assert_int_eq(tr_rtype(trs[i]), CK_PASS);
+  }
+  ck_assert_str_eq(tr_msg(trs[7]), "chunk failure");
+  ck_assert_int_eq(tr_rtype(trs[20]), CK_ERROR);
+  ck_assert_str_eq(tr_msg(trs[33]), "Test timeout expired");
+  ck_assert_str_eq(tr_msg(trs[45]), "Early exit with return value 3");
+
+  /* A fork server forks every iteration, chunks may have one each */
+  for(i = 0; i < 5; i++)
+  {
+    const char *rtype = tr_rtype(trs[60 + i]) == CK_PASS ? "P" : "F";
+
+    ck_assert_int_eq(trs[60 + i]->iter, i);
+    if(_i == 0 || _i == 2)
+      ck_assert_int_eq(rtype[0], batched[i]);
+    else if(_i == 3)
+      ck_assert_str_eq(rtype, "P");
+  }
+  free(trs);
+  srunner_free(sr);
+}
+END_TEST
+START_TEST(test_sub_stream_loop)
+{
+  ck_assert_int_ne(_i % 50, 7);
+}
+END_TEST
+
+/*
+ * Streamed passes are counted and logged, but only the failures are
+ * kept, and they share their file name.
+ */
+START_TEST(test_stream_results)
+{
+  const char *fname = "test_stream_results.tap";
+  char line[256];
+  int nok_lines = 0;
+  TestResult **trs;
+  SRunner *sr;
+  Suite *s;
+  TCase *tc;
+  FILE *f;
+  int i;
+
+  s = suite_create("Stream Sub");
+  tc = tcase_create("Stream");
+  tcase_add_loop_test(tc, test_sub_stream_loop, 0, 200);
+  suite_add_tcase(s, tc);
+
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, _i == 0 ? CK_NOFORK :
+                          _i == 3 ? CK_FORK_BATCH : CK_FORK);
+  srunner_set_jobs(sr, _i == 2 ? 4 : 1);
+  srunner_set_fork_tcase(sr, _i == 4);
+  srunner_set_stream_results(sr, 1);
+  srunner_set_tap(sr, fname);
+  srunner_run_all(sr, CK_SILENT);
+
+  ck_assert_int_eq(srunner_ntests_run(sr), 200);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 4);
+  trs = srunner_results(sr);
+  for(i = 0; i < 4; i++)
+  {
+    ck_assert_int_eq(tr_rtype(trs[i]), CK_FAILURE);
+    ck_assert_int_eq(trs[i]->iter, 50 * i + 7);
+    ck_assert_ptr_eq(tr_lfile(trs[i]), tr_lfile(trs[0]));
+  }
+  free(trs);
+  trs = srunner_failures(sr);
+  ck_assert_int_eq(trs[3]->iter, 157);
+  free(trs);
+  srunner_free(sr);
+
+  f = fopen(fname, "r");
+  ck_assert_ptr_ne(f, NULL);
+  while(fgets(line, sizeof(line), f) != NULL)
+  {
+    if(strncmp(line, "ok ", 3) == 0)
+      nok_lines++;
+  }
+  fclose(f);
+  remove(fname);
+  ck_assert_int_eq(nok_lines, 196);
+}
+END_TEST
+
+#endif /* HAVE_FORK */
+
+Suite *make_jobs_suite(void)
+{
+  Suite *s;
+  TCase *tc;
+
+  s = suite_create("Jobs");
+  tc = tcase_create("Core");
+  tcase_add_checked_fixture(tc, jobs_setup, jobs_teardown);
+  tcase_add_test(tc, test_jobs_default);
+  tcase_add_test(tc, test_jobs_env);
+  tcase_add_test(tc, test_jobs_env_and_set);
+  tcase_add_test(tc, test_fork_server_env);
+  tcase_add_test(tc, test_fork_tcase_env);
+  tcase_add_test(tc, test_loop_chunks_env);
+  tcase_add_test(tc, test_max_failures_env);
+  tcase_add_test(tc, test_stream_results_env);
+#if defined(HAVE_FORK) && HAVE_FORK==1
+  tcase_add_loop_test(tc, test_jobs_results_in_order, 0, 4);
+  tcase_add_loop_test(tc, test_jobs_timeouts, 0, 4);
+  tcase_add_loop_test(tc, test_fork_tcase, 0, 4);
+  tcase_add_loop_test(tc, test_jobs_longest_first, 0, 2);
+  tcase_add_loop_test(tc, test_max_failures, 0, 6);
+  tcase_add_loop_test(tc, test_loop_fail_fast, 0, 5);
+  tcase_add_loop_test(tc, test_loop_chunks, 0, 3);
+  tcase_add_loop_test(tc, test_batched_loop, 0, 4);
+  tcase_add_loop_test(tc, test_stream_results, 0, 5);
+#endif /* HAVE_FORK */
+  suite_add_tcase(s, tc);
+
+  return s;
+}
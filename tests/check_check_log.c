@@ -20,6 +20,7 @@
 
 #include "../lib/libcompat.h"
 
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -49,6 +50,26 @@ static int restore_env(const char *name, const char *old_value)
 }
 #endif /* HAVE_DECL_SETENV */
 
+/* The contents of a file, which is removed */
+static char *read_file(const char *fname)
+{
+  char *buf;
+  long len;
+  FILE *f;
+
+  f = fopen(fname, "rb");
+  ck_assert_ptr_ne(f, NULL);
+  ck_assert_int_eq(fseek(f, 0, SEEK_END), 0);
+  len = ftell(f);
+  rewind(f);
+  buf = (char *)malloc(len + 1);
+  ck_assert_int_eq(fread(buf, 1, len, f), len);
+  buf[len] = '\0';
+  fclose(f);
+  remove(fname);
+  return buf;
+}
+
 START_TEST(test_set_log)
 {
   Suite *s = suite_create("Suite");
@@ -275,16 +296,706 @@ START_TEST(test_double_set_tap)
 }
 END_TEST
 
+START_TEST(test_set_junit)
+{
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  srunner_set_junit (sr, "test_log.junit.xml");
+
+  ck_assert_msg (srunner_has_junit (sr), "SRunner not logging JUnit XML");
+  ck_assert_msg (strcmp(srunner_junit_fname(sr), "test_log.junit.xml") == 0,
+               "Bad file name returned");
+
+  srunner_free(sr);
+}
+END_TEST
+
+#if HAVE_DECL_SETENV
+/* Test enabling JUnit XML logging via environment variable */
+START_TEST(test_set_junit_env)
+{
+  const char *old_val;
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  /* check that setting JUnit log file via environment variable works */
+  ck_assert_msg(save_set_env("CK_JUNIT_LOG_FILE_NAME", "test_log.junit.xml",
+                             &old_val) == 0,
+              "Failed to set environment variable");
+
+  ck_assert_msg (srunner_has_junit (sr), "SRunner not logging JUnit XML");
+  ck_assert_msg (strcmp(srunner_junit_fname(sr), "test_log.junit.xml") == 0,
+               "Bad file name returned");
+
+  /* check that explicit call to srunner_set_junit()
+     overrides environment variable */
+  srunner_set_junit (sr, "test2_log.junit.xml");
+
+  ck_assert_msg (srunner_has_junit (sr), "SRunner not logging JUnit XML");
+  ck_assert_msg (strcmp(srunner_junit_fname(sr), "test2_log.junit.xml") == 0,
+               "Bad file name returned");
+
+  /* restore old environment */
+  ck_assert_msg(restore_env("CK_JUNIT_LOG_FILE_NAME", old_val) == 0,
+              "Failed to restore environment variable");
+
+  srunner_free(sr);
+}
+END_TEST
+#endif /* HAVE_DECL_SETENV */
+
+START_TEST(test_no_set_junit)
+{
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  ck_assert_msg (!srunner_has_junit (sr), "SRunner not logging JUnit XML");
+  ck_assert_msg (srunner_junit_fname(sr) == NULL, "Bad file name returned");
+
+  srunner_free(sr);
+}
+END_TEST
+
+START_TEST(test_double_set_junit)
+{
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  srunner_set_junit (sr, "test_log.junit.xml");
+  srunner_set_junit (sr, "test2_log.junit.xml");
+
+  ck_assert_msg(strcmp(srunner_junit_fname(sr), "test_log.junit.xml") == 0,
+	      "JUnit Log file is initialize only and shouldn't be changeable once set");
+
+  srunner_free(sr);
+}
+END_TEST
+
+START_TEST(test_set_duration_file)
+{
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  srunner_set_duration_file (sr, "test_durations");
+
+  ck_assert_msg (srunner_has_duration_file (sr),
+               "SRunner not keeping durations");
+  ck_assert_msg (strcmp(srunner_duration_fname(sr), "test_durations") == 0,
+               "Bad file name returned");
+
+  srunner_free(sr);
+}
+END_TEST
+
+#if HAVE_DECL_SETENV
+/* Test keeping durations via environment variable */
+START_TEST(test_set_duration_file_env)
+{
+  const char *old_val;
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  ck_assert_msg(save_set_env("CK_DURATION_FILE_NAME", "test_durations",
+                             &old_val) == 0,
+              "Failed to set environment variable");
+
+  ck_assert_msg (srunner_has_duration_file (sr),
+               "SRunner not keeping durations");
+  ck_assert_msg (strcmp(srunner_duration_fname(sr), "test_durations") == 0,
+               "Bad file name returned");
+
+  /* check that explicit call to srunner_set_duration_file()
+     overrides environment variable */
+  srunner_set_duration_file (sr, "test2_durations");
+
+  ck_assert_msg (strcmp(srunner_duration_fname(sr), "test2_durations") == 0,
+               "Bad file name returned");
+
+  /* restore old environment */
+  ck_assert_msg(restore_env("CK_DURATION_FILE_NAME", old_val) == 0,
+              "Failed to restore environment variable");
+
+  srunner_free(sr);
+}
+END_TEST
+#endif /* HAVE_DECL_SETENV */
+
+START_TEST(test_no_set_duration_file)
+{
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  ck_assert_msg (!srunner_has_duration_file (sr),
+               "SRunner keeping durations");
+  ck_assert_msg (srunner_duration_fname(sr) == NULL,
+               "Bad file name returned");
+
+  srunner_free(sr);
+}
+END_TEST
+
+START_TEST(test_double_set_duration_file)
+{
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  srunner_set_duration_file (sr, "test_durations");
+  srunner_set_duration_file (sr, "test2_durations");
+
+  ck_assert_msg(strcmp(srunner_duration_fname(sr), "test_durations") == 0,
+              "Duration file is initialize only and shouldn't be changeable once set");
+
+  srunner_free(sr);
+}
+END_TEST
+
+START_TEST(test_duration_sub_pass)
+{
+}
+END_TEST
+
+/* The file is written by every run, and a bad one is replaced */
+START_TEST(test_duration_file_written)
+{
+  char fname[64];
+  char magic[4];
+  Suite *s;
+  TCase *tc;
+  SRunner *sr;
+  FILE *f;
+  int i;
+
+  pid_fname(fname, sizeof(fname), "test_durations_written");
+  f = fopen(fname, "w");
+  ck_assert_ptr_ne(f, NULL);
+  fputs("not a duration history", f);
+  fclose(f);
+
+  for (i = 0; i < 2; i++) {
+    s = suite_create("Duration Sub");
+    tc = tcase_create("Core");
+    tcase_add_loop_test(tc, test_duration_sub_pass, 0, 3);
+    suite_add_tcase(s, tc);
+    sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_set_duration_file(sr, fname);
+    srunner_run(sr, "Duration Sub", NULL, CK_SILENT);
+    ck_assert_int_eq(srunner_ntests_run(sr), 3);
+    srunner_free(sr);
+
+    f = fopen(fname, "rb");
+    ck_assert_ptr_ne(f, NULL);
+    ck_assert_int_eq(fread(magic, 1, 4, f), 4);
+    ck_assert_int_eq(memcmp(magic, "CKDH", 4), 0);
+    /* the magic, and 3 tests with i + 1 durations of 4 bytes each */
+    ck_assert_int_eq(fseek(f, 0, SEEK_END), 0);
+    ck_assert_int_eq(ftell(f), 8 + 3 * (9 + 4 * (i + 1)));
+    fclose(f);
+  }
+
+  remove(fname);
+}
+END_TEST
+
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+/*
+ * The resource usage of a forked test is only logged, on a line of the
+ * log and in an element of the XML log, once it is enabled.
+ */
+START_TEST(test_rusage_output)
+{
+  char log_fname[64], xml_fname[64];
+  char *log, *xml;
+  Suite *s;
+  TCase *tc;
+  SRunner *sr;
+
+  pid_fname(log_fname, sizeof(log_fname), "test_rusage_output.log");
+  pid_fname(xml_fname, sizeof(xml_fname), "test_rusage_output.xml");
+  s = suite_create("Rusage Sub");
+  tc = tcase_create("Core");
+  tcase_add_test(tc, test_duration_sub_pass);
+  suite_add_tcase(s, tc);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, CK_FORK);
+  srunner_set_rusage(sr, _i);
+  ck_assert_int_eq(srunner_rusage(sr), _i);
+  srunner_set_log(sr, log_fname);
+  srunner_set_xml(sr, xml_fname);
+  srunner_run(sr, "Rusage Sub", NULL, CK_SILENT);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 0);
+  srunner_free(sr);
+
+  log = read_file(log_fname);
+  xml = read_file(xml_fname);
+#if HAVE_WAIT4 && HAVE_SYS_RESOURCE_H
+  if (_i)
+  {
+    ck_assert_msg(strstr(log, "\ntest_duration_sub_pass:0: Usage: user ")
+                  != NULL, "%s", log);
+    ck_assert_msg(strstr(log, "kB, minflt ") != NULL, "%s", log);
+    ck_assert_msg(strstr(xml, "      <rusage utime=\"") != NULL, "%s", xml);
+    ck_assert_msg(strstr(xml, "\" oublock=\"") != NULL, "%s", xml);
+  }
+  else
+#endif /* HAVE_WAIT4 && HAVE_SYS_RESOURCE_H */
+  {
+    ck_assert_msg(strstr(log, ": Usage: ") == NULL, "%s", log);
+    ck_assert_msg(strstr(xml, "<rusage") == NULL, "%s", xml);
+  }
+  free(log);
+  free(xml);
+}
+END_TEST
+#endif /* HAVE_FORK */
+
+#if HAVE_DECL_SETENV
+START_TEST(test_rusage_env)
+{
+  const char *old_rusage;
+  SRunner *sr = srunner_create(suite_create("Suite"));
+
+  ck_assert_int_eq(srunner_rusage(sr), 0);
+  ck_assert_msg(save_set_env("CK_RUSAGE", "yes", &old_rusage) == 0,
+                "Failed to set environment variable");
+  ck_assert_int_eq(srunner_rusage(sr), 1);
+  srunner_set_rusage(sr, 0);
+  ck_assert_int_eq(srunner_rusage(sr), 0);
+  srunner_set_rusage(sr, -1);
+  ck_assert_int_eq(srunner_rusage(sr), 1);
+  ck_assert_msg(restore_env("CK_RUSAGE", old_rusage) == 0,
+                "Failed to restore environment variable");
+  srunner_free(sr);
+}
+END_TEST
+#endif /* HAVE_DECL_SETENV */
+
+START_TEST(test_set_bench_file)
+{
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  srunner_set_bench_file (sr, "test_bench.json");
+
+  ck_assert_msg (srunner_has_bench_file (sr),
+               "SRunner not writing benchmarks");
+  ck_assert_msg (strcmp(srunner_bench_fname(sr), "test_bench.json") == 0,
+               "Bad file name returned");
+
+  srunner_free(sr);
+}
+END_TEST
+
+START_TEST(test_bench_sub_op)
+{
+  volatile int n = _i;
+
+  n++;
+}
+END_TEST
+
+/* The file has an object for each benchmark, but not for tests */
+START_TEST(test_bench_file_written)
+{
+  char fname[64];
+  char buf[4096];
+  Suite *s;
+  TCase *tc;
+  SRunner *sr;
+  FILE *f;
+  size_t n;
+
+  pid_fname(fname, sizeof(fname), "test_bench_written.json");
+  s = suite_create("Bench Sub");
+  tc = tcase_create("Core");
+  tcase_add_bench(tc, test_bench_sub_op);
+  tcase_add_test(tc, test_duration_sub_pass);
+  suite_add_tcase(s, tc);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, CK_NOFORK);
+  srunner_set_bench_file(sr, fname);
+  setenv("CK_BENCH_TIME", "0.01", 1);
+  setenv("CK_BENCH_SAMPLES", "5", 1);
+  srunner_run(sr, "Bench Sub", NULL, CK_SILENT);
+  unsetenv("CK_BENCH_TIME");
+  unsetenv("CK_BENCH_SAMPLES");
+  ck_assert_int_eq(srunner_ntests_failed(sr), 0);
+  srunner_free(sr);
+
+  f = fopen(fname, "r");
+  ck_assert_ptr_ne(f, NULL);
+  n = fread(buf, 1, sizeof(buf) - 1, f);
+  buf[n] = '\0';
+  fclose(f);
+  ck_assert_ptr_ne(strstr(buf, "\"benchmarks\": ["), NULL);
+  ck_assert_ptr_ne(strstr(buf, "\"suite\": \"Bench Sub\""), NULL);
+  ck_assert_ptr_ne(strstr(buf, "\"name\": \"test_bench_sub_op\""), NULL);
+  ck_assert_ptr_eq(strstr(buf, "test_duration_sub_pass"), NULL);
+
+  remove(fname);
+}
+END_TEST
+
+START_TEST(test_set_bench_baseline)
+{
+  Suite *s = suite_create("Suite");
+  SRunner *sr = srunner_create(s);
+
+  srunner_set_bench_save (sr, "test_baseline");
+  srunner_set_bench_compare (sr, "test_baseline2");
+  srunner_set_bench_save (sr, "test_baseline3");
+
+  ck_assert_msg (srunner_has_bench_save (sr),
+               "SRunner not saving benchmarks");
+  ck_assert_msg (srunner_has_bench_compare (sr),
+               "SRunner not comparing benchmarks");
+  ck_assert_str_eq (srunner_bench_save_fname (sr), "test_baseline");
+  ck_assert_str_eq (srunner_bench_compare_fname (sr), "test_baseline2");
+
+  srunner_free(sr);
+}
+END_TEST
+
+static int bench_work;
+
+START_BENCH(test_bench_sub_work)
+{
+  volatile int n = 0;
+  int k;
+
+  for (k = 0; k < bench_work; k++)
+    n += k;
+}
+END_BENCH
+
+static SRunner *run_baseline_sub(const char *fname, int work, int save)
+{
+  Suite *s;
+  TCase *tc;
+  SRunner *sr;
+
+  s = suite_create("Baseline Sub");
+  tc = tcase_create("Core");
+  tcase_add_bench(tc, test_bench_sub_work);
+  suite_add_tcase(s, tc);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, CK_NOFORK);
+  if (save)
+    srunner_set_bench_save(sr, fname);
+  srunner_set_bench_compare(sr, fname);
+  srunner_set_bench_thresholds(sr, 5, 0.01);
+  bench_work = work;
+  srunner_run(sr, "Baseline Sub", NULL, CK_SILENT);
+  ck_assert_int_eq(srunner_ntests_run(sr), 1);
+  return sr;
+}
+
+/*
+ * A benchmark far slower than its baseline fails, and does not replace
+ * the samples it was compared to.
+ */
+START_TEST(test_bench_baseline)
+{
+  char fname[64];
+  TestResult **trs;
+  SRunner *sr;
+
+  pid_fname(fname, sizeof(fname), "test_bench_baseline");
+  remove(fname);
+  setenv("CK_BENCH_TIME", "0.02", 1);
+
+  /* Nothing to compare to yet */
+  sr = run_baseline_sub(fname, 100, 1);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 0);
+  srunner_free(sr);
+
+  sr = run_baseline_sub(fname, 5000, 1);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 1);
+  trs = srunner_results(sr);
+  ck_assert_int_eq(tr_rtype(trs[0]), CK_FAILURE);
+  ck_assert_msg(strncmp(tr_msg(trs[0]), "median ", 7) == 0, "%s",
+                tr_msg(trs[0]));
+  ck_assert_ptr_ne(strstr(tr_msg(trs[0]), "x slower than baseline (p<0.01)"),
+                   NULL);
+  ck_assert_ptr_ne(tr_bench(trs[0]), NULL);
+  free(trs);
+  srunner_free(sr);
+
+  sr = run_baseline_sub(fname, 5000, 0);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 1);
+  srunner_free(sr);
+
+  sr = run_baseline_sub(fname, 100, 0);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 0);
+  srunner_free(sr);
+
+  unsetenv("CK_BENCH_TIME");
+  remove(fname);
+}
+END_TEST
+
+#if HAVE_DECL_SETENV
+START_TEST(test_buffered_logs_env)
+{
+  const char *old_buffered, *old_thread;
+  SRunner *sr = srunner_create(suite_create("Suite"));
+
+  ck_assert_msg(save_set_env("CK_BUFFERED_LOGS", "yes", &old_buffered) == 0,
+                "Failed to set environment variable");
+  ck_assert_msg(save_set_env("CK_LOG_THREAD", "no", &old_thread) == 0,
+                "Failed to set environment variable");
+  ck_assert_int_eq(srunner_buffered_logs(sr), 1);
+  ck_assert_int_eq(srunner_log_thread(sr), 0);
+  srunner_set_buffered_logs(sr, 0);
+  srunner_set_log_thread(sr, 1);
+  ck_assert_int_eq(srunner_buffered_logs(sr), 0);
+  ck_assert_int_eq(srunner_log_thread(sr), 1);
+  srunner_set_buffered_logs(sr, -1);
+  srunner_set_log_thread(sr, -1);
+  ck_assert_int_eq(srunner_buffered_logs(sr), 1);
+  ck_assert_int_eq(srunner_log_thread(sr), 0);
+  ck_assert_msg(restore_env("CK_BUFFERED_LOGS", old_buffered) == 0,
+                "Failed to restore environment variable");
+  ck_assert_msg(restore_env("CK_LOG_THREAD", old_thread) == 0,
+                "Failed to restore environment variable");
+  srunner_free(sr);
+}
+END_TEST
+#endif /* HAVE_DECL_SETENV */
+
+START_TEST(test_buffered_sub_loop)
+{
+  ck_assert_int_ne(_i % 200, 199);
+}
+END_TEST
+
+static void run_buffered_sub(const char *tap_fname, const char *xml_fname,
+                             enum fork_status fstat, int buffered,
+                             int thread)
+{
+  Suite *s;
+  TCase *tc;
+  SRunner *sr;
+
+  s = suite_create("Buffered Sub");
+  tc = tcase_create("Core");
+  tcase_add_loop_test(tc, test_buffered_sub_loop, 0, 400);
+  suite_add_tcase(s, tc);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, fstat);
+  srunner_set_buffered_logs(sr, buffered);
+  srunner_set_log_thread(sr, thread);
+  srunner_set_tap(sr, tap_fname);
+  srunner_set_xml(sr, xml_fname);
+  srunner_run(sr, "Buffered Sub", NULL, CK_SILENT);
+  ck_assert_int_eq(srunner_ntests_failed(sr), 2);
+  srunner_free(sr);
+}
+
+/*
+ * Buffered logs, written or not by a thread, are the same as the
+ * unbuffered ones once the run has ended, forked or not.
+ */
+START_TEST(test_buffered_logs)
+{
+  enum fork_status fstat = _i % 2 == 0 ? CK_NOFORK : CK_FORK;
+  char tap_fname[64], xml_fname[64];
+  char *tap, *buffered_tap, *xml;
+  const char *end;
+
+  pid_fname(tap_fname, sizeof(tap_fname), "test_buffered_logs.tap");
+  pid_fname(xml_fname, sizeof(xml_fname), "test_buffered_logs.xml");
+  run_buffered_sub(tap_fname, xml_fname, fstat, 0, 0);
+  tap = read_file(tap_fname);
+  free(read_file(xml_fname));
+
+  run_buffered_sub(tap_fname, xml_fname, fstat, _i < 2, _i >= 2);
+  buffered_tap = read_file(tap_fname);
+  xml = read_file(xml_fname);
+
+  ck_assert_str_eq(buffered_tap, tap);
+  ck_assert_int_gt(strlen(xml), 64 * 1024);
+  end = xml + strlen(xml) - strlen("</testsuites>\n");
+  ck_assert_str_eq(end, "</testsuites>\n");
+  free(tap);
+  free(buffered_tap);
+  free(xml);
+}
+END_TEST
+
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+START_TEST(test_buffered_sub_crash)
+{
+  raise(SIGSEGV);
+}
+END_TEST
+
+/*
+ * A test which crashes a run in CK_NOFORK mode leaves the results of
+ * the tests before it in the log, which is not buffered then.
+ */
+START_TEST(test_buffered_logs_nofork_crash)
+{
+  char fname[64];
+  const char *p;
+  char *log;
+  int n = 0;
+  int status;
+  pid_t pid;
+
+  pid_fname(fname, sizeof(fname), "test_buffered_crash.log");
+  pid = fork();
+  ck_assert_int_ne(pid, -1);
+  if(pid == 0)
+  {
+    Suite *s = suite_create("Crash Sub");
+    TCase *tc = tcase_create("Core");
+    SRunner *sr;
+
+    tcase_add_loop_test(tc, test_duration_sub_pass, 0, 50);
+    tcase_add_test(tc, test_buffered_sub_crash);
+    suite_add_tcase(s, tc);
+    sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_set_buffered_logs(sr, 1);
+    srunner_set_log(sr, fname);
+    srunner_run_all(sr, CK_SILENT);
+    _exit(0);
+  }
+  ck_assert_int_eq(waitpid(pid, &status, 0), pid);
+  ck_assert(WIFSIGNALED(status));
+
+  log = read_file(fname);
+  for(p = strstr(log, ": Passed\n"); p != NULL; p = strstr(p + 1, ": Passed\n"))
+    n++;
+  ck_assert_msg(n == 50, "%d results in %s", n, log);
+  free(log);
+}
+END_TEST
+#endif /* HAVE_FORK */
+
+START_TEST(test_junit_sub_loop)
+{
+  ck_assert_msg(_i != 1, "iteration %d of <loop>", _i);
+}
+END_TEST
+
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+START_TEST(test_junit_sub_exit)
+{
+  exit(1);
+}
+END_TEST
+#endif /* HAVE_FORK */
+
+/*
+ * The counts of a suite come before its test cases in the JUnit log,
+ * whether they are written in place in a file or the test cases wait
+ * for them, as they do in a buffered log.
+ */
+START_TEST(test_junit_output)
+{
+  char fname[64];
+  const char *head = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<testsuites>\n  <testsuite name=\"JUnit &lt;Sub&gt;\" timestamp=\"";
+  const char *counts;
+  Suite *s;
+  TCase *tc;
+  SRunner *sr;
+  char *xml;
+
+  pid_fname(fname, sizeof(fname), "test_junit_output.xml");
+  s = suite_create("JUnit <Sub>");
+  tc = tcase_create("Core");
+  tcase_add_loop_test(tc, test_junit_sub_loop, 0, 4);
+  tcase_set_loop_fail_fast(tc, 1);
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+  tcase_add_test(tc, test_junit_sub_exit);
+#endif /* HAVE_FORK */
+  suite_add_tcase(s, tc);
+  sr = srunner_create(s);
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+  srunner_set_fork_status(sr, CK_FORK);
+#endif /* HAVE_FORK */
+  srunner_set_buffered_logs(sr, _i);
+  srunner_set_junit(sr, fname);
+  srunner_run(sr, "JUnit <Sub>", NULL, CK_SILENT);
+  srunner_free(sr);
+
+  xml = read_file(fname);
+  ck_assert_msg(strncmp(xml, head, strlen(head)) == 0, "%s", xml);
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+  counts = _i == 0 ? " tests=\"0000000005\" failures=\"0000000001\""
+    " errors=\"0000000001\" skipped=\"0000000002\" time=\"" :
+    " tests=\"5\" failures=\"1\" errors=\"1\" skipped=\"2\" time=\"";
+#else
+  counts = _i == 0 ? " tests=\"0000000004\" failures=\"0000000001\""
+    " errors=\"0000000000\" skipped=\"0000000002\" time=\"" :
+    " tests=\"4\" failures=\"1\" errors=\"0\" skipped=\"2\" time=\"";
+#endif /* HAVE_FORK */
+  ck_assert_msg(strstr(xml, counts) != NULL, "%s", xml);
+  ck_assert_msg(strstr(xml, "    <testcase classname=\"JUnit &lt;Sub&gt;.Core\""
+                       " name=\"test_junit_sub_loop:0\" time=\"") != NULL,
+                "%s", xml);
+  ck_assert_msg(strstr(xml, "      <failure message=\"iteration 1 of &lt;loop&gt;\""
+                       " type=\"failure\">") != NULL, "%s", xml);
+  ck_assert_msg(strstr(xml, " name=\"test_junit_sub_loop:3\" time=\"0.000000\">\n"
+                       "      <skipped message=\"") != NULL, "%s", xml);
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+  ck_assert_msg(strstr(xml, "      <error message=\"Early exit with return"
+                       " value 1\" type=\"error\">") != NULL, "%s", xml);
+#endif /* HAVE_FORK */
+  ck_assert_str_eq(xml + strlen(xml) - strlen("  </testsuite>\n</testsuites>\n"),
+                   "  </testsuite>\n</testsuites>\n");
+  free(xml);
+}
+END_TEST
+
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+/* The details of a test are escaped like the rest of the JUnit log */
+START_TEST(test_junit_details)
+{
+  char fname[64];
+  Suite *s;
+  TCase *tc;
+  SRunner *sr;
+  char *xml;
+
+  pid_fname(fname, sizeof(fname), "test_junit_details.xml");
+  s = suite_create("JUnit Details");
+  tc = tcase_create("Core");
+  _tcase_add_test(tc, test_duration_sub_pass, "test_<details>", 0, 0, 0, 1);
+  suite_add_tcase(s, tc);
+  sr = srunner_create(s);
+  srunner_set_fork_status(sr, CK_FORK);
+  srunner_set_rusage(sr, 1);
+  srunner_set_junit(sr, fname);
+  srunner_run_all(sr, CK_SILENT);
+  srunner_free(sr);
+
+  xml = read_file(fname);
+  ck_assert_msg(strstr(xml, "      <system-out>test_&lt;details&gt;:0: "
+                       "Usage: user ") != NULL, "%s", xml);
+  free(xml);
+}
+END_TEST
+#endif /* HAVE_FORK */
+
 Suite *make_log_suite(void)
 {
 
   Suite *s;
-  TCase *tc_core, *tc_core_xml, *tc_core_tap;
+  TCase *tc_core, *tc_core_xml, *tc_core_tap, *tc_core_duration;
+  TCase *tc_core_buffered, *tc_core_junit;
 
   s = suite_create("Log");
   tc_core = tcase_create("Core");
   tc_core_xml = tcase_create("Core XML");
   tc_core_tap = tcase_create("Core TAP");
+  tc_core_junit = tcase_create("Core JUnit");
+  tc_core_duration = tcase_create("Core Duration");
+  tc_core_buffered = tcase_create("Core Buffered");
 
   suite_add_tcase(s, tc_core);
   tcase_add_test(tc_core, test_set_log);
@@ -293,6 +1004,12 @@ Suite *make_log_suite(void)
 #endif /* HAVE_DECL_SETENV */
   tcase_add_test(tc_core, test_no_set_log);
   tcase_add_test(tc_core, test_double_set_log);
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+  tcase_add_loop_test(tc_core, test_rusage_output, 0, 2);
+#endif /* HAVE_FORK */
+#if HAVE_DECL_SETENV
+  tcase_add_test(tc_core, test_rusage_env);
+#endif /* HAVE_DECL_SETENV */
 
   suite_add_tcase(s, tc_core_xml);
   tcase_add_test(tc_core_xml, test_set_xml);
@@ -310,6 +1027,44 @@ Suite *make_log_suite(void)
   tcase_add_test(tc_core_tap, test_no_set_tap);
   tcase_add_test(tc_core_tap, test_double_set_tap);
 
+  suite_add_tcase(s, tc_core_junit);
+  tcase_add_test(tc_core_junit, test_set_junit);
+#if HAVE_DECL_SETENV
+  tcase_add_test(tc_core_junit, test_set_junit_env);
+#endif /* HAVE_DECL_SETENV */
+  tcase_add_test(tc_core_junit, test_no_set_junit);
+  tcase_add_test(tc_core_junit, test_double_set_junit);
+  tcase_add_loop_test(tc_core_junit, test_junit_output, 0, 2);
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+  tcase_add_test(tc_core_junit, test_junit_details);
+#endif /* HAVE_FORK */
+
+  suite_add_tcase(s, tc_core_duration);
+  tcase_add_test(tc_core_duration, test_set_duration_file);
+#if HAVE_DECL_SETENV
+  tcase_add_test(tc_core_duration, test_set_duration_file_env);
+#endif /* HAVE_DECL_SETENV */
+  tcase_add_test(tc_core_duration, test_no_set_duration_file);
+  tcase_add_test(tc_core_duration, test_double_set_duration_file);
+  tcase_add_test(tc_core_duration, test_duration_file_written);
+  tcase_add_test(tc_core_duration, test_set_bench_file);
+#if HAVE_DECL_SETENV
+  tcase_add_test(tc_core_duration, test_bench_file_written);
+#endif /* HAVE_DECL_SETENV */
+  tcase_add_test(tc_core_duration, test_set_bench_baseline);
+#if HAVE_DECL_SETENV
+  tcase_add_test(tc_core_duration, test_bench_baseline);
+#endif /* HAVE_DECL_SETENV */
+
+  suite_add_tcase(s, tc_core_buffered);
+#if HAVE_DECL_SETENV
+  tcase_add_test(tc_core_buffered, test_buffered_logs_env);
+#endif /* HAVE_DECL_SETENV */
+  tcase_add_loop_test(tc_core_buffered, test_buffered_logs, 0, 4);
+#if defined(HAVE_FORK) && HAVE_FORK == 1
+  tcase_add_test(tc_core_buffered, test_buffered_logs_nofork_crash);
+#endif /* HAVE_FORK */
+
   return s;
 }
 
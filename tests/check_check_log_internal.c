@@ -29,6 +29,7 @@
 #include <check_list.h>
 #include <check_impl.h>
 #include <check_log.h>
+#include <check_print.h>
 #include "check_check.h"
 
 
@@ -56,9 +57,66 @@ START_TEST(test_init_logging_subunit)
 END_TEST
 #endif
 
+/* What a byte becomes in XML, see fprint_xml_esc() */
+static const char *xml_esc_expected(unsigned char c)
+{
+  switch (c) {
+    case '"': return "&quot;";
+    case '\'': return "&apos;";
+    case '<': return "&lt;";
+    case '>': return "&gt;";
+    case '&': return "&amp;";
+    case '\t': return "&#x9;";
+    case '\n': return "&#xA;";
+    case '\r': return "&#xD;";
+    case 0x7F: return "&#x7F;";
+    default: return "";
+  }
+}
+
+/*
+ * Every byte which is not plain is escaped or left out, wherever it is
+ * in the string and however the string is aligned.
+ */
+START_TEST(test_xml_esc)
+{
+  static const unsigned char specials[] = {
+    '"', '\'', '<', '>', '&', '\t', '\n', '\r', 0x7F, 0x01, 0x1F, 0x80,
+    0xC3, 0xFF
+  };
+  char str[128], expected[160], actual[160];
+  size_t k, n;
+  int pos;
+  FILE *f;
+
+  for (k = 0; k < sizeof(specials); k++) {
+    for (pos = 0; pos < 70; pos++) {
+      char *start = str + _i;
+
+      memset(start, 'a', 70);
+      start[70] = '\0';
+      start[pos] = (char)specials[k];
+      snprintf(expected, sizeof(expected), "%.*s%s%s", pos, start,
+               xml_esc_expected(specials[k]), start + pos + 1);
+
+      f = tmpfile();
+      ck_assert_ptr_ne(f, NULL);
+      fprint_xml_esc(f, start);
+      rewind(f);
+      n = fread(actual, 1, sizeof(actual) - 1, f);
+      actual[n] = '\0';
+      fclose(f);
+      ck_assert_str_eq(actual, expected);
+    }
+  }
+  tr_xmlprint_free();
+}
+END_TEST
+
 Suite *make_log_internal_suite(void)
 {
   Suite *s;
+  TCase *tc_core_xml;
 
 #if ENABLE_SUBUNIT
   TCase *tc_core_subunit;
@@ -69,6 +127,10 @@ Suite *make_log_internal_suite(void)
 #else
   s = suite_create("Log");
 #endif
+
+  tc_core_xml = tcase_create("Core XML Escape");
+  suite_add_tcase(s, tc_core_xml);
+  tcase_add_loop_test(tc_core_xml, test_xml_esc, 0, 32);
   
   return s;
 }
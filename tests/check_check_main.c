@@ -49,6 +49,7 @@ int main (void)
 #endif
 
   srunner_add_suite(sr, make_selective_suite());
+  srunner_add_suite(sr, make_jobs_suite());
   
   printf ("Ran %d tests in subordinate suite\n", sub_ntests);
   srunner_run_all (sr, CK_VERBOSE);
@@ -676,3 +676,9 @@ int get_next_failure_line_num(FILE * file)
 
   return value;
 }
+
+const char *pid_fname(char *buf, size_t size, const char *name)
+{
+  snprintf(buf, size, "%s.%ld", name, (long)getpid());
+  return buf;
+}
@@ -172,6 +172,65 @@ START_TEST(test_send_with_error_teardown)
 END_TEST
 
 
+START_TEST(test_record_shared)
+{
+  TestResult *tr;
+  set_loc_tracking(CK_LOC_SHARED);
+  setup_messaging();
+  set_loc_tracking(CK_LOC_MESSAGE);
+  send_ctx_info(CK_CTX_SETUP);
+  record_loc_info("abc123.c", 10);
+  send_ctx_info(CK_CTX_TEST);
+  record_loc_info("abc124.c", 22);
+  record_loc_info("abc125.c", 25);
+  tr = receive_test_result(1);
+  teardown_messaging();
+
+  ck_assert_msg (tr != NULL,
+	       "No test result received");
+  ck_assert_msg (tr_ctx(tr) == CK_CTX_TEST,
+	       "Bad CTX received");
+  ck_assert_msg (strcmp(tr_lfile(tr), "abc125.c") == 0,
+	       "Bad loc file received");
+  ck_assert_msg (tr_lno(tr) == 25,
+	       "Bad loc line received");
+  if (tr != NULL)
+    tr_free(tr);
+}
+END_TEST
+
+START_TEST(test_record_shared_failure)
+{
+  TestResult *tr;
+  set_loc_tracking(CK_LOC_SHARED);
+  setup_messaging();
+  set_loc_tracking(CK_LOC_MESSAGE);
+  send_ctx_info(CK_CTX_SETUP);
+  record_loc_info("abc123.c", 10);
+  send_ctx_info(CK_CTX_TEST);
+  record_loc_info("abc124.c", 22);
+  send_failure_info("Oops");
+  record_loc_info("abc125.c", 25);
+  send_ctx_info(CK_CTX_TEARDOWN);
+  record_loc_info("abc126.c", 54);
+  tr = receive_test_result(0);
+  teardown_messaging();
+
+  ck_assert_msg (tr != NULL,
+	       "No test result received");
+  ck_assert_msg (tr_ctx(tr) == CK_CTX_TEST,
+	       "Bad CTX received");
+  ck_assert_msg (strcmp(tr_msg(tr), "Oops") == 0,
+	       "Bad failure msg received");
+  ck_assert_msg (strcmp(tr_lfile(tr), "abc124.c") == 0,
+	       "Bad loc file received");
+  ck_assert_msg (tr_lno(tr) == 22,
+	       "Bad loc line received");
+  if (tr != NULL)
+    tr_free(tr);
+}
+END_TEST
+
 Suite *make_msg_suite (void)
 {
   Suite *s;
@@ -183,6 +242,8 @@ Suite *make_msg_suite (void)
   tcase_add_test(tc, test_send_test_error);
   tcase_add_test(tc, test_send_with_passing_teardown);
   tcase_add_test(tc, test_send_with_error_teardown);
+  tcase_add_test(tc, test_record_shared);
+  tcase_add_test(tc, test_record_shared_failure);
   suite_add_tcase(s, tc);
   return s;
 }
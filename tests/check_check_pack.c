@@ -130,6 +130,103 @@ START_TEST(test_pack_ctx)
 }
 END_TEST
 
+START_TEST(test_pack_bench)
+{
+  BenchMsg bmsg;
+  uint64_t samples[3];
+  char *buf;
+  enum ck_msg_type type;
+
+  samples[0] = 1;
+  samples[1] = 0x123456789ULL;
+  samples[2] = 0xFFFFFFFFULL;
+  bmsg.iterations = 1000;
+  bmsg.nsamples = 3;
+  bmsg.sample_ns = samples;
+  pack (CK_MSG_BENCH, &buf, (CheckMsg *) &bmsg);
+
+  memset (&bmsg, 0, sizeof (bmsg));
+  upack (buf, (CheckMsg *) &bmsg, &type);
+
+  ck_assert_msg (type == CK_MSG_BENCH,
+	       "Bad type unpacked for BenchMsg");
+  ck_assert_int_eq (bmsg.iterations, 1000);
+  ck_assert_int_eq (bmsg.nsamples, 3);
+  ck_assert_msg (bmsg.sample_ns[0] == samples[0]
+                 && bmsg.sample_ns[1] == samples[1]
+                 && bmsg.sample_ns[2] == samples[2],
+                 "BenchMsg samples not unpacked");
+
+  free (bmsg.sample_ns);
+  free (buf);
+}
+END_TEST
+
+START_TEST(test_pack_perf)
+{
+  PerfMsg pmsg;
+  char *buf;
+  enum ck_msg_type type;
+
+  memset (&pmsg, 0, sizeof (pmsg));
+  pmsg.perf.hardware = 1;
+  pmsg.perf.cycles = 0x123456789LL;
+  pmsg.perf.instructions = 42;
+  pmsg.perf.branch_misses = 0;
+  pmsg.perf.cache_misses = 7;
+  pmsg.perf.task_clock = -1;
+  pmsg.perf.page_faults = -1;
+  pmsg.perf.context_switches = -1;
+  pack (CK_MSG_PERF, &buf, (CheckMsg *) &pmsg);
+
+  memset (&pmsg, 0, sizeof (pmsg));
+  upack (buf, (CheckMsg *) &pmsg, &type);
+
+  ck_assert_msg (type == CK_MSG_PERF,
+	       "Bad type unpacked for PerfMsg");
+  ck_assert_int_eq (pmsg.perf.hardware, 1);
+  ck_assert_msg (pmsg.perf.cycles == 0x123456789LL,
+                 "PerfMsg cycles not unpacked");
+  ck_assert_int_eq (pmsg.perf.instructions, 42);
+  ck_assert_int_eq (pmsg.perf.branch_misses, 0);
+  ck_assert_int_eq (pmsg.perf.cache_misses, 7);
+  ck_assert_int_eq (pmsg.perf.task_clock, -1);
+  ck_assert_int_eq (pmsg.perf.context_switches, -1);
+
+  free (buf);
+}
+END_TEST
+
+START_TEST(test_pack_alloc)
+{
+  AllocMsg amsg;
+  char *buf;
+  enum ck_msg_type type;
+
+  amsg.alloc.allocations = 3;
+  amsg.alloc.frees = 2;
+  amsg.alloc.bytes = 0x123456789LL;
+  amsg.alloc.peak_bytes = 240;
+  amsg.alloc.leaks = 1;
+  amsg.alloc.leaked_bytes = 200;
+  pack (CK_MSG_ALLOC, &buf, (CheckMsg *) &amsg);
+
+  memset (&amsg, 0, sizeof (amsg));
+  upack (buf, (CheckMsg *) &amsg, &type);
+
+  ck_assert_msg (type == CK_MSG_ALLOC,
+	       "Bad type unpacked for AllocMsg");
+  ck_assert_int_eq (amsg.alloc.allocations, 3);
+  ck_assert_int_eq (amsg.alloc.frees, 2);
+  ck_assert_msg (amsg.alloc.bytes == 0x123456789LL,
+                 "AllocMsg bytes not unpacked");
+  ck_assert_int_eq (amsg.alloc.peak_bytes, 240);
+  ck_assert_int_eq (amsg.alloc.leaks, 1);
+  ck_assert_int_eq (amsg.alloc.leaked_bytes, 200);
+
+  free (buf);
+}
+END_TEST
 
 START_TEST(test_pack_len)
 {
@@ -437,6 +534,89 @@ START_TEST(test_ppack_big)
 END_TEST
 #endif /* HAVE_FORK */
 
+START_TEST(test_ppack_ring)
+{
+  MsgRing *ring;
+  CtxMsg cmsg;
+  LocMsg lmsg;
+  FailMsg fmsg;
+  RcvMsg *rmsg;
+  int i;
+
+  ring = (MsgRing *) malloc(sizeof(MsgRing) + 64);
+  msg_ring_init(ring, 64);
+  cmsg.ctx = CK_CTX_TEST;
+  lmsg.file = (char *) "abc123.c";
+  fmsg.msg = (char *) "oops";
+
+  /* Each round ends past the end of the ring, so frames have to wrap */
+  for (i = 0; i < 5; i++)
+  {
+    lmsg.line = i;
+    ppack_ring (ring, NULL, CK_MSG_CTX, (CheckMsg *) &cmsg);
+    ppack_ring (ring, NULL, CK_MSG_LOC, (CheckMsg *) &lmsg);
+    rmsg = punpack_ring (ring, NULL);
+
+    ck_assert_msg (rmsg != NULL,
+                   "Return value from punpack_ring should always be malloc'ed");
+    ck_assert_int_eq (rmsg->lastctx, CK_CTX_TEST);
+    ck_assert_int_eq (rmsg->test_line, i);
+    ck_assert_str_eq (rmsg->test_file, "abc123.c");
+    ck_assert_int_eq (ring->spilled, 0);
+    rcvmsg_free(rmsg);
+  }
+
+  ppack_ring (ring, NULL, CK_MSG_CTX, (CheckMsg *) &cmsg);
+  ppack_ring (ring, NULL, CK_MSG_FAIL, (CheckMsg *) &fmsg);
+  rmsg = punpack_ring (ring, NULL);
+  ck_assert_str_eq (rmsg->msg, "oops");
+  rcvmsg_free(rmsg);
+
+  free(ring);
+}
+END_TEST
+
+START_TEST(test_ppack_ring_spill)
+{
+  FILE * overflow;
+  char * overflow_name = NULL;
+  MsgRing *ring;
+  CtxMsg cmsg;
+  LocMsg lmsg;
+  FailMsg fmsg;
+  RcvMsg *rmsg;
+  int i;
+
+  ring = (MsgRing *) malloc(sizeof(MsgRing) + 64);
+  msg_ring_init(ring, 64);
+  overflow = open_tmp_file(&overflow_name);
+  free(overflow_name);
+  cmsg.ctx = CK_CTX_TEST;
+  lmsg.file = (char *) "abc123.c";
+  fmsg.msg = (char *) "oops";
+
+  ppack_ring (ring, overflow, CK_MSG_CTX, (CheckMsg *) &cmsg);
+  for (i = 0; i < 100; i++)
+  {
+    lmsg.line = i;
+    ppack_ring (ring, overflow, CK_MSG_LOC, (CheckMsg *) &lmsg);
+  }
+  ppack_ring (ring, overflow, CK_MSG_FAIL, (CheckMsg *) &fmsg);
+
+  ck_assert_msg (ring->spilled != 0,
+                 "Messages should have been written to the overflow file");
+  rmsg = punpack_ring (ring, overflow);
+  ck_assert_int_eq (rmsg->lastctx, CK_CTX_TEST);
+  ck_assert_int_eq (rmsg->failctx, CK_CTX_TEST);
+  ck_assert_int_eq (rmsg->test_line, 99);
+  ck_assert_str_eq (rmsg->msg, "oops");
+  rcvmsg_free(rmsg);
+
+  fclose(overflow);
+  free(ring);
+}
+END_TEST
+
 Suite *make_pack_suite(void)
 {
 
@@ -452,6 +632,9 @@ Suite *make_pack_suite(void)
   tcase_add_test (tc_core, test_pack_fmsg);
   tcase_add_test (tc_core, test_pack_loc);
   tcase_add_test (tc_core, test_pack_ctx);
+  tcase_add_test (tc_core, test_pack_bench);
+  tcase_add_test (tc_core, test_pack_perf);
+  tcase_add_test (tc_core, test_pack_alloc);
   tcase_add_test (tc_core, test_pack_len);
   tcase_add_test (tc_core, test_pack_abuse);
 #if defined(HAVE_FORK) && HAVE_FORK==1
@@ -461,6 +644,8 @@ Suite *make_pack_suite(void)
   tcase_add_test (tc_core, test_ppack_multictx);
   tcase_add_test (tc_core, test_ppack_nofail);
 #endif /* HAVE_FORK */
+  tcase_add_test (tc_core, test_ppack_ring);
+  tcase_add_test (tc_core, test_ppack_ring_spill);
   suite_add_tcase (s, tc_limit);
   tcase_add_test (tc_limit, test_pack_ctx_limit);
   tcase_add_test (tc_limit, test_pack_fail_limit);
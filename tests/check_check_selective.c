@@ -22,8 +22,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include "check_check.h"
+#include "check_list.h"
+#include "check_impl.h"
 
 static SRunner *sr;
 static int test_tc11_executed;
@@ -81,6 +84,11 @@ static void selective_setup (void)
   tcase_add_test (tc21, test_tc21);
   suite_add_tcase (s2, tc21);
 
+  tcase_add_tag (tc11, "fast");
+  tcase_add_tag (tc12, "slow");
+  tcase_add_tag (tc21, "fast");
+  tcase_add_tag (tc21, "net");
+
   sr = srunner_create (s1);
   srunner_add_suite (sr, s2);
   srunner_set_fork_status (sr, CK_NOFORK);
@@ -326,6 +334,369 @@ START_TEST(test_srunner_suite_no_tcase_env)
 END_TEST
 #endif /* HAVE_DECL_SETENV */
 
+/* Which of test_tc11, test_tc12 and test_tc21 run, as "101" */
+static const struct
+{
+  const char *sname;
+  const char *filter;
+  const char *include_tags;
+  const char *exclude_tags;
+  const char *executed;
+} filter_cases[] = {
+  { NULL, "suite1", NULL, NULL, "110" },
+  { NULL, "suite?", NULL, NULL, "111" },
+  { NULL, "*:tcase1*", NULL, NULL, "110" },
+  { NULL, "suite1:tcase12", NULL, NULL, "010" },
+  { NULL, "-suite1:tcase11", NULL, NULL, "011" },
+  { NULL, "*:*:test_tc2?", NULL, NULL, "001" },
+  { NULL, "suite1,-*:*:test_tc12", NULL, NULL, "100" },
+  { NULL, " suite2 , suite1 : tcase11 ", NULL, NULL, "101" },
+  { NULL, "tcase11", NULL, NULL, "000" },
+  { NULL, "", NULL, NULL, "111" },
+  { "suite1", "*:tcase12", NULL, NULL, "010" },
+  { NULL, NULL, "fast", NULL, "101" },
+  { NULL, NULL, "slow", NULL, "010" },
+  { NULL, NULL, NULL, "fast", "010" },
+  { NULL, NULL, "fast,net", NULL, "101" },
+  { NULL, NULL, "fast", "net", "100" },
+  { NULL, NULL, " unknown ", NULL, "000" },
+  { NULL, "suite1", "fast", NULL, "100" },
+  { "suite2", NULL, NULL, "net", "000" },
+};
+
+START_TEST(test_srunner_filter)
+{
+  char executed[4];
+
+  srunner_set_filter (sr, filter_cases[_i].filter);
+  srunner_set_tags (sr, filter_cases[_i].include_tags,
+                    filter_cases[_i].exclude_tags);
+  srunner_run (sr, filter_cases[_i].sname, NULL, CK_SILENT);
+
+  executed[0] = test_tc11_executed ? '1' : '0';
+  executed[1] = test_tc12_executed ? '1' : '0';
+  executed[2] = test_tc21_executed ? '1' : '0';
+  executed[3] = '\0';
+  ck_assert_str_eq (executed, filter_cases[_i].executed);
+  reset_executed ();
+}
+END_TEST
+
+#if HAVE_DECL_SETENV
+START_TEST(test_srunner_filter_env)
+{
+  setenv ("CK_RUN_FILTER", "suite1", 1);
+  setenv ("CK_EXCLUDE_TAGS", "slow", 1);
+  ck_assert_str_eq (srunner_filter (sr), "suite1");
+  ck_assert_ptr_eq (srunner_include_tags (sr), NULL);
+  ck_assert_str_eq (srunner_exclude_tags (sr), "slow");
+  srunner_run (sr, NULL, NULL, CK_SILENT);
+  ck_assert (test_tc11_executed && !test_tc12_executed && !test_tc21_executed);
+  reset_executed ();
+
+  /* Set values take precedence */
+  srunner_set_filter (sr, "suite2");
+  srunner_set_tags (sr, "net", NULL);
+  ck_assert_str_eq (srunner_include_tags (sr), "net");
+  srunner_run (sr, NULL, NULL, CK_SILENT);
+  ck_assert (!test_tc11_executed && !test_tc12_executed && test_tc21_executed);
+  reset_executed ();
+
+  unsetenv ("CK_RUN_FILTER");
+  unsetenv ("CK_EXCLUDE_TAGS");
+}
+END_TEST
+#endif /* HAVE_DECL_SETENV */
+
+static int many_executed;
+
+START_TEST(test_many_sub)
+{
+  many_executed++;
+}
+END_TEST
+
+START_TEST(test_many_late)
+{
+  many_executed += 1000;
+}
+END_TEST
+
+/* A few test cases found by name among many, in the order added */
+START_TEST(test_srunner_filter_many)
+{
+  char names[2][200][8];
+  SRunner *sr_many;
+  TestResult **trs;
+  Suite *s = NULL;
+  TCase *tc;
+  int i, k;
+
+  sr_many = srunner_create (NULL);
+  for (i = 0; i < 200; i++)
+    {
+      snprintf (names[0][i], sizeof (names[0][i]), "S%d", i);
+      snprintf (names[1][i], sizeof (names[1][i]), "T%d", i);
+      s = suite_create (names[0][i]);
+      for (k = 0; k < 200; k++)
+        {
+          tc = tcase_create (names[1][k]);
+          tcase_add_test (tc, test_many_sub);
+          if (k == i)
+            tcase_add_tag (tc, "diagonal");
+          suite_add_tcase (s, tc);
+        }
+      srunner_add_suite (sr_many, s);
+    }
+  srunner_set_fork_status (sr_many, CK_NOFORK);
+
+  many_executed = 0;
+  srunner_set_filter (sr_many, "S7:T3,S150:T199,S7:T1,-S150");
+  srunner_run (sr_many, NULL, NULL, CK_SILENT);
+  ck_assert_int_eq (many_executed, 2);
+  trs = srunner_results (sr_many);
+  ck_assert_str_eq (trs[0]->tcname, "T1");
+  ck_assert_str_eq (trs[1]->tcname, "T3");
+  free (trs);
+
+  many_executed = 0;
+  srunner_set_filter (sr_many, NULL);
+  srunner_set_tags (sr_many, "diagonal", NULL);
+  srunner_run (sr_many, NULL, NULL, CK_SILENT);
+  ck_assert_int_eq (many_executed, 200);
+
+  /* Found by its test name, though added after the suite was */
+  tc = tcase_create ("Late");
+  tcase_add_test (tc, test_many_late);
+  suite_add_tcase (s, tc);
+  many_executed = 0;
+  srunner_set_filter (sr_many, "*:*:test_many_late");
+  srunner_set_tags (sr_many, NULL, NULL);
+  srunner_run (sr_many, NULL, NULL, CK_SILENT);
+  ck_assert_int_eq (many_executed, 1000);
+
+  srunner_free (sr_many);
+}
+END_TEST
+
+START_TEST(test_shard_sub_pass)
+{
+}
+END_TEST
+
+START_TEST(test_shard_sub_loop)
+{
+}
+END_TEST
+
+#define SHARD_SUB_NTESTS 25
+
+static SRunner *shard_srunner_create (void)
+{
+  Suite *s1, *s2;
+  TCase *tc;
+  SRunner *sr_shard;
+
+  s1 = suite_create ("Shard Sub 1");
+  tc = tcase_create ("Loop");
+  tcase_add_loop_test (tc, test_shard_sub_loop, 0, 20);
+  suite_add_tcase (s1, tc);
+  tc = tcase_create ("Pass");
+  tcase_add_test (tc, test_shard_sub_pass);
+  suite_add_tcase (s1, tc);
+
+  s2 = suite_create ("Shard Sub 2");
+  tc = tcase_create ("Mixed");
+  tcase_add_test (tc, test_shard_sub_pass);
+  tcase_add_loop_test (tc, test_shard_sub_loop, 0, 3);
+  suite_add_tcase (s2, tc);
+
+  sr_shard = srunner_create (s1);
+  srunner_add_suite (sr_shard, s2);
+  return sr_shard;
+}
+
+/* A number for each test of shard_srunner_create() */
+static int shard_sub_index (TestResult *tr)
+{
+  if (strcmp (tr->tcname, "Loop") == 0)
+    return tr->iter;
+  if (strcmp (tr->tcname, "Pass") == 0)
+    return 20;
+  if (strcmp (tr->tname, "test_shard_sub_pass") == 0)
+    return 21;
+  return 22 + tr->iter;
+}
+
+/*
+ * Every iteration of every test runs in exactly one of the shards, by
+ * hash or, with a duration file, by the durations of an earlier run.
+ */
+START_TEST(test_shard_each_test_once)
+{
+  const char *fname = "test_durations_shard";
+  const int nshards = 3;
+  int seen[SHARD_SUB_NTESTS];
+  unsigned char history[4096];
+  size_t history_len = 0;
+  int shard;
+  int k;
+
+  memset (seen, 0, sizeof (seen));
+  remove (fname);
+
+  if (_i == 1)
+    {
+      SRunner *sr_all = shard_srunner_create ();
+      FILE *f;
+
+      srunner_set_fork_status (sr_all, CK_NOFORK);
+      srunner_set_duration_file (sr_all, fname);
+      srunner_run (sr_all, NULL, NULL, CK_SILENT);
+      ck_assert_int_eq (srunner_ntests_run (sr_all), SHARD_SUB_NTESTS);
+      srunner_free (sr_all);
+
+      f = fopen (fname, "rb");
+      ck_assert_ptr_ne (f, NULL);
+      history_len = fread (history, 1, sizeof (history), f);
+      fclose (f);
+    }
+
+  for (shard = 0; shard < nshards; shard++)
+    {
+      SRunner *sr_shard = shard_srunner_create ();
+      TestResult **trs;
+      int n;
+
+      switch (_i)
+        {
+        case 0:
+        case 1:
+          srunner_set_fork_status (sr_shard, CK_NOFORK);
+          break;
+        case 2:
+          srunner_set_fork_status (sr_shard, CK_FORK);
+          break;
+        default:
+          srunner_set_fork_status (sr_shard, CK_FORK_BATCH);
+          break;
+        }
+      srunner_set_shard (sr_shard, shard, nshards);
+      if (_i == 1)
+        {
+          /* Each shard starts from the same durations */
+          FILE *f = fopen (fname, "wb");
+
+          ck_assert_ptr_ne (f, NULL);
+          ck_assert_int_eq (fwrite (history, 1, history_len, f), history_len);
+          fclose (f);
+          srunner_set_duration_file (sr_shard, fname);
+        }
+      srunner_run (sr_shard, NULL, NULL, CK_SILENT);
+
+      n = srunner_ntests_run (sr_shard);
+      ck_assert_int_lt (n, SHARD_SUB_NTESTS);
+      trs = srunner_results (sr_shard);
+      for (k = 0; k < n; k++)
+        {
+          ck_assert_int_eq (tr_rtype (trs[k]), CK_PASS);
+          seen[shard_sub_index (trs[k])]++;
+        }
+      free (trs);
+      srunner_free (sr_shard);
+    }
+
+  for (k = 0; k < SHARD_SUB_NTESTS; k++)
+    ck_assert_msg (seen[k] == 1, "Test %d ran %d times", k, seen[k]);
+  remove (fname);
+}
+END_TEST
+
+START_TEST(test_shard_file)
+{
+  const char *fname = "test_shard_summary";
+  SRunner *sr_shard = shard_srunner_create ();
+  char line[256];
+  char expected[64];
+  FILE *f;
+  int nlines = 0;
+  int n;
+
+  srunner_set_fork_status (sr_shard, CK_NOFORK);
+  srunner_set_shard (sr_shard, 1, 2);
+  srunner_set_shard_file (sr_shard, fname);
+  ck_assert_int_eq (srunner_has_shard_file (sr_shard), 1);
+  ck_assert_str_eq (srunner_shard_fname (sr_shard), fname);
+  srunner_run (sr_shard, NULL, NULL, CK_SILENT);
+  n = srunner_ntests_run (sr_shard);
+
+  f = fopen (fname, "r");
+  ck_assert_ptr_ne (f, NULL);
+  ck_assert_ptr_ne (fgets (line, sizeof (line), f), NULL);
+  snprintf (expected, sizeof (expected),
+            "# Check shard 1 of 2: %d of %d tests\n", n, SHARD_SUB_NTESTS);
+  ck_assert_str_eq (line, expected);
+  while (fgets (line, sizeof (line), f) != NULL)
+    {
+      ck_assert_msg (strncmp (line, "Shard Sub ", 10) == 0
+                     && strchr (line, '\t') != NULL,
+                     "Bad line in shard file: %s", line);
+      nlines++;
+    }
+  fclose (f);
+  ck_assert_int_eq (nlines, n);
+
+  srunner_free (sr_shard);
+  remove (fname);
+}
+END_TEST
+
+START_TEST(test_shard_default)
+{
+  SRunner *sr_shard = srunner_create (NULL);
+
+  unsetenv ("CK_SHARD_INDEX");
+  unsetenv ("CK_SHARD_COUNT");
+  unsetenv ("CK_SHARD_FILE_NAME");
+  ck_assert_int_eq (srunner_shard_index (sr_shard), 0);
+  ck_assert_int_eq (srunner_shard_count (sr_shard), 1);
+  ck_assert_int_eq (srunner_has_shard_file (sr_shard), 0);
+  srunner_set_shard (sr_shard, 2, 5);
+  ck_assert_int_eq (srunner_shard_index (sr_shard), 2);
+  ck_assert_int_eq (srunner_shard_count (sr_shard), 5);
+  srunner_free (sr_shard);
+}
+END_TEST
+
+#if HAVE_DECL_SETENV
+START_TEST(test_shard_env)
+{
+  SRunner *sr_shard = srunner_create (NULL);
+
+  setenv ("CK_SHARD_INDEX", "1", 1);
+  setenv ("CK_SHARD_COUNT", "4", 1);
+  ck_assert_int_eq (srunner_shard_index (sr_shard), 1);
+  ck_assert_int_eq (srunner_shard_count (sr_shard), 4);
+
+  /* An index out of range runs all tests */
+  setenv ("CK_SHARD_INDEX", "4", 1);
+  ck_assert_int_eq (srunner_shard_index (sr_shard), 0);
+  ck_assert_int_eq (srunner_shard_count (sr_shard), 1);
+
+  setenv ("CK_SHARD_INDEX", "1", 1);
+  srunner_set_shard (sr_shard, 0, 2);
+  ck_assert_int_eq (srunner_shard_index (sr_shard), 0);
+  ck_assert_int_eq (srunner_shard_count (sr_shard), 2);
+  srunner_set_shard (sr_shard, 0, -1);
+  ck_assert_int_eq (srunner_shard_count (sr_shard), 4);
+
+  unsetenv ("CK_SHARD_INDEX");
+  unsetenv ("CK_SHARD_COUNT");
+  srunner_free (sr_shard);
+}
+END_TEST
+#endif /* HAVE_DECL_SETENV */
+
 Suite *make_selective_suite (void)
 {
   Suite *s = suite_create ("SelectiveTesting");
@@ -352,5 +723,30 @@ Suite *make_selective_suite (void)
   tcase_add_unchecked_fixture (tc,
                                selective_setup,
                                selective_teardown);
+
+  tc = tcase_create ("Filter");
+  suite_add_tcase (s, tc);
+  tcase_add_loop_test (tc, test_srunner_filter, 0,
+                       sizeof (filter_cases) / sizeof (filter_cases[0]));
+#if HAVE_DECL_SETENV
+  tcase_add_test (tc, test_srunner_filter_env);
+#endif /* HAVE_DECL_SETENV */
+  tcase_add_test (tc, test_srunner_filter_many);
+  tcase_add_unchecked_fixture (tc,
+                               selective_setup,
+                               selective_teardown);
+
+  tc = tcase_create ("Shard");
+  suite_add_tcase (s, tc);
+  tcase_add_test (tc, test_shard_default);
+#if HAVE_DECL_SETENV
+  tcase_add_test (tc, test_shard_env);
+#endif /* HAVE_DECL_SETENV */
+  tcase_add_test (tc, test_shard_file);
+#if defined(HAVE_FORK) && HAVE_FORK==1
+  tcase_add_loop_test (tc, test_shard_each_test_once, 0, 4);
+#else
+  tcase_add_loop_test (tc, test_shard_each_test_once, 0, 2);
+#endif /* HAVE_FORK */
   return s;
 }
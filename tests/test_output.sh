@@ -47,6 +47,10 @@ act_normal_env_blank=`./ex_output${EXEEXT} CK_ENV  STDOUT NORMAL | tr -d "\r"`
 act_normal_env_invalid=`CK_VERBOSITY='BLARGS' ./ex_output${EXEEXT} CK_ENV  STDOUT NORMAL | tr -d "\r"`
 act_verbose=`./ex_output${EXEEXT} CK_VERBOSE STDOUT NORMAL | tr -d "\r"`
 act_verbose_env=`CK_VERBOSITY=verbose ./ex_output${EXEEXT} CK_ENV STDOUT NORMAL | tr -d "\r"`
+act_verbose_shared=`CK_LOC_TRACKING=shared ./ex_output${EXEEXT} CK_VERBOSE STDOUT NORMAL | tr -d "\r"`
+act_verbose_jobs=`CK_JOBS=4 ./ex_output${EXEEXT} CK_VERBOSE STDOUT NORMAL | tr -d "\r"`
+act_verbose_fork_server=`CK_FORK_SERVER=yes CK_JOBS=4 ./ex_output${EXEEXT} CK_VERBOSE STDOUT NORMAL | tr -d "\r"`
+act_verbose_batch=`CK_FORK=batch ./ex_output${EXEEXT} CK_VERBOSE STDOUT NORMAL | tr -d "\r"`
 act_verbose_dump_env=`CK_VERBOSITY=verbose ./ex_output${EXEEXT} CK_ENV STDOUT_DUMP NORMAL | tr -d "\r"`
 if test 1 -eq $ENABLE_SUBUNIT; then
 act_subunit=`./ex_output${EXEEXT} CK_SUBUNIT STDOUT NORMAL | tr -d "\r"`
@@ -59,6 +63,8 @@ tap_stdout=`                             ./ex_output${EXEEXT} CK_SILENT TAP_STDO
 tap_env_stdout=`CK_TAP_LOG_FILE_NAME="-" ./ex_output${EXEEXT} CK_SILENT STDOUT NORMAL`
 xml_stdout=`                             ./ex_output${EXEEXT} CK_SILENT XML_STDOUT NORMAL  | tr -d "\r" | grep -v \<duration\> | grep -v \<datetime\> | grep -v \<path\>`
 xml_env_stdout=`CK_XML_LOG_FILE_NAME="-" ./ex_output${EXEEXT} CK_SILENT STDOUT NORMAL      | tr -d "\r" | grep -v \<duration\> | grep -v \<datetime\> | grep -v \<path\>`
+xml_jobs_stdout=`CK_JOBS=4               ./ex_output${EXEEXT} CK_SILENT XML_STDOUT NORMAL  | tr -d "\r" | grep -v \<duration\> | grep -v \<datetime\> | grep -v \<path\>`
+tap_jobs_stdout=`CK_JOBS=4               ./ex_output${EXEEXT} CK_SILENT TAP_STDOUT NORMAL`
 
 test_output ( ) {
     if [ "x${1}" != "x${2}" ]; then
@@ -82,6 +88,10 @@ test_output "$exp_normal"  "$act_normal_env_blank"   "CK_ENV STDOUT NORMAL";
 test_output "$exp_normal"  "$act_normal_env_invalid" "CK_ENV STDOUT NORMAL";
 test_output "$exp_verbose" "$act_verbose"            "CK_VERBOSE STDOUT NORMAL";
 test_output "$exp_verbose" "$act_verbose_env"        "CK_ENV STDOUT NORMAL";
+test_output "$exp_verbose" "$act_verbose_shared"     "CK_VERBOSE STDOUT NORMAL (with shared locations)";
+test_output "$exp_verbose" "$act_verbose_jobs"       "CK_VERBOSE STDOUT NORMAL (with 4 jobs)";
+test_output "$exp_verbose" "$act_verbose_fork_server" "CK_VERBOSE STDOUT NORMAL (with a fork server)";
+test_output "$exp_verbose" "$act_verbose_batch"      "CK_VERBOSE STDOUT NORMAL (in batch mode)";
 
 test_output "$exp_silent_dump"  "$act_silent_dump_env"  "CK_ENV STDOUT_DUMP NORMAL (for silent)"
 test_output "$exp_minimal_dump" "$act_minimal_dump_env" "CK_ENV STDOUT_DUMP NORMAL (for minimal)"
@@ -94,6 +104,8 @@ test_output "${expected_xml}"        "${xml_stdout}"     "CK_SILENT XML_STDOUT N
 test_output "${expected_xml}"        "${xml_env_stdout}" "CK_SILENT STDOUT     NORMAL (with xml env = '-')"
 test_output "${expected_normal_tap}" "${tap_stdout}"     "CK_SILENT TAP_STDOUT NORMAL"
 test_output "${expected_normal_tap}" "${tap_env_stdout}" "CK_SILENT STDOUT     NORMAL (with tap env = '-')"
+test_output "${expected_xml}"        "${xml_jobs_stdout}"  "CK_SILENT XML_STDOUT NORMAL (with 4 jobs)"
+test_output "${expected_normal_tap}" "${tap_jobs_stdout}"  "CK_SILENT TAP_STDOUT NORMAL (with 4 jobs)"
 
 if test 1 -eq $ENABLE_SUBUNIT; then
     test_output "$exp_subunit"      "$act_subunit"          "CK_SUBUNIT STDOUT NORMAL";